@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+struct TermState{
+	bool bold : 1;
+	bool italic : 1;
+	bool faint : 1;
+	bool underline : 1;
+	bool blink : 1;
+	bool reverse : 1;
+	bool strikethrough: 1;
+
+	uint8_t fgColour;
+	uint8_t bgColour;
+};
+
+struct TerminalChar {
+	TermState s;
+	char c;
+};
+
+using TerminalLine = std::vector<TerminalChar>;
+
+// Fixed capacity ring buffer of lines
+// Once full the oldest line is recycled, keeping its allocation
+class TerminalBuffer {
+public:
+	TerminalBuffer(int capacity) : lines(capacity) {}
+
+	inline int Count() const { return count; }
+	inline int Capacity() const { return static_cast<int>(lines.size()); }
+
+	inline TerminalLine& operator[](int index) { return lines[(head + index) % lines.size()]; }
+
+	// Append an empty line, returns true if the oldest line was discarded to make room
+	bool PushBack(){
+		if(count < Capacity()){
+			(*this)[count++].clear();
+			return false;
+		}
+
+		lines[head].clear();
+		head = (head + 1) % lines.size();
+		return true;
+	}
+
+	void Clear(){
+		for(TerminalLine& line : lines){
+			line.clear(); // Keep the allocation
+		}
+
+		head = 0;
+		count = 0;
+	}
+
+	// Insert n blank lines at index, lines in [index, end) move down and those pushed past end are discarded
+	void InsertLines(int index, int end, int n){
+		n = std::min(n, end - index);
+		for(int i = end - 1; i >= index + n; i--){
+			std::swap((*this)[i], (*this)[i - n]);
+		}
+
+		for(int i = index; i < index + n; i++){
+			(*this)[i].clear();
+		}
+	}
+
+	// Delete n lines at index, lines in [index + n, end) move up and blank lines fill in at end
+	void DeleteLines(int index, int end, int n){
+		n = std::min(n, end - index);
+		for(int i = index; i + n < end; i++){
+			std::swap((*this)[i], (*this)[i + n]);
+		}
+
+		for(int i = end - n; i < end; i++){
+			(*this)[i].clear();
+		}
+	}
+
+private:
+	std::vector<TerminalLine> lines;
+	int head = 0; // Index of the oldest line
+	int count = 0;
+};
@@ -17,9 +17,13 @@
 #include <sys/ioctl.h>
 #include <sys/wait.h>
 
+#include <time.h>
+
+#include <atomic>
 #include <vector>
 #include <mutex>
 
+#include "buffer.h"
 #include "escape.h"
 #include "colours.h"
 
@@ -32,24 +36,11 @@
 
 Lemon::GUI::Window* window;
 
-bool paint = true;
+std::atomic<bool> paint = true;
 bool paintAll = true;
 
 std::mutex paintLock;
 
-struct TermState{
-	bool bold : 1;
-	bool italic : 1;
-	bool faint : 1;
-	bool underline : 1;
-	bool blink : 1;
-	bool reverse : 1;
-	bool strikethrough: 1;
-
-	uint8_t fgColour;
-	uint8_t bgColour;
-};
-
 TermState defaultState {
 	.bold = 0,
 	.italic = 0,
@@ -62,11 +53,6 @@ TermState defaultState {
 	.bgColour = 0,
 };
 
-struct TerminalChar {
-	TermState s;
-	char c;
-};
-
 rgba_colour_t* colours = coloursProfile2;
 
 Lemon::Graphics::Font* terminalFont;
@@ -79,10 +65,19 @@ int escapeType = 0;
 surface_t menuSurface;
 surface_t windowSurface;
 
+const int scrollbackLines = 2000;
+const long frameInterval = 16; // Minimum time between paints in ms
+
 int bufferOffset = 0;
 int columnCount = 80;
 int rowCount = 25;
-std::vector<std::vector<TerminalChar>> buffer;
+TerminalBuffer buffer(scrollbackLines);
+
+surface_t termSurface; // Persistent surface, only dirty rows are redrawn before being copied to the window
+std::vector<bool> dirtyRows; // Rows of the screen that need to be redrawn
+int pendingScroll = 0; // Amount of rows the contents of termSurface need to be moved up by
+vector2i_t lastCursorPos = {0, 0}; // Where the cursor was last drawn
+timespec lastPaint = {0, 0};
 
 vector2i_t curPos = {0, 0};
 vector2i_t storedCurPos = {0, 0};
@@ -96,54 +91,145 @@ char charactersPerLine; // Characters displayed per line
 int masterPTYFd; // PTY file desc
 pid_t lsh; // LSh Process PID
 
-void Scroll(){
-	if(curPos.y >= rowCount){
-		bufferOffset += curPos.y - (rowCount - 1);
-		curPos.y = rowCount - 1;
+void MarkDirty(int row){
+	if(row >= 0 && row < static_cast<int>(dirtyRows.size())){
+		dirtyRows[row] = true;
 	}
+}
 
-	while(static_cast<std::size_t>(bufferOffset + rowCount) >= buffer.size()) buffer.push_back(std::vector<TerminalChar>());
-			
-	if(buffer.size() > 2000){
-		buffer.erase(buffer.begin() + 2000, buffer.end());
+void MarkDirty(int begin, int end){
+	for(int i = begin; i < end; i++){
+		MarkDirty(i);
 	}
-	
+}
+
+// Make sure there are lines for every row on screen
+void FillScreen(){
+	while(bufferOffset + rowCount > buffer.Count()){
+		if(buffer.PushBack()){
+			bufferOffset--; // Oldest line was discarded
+		}
+	}
+}
+
+// Move the screen down by amount lines
+void ScrollScreen(int amount){
+	bufferOffset += amount;
+	FillScreen();
+
+	if(paintAll){
+		return;
+	}
+
+	pendingScroll += amount;
+	if(pendingScroll >= rowCount){
+		paintAll = true; // Nothing on screen can be reused
+		return;
+	}
+
+	int rows = static_cast<int>(dirtyRows.size());
+	amount = std::min(amount, rows);
+	std::move(dirtyRows.begin() + amount, dirtyRows.end(), dirtyRows.begin());
+	std::fill(dirtyRows.end() - amount, dirtyRows.end(), true); // Newly exposed rows
+}
+
+void ClearScreen(){
+	buffer.Clear();
+	curPos = {0, 0};
+	bufferOffset = 0;
+	FillScreen();
+
 	paintAll = true;
 }
 
-void OnPaint(surface_t* surface){
+void Scroll(){
+	if(curPos.y >= rowCount){
+		int amount = curPos.y - (rowCount - 1);
+		curPos.y = rowCount - 1;
+		ScrollScreen(amount);
+	} else {
+		FillScreen();
+	}
+}
+
+void PaintRow(int row){
 	int fontHeight = terminalFont->lineHeight;
+	int y = row * fontHeight;
 
-	paintAll = true;
+	int j = 0;
+	if(bufferOffset + row < buffer.Count()){
+		TerminalLine& line = buffer[bufferOffset + row];
+		int lineLength = std::min(static_cast<int>(line.size()), columnCount + 1);
 
-	if(paintAll){
-		for(int i = 0; i < rowCount && (bufferOffset + i) < static_cast<int>(buffer.size()); i++){
-			int j = 0;
-			for(; j < static_cast<int>(buffer[bufferOffset + i].size()); j++){
-				TerminalChar ch = buffer[bufferOffset + i][j];
-				rgba_colour_t fg = colours[ch.s.fgColour];
-				rgba_colour_t bg = colours[ch.s.bgColour];
-				Lemon::Graphics::DrawRect(j * 8, i * fontHeight, 8, fontHeight, bg.r, bg.g, bg.b, surface);
-				Lemon::Graphics::DrawChar(ch.c, j * 8, i * fontHeight, fg.r, fg.g, fg.b, surface, terminalFont);
+		// Draw backgrounds in runs of the same colour
+		while(j < lineLength){
+			uint8_t bgColour = line[j].s.bgColour;
+
+			int runStart = j;
+			while(j < lineLength && line[j].s.bgColour == bgColour){
+				j++;
 			}
-			
-			Lemon::Graphics::DrawRect(j * 8, i * fontHeight, window->GetSize().x - j * 8, fontHeight, colours[state.bgColour], surface);
+
+			Lemon::Graphics::DrawRect(runStart * 8, y, (j - runStart) * 8, fontHeight, colours[bgColour], &termSurface);
 		}
-	} else if(static_cast<unsigned>(curPos.y) < buffer.size()) {
-		int j = 0;
-		for(; j < static_cast<int>(buffer[bufferOffset + curPos.y].size()); j++){
-			TerminalChar ch = buffer[bufferOffset + curPos.y][j];
+
+		for(int k = 0; k < lineLength; k++){
+			const TerminalChar& ch = line[k];
+			if(ch.c == ' '){
+				continue;
+			}
+
 			rgba_colour_t fg = colours[ch.s.fgColour];
-			rgba_colour_t bg = colours[ch.s.bgColour];
-			Lemon::Graphics::DrawRect(j * 8, curPos.y * fontHeight, 8, fontHeight, bg.r, bg.g, bg.b, surface);
-			Lemon::Graphics::DrawChar(ch.c, j * 8, curPos.y * fontHeight, fg.r, fg.g, fg.b, surface, terminalFont);
+			Lemon::Graphics::DrawChar(ch.c, k * 8, y, fg.r, fg.g, fg.b, &termSurface, terminalFont);
 		}
+	}
+
+	Lemon::Graphics::DrawRect(j * 8, y, termSurface.width - j * 8, fontHeight, colours[state.bgColour], &termSurface);
+}
+
+void OnPaint(surface_t* surface){
+	int fontHeight = terminalFont->lineHeight;
 
-		Lemon::Graphics::DrawRect(j * 8, curPos.y * fontHeight, window->GetSize().x -  j * 8, fontHeight, colours[state.bgColour], surface);
+	if(termSurface.width != surface->width || termSurface.height != surface->height){
+		delete[] termSurface.buffer;
+
+		termSurface = {.width = surface->width, .height = surface->height, .depth = 32, .buffer = new uint8_t[surface->width * surface->height * 4]};
+		paintAll = true;
 	}
 
-	Lemon::Graphics::DrawRect(curPos.x * 8, curPos.y * fontHeight + (fontHeight / 4 * 3), 8, fontHeight / 4, colours[0x7] /* Grey */, surface);
+	if(static_cast<int>(dirtyRows.size()) != rowCount){
+		dirtyRows.resize(rowCount);
+		paintAll = true;
+	}
+
+	if(paintAll){
+		std::fill(dirtyRows.begin(), dirtyRows.end(), true);
+
+		// Clear the area below the last row
+		Lemon::Graphics::DrawRect(0, rowCount * fontHeight, termSurface.width, termSurface.height - rowCount * fontHeight, colours[state.bgColour], &termSurface);
+	} else if(pendingScroll > 0){
+		// Move what is still on screen up and only redraw the exposed rows
+		size_t pitch = termSurface.width * 4;
+		memmove(termSurface.buffer, termSurface.buffer + pendingScroll * fontHeight * pitch, (rowCount - pendingScroll) * fontHeight * pitch);
+	}
 
+	// Erase the old cursor, which has moved along with the contents
+	MarkDirty(lastCursorPos.y - (paintAll ? 0 : pendingScroll));
+	MarkDirty(curPos.y);
+
+	for(int i = 0; i < rowCount; i++){
+		if(dirtyRows[i]){
+			PaintRow(i);
+			dirtyRows[i] = false;
+		}
+	}
+
+	Lemon::Graphics::DrawRect(curPos.x * 8, curPos.y * fontHeight + (fontHeight / 4 * 3), 8, fontHeight / 4, colours[0x7] /* Grey */, &termSurface);
+	lastCursorPos = curPos;
+
+	Lemon::Graphics::surfacecpy(surface, &termSurface);
+
+	pendingScroll = 0;
 	paintAll = false;
 }
 
@@ -232,8 +318,6 @@ void DoAnsiCSI(char ch){
 
 			curPos.y -= amount;
 			if(curPos.y < 0) curPos.y = 0;
-
-			paintAll = true;
 			break;
 		}
 	case ANSI_CSI_CUD:
@@ -245,8 +329,6 @@ void DoAnsiCSI(char ch){
 
 			curPos.y += amount;
 			Scroll();
-
-			paintAll = true;
 			break;
 		}
 	case ANSI_CSI_CUF:
@@ -273,8 +355,6 @@ void DoAnsiCSI(char ch){
 			if(curPos.x < 0) {
 				curPos.x = columnCount - 1;
 				curPos.y--;
-
-				paintAll = true;
 			}
 			if(curPos.y < 0) curPos.y = 0;
 			break;
@@ -297,8 +377,6 @@ void DoAnsiCSI(char ch){
 				curPos.x = 0;
 				curPos.y = 0;
 			}
-
-			paintAll = true;
 		}
 		break;
 	case ANSI_CSI_ED:
@@ -306,20 +384,14 @@ void DoAnsiCSI(char ch){
 			int num = atoi(escBuf);
 			switch(num){
 				case 0: // Clear entire screen from cursor
-					for(int i = curPos.y + 1; i < rowCount && i + bufferOffset < static_cast<int>(buffer.size()); i++){
+					for(int i = curPos.y + 1; i < rowCount && i + bufferOffset < buffer.Count(); i++){
 						buffer[bufferOffset + i].clear();
 					}
-					paintAll = true;
+					MarkDirty(curPos.y + 1, rowCount);
 					break;
 				case 1: // Clear screen and move cursor
 				case 2: // Same as 1 but delete everything in the scrollback buffer
-					buffer.clear();
-					curPos = {0, 0};
-					bufferOffset = 0;
-					for(int i = 0; i < rowCount; i++){
-						buffer.push_back(std::vector<TerminalChar>());
-					}
-					paintAll = true;
+					ClearScreen();
 					break;
 			}
 		}
@@ -334,15 +406,10 @@ void DoAnsiCSI(char ch){
 			switch (n)
 			{
 			case 2: // Clear entire screen
-				curPos.y = 0;
-				curPos.x = 0;
-
-				bufferOffset = 0;
-				buffer.clear();
-				paintAll = true;
+				ClearScreen();
 				break;
 			case 1: // Clear from cursor to beginning of line
-				if(bufferOffset + curPos.y < static_cast<int>(buffer.size())){
+				if(bufferOffset + curPos.y < buffer.Count()){
 					if(curPos.x < static_cast<int>(buffer[bufferOffset + curPos.y].size())){
 						buffer[bufferOffset + curPos.y].erase(buffer[bufferOffset + curPos.y].begin(), buffer[bufferOffset + curPos.y].begin() + curPos.x);
 					} else {
@@ -350,59 +417,55 @@ void DoAnsiCSI(char ch){
 					}
 					curPos.x = 0;
 				}
+				MarkDirty(curPos.y);
 				break;
 			case 0: // Clear from cursor to end of line
 			default:
-				buffer[bufferOffset + curPos.y].erase(buffer[bufferOffset + curPos.y].begin() + curPos.x, buffer[bufferOffset + curPos.y].end());
+				if(curPos.x < static_cast<int>(buffer[bufferOffset + curPos.y].size())){
+					buffer[bufferOffset + curPos.y].erase(buffer[bufferOffset + curPos.y].begin() + curPos.x, buffer[bufferOffset + curPos.y].end());
+				}
+				MarkDirty(curPos.y);
 				break;
 			}
 			break;
 		}
 	case ANSI_CSI_IL: // Insert blank lines
 		{
-			int amount = atoi(escBuf);
-			buffer.insert(buffer.begin() + bufferOffset + curPos.y, amount, std::vector<TerminalChar>());
+			int amount = 1;
+			if(strlen(escBuf)){
+				amount = atoi(escBuf);
+			}
 
-			paintAll = true;
+			buffer.InsertLines(bufferOffset + curPos.y, bufferOffset + rowCount, amount);
+			MarkDirty(curPos.y, rowCount);
 			break;
 		}
 	case ANSI_CSI_DL:
 		{
-			int amount = atoi(escBuf);
-			buffer.erase(buffer.begin() + bufferOffset + curPos.y - amount, buffer.begin() + bufferOffset + curPos.y);
-
-			while(static_cast<int>(buffer.size()) - bufferOffset < rowCount){
-				buffer.push_back(std::vector<TerminalChar>());
+			int amount = 1;
+			if(strlen(escBuf)){
+				amount = atoi(escBuf);
 			}
 
-			paintAll = true;
+			buffer.DeleteLines(bufferOffset + curPos.y, bufferOffset + rowCount, amount);
+			MarkDirty(curPos.y, rowCount);
 			break;
 		}
 	case ANSI_CSI_SU: // Scroll Up
 		if(strlen(escBuf)){
-			bufferOffset += atoi(escBuf);
+			ScrollScreen(atoi(escBuf));
 		} else {
-			bufferOffset++;
+			ScrollScreen(1);
 		}
-
-		while(static_cast<int>(buffer.size()) - bufferOffset < rowCount){
-			buffer.push_back(std::vector<TerminalChar>());
-		}
-
-		paintAll = true;
 		break;
 	case ANSI_CSI_SD: // Scroll Down
 		if(strlen(escBuf)){
-			buffer.insert(buffer.begin() + bufferOffset, atoi(escBuf), std::vector<TerminalChar>());
-			//bufferOffset -= atoi(escBuf);
-
-			paintAll = true;
+			buffer.InsertLines(bufferOffset, bufferOffset + rowCount, atoi(escBuf));
 		} else {
-			buffer.insert(buffer.begin() + bufferOffset, 1, std::vector<TerminalChar>());
-			//bufferOffset--;
-
-			paintAll = true;
+			buffer.InsertLines(bufferOffset, bufferOffset + rowCount, 1);
 		}
+
+		MarkDirty(0, rowCount);
 		break;
 	default:
 		//fprintf(stderr, "Unknown Control Sbequence Introducer (CSI) '%c'\n", ch);
@@ -443,12 +506,7 @@ void PrintChar(char ch){
 			}
 		} else if (escapeType == ANSI_RIS){
 			state = defaultState;
-			buffer.clear();
-			curPos = {0, 0};
-			bufferOffset = 0;
-			for(int i = 0; i < rowCount; i++){
-				buffer.push_back(std::vector<TerminalChar>());
-			}
+			ClearScreen();
 		} else if(escapeType == ESC_SAVE_CURSOR) {
 			storedCurPos = curPos;	
 		} else if(escapeType == ESC_RESTORE_CURSOR) {
@@ -473,21 +531,20 @@ void PrintChar(char ch){
 			curPos.y++;
 			curPos.x = 0;
 			Scroll();
-
-			paintAll = true;
 			break;
 		case '\b':
 			if(curPos.x > 0) curPos.x--;
 			else if(curPos.y > 0) {
 				curPos.y--;
 				curPos.x = buffer[bufferOffset + curPos.y].size();
-
-				paintAll = true;
 			} else {
 				break;
 			}
 			
-			buffer[bufferOffset + curPos.y].erase(buffer[bufferOffset + curPos.y].begin() + curPos.x);
+			if(curPos.x < static_cast<int>(buffer[bufferOffset + curPos.y].size())){
+				buffer[bufferOffset + curPos.y].erase(buffer[bufferOffset + curPos.y].begin() + curPos.x);
+			}
+			MarkDirty(curPos.y);
 			break;
 		case ' ':
 		default:
@@ -504,6 +561,7 @@ void PrintChar(char ch){
 			else
 				buffer[bufferOffset + curPos.y][curPos.x] = {.s = state, .c = ch};
 
+			MarkDirty(curPos.y);
 			curPos.x++;
 
 			if(curPos.x > columnCount){
@@ -521,13 +579,19 @@ void PrintChar(char ch){
 	std::vector<pollfd> fds;
 	fds.push_back({.fd = masterPTYFd, .events = POLLIN, .revents = 0});
 
-	char buf[512];
+	char buf[4096];
 
 	while(waitpid(lsh, nullptr, WNOHANG) == 0){
 		poll(fds.data(), fds.size(), 500000); // Wake up every 500ms to check if LSh has exited
 
 		bool needsPaint = false;
-		while(int len = read(masterPTYFd, buf, 512)){
+		while(int len = read(masterPTYFd, buf, sizeof(buf))){
+			if(len < 0){
+				break;
+			}
+
+			// Only hold the lock whilst updating the buffer so the main thread can paint between chunks
+			std::lock_guard acquired(paintLock);
 			for(int i = 0; i < len; i++){
 				PrintChar(buf[i]);
 			}
@@ -535,10 +599,8 @@ void PrintChar(char ch){
 			needsPaint = true;
 		}
 
-		if(needsPaint){
-			std::lock_guard acquired(paintLock);
-
-			paint = true;
+		// Coalesce output, only wake the main thread if there is not already a paint pending
+		if(needsPaint && !paint.exchange(true)){
 			Lemon::InterruptThread(1);
 		}
 	}
@@ -558,10 +620,7 @@ int main(int argc, char** argv){
 	columnCount = 720 / 8;
 
 	curPos = {0, 0};
-
-	for(int i = 0; i < rowCount; i++){
-		buffer.push_back(std::vector<TerminalChar>());
-	}
+	FillScreen();
 
 	syscall(SYS_GRANT_PTY, (uintptr_t)&masterPTYFd, 0, 0, 0, 0);
 	setenv("TERM", "xterm-256color", 1); // the Lemon OS terminal is (fairly) xterm compatible (256 colour, etc.)
@@ -630,6 +689,8 @@ int main(int argc, char** argv){
 				exit(0);
 				return 0;
 			} else if (ev.event == Lemon::EventWindowResize){
+				std::lock_guard acquired(paintLock);
+
 				window->Resize(ev.resizeBounds);
 
 				columnCount = window->GetSize().x / 8;
@@ -641,18 +702,33 @@ int main(int argc, char** argv){
 				wSz.ws_ypixel = static_cast<unsigned short>(window->GetSize().y);
 				
 				ioctl(masterPTYFd, TIOCSWINSZ, &wSz);
+
+				if(curPos.y >= rowCount){
+					Scroll();
+				} else {
+					FillScreen();
+				}
+
 				paintAll = true;
+				paint = true;
 			}
 		}
 
-		{
-			std::lock_guard acquired(paintLock);
-			if(paint){
-				window->Paint();
+		if(paint){
+			// Limit painting to once per frame, output arriving in the meantime is coalesced into one paint
+			timespec now;
+			clock_gettime(CLOCK_BOOTTIME, &now);
 
-				paint = false;
-				paintAll = false;
+			long elapsed = (now.tv_sec - lastPaint.tv_sec) * 1000 + (now.tv_nsec - lastPaint.tv_nsec) / 1000000;
+			if(elapsed >= 0 && elapsed < frameInterval){
+				usleep((frameInterval - elapsed) * 1000);
 			}
+
+			std::lock_guard acquired(paintLock);
+			window->Paint();
+
+			paint = false;
+			clock_gettime(CLOCK_BOOTTIME, &lastPaint);
 		}
 
         Lemon::WindowServer::Instance()->Wait();
@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <cstring>
 #include <cassert> 
 #include <stack>
 #include <iostream>
@@ -10,6 +11,8 @@
 std::vector<Token> tokens;
 std::vector<std::shared_ptr<Statement>> statements;
 
+std::string transport = "Lemon::TransportKernel"; // Transport used by generated endpoints
+
 void BuildTokens(std::string& input){
     int lineNum = 1;
     int linePos = 0;
@@ -308,7 +311,7 @@ void Generate(std::ostream& out){
             client << "class " << interfaceStatement->interfaceName << "Endpoint : public Lemon::Endpoint {\n"
                 << "public:\n"
                 << "    " << interfaceStatement->interfaceName << "Endpoint(const Lemon::Handle& handle) : Endpoint(std::move(handle)) {}\n"
-                << "    " << interfaceStatement->interfaceName << "Endpoint(const std::string& interface) : Endpoint(interface) {}\n\n"
+                << "    " << interfaceStatement->interfaceName << "Endpoint(const std::string& interface) : Endpoint(interface, " << transport << ") {}\n\n"
                 << "    virtual ~" << interfaceStatement->interfaceName << "Endpoint() = default;\n\n";
 
 			std::stringstream requestIDs; // Request IDs
@@ -571,20 +574,32 @@ void Generate(std::ostream& out){
 }
 
 int main(int argc, char** argv){
-    if(argc < 2){
-        printf("Usage: %s <file> [outFile]\n", argv[0]);
+    int arg = 1;
+    if(argc >= 3 && !strcmp(argv[1], "-t")){ // Transport for generated endpoints
+        if(!strcmp(argv[2], "ring")){
+            transport = "Lemon::TransportSharedRing";
+        } else if(strcmp(argv[2], "kernel")){
+            printf("Unknown transport '%s', expected 'kernel' or 'ring'\n", argv[2]);
+            exit(1);
+        }
+
+        arg = 3;
+    }
+
+    if(argc - arg < 1){
+        printf("Usage: %s [-t kernel|ring] <file> [outFile]\n", argv[0]);
         exit(1);
     }
 
     FILE* inputFile;
-    if(!(inputFile = fopen(argv[1], "r"))){
+    if(!(inputFile = fopen(argv[arg], "r"))){
         perror("Error opening file for reading: ");
         exit(1);
     }
 
     std::ofstream outFile;
-    if(argc >= 3){
-        outFile.open(argv[2]);
+    if(argc - arg >= 2){
+        outFile.open(argv[arg + 1]);
         
         if(!outFile.is_open()){
             perror("Error opening file for writing!");
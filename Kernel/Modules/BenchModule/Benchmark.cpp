@@ -0,0 +1,204 @@
+#include "Benchmark.h"
+
+#include <Assert.h>
+#include <Liballoc.h>
+#include <Lock.h>
+#include <Logging.h>
+#include <Scheduler.h>
+#include <String.h>
+#include <Timer.h>
+
+Samples::Samples(unsigned capacity) : m_capacity(capacity) {
+    m_samples = reinterpret_cast<uint64_t*>(kmalloc(capacity * sizeof(uint64_t)));
+    if (!m_samples) {
+        m_capacity = 0;
+    }
+}
+
+Samples::~Samples() {
+    if (m_samples) {
+        kfree(m_samples);
+    }
+}
+
+// Heap sort, the samples are too many for insertion sort and there is no need for recursion
+static void SiftDown(uint64_t* values, unsigned root, unsigned count) {
+    while (root * 2 + 1 < count) {
+        unsigned child = root * 2 + 1;
+        if (child + 1 < count && values[child] < values[child + 1]) {
+            child++;
+        }
+
+        if (values[root] >= values[child]) {
+            return;
+        }
+
+        uint64_t temp = values[root];
+        values[root] = values[child];
+        values[child] = temp;
+
+        root = child;
+    }
+}
+
+uint64_t Samples::Percentile(unsigned perMille) {
+    if (!m_count) {
+        return 0;
+    }
+
+    if (!m_sorted) {
+        for (unsigned i = m_count / 2; i > 0; i--) {
+            SiftDown(m_samples, i - 1, m_count);
+        }
+
+        for (unsigned end = m_count - 1; end > 0; end--) {
+            uint64_t temp = m_samples[0];
+            m_samples[0] = m_samples[end];
+            m_samples[end] = temp;
+
+            SiftDown(m_samples, 0, end);
+        }
+
+        m_sorted = true;
+    }
+
+    unsigned index = static_cast<uint64_t>(m_count) * perMille / 1000;
+    if (index >= m_count) {
+        index = m_count - 1;
+    }
+
+    return m_samples[index];
+}
+
+uint64_t Samples::Mean() const {
+    if (!m_count) {
+        return 0;
+    }
+
+    uint64_t total = 0;
+    for (unsigned i = 0; i < m_count; i++) {
+        total += m_samples[i];
+    }
+
+    return total / m_count;
+}
+
+namespace Bench {
+static char report[BENCH_REPORT_SIZE];
+static size_t reportLength = 0;
+
+// Modules do not run global constructors, so it is created in Initialize
+static Semaphore* helperSemaphore = nullptr;
+
+static void Append(const char* text) {
+    size_t length = strlen(text);
+    if (reportLength + length >= BENCH_REPORT_SIZE) {
+        return;
+    }
+
+    strcpy(report + reportLength, text);
+    reportLength += length;
+}
+
+static void AppendValue(const char* key, uint64_t value) {
+    char buffer[24];
+
+    Append(" ");
+    Append(key);
+    Append("=");
+
+    itoa(value, buffer, 10);
+    Append(buffer);
+}
+
+uint64_t CyclesToNs(uint64_t cycles) {
+    return static_cast<unsigned __int128>(cycles) * 1000000000 / Timer::GetTSCFrequency();
+}
+
+void ReportLatency(const char* name, Samples& samples) {
+    if (!samples.Count()) {
+        ReportSkipped(name, "no samples");
+        return;
+    }
+
+    uint64_t values[] = {
+        CyclesToNs(samples.Percentile(0)),   CyclesToNs(samples.Percentile(500)), CyclesToNs(samples.Percentile(900)),
+        CyclesToNs(samples.Percentile(990)), CyclesToNs(samples.Percentile(999)), CyclesToNs(samples.Percentile(1000)),
+        CyclesToNs(samples.Mean()),
+    };
+
+    Log::Info("[BenchModule] %s: %u samples, min %u ns, p50 %u ns, p90 %u ns, p99 %u ns, p99.9 %u ns, max %u ns, "
+              "mean %u ns",
+              name, samples.Count(), values[0], values[1], values[2], values[3], values[4], values[5], values[6]);
+
+    Append(name);
+    AppendValue("samples", samples.Count());
+    AppendValue("min", values[0]);
+    AppendValue("p50", values[1]);
+    AppendValue("p90", values[2]);
+    AppendValue("p99", values[3]);
+    AppendValue("p999", values[4]);
+    AppendValue("max", values[5]);
+    AppendValue("mean", values[6]);
+    Append("\n");
+}
+
+void ReportThroughput(const char* name, uint64_t bytes, uint64_t cycles) {
+    uint64_t ns = CyclesToNs(cycles);
+    if (!ns) {
+        ns = 1;
+    }
+
+    // Bytes per microsecond is MB/s
+    uint64_t mbps = bytes * 1000 / ns;
+
+    Log::Info("[BenchModule] %s: %u bytes in %u ns, %u MB/s", name, bytes, ns, mbps);
+
+    Append(name);
+    AppendValue("bytes", bytes);
+    AppendValue("ns", ns);
+    AppendValue("mbps", mbps);
+    Append("\n");
+}
+
+void ReportSkipped(const char* name, const char* reason) {
+    Log::Warning("[BenchModule] %s: Skipped (%s)", name, reason);
+
+    Append(name);
+    Append(" skipped\n");
+}
+
+void Initialize() { helperSemaphore = new Semaphore(0); }
+
+void Finalize() {
+    delete helperSemaphore;
+    helperSemaphore = nullptr;
+}
+
+void ResetReport() {
+    reportLength = 0;
+    report[0] = 0;
+}
+
+const char* ReportText() { return report; }
+size_t ReportLength() { return reportLength; }
+
+void StartHelper(void (*entry)()) {
+    assert(helperSemaphore);
+
+    Process* helper = Scheduler::CreateProcess(reinterpret_cast<void*>(entry));
+    strcpy(helper->name, "benchhelper");
+}
+
+void HelperDone() {
+    helperSemaphore->Signal();
+
+    acquireLock(&Scheduler::GetCurrentThread()->lock);
+    Scheduler::EndProcess(Scheduler::GetCurrentProcess());
+}
+
+void WaitForHelper() {
+    while (helperSemaphore->Wait())
+        ;
+}
+} // namespace Bench
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Compiler.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BENCH_REPORT_SIZE 8192
+
+using Benchmark = void (*)();
+
+void MemoryBenchmarks();
+void SchedulingBenchmarks();
+void IPCBenchmarks();
+void FilesystemBenchmarks();
+
+// lfence keeps rdtsc from being executed before the code being measured
+ALWAYS_INLINE uint64_t BenchTimestamp() {
+    uint32_t low, high;
+    asm volatile("lfence; rdtsc" : "=a"(low), "=d"(high)::"memory");
+    return (static_cast<uint64_t>(high) << 32) | low;
+}
+
+/////////////////////////////
+/// \brief Latency samples of a benchmark in TSC cycles
+/////////////////////////////
+class Samples final {
+public:
+    Samples(unsigned capacity);
+    ~Samples();
+
+    ALWAYS_INLINE void Add(uint64_t cycles) {
+        if (m_count < m_capacity) {
+            m_samples[m_count++] = cycles;
+        }
+    }
+
+    ALWAYS_INLINE unsigned Count() const { return m_count; }
+
+    // Sorts the samples
+    uint64_t Percentile(unsigned perMille);
+    uint64_t Mean() const;
+
+private:
+    uint64_t* m_samples;
+    unsigned m_capacity;
+    unsigned m_count = 0;
+    bool m_sorted = false;
+};
+
+namespace Bench {
+void Initialize();
+void Finalize();
+
+/////////////////////////////
+/// \brief Report latency percentiles
+///
+/// Logged and appended to the report read through /dev/bench as
+/// name samples=n min=ns p50=ns p90=ns p99=ns p999=ns max=ns mean=ns
+/////////////////////////////
+void ReportLatency(const char* name, Samples& samples);
+
+/////////////////////////////
+/// \brief Report throughput
+///
+/// Appended to the report as name bytes=n ns=ns mbps=MB/s
+/////////////////////////////
+void ReportThroughput(const char* name, uint64_t bytes, uint64_t cycles);
+
+// Appended to the report as name skipped
+void ReportSkipped(const char* name, const char* reason);
+
+void ResetReport();
+const char* ReportText();
+size_t ReportLength();
+
+/////////////////////////////
+/// \brief Run a function in a new kernel process
+///
+/// The helper has to finish with HelperDone, which ends its process.
+/// Only one helper can run at a time.
+/////////////////////////////
+void StartHelper(void (*entry)());
+void HelperDone();
+void WaitForHelper();
+
+uint64_t CyclesToNs(uint64_t cycles);
+} // namespace Bench
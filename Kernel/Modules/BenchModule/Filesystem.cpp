@@ -0,0 +1,97 @@
+#include "Benchmark.h"
+
+#include <Fs/Filesystem.h>
+#include <Liballoc.h>
+#include <Logging.h>
+
+#define RESOLVE_BENCH_COUNT 10000
+#define READ_BENCH_RANDOM_COUNT 4096
+#define READ_BENCH_CHUNK 65536
+#define READ_BENCH_BLOCK 4096
+
+// Should live on the system volume (Ext2 on the standard disk image) and be at least a few MB
+#define READ_BENCH_PATH "/system/lib/libc.so"
+
+static uint32_t Random(uint32_t& seed) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static void ResolvePathBenchmark() {
+    Samples samples(RESOLVE_BENCH_COUNT);
+    for (unsigned i = 0; i < RESOLVE_BENCH_COUNT; i++) {
+        uint64_t start = BenchTimestamp();
+        FsNode* node = fs::ResolvePath(READ_BENCH_PATH);
+        uint64_t end = BenchTimestamp();
+
+        if (!node) {
+            Bench::ReportSkipped("resolvepath", "file not found");
+            return;
+        }
+
+        samples.Add(end - start);
+    }
+
+    Bench::ReportLatency("resolvepath", samples);
+}
+
+static void ReadBenchmark() {
+    FsNode* node = fs::ResolvePath(READ_BENCH_PATH);
+    if (!node || node->size < READ_BENCH_BLOCK) {
+        Bench::ReportSkipped("read-seq", "file not found");
+        Bench::ReportSkipped("read-rand", "file not found");
+        return;
+    }
+
+    uint8_t* buffer = reinterpret_cast<uint8_t*>(kmalloc(READ_BENCH_CHUNK));
+
+    // The first pass may have to go to the disk, the second is served from the page cache
+    const char* const sequentialNames[] = {"read-seq-first", "read-seq"};
+    for (const char* name : sequentialNames) {
+        size_t total = 0;
+
+        uint64_t start = BenchTimestamp();
+        while (total < node->size) {
+            ssize_t ret = fs::Read(node, total, READ_BENCH_CHUNK, buffer);
+            if (ret <= 0) {
+                break;
+            }
+
+            total += ret;
+        }
+
+        Bench::ReportThroughput(name, total, BenchTimestamp() - start);
+    }
+
+    uint32_t seed = 0x2468ACE;
+    size_t blocks = node->size / READ_BENCH_BLOCK;
+
+    Samples samples(READ_BENCH_RANDOM_COUNT);
+    for (unsigned i = 0; i < READ_BENCH_RANDOM_COUNT; i++) {
+        size_t offset = (Random(seed) % blocks) * READ_BENCH_BLOCK;
+
+        uint64_t start = BenchTimestamp();
+        ssize_t ret = fs::Read(node, offset, READ_BENCH_BLOCK, buffer);
+        uint64_t end = BenchTimestamp();
+
+        if (ret <= 0) {
+            Log::Warning("[BenchModule] read-rand: Read failed (%d)", ret);
+            break;
+        }
+
+        samples.Add(end - start);
+    }
+
+    kfree(buffer);
+
+    Bench::ReportLatency("read-rand", samples);
+}
+
+void FilesystemBenchmarks() {
+    Log::Info("[BenchModule] Running filesystem benchmarks...");
+
+    ResolvePathBenchmark();
+    ReadBenchmark();
+}
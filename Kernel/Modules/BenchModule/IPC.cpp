@@ -0,0 +1,182 @@
+#include "Benchmark.h"
+
+#include <Errno.h>
+#include <Fs/Filesystem.h>
+#include <Fs/Pipe.h>
+#include <Liballoc.h>
+#include <Logging.h>
+#include <Net/Socket.h>
+#include <Objects/Message.h>
+#include <String.h>
+
+#define ENDPOINT_BENCH_COUNT 10000
+#define ENDPOINT_REQUEST_ID 1
+#define ENDPOINT_REPLY_ID 2
+#define ENDPOINT_QUIT_ID 3
+#define ENDPOINT_CALL_TIMEOUT 1000000 // 1s, the benchmarks run while the module is loading so never wait forever
+
+#define STREAM_BENCH_BYTES (64 * 1024 * 1024)
+#define STREAM_BENCH_CHUNK 16384
+
+static FancyRefPtr<KernelObject>* serverEndpoint = nullptr;
+static fs_fd_t* streamWriteHandle = nullptr;
+
+// Replies to every request with the same data
+static void EndpointServer() {
+    MessageEndpoint* endpoint = reinterpret_cast<MessageEndpoint*>(serverEndpoint->get());
+
+    bool running = true;
+    while (running) {
+        {
+            KernelObjectWatcher watcher;
+            watcher.WatchObject(*serverEndpoint, 0);
+
+            if (watcher.Wait()) {
+                continue;
+            }
+        }
+
+        uint64_t id;
+        uint16_t size;
+        uint64_t data;
+        int64_t ret;
+        while (running && (ret = endpoint->Read(&id, &size, reinterpret_cast<uint8_t*>(&data))) > 0) {
+            if (id == ENDPOINT_QUIT_ID) {
+                running = false;
+            } else {
+                endpoint->Write(ENDPOINT_REPLY_ID, sizeof(data), reinterpret_cast<uint64_t>(&data));
+            }
+        }
+
+        if (ret == -ENOTCONN) {
+            break; // The benchmark gave up on us
+        }
+    }
+
+    Bench::HelperDone();
+}
+
+static void StreamWriter() {
+    uint8_t* buffer = reinterpret_cast<uint8_t*>(kmalloc(STREAM_BENCH_CHUNK));
+    memset(buffer, 0xAB, STREAM_BENCH_CHUNK);
+
+    for (size_t written = 0; written < STREAM_BENCH_BYTES;) {
+        ssize_t ret = fs::Write(streamWriteHandle, STREAM_BENCH_CHUNK, buffer);
+        if (ret <= 0) {
+            Log::Warning("[BenchModule] Stream write failed (%d)", ret);
+            break;
+        }
+
+        written += ret;
+    }
+
+    kfree(buffer);
+    Bench::HelperDone();
+}
+
+static void EndpointBenchmark() {
+    auto endpoints = MessageEndpoint::CreatePair(sizeof(uint64_t));
+
+    FancyRefPtr<KernelObject> server = static_pointer_cast<KernelObject>(endpoints.item2);
+    serverEndpoint = &server;
+
+    Bench::StartHelper(EndpointServer);
+
+    Samples samples(ENDPOINT_BENCH_COUNT);
+    for (unsigned i = 0; i < ENDPOINT_BENCH_COUNT; i++) {
+        uint64_t request = i;
+        uint64_t reply = 0;
+        uint16_t replySize;
+
+        uint64_t start = BenchTimestamp();
+        int64_t ret = endpoints.item1->Call(ENDPOINT_REQUEST_ID, sizeof(request), reinterpret_cast<uint64_t>(&request),
+                                            ENDPOINT_REPLY_ID, &replySize, reinterpret_cast<uint8_t*>(&reply),
+                                            ENDPOINT_CALL_TIMEOUT);
+        uint64_t end = BenchTimestamp();
+
+        if (ret || reply != request) {
+            Log::Warning("[BenchModule] Endpoint call failed (%d)", ret);
+            break;
+        }
+
+        samples.Add(end - start);
+    }
+
+    // Disconnecting also stops the server if the quit message cannot be queued
+    endpoints.item1->Write(ENDPOINT_QUIT_ID, 0, 0);
+    endpoints.item1->Destroy();
+    Bench::WaitForHelper();
+
+    serverEndpoint = nullptr;
+    endpoints.item2->Destroy();
+
+    Bench::ReportLatency("endpoint-rtt", samples);
+}
+
+// Read everything the writer helper sends through a pair of file handles
+static void StreamBenchmark(const char* name, fs_fd_t* readHandle, fs_fd_t* writeHandle) {
+    uint8_t* buffer = reinterpret_cast<uint8_t*>(kmalloc(STREAM_BENCH_CHUNK));
+
+    streamWriteHandle = writeHandle;
+    Bench::StartHelper(StreamWriter);
+
+    size_t total = 0;
+    uint64_t start = BenchTimestamp();
+    while (total < STREAM_BENCH_BYTES) {
+        ssize_t ret = fs::Read(readHandle, STREAM_BENCH_CHUNK, buffer);
+        if (ret <= 0) {
+            Log::Warning("[BenchModule] %s: Read failed (%d)", name, ret);
+            break;
+        }
+
+        total += ret;
+    }
+    uint64_t end = BenchTimestamp();
+
+    Bench::WaitForHelper();
+    streamWriteHandle = nullptr;
+
+    kfree(buffer);
+
+    Bench::ReportThroughput(name, total, end - start);
+}
+
+static void PipeBenchmark() {
+    UNIXPipe* read;
+    UNIXPipe* write;
+    UNIXPipe::CreatePipe(read, write);
+
+    fs_fd_t* readHandle = fs::Open(read);
+    fs_fd_t* writeHandle = fs::Open(write);
+
+    StreamBenchmark("pipe", readHandle, writeHandle);
+
+    fs::Close(writeHandle);
+    fs::Close(readHandle);
+    delete writeHandle;
+    delete readHandle;
+}
+
+// The network stack has no loopback adapter, so sockets are measured through a UNIX domain stream socket pair
+static void SocketBenchmark() {
+    LocalSocket* client = new LocalSocket(StreamSocket, 0);
+    LocalSocket* server = LocalSocket::CreatePairedSocket(client);
+
+    fs_fd_t* readHandle = fs::Open(server);
+    fs_fd_t* writeHandle = fs::Open(client);
+
+    StreamBenchmark("unixsocket", readHandle, writeHandle);
+
+    fs::Close(writeHandle);
+    fs::Close(readHandle);
+    delete writeHandle;
+    delete readHandle;
+}
+
+void IPCBenchmarks() {
+    Log::Info("[BenchModule] Running IPC benchmarks...");
+
+    EndpointBenchmark();
+    PipeBenchmark();
+    SocketBenchmark();
+}
@@ -0,0 +1,81 @@
+#include <Module.h>
+
+#include <Device.h>
+#include <Lock.h>
+#include <Logging.h>
+#include <String.h>
+
+#include "Benchmark.h"
+
+#define BENCHMARK_COUNT 4
+Benchmark benchmarks[BENCHMARK_COUNT]{
+    MemoryBenchmarks,
+    SchedulingBenchmarks,
+    IPCBenchmarks,
+    FilesystemBenchmarks,
+};
+
+// Held whilst the benchmarks run, they take seconds so a reader sleeps rather than spins
+static Mutex* benchMutex = nullptr;
+
+static void RunBenchmarks() {
+    ScopedMutex acq(*benchMutex);
+
+    Bench::ResetReport();
+    for (unsigned i = 0; i < BENCHMARK_COUNT; i++) {
+        benchmarks[i]();
+    }
+}
+
+// Reading gives the results of the last run, any write runs the benchmarks again
+class BenchDevice : public Device {
+public:
+    BenchDevice(const char* name) : Device(name, DeviceTypeUNIXPseudo) { flags = FS_NODE_FILE; }
+
+    ssize_t Read(size_t offset, size_t size, uint8_t* buffer) {
+        ScopedMutex acq(*benchMutex);
+
+        size_t length = Bench::ReportLength();
+        if (offset >= length) {
+            return 0;
+        }
+
+        if (size > length - offset) {
+            size = length - offset;
+        }
+        memcpy(buffer, Bench::ReportText() + offset, size);
+
+        return size;
+    }
+
+    ssize_t Write(size_t, size_t size, uint8_t*) {
+        RunBenchmarks();
+
+        return size;
+    }
+};
+
+static BenchDevice* benchDevice = nullptr;
+
+static int ModuleInit() {
+    Bench::Initialize();
+    benchMutex = new Mutex();
+
+    RunBenchmarks();
+
+    benchDevice = new BenchDevice("bench");
+    return 0;
+}
+
+static int ModuleExit() {
+    delete benchDevice;
+    benchDevice = nullptr;
+
+    delete benchMutex;
+    benchMutex = nullptr;
+
+    Bench::Finalize();
+    return 0;
+}
+
+DECLARE_MODULE("benchmodule", "Kernel microbenchmarks.", ModuleInit, ModuleExit)
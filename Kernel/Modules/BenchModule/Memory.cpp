@@ -0,0 +1,213 @@
+#include "Benchmark.h"
+
+#include <Liballoc.h>
+#include <Logging.h>
+#include <Paging.h>
+#include <PhysicalAllocator.h>
+#include <Scheduler.h>
+#include <String.h>
+
+#define PAGEFAULT_BENCH_PAGES 1024
+#define PHYSALLOC_BENCH_COUNT 4096
+#define KMALLOC_BENCH_COUNT 4096
+#define KMALLOC_BENCH_MAX_BYTES (16 * 1024 * 1024) // Limits the amount of the larger size classes
+#define STRING_BENCH_BYTES (64 * 1024 * 1024) // Moved per string benchmark
+#define STRING_BENCH_BUFFER (256 * 1024) // Larger than most L2 caches
+
+// Time the first write to each page of an anonymous mapping
+static void PageFaultBenchmark() {
+    AddressSpace* addressSpace = Scheduler::GetCurrentProcess()->addressSpace;
+
+    size_t size = PAGEFAULT_BENCH_PAGES * PAGE_SIZE_4K;
+    MappedRegion* region = addressSpace->AllocateAnonymousVMObject(size, 0, false);
+    if (!region) {
+        Bench::ReportSkipped("pagefault", "failed to map memory");
+        return;
+    }
+
+    uintptr_t base = region->base;
+
+    Samples samples(PAGEFAULT_BENCH_PAGES);
+    for (unsigned i = 0; i < PAGEFAULT_BENCH_PAGES; i++) {
+        volatile uint8_t* page = reinterpret_cast<volatile uint8_t*>(base + i * PAGE_SIZE_4K);
+
+        uint64_t start = BenchTimestamp();
+        *page = 1;
+        samples.Add(BenchTimestamp() - start);
+    }
+
+    addressSpace->UnmapMemory(base, size);
+
+    Bench::ReportLatency("pagefault", samples);
+}
+
+static void PhysicalAllocatorBenchmark() {
+    uint64_t* blocks = reinterpret_cast<uint64_t*>(kmalloc(PHYSALLOC_BENCH_COUNT * sizeof(uint64_t)));
+    if (!blocks) {
+        Bench::ReportSkipped("physalloc", "out of memory");
+        return;
+    }
+
+    Samples allocSamples(PHYSALLOC_BENCH_COUNT);
+    for (unsigned i = 0; i < PHYSALLOC_BENCH_COUNT; i++) {
+        uint64_t start = BenchTimestamp();
+        blocks[i] = Memory::AllocatePhysicalMemoryBlock();
+        allocSamples.Add(BenchTimestamp() - start);
+    }
+
+    Samples freeSamples(PHYSALLOC_BENCH_COUNT);
+    for (unsigned i = 0; i < PHYSALLOC_BENCH_COUNT; i++) {
+        uint64_t start = BenchTimestamp();
+        Memory::FreePhysicalMemoryBlock(blocks[i]);
+        freeSamples.Add(BenchTimestamp() - start);
+    }
+
+    kfree(blocks);
+
+    Bench::ReportLatency("physalloc", allocSamples);
+    Bench::ReportLatency("physfree", freeSamples);
+}
+
+static void HeapBenchmark(size_t size, const char* allocName, const char* freeName) {
+    unsigned count = KMALLOC_BENCH_COUNT;
+    if (count * size > KMALLOC_BENCH_MAX_BYTES) {
+        count = KMALLOC_BENCH_MAX_BYTES / size;
+    }
+
+    void** allocations = reinterpret_cast<void**>(kmalloc(count * sizeof(void*)));
+    if (!allocations) {
+        Bench::ReportSkipped(allocName, "out of memory");
+        return;
+    }
+
+    Samples allocSamples(count);
+    for (unsigned i = 0; i < count; i++) {
+        uint64_t start = BenchTimestamp();
+        allocations[i] = kmalloc(size);
+        allocSamples.Add(BenchTimestamp() - start);
+    }
+
+    // Free in a different order to the allocations so that the free lists get mixed up,
+    // count is a power of two so every allocation is visited once
+    Samples freeSamples(count);
+    for (unsigned i = 0; i < count; i++) {
+        void* allocation = allocations[(i * 7919) % count];
+
+        uint64_t start = BenchTimestamp();
+        kfree(allocation);
+        freeSamples.Add(BenchTimestamp() - start);
+    }
+
+    kfree(allocations);
+
+    Bench::ReportLatency(allocName, allocSamples);
+    Bench::ReportLatency(freeName, freeSamples);
+}
+
+// Copy, fill and compare a buffer in chunks, the small sizes show the startup cost of the rep string instructions
+static void StringBenchmark(size_t chunk, const char* copyName, const char* setName, const char* compareName) {
+    uint8_t* src = reinterpret_cast<uint8_t*>(kmalloc(STRING_BENCH_BUFFER));
+    uint8_t* dest = reinterpret_cast<uint8_t*>(kmalloc(STRING_BENCH_BUFFER));
+    if (!src || !dest) {
+        kfree(src);
+        kfree(dest);
+
+        Bench::ReportSkipped(copyName, "out of memory");
+        return;
+    }
+
+    memset(src, 0xAB, STRING_BENCH_BUFFER);
+
+    uint64_t start = BenchTimestamp();
+    for (size_t total = 0; total < STRING_BENCH_BYTES; total += chunk) {
+        size_t offset = total % STRING_BENCH_BUFFER;
+        memcpy(dest + offset, src + offset, chunk);
+    }
+    Bench::ReportThroughput(copyName, STRING_BENCH_BYTES, BenchTimestamp() - start);
+
+    start = BenchTimestamp();
+    for (size_t total = 0; total < STRING_BENCH_BYTES; total += chunk) {
+        memset(dest + total % STRING_BENCH_BUFFER, 0xAB, chunk);
+    }
+    Bench::ReportThroughput(setName, STRING_BENCH_BYTES, BenchTimestamp() - start);
+
+    // Equal buffers so every byte gets compared
+    int result = 0;
+    start = BenchTimestamp();
+    for (size_t total = 0; total < STRING_BENCH_BYTES; total += chunk) {
+        size_t offset = total % STRING_BENCH_BUFFER;
+        result |= memcmp(dest + offset, src + offset, chunk);
+    }
+    Bench::ReportThroughput(compareName, STRING_BENCH_BYTES, BenchTimestamp() - start);
+
+    if (result) {
+        Log::Warning("[BenchModule] %s: Buffers differ", compareName);
+    }
+
+    kfree(src);
+    kfree(dest);
+}
+
+static void PageCopyBenchmark() {
+    uint8_t* pages = reinterpret_cast<uint8_t*>(Memory::KernelAllocate4KPages(STRING_BENCH_BUFFER / PAGE_SIZE_4K * 2));
+    for (size_t i = 0; i < STRING_BENCH_BUFFER / PAGE_SIZE_4K * 2; i++) {
+        Memory::KernelMapVirtualMemory4K(Memory::AllocatePhysicalMemoryBlock(), (uintptr_t)pages + i * PAGE_SIZE_4K, 1);
+    }
+
+    uint8_t* src = pages;
+    uint8_t* dest = pages + STRING_BENCH_BUFFER;
+
+    memset(src, 0xAB, STRING_BENCH_BUFFER);
+
+    // Cached stores with memset/memcpy against non-temporal stores
+    uint64_t start = BenchTimestamp();
+    for (size_t total = 0; total < STRING_BENCH_BYTES; total += PAGE_SIZE_4K) {
+        memset(dest + total % STRING_BENCH_BUFFER, 0, PAGE_SIZE_4K);
+    }
+    Bench::ReportThroughput("memset-page", STRING_BENCH_BYTES, BenchTimestamp() - start);
+
+    start = BenchTimestamp();
+    for (size_t total = 0; total < STRING_BENCH_BYTES; total += PAGE_SIZE_4K) {
+        ZeroPage(dest + total % STRING_BENCH_BUFFER);
+    }
+    Bench::ReportThroughput("zeropage", STRING_BENCH_BYTES, BenchTimestamp() - start);
+
+    start = BenchTimestamp();
+    for (size_t total = 0; total < STRING_BENCH_BYTES; total += PAGE_SIZE_4K) {
+        size_t offset = total % STRING_BENCH_BUFFER;
+        memcpy(dest + offset, src + offset, PAGE_SIZE_4K);
+    }
+    Bench::ReportThroughput("memcpy-page", STRING_BENCH_BYTES, BenchTimestamp() - start);
+
+    start = BenchTimestamp();
+    for (size_t total = 0; total < STRING_BENCH_BYTES; total += PAGE_SIZE_4K) {
+        size_t offset = total % STRING_BENCH_BUFFER;
+        CopyPage(dest + offset, src + offset);
+    }
+    Bench::ReportThroughput("copypage", STRING_BENCH_BYTES, BenchTimestamp() - start);
+
+    for (size_t i = 0; i < STRING_BENCH_BUFFER / PAGE_SIZE_4K * 2; i++) {
+        Memory::FreePhysicalMemoryBlock(Memory::VirtualToPhysicalAddress((uintptr_t)pages + i * PAGE_SIZE_4K));
+    }
+    Memory::KernelFree4KPages(pages, STRING_BENCH_BUFFER / PAGE_SIZE_4K * 2);
+}
+
+void MemoryBenchmarks() {
+    Log::Info("[BenchModule] Running memory benchmarks...");
+
+    PageFaultBenchmark();
+    PhysicalAllocatorBenchmark();
+
+    HeapBenchmark(16, "kmalloc-16", "kfree-16");
+    HeapBenchmark(64, "kmalloc-64", "kfree-64");
+    HeapBenchmark(256, "kmalloc-256", "kfree-256");
+    HeapBenchmark(1024, "kmalloc-1024", "kfree-1024");
+    HeapBenchmark(4096, "kmalloc-4096", "kfree-4096");
+    HeapBenchmark(32768, "kmalloc-32768", "kfree-32768");
+
+    StringBenchmark(16, "memcpy-16", "memset-16", "memcmp-16");
+    StringBenchmark(256, "memcpy-256", "memset-256", "memcmp-256");
+    StringBenchmark(4096, "memcpy-4096", "memset-4096", "memcmp-4096");
+    StringBenchmark(65536, "memcpy-65536", "memset-65536", "memcmp-65536");
+    PageCopyBenchmark();
+}
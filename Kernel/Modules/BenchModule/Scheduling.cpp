@@ -0,0 +1,67 @@
+#include "Benchmark.h"
+
+#include <Lock.h>
+#include <Logging.h>
+#include <Scheduler.h>
+
+#define YIELD_BENCH_COUNT 10000
+#define CTXSWITCH_BENCH_COUNT 10000
+
+static Semaphore* ping = nullptr;
+static Semaphore* pong = nullptr;
+
+static void PingPongHelper() {
+    for (unsigned i = 0; i < CTXSWITCH_BENCH_COUNT; i++) {
+        while (ping->Wait())
+            ;
+
+        pong->Signal();
+    }
+
+    Bench::HelperDone();
+}
+
+static void YieldBenchmark() {
+    Samples samples(YIELD_BENCH_COUNT);
+    for (unsigned i = 0; i < YIELD_BENCH_COUNT; i++) {
+        uint64_t start = BenchTimestamp();
+        Scheduler::Yield();
+        samples.Add(BenchTimestamp() - start);
+    }
+
+    Bench::ReportLatency("yield", samples);
+}
+
+// Wake a thread blocked on a semaphore and block until it wakes us back,
+// each round trip is two context switches
+static void ContextSwitchBenchmark() {
+    ping = new Semaphore(0);
+    pong = new Semaphore(0);
+
+    Bench::StartHelper(PingPongHelper);
+
+    Samples samples(CTXSWITCH_BENCH_COUNT);
+    for (unsigned i = 0; i < CTXSWITCH_BENCH_COUNT; i++) {
+        uint64_t start = BenchTimestamp();
+
+        ping->Signal();
+        while (pong->Wait())
+            ;
+
+        samples.Add((BenchTimestamp() - start) / 2);
+    }
+
+    Bench::WaitForHelper();
+
+    delete ping;
+    delete pong;
+
+    Bench::ReportLatency("ctxswitch", samples);
+}
+
+void SchedulingBenchmarks() {
+    Log::Info("[BenchModule] Running scheduling benchmarks...");
+
+    YieldBenchmark();
+    ContextSwitchBenchmark();
+}
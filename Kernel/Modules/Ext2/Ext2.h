@@ -206,7 +206,7 @@ public:
         Ext2Volume* vol;
         ext2_inode_t e2inode;
 
-        FilesystemLock flock; // Lock on file data
+        FilesystemLock flock = FilesystemLock(LockClassFileData); // Lock on file data
 
         friend class Ext2Volume;
 
@@ -253,7 +253,7 @@ public:
         uint32_t inodeSize = 128;
 
         HashMap<uint32_t, Ext2Node*> inodeCache;
-        HashMap<uint32_t, uint8_t*> blockCache = HashMap<uint32_t, uint8_t*>(1024);
+        StripedHashMap<uint32_t, uint8_t*> blockCache; // Hit by every read, spread the lock over stripes
         HashMap<uint32_t, uint8_t*> bitmapCache = HashMap<uint32_t, uint8_t*>(256);
         unsigned blockCacheMemoryUsage;
 
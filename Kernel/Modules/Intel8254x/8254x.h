@@ -11,7 +11,9 @@
 #define I8254_REGISTER_EEPROM       0x14
 #define I8254_REGISTER_CTRL_EXT     0x18
 #define I8254_REGISTER_INT_READ     0xC0
+#define I8254_REGISTER_INT_RATE     0xC4
 #define I8254_REGISTER_INT_MASK     0xD0
+#define I8254_REGISTER_INT_MASK_CLR 0xD8
 
 #define I8254_REGISTER_RCTRL        0x100
 #define I8254_REGISTER_RDESC_LO     0x2800
@@ -19,6 +21,8 @@
 #define I8254_REGISTER_RDESC_LEN    0x2808
 #define I8254_REGISTER_RDESC_HEAD   0x2810
 #define I8254_REGISTER_RDESC_TAIL   0x2818
+#define I8254_REGISTER_RDTR         0x2820
+#define I8254_REGISTER_RADV         0x282C
 
 #define I8254_REGISTER_TCTRL        0x400
 #define I8254_REGISTER_TDESC_LO     0x3800
@@ -62,10 +66,24 @@
 #define TCMD_VLE (1 << 6) // VLAN Packet Enable
 #define TCMD_IDE (1 << 7) // Interrupt Delay Enable
 
+#define RSTATUS_DD (1 << 0) // Descriptor Done
+#define RSTATUS_EOP (1 << 1) // End of packet
+
 #define TSTATUS_DD (1 << 0) // Descriptor Done
 #define TSTATUS_EC (1 << 1) // Excess Collisions
 #define TSTATUS_LC (1 << 2) // Late collision
 
+#define INT_LSC (1 << 2)    // Link status change
+#define INT_RXDMT0 (1 << 4) // Receive descriptor minimum threshold reached
+#define INT_RXO (1 << 6)    // Receiver overrun
+#define INT_RXT0 (1 << 7)   // Receiver timer
+#define INT_RX (INT_RXDMT0 | INT_RXO | INT_RXT0)
+
+// Interrupt coalescing
+#define INT_RATE_INTERVAL 488   // Minimum interval between interrupts in 256ns units (~8000 interrupts/s)
+#define RX_DELAY_TIMER 32       // Delay after a packet before raising an interrupt in 1.024us units
+#define RX_ABSOLUTE_DELAY 128   // Upper bound for the delay under a steady stream of packets
+
 #define STATUS_LINK_UP (1 << 1)
 #define STATUS_SPEED (3 << 6)   // 00b - 10Mb/s, 01b - 100MB/s, 10b/11b - 1000Mb/s
 
@@ -83,6 +101,9 @@ public:
 
     void SendPacket(void* data, size_t len);
 
+    int Poll(int budget);
+    void EnableReceiveInterrupts();
+
 private:
     typedef struct {
         uint64_t addr; // Buffer Address
@@ -126,6 +147,8 @@ private:
 
     int GetSpeed();
 
+    void* AllocateBuffer(uintptr_t& phys);
+
     void InitializeRx();
     void InitializeTx();
 
@@ -117,40 +117,69 @@ bool Intel8254x::CheckForEEPROM(){
 }
 
 void Intel8254x::OnInterrupt(){
-    uint32_t status = ReadMem32(I8254_REGISTER_INT_READ);
+    uint32_t status = ReadMem32(I8254_REGISTER_INT_READ); // Reading clears the interrupt causes
     
-    if(status & 0x4){
+    if(status & INT_LSC){
         Log::Info("[i8254x] Initializing Link...");
 
         WriteMem32(I8254_REGISTER_CTRL, ReadMem32(I8254_REGISTER_CTRL) | CTRL_SLU | CTRL_ASDE);
 
         UpdateLink();
-    } else if(status & 0x80){
-        do {
-            rxTail = ReadMem32(I8254_REGISTER_RDESC_TAIL);
-            if(rxTail == ReadMem32(I8254_REGISTER_RDESC_HEAD)) return;
-            rxTail = (rxTail + 1) % RX_DESC_COUNT;
+    }
+    
+    if(status & INT_RX){
+        // Receive interrupts stay masked until the network stack has drained the ring
+        WriteMem32(I8254_REGISTER_INT_MASK_CLR, INT_RX);
+        ScheduleReceive();
+    }
+}
 
-            if(!(rxDescriptors[rxTail].status & 0x1)) break;
+int Intel8254x::Poll(int budget){
+    int count = 0;
 
-            rxDescriptors[rxTail].status = 0;
+    while(count < budget){
+        unsigned next = (rxTail + 1) % RX_DESC_COUNT;
+        r_desc_t* rxd = &rxDescriptors[next];
 
-            if(rxDescriptors[rxTail].length <= ETHERNET_MAX_PACKET_SIZE && cache.get_length()){
-                NetworkPacket* pkt = cache.remove_at(0);
+        asm volatile("" ::: "memory"); // The NIC writes to the descriptor
+        if(!(rxd->status & RSTATUS_DD)) break;
 
-                pkt->length = rxDescriptors[rxTail].length;
-                memcpy(pkt->data, rxDescriptorsVirt[rxTail], pkt->length);
-                
-                queue.add_back(pkt);
-                packetSemaphore.Signal();
-                Network::packetQueueSemaphore.Signal();
-            } else {
-                // TODO: Do something that isn't dropping the packet when the cache is empty
-            }
+        if((rxd->status & RSTATUS_EOP) && !rxd->errors && rxd->length <= ETHERNET_MAX_PACKET_SIZE){
+            acquireLock(&cacheLock);
+            NetworkPacket* pkt = cache.get_length() ? cache.remove_at(0) : nullptr;
+            releaseLock(&cacheLock);
+
+            if(pkt){
+                // Rather than copying, hand the descriptor's buffer up the stack and give the NIC the packet's spare buffer
+                uint8_t* spare = pkt->data;
+                uintptr_t sparePhys = pkt->bufferPhys;
+
+                pkt->data = reinterpret_cast<uint8_t*>(rxDescriptorsVirt[next]);
+                pkt->bufferPhys = rxd->addr;
+                pkt->length = rxd->length;
+                pkt->adapter = this;
+
+                rxDescriptorsVirt[next] = spare;
+                rxd->addr = sparePhys;
+
+                Network::ReceivePacket(pkt);
+            } // Otherwise every buffer is in use by the network stack so drop the packet
+        }
+
+        rxd->status = 0;
+        rxTail = next;
+        count++;
+    }
 
-            WriteMem32(I8254_REGISTER_RDESC_TAIL, rxTail);
-        } while(1);
+    if(count){
+        WriteMem32(I8254_REGISTER_RDESC_TAIL, rxTail); // Give the descriptors back to the NIC
     }
+
+    return count;
+}
+
+void Intel8254x::EnableReceiveInterrupts(){
+    WriteMem32(I8254_REGISTER_INT_MASK, INT_RX);
 }
 
 int Intel8254x::GetSpeed(){
@@ -187,6 +216,15 @@ void Intel8254x::UpdateLink(){
     }  
 }
 
+void* Intel8254x::AllocateBuffer(uintptr_t& phys){
+    phys = Memory::AllocatePhysicalMemoryBlock();
+
+    void* virt = Memory::KernelAllocate4KPages(1);
+    Memory::KernelMapVirtualMemory4K(phys, (uintptr_t)virt, 1);
+
+    return virt;
+}
+
 void Intel8254x::InitializeRx(){
     uint64_t rxDescPhys = Memory::AllocatePhysicalMemoryBlock(); // The card wants a physical address
     rxDescriptors = (r_desc_t*)Memory::KernelAllocate4KPages(1);
@@ -210,14 +248,18 @@ void Intel8254x::InitializeRx(){
 
     for(int i = 0; i < RX_DESC_COUNT; i++){
         r_desc_t* rxd = &rxDescriptors[i];
-        uint64_t phys = Memory::AllocatePhysicalMemoryBlock();
+        uintptr_t phys;
+        rxDescriptorsVirt[i] = AllocateBuffer(phys);
+
         rxd->addr = phys;
         rxd->status = 0;
-
-        rxDescriptorsVirt[i] = Memory::KernelAllocate4KPages(1);
-        Memory::KernelMapVirtualMemory4K(phys, (uintptr_t)rxDescriptorsVirt[i], 1);
     }
 
+    rxTail = _rxTail; // Last descriptor we have processed
+
+    WriteMem32(I8254_REGISTER_RDTR, RX_DELAY_TIMER);
+    WriteMem32(I8254_REGISTER_RADV, RX_ABSOLUTE_DELAY);
+
     WriteMem32(I8254_REGISTER_RCTRL, (RCTRL_ENABLE | RCTRL_SBP | RCTRL_UPE | RCTRL_MPE | RCTRL_LPE | RCTRL_BAM | RCTRL_SECRC | BSIZE_4096));
 }
 
@@ -324,9 +366,14 @@ Intel8254x::Intel8254x(const PCIInfo& device) : NetworkAdapter(NetworkAdapterEth
 
     maxCache = 256;
     for(unsigned i = 0; i < maxCache; i++){
-        cache.add_back(new NetworkPacket()); // Fill the cache
+        // Each packet owns a spare buffer which gets swapped with a receive descriptor's
+        NetworkPacket* pkt = new NetworkPacket();
+        pkt->data = reinterpret_cast<uint8_t*>(AllocateBuffer(pkt->bufferPhys));
+
+        cache.add_back(pkt); // Fill the cache
     }
 
+    WriteMem32(I8254_REGISTER_INT_RATE, INT_RATE_INTERVAL);
     WriteMem32(I8254_REGISTER_INT_MASK, 0x1F6DF); // Set the interrupt mask to enable all interrupts
     UpdateLink();
 }
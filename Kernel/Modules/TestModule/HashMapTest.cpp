@@ -0,0 +1,170 @@
+#include <Hash.h>
+
+#include <List.h>
+#include <Logging.h>
+#include <StringView.h>
+#include <Timer.h>
+
+#define HASHMAP_BENCHMARK_COUNT 100000
+
+// The chained hash map the kernel used before, kept to compare against
+template<typename K, typename T>
+class LegacyHashMap{
+    struct KeyValuePair{
+        K key;
+        T value;
+    };
+
+    List<KeyValuePair>* buckets;
+    unsigned bucketCount;
+    lock_t lock = 0;
+
+public:
+    LegacyHashMap(unsigned bCount = 512) : bucketCount(bCount){
+        buckets = new List<KeyValuePair>[bucketCount];
+    }
+
+    ~LegacyHashMap(){
+        delete[] buckets;
+    }
+
+    void insert(K key, const T& value){
+        auto& bucket = buckets[Hash(key) % bucketCount];
+
+        acquireLock(&lock);
+        for(KeyValuePair& v : bucket){
+            if(v.key == key){
+                v.value = value;
+
+                releaseLock(&lock);
+                return;
+            }
+        }
+
+        bucket.add_back({key, value});
+        releaseLock(&lock);
+    }
+
+    T remove(K key){
+        auto& bucket = buckets[Hash(key) % bucketCount];
+
+        acquireLock(&lock);
+        for(unsigned i = 0; i < bucket.get_length(); i++){
+            if(bucket[i].key == key){
+                auto pair = bucket.remove_at(i);
+
+                releaseLock(&lock);
+                return pair.value;
+            }
+        }
+        releaseLock(&lock);
+
+        return T();
+    }
+
+    int get(const K& key, T& value){
+        auto& bucket = buckets[Hash(key) % bucketCount];
+
+        acquireLock(&lock);
+        for(KeyValuePair& val : bucket){
+            if(val.key == key){
+                value = val.value;
+
+                releaseLock(&lock);
+                return 1;
+            }
+        }
+        releaseLock(&lock);
+
+        return 0;
+    }
+};
+
+// Runs insert, get and remove over HASHMAP_BENCHMARK_COUNT keys, returns non-zero on a wrong result
+template<typename Map>
+static int HashMapBenchmark(const char* name, Map& map){
+    uint64_t start = Timer::GetSystemUptimeNs();
+    for(unsigned i = 0; i < HASHMAP_BENCHMARK_COUNT; i++){
+        map.insert(i * 4096, i); // Page aligned keys like the page cache uses
+    }
+    uint64_t inserted = Timer::GetSystemUptimeNs();
+
+    for(unsigned i = 0; i < HASHMAP_BENCHMARK_COUNT; i++){
+        unsigned value;
+        if(!map.get(i * 4096, value) || value != i){
+            Log::Warning("[TestModule] %s: Key %u has the wrong value", name, i * 4096);
+            return 1;
+        }
+    }
+    uint64_t found = Timer::GetSystemUptimeNs();
+
+    for(unsigned i = 0; i < HASHMAP_BENCHMARK_COUNT; i++){
+        if(map.remove(i * 4096) != i){
+            Log::Warning("[TestModule] %s: Failed to remove key %u", name, i * 4096);
+            return 2;
+        }
+    }
+    uint64_t removed = Timer::GetSystemUptimeNs();
+
+    Log::Info("[TestModule] %s: %u keys: insert %u ns/op, get %u ns/op, remove %u ns/op", name, HASHMAP_BENCHMARK_COUNT,
+        (inserted - start) / HASHMAP_BENCHMARK_COUNT, (found - inserted) / HASHMAP_BENCHMARK_COUNT,
+        (removed - found) / HASHMAP_BENCHMARK_COUNT);
+
+    return 0;
+}
+
+// Remove every other key so that backward shifting has work to do
+static int HashMapRemoveTest(){
+    HashMap<unsigned, unsigned> map;
+
+    for(unsigned i = 0; i < 4096; i++){
+        map.insert(i, i);
+    }
+
+    for(unsigned i = 0; i < 4096; i += 2){
+        map.remove(i);
+    }
+
+    if(map.get_length() != 2048){
+        Log::Warning("[TestModule] HashMap has %u items, expected 2048", map.get_length());
+        return 3;
+    }
+
+    for(unsigned i = 0; i < 4096; i++){
+        if(map.find(i) != (i & 1)){
+            Log::Warning("[TestModule] HashMap key %u in wrong state after removal", i);
+            return 4;
+        }
+    }
+
+    return 0;
+}
+
+int HashMapTest(){
+    Log::Info("[TestModule] Running HashMap Test...");
+
+    // The old string hash XORed the characters together so these all collided
+    if(Hash(StringView("ext2fs")) == Hash(StringView("fs2ext")) || Hash(StringView("ab")) == Hash(StringView("ba"))){
+        Log::Warning("[TestModule] Anagrams have the same hash");
+        return 5;
+    }
+
+    if(int ret = HashMapRemoveTest(); ret){
+        return ret;
+    }
+
+    {
+        LegacyHashMap<unsigned long, unsigned> legacy;
+        if(int ret = HashMapBenchmark("Chained HashMap", legacy); ret){
+            return ret;
+        }
+    }
+
+    HashMap<unsigned long, unsigned> map;
+    if(int ret = HashMapBenchmark("HashMap", map); ret){
+        return ret;
+    }
+
+    StripedHashMap<unsigned long, unsigned> striped;
+    return HashMapBenchmark("StripedHashMap", striped);
+}
@@ -0,0 +1,116 @@
+#include <Timer.h>
+#include <TimerEvent.h>
+
+#include <Assert.h>
+#include <Compiler.h>
+#include <Liballoc.h>
+#include <Logging.h>
+#include <Scheduler.h>
+
+#define TIMER_ORDER_COUNT 256
+#define TIMER_BENCHMARK_COUNT 100000
+
+static uint64_t dispatchedDeadlines[TIMER_ORDER_COUNT];
+static unsigned dispatchedCount = 0;
+
+static uint32_t Random(uint32_t& seed){
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+// Events armed in a random order should fire in order of deadline
+static int TimerOrderTest(){
+    Timer::TimerEvent* events = reinterpret_cast<Timer::TimerEvent*>(kmalloc(sizeof(Timer::TimerEvent) * TIMER_ORDER_COUNT));
+    if(!events){
+        return 3;
+    }
+
+    uint32_t seed = 0x1234567;
+
+    dispatchedCount = 0;
+    for(unsigned i = 0; i < TIMER_ORDER_COUNT; i++){
+        // Pass the event to its own callback so it can record the deadline
+        new (&events[i]) Timer::TimerEvent(1 + Random(seed) % 2000, [](void* ev){
+            unsigned index = __atomic_fetch_add(&dispatchedCount, 1, __ATOMIC_RELAXED);
+            dispatchedDeadlines[index] = reinterpret_cast<Timer::TimerEvent*>(ev)->GetDeadline();
+        }, &events[i]);
+    }
+
+    Scheduler::GetCurrentThread()->Sleep(10000);
+
+    int ret = 0;
+    if(__atomic_load_n(&dispatchedCount, __ATOMIC_ACQUIRE) != TIMER_ORDER_COUNT){
+        Log::Warning("[TestModule] Only %u/%u timers fired", dispatchedCount, TIMER_ORDER_COUNT);
+        ret = 1;
+    }
+
+    for(unsigned i = 1; i < dispatchedCount; i++){
+        if(dispatchedDeadlines[i] < dispatchedDeadlines[i - 1]){
+            Log::Warning("[TestModule] Timer %u fired out of order", i);
+            ret = 2;
+            break;
+        }
+    }
+
+    for(unsigned i = 0; i < TIMER_ORDER_COUNT; i++){
+        events[i].~TimerEvent(); // Already dispatched, should not touch the queue
+    }
+
+    kfree(events);
+    return ret;
+}
+
+// Arm and cancel 100k timers far enough in the future that none of them fire
+static int TimerBenchmark(){
+    Timer::TimerEvent* events = reinterpret_cast<Timer::TimerEvent*>(kmalloc(sizeof(Timer::TimerEvent) * TIMER_BENCHMARK_COUNT));
+    if(!events){
+        return 3;
+    }
+
+    uint32_t seed = 0x89ABCDE;
+
+    uint64_t start = Timer::GetSystemUptimeNs();
+    for(unsigned i = 0; i < TIMER_BENCHMARK_COUNT; i++){
+        new (&events[i]) Timer::TimerEvent(10000000 + Random(seed) % 10000000, [](void*){
+            assert(!"Benchmark timer fired");
+        }, nullptr);
+    }
+    uint64_t armed = Timer::GetSystemUptimeNs();
+
+    // Cancel in a different order to the one they were armed in
+    for(unsigned i = 0; i < TIMER_BENCHMARK_COUNT; i++){
+        events[(i * 7919) % TIMER_BENCHMARK_COUNT].~TimerEvent();
+    }
+    uint64_t cancelled = Timer::GetSystemUptimeNs();
+
+    // Destroying an event that has already been dispatched should not need the queue lock
+    for(unsigned i = 0; i < TIMER_BENCHMARK_COUNT; i++){
+        new (&events[i]) Timer::TimerEvent(0, [](void*){}, nullptr);
+    }
+
+    uint64_t dispatchedStart = Timer::GetSystemUptimeNs();
+    for(unsigned i = 0; i < TIMER_BENCHMARK_COUNT; i++){
+        events[i].~TimerEvent();
+    }
+    uint64_t dispatchedEnd = Timer::GetSystemUptimeNs();
+
+    kfree(events);
+
+    Log::Info("[TestModule] %u timers: arm %u ns/op, cancel %u ns/op, cancel dispatched %u ns/op", TIMER_BENCHMARK_COUNT,
+        (armed - start) / TIMER_BENCHMARK_COUNT, (cancelled - armed) / TIMER_BENCHMARK_COUNT,
+        (dispatchedEnd - dispatchedStart) / TIMER_BENCHMARK_COUNT);
+
+    return 0;
+}
+
+int TimerTest(){
+    Log::Info("[TestModule] Running Timer Test...");
+
+    if(int ret = TimerOrderTest(); ret){
+        return ret;
+    }
+
+    return TimerBenchmark();
+}
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <stdint.h>
+#include <Spinlock.h>
 #include <TSS.h>
 #include <Thread.h>
+#include <TimerEvent.h>
 #include <System.h>
 
 struct Process;
+struct ProfilerBuffer;
 template<typename T>
 class FastList;
 
@@ -14,16 +17,36 @@ typedef struct {
 	uint64_t base;
 } __attribute__((packed)) gdt_ptr_t;
 
+#define MSR_EFER 0xC0000080
+#define MSR_STAR 0xC0000081 // Segment selectors for SYSCALL/SYSRET
+#define MSR_LSTAR 0xC0000082 // SYSCALL entry point
+#define MSR_FMASK 0xC0000084 // RFLAGS bits cleared on SYSCALL
+
+#define EFER_SCE (1 << 0) // SYSCALL enable
+
 struct CPU{
 	CPU* self;
+	// Used by the SYSCALL entry point, the offsets are hardcoded in IDT.asm
+	uintptr_t kernelStack = 0; // Kernel stack of the current thread, same as tss.rsp0
+	uintptr_t userStack = 0; // User stack pointer saved on SYSCALL
     uint64_t id; // APIC/CPU id
     void* gdt; // GDT
 	gdt_ptr_t gdtPtr;
 	Thread* currentThread = nullptr;
 	Process* idleProcess = nullptr;
-	volatile int runQueueLock = 0;
+	TicketLock runQueueLock = TicketLock(LockClassRunQueue);
 	FastList<Thread*>* runQueue;
+	Timer::TimerQueue timers; // Pending timer events
+	uint64_t timerDeadline = UINT64_MAX; // Deadline the local APIC timer is programmed for, in nanoseconds since boot
+	uint64_t sliceDeadline = 0; // End of the current scheduler tick in nanoseconds since boot
+	Thread* fpuOwner = nullptr; // Thread whose state was last loaded into the extended registers
+	bool fpuTrap = false; // CR0.TS is set, the next FPU instruction raises #NM
+	ProfilerBuffer* profilerBuffer = nullptr; // Samples taken on this CPU, see Profiler.h
+	uint64_t profilerDeadline = 0; // Time the next sample is due in nanoseconds since boot
     tss_t tss __attribute__((aligned(16)));
+
+	// Is the CPU running its idle thread (or has not started scheduling yet)?
+	inline bool IsIdle() const { return !currentThread || currentThread->parent == idleProcess; }
 };
 
 enum {
@@ -86,6 +109,12 @@ enum {
 	CPUID_EDX_PBE = 1 << 31
 };
 
+// Structured extended features, leaf 7 subleaf 0
+enum {
+	CPUID_7_EBX_ERMS = 1 << 9, // Enhanced REP MOVSB/STOSB
+	CPUID_7_EDX_FSRM = 1 << 4, // Fast short REP MOVSB
+};
+
 typedef struct {
 	char vendorString[12]; // CPU vendor string
 	char nullTerminator = '\0'; // Acts as a terminator for the vendor string
@@ -96,6 +125,10 @@ typedef struct {
 
 cpuid_info_t CPUID();
 
+inline void CPUIDLeaf(uint32_t leaf, uint32_t subleaf, uint32_t& eax, uint32_t& ebx, uint32_t& ecx, uint32_t& edx){
+	asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(leaf), "c"(subleaf));
+}
+
 inline uintptr_t GetRBP(){
 	volatile uintptr_t val;
 	
@@ -110,6 +143,16 @@ inline uintptr_t GetCR3(){
 	return val;
 }
 
+static inline uint64_t ReadMSR(uint32_t msr){
+	uint32_t low, high;
+	asm volatile("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+	return (static_cast<uint64_t>(high) << 32) | low;
+}
+
+static inline void WriteMSR(uint32_t msr, uint64_t value){
+	asm volatile("wrmsr" :: "a"(value & 0xFFFFFFFF), "d"(value >> 32), "c"(msr));
+}
+
 static inline void SetCPULocal(CPU* val){
 	val->self = val;
 	asm volatile("wrmsr" :: "a"((uintptr_t)val & 0xFFFFFFFF) /*Value low*/, "d"(((uintptr_t)val >> 32) & 0xFFFFFFFF) /*Value high*/, "c"(0xC0000102) /*Set Kernel GS Base*/);
@@ -124,6 +124,11 @@ typedef struct {
 #define PT_SHLIB 5
 #define PT_PHDR 6
 
+// Segment permissions
+#define PF_X 1 // Execute
+#define PF_W 2 // Write
+#define PF_R 4 // Read
+
 // Section Types
 #define SHT_NULL 0 // Unused
 #define SHT_PROGBITS 1 // Information defined by the program
@@ -178,6 +183,21 @@ using ELFRelocation = ELF64Relocation;
 using ELFRelocationA = ELF64RelocationA;
 
 typedef struct Process process_t;
+class FsNode;
 
 int VerifyELF(void* elf);
-elf_info_t LoadELFSegments(process_t* proc, void* elf, uintptr_t base);
\ No newline at end of file
+
+/////////////////////////////
+/// \brief Map the loadable segments of an ELF file into a process
+///
+/// Segments are mapped straight from the node's page cache and faulted in on demand.
+/// Read only segments are shared between every process mapping them,
+/// writable segments are copy on write.
+///
+/// \param proc Process to map into
+/// \param node ELF file
+/// \param base Load base (0 for non-relocatable executables)
+///
+/// \return ELF information, entry is 0 on failure
+/////////////////////////////
+elf_info_t LoadELFSegments(process_t* proc, FsNode* node, uintptr_t base);
\ No newline at end of file
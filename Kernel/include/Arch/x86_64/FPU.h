@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct CPU;
+struct Thread;
+
+#define CR0_TS (1 << 3) // Task switched, FPU/SSE/AVX instructions raise #NM
+#define CR4_OSFXSR (1 << 9)
+#define CR4_OSXMMEXCPT (1 << 10)
+#define CR4_OSXSAVE (1 << 18)
+
+#define XCR0_X87 (1 << 0)
+#define XCR0_SSE (1 << 1)
+#define XCR0_AVX (1 << 2)
+#define XCR0_OPMASK (1 << 5) // AVX-512 opmask registers
+#define XCR0_ZMM_HI256 (1 << 6) // Upper halves of ZMM0-15
+#define XCR0_HI16_ZMM (1 << 7) // ZMM16-31
+#define XCR0_AVX512 (XCR0_OPMASK | XCR0_ZMM_HI256 | XCR0_HI16_ZMM)
+
+// Time slices in a row a thread has to use the FPU in before its state is restored on switch
+// rather than on the first FPU instruction (lazy mode only)
+#define FPU_EAGER_THRESHOLD 5
+
+typedef struct {
+    uint64_t xstateBV; // Components in the save area that are not in their initial state
+    uint64_t xcompBV;
+    uint64_t reserved[6];
+} __attribute__((packed)) xsave_header_t;
+
+namespace FPU {
+    /////////////////////////////
+    /// \brief Detect FPU features and enable them on the bootstrap processor
+    ///
+    /// Must be called before any other processors are started or threads are created.
+    /////////////////////////////
+    void Initialize();
+
+    /////////////////////////////
+    /// \brief Enable the features found by Initialize() on the current processor
+    /////////////////////////////
+    void InitializeCPU();
+
+    /////////////////////////////
+    /// \return Size of the extended register state in bytes
+    /////////////////////////////
+    size_t StateSize();
+
+    /////////////////////////////
+    /// \brief Allocate and initialize the extended register state for a thread
+    /////////////////////////////
+    void* AllocateState();
+
+    /////////////////////////////
+    /// \brief Set the extended register state to default values (FPU and SSE control words)
+    /////////////////////////////
+    void InitializeState(void* state);
+
+    /////////////////////////////
+    /// \brief Save the state of a thread being switched out if it was using the FPU
+    ///
+    /// Interrupts must be disabled.
+    /////////////////////////////
+    void SwitchOut(CPU* cpu, Thread* thread);
+
+    /////////////////////////////
+    /// \brief Load the state of a thread being switched in
+    ///
+    /// In lazy mode the state is only loaded once the thread executes an FPU instruction,
+    /// unless it has used the FPU in the last FPU_EAGER_THRESHOLD time slices.
+    /// Interrupts must be disabled.
+    /////////////////////////////
+    void SwitchIn(CPU* cpu, Thread* thread);
+
+    /////////////////////////////
+    /// \brief Reset the state of the current thread (e.g. on exec)
+    /////////////////////////////
+    void Reset(Thread* thread);
+
+    /////////////////////////////
+    /// \brief Copy the state of the current thread to a forked thread
+    /////////////////////////////
+    void Fork(Thread* thread, Thread* newThread);
+}
@@ -12,6 +12,7 @@ namespace HAL{
     extern bool disableSMP;
     extern bool useKCon;
     extern bool runTests;
+    extern bool useLazyFPU;
 
     void InitCore();
 
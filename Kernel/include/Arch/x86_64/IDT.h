@@ -7,6 +7,8 @@
 
 #define IPI_HALT 0xFE
 #define IPI_SCHEDULE 0xFD
+#define IRQ_LOCAL_TIMER 0xFC // Local APIC timer
+#define IPI_TLB_SHOOTDOWN 0xFB
 
 typedef struct {
 	uint16_t base_low;
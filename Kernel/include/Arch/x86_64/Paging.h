@@ -136,6 +136,19 @@ namespace Memory{
     /////////////////////////////
     void MapVirtualMemory4K(uint64_t phys, uint64_t virt, uint64_t amount, uint64_t flags, PageMap* pageMap);
 
+    /////////////////////////////
+    /// \brief Invalidate pages on other CPUs
+    ///
+    /// MapVirtualMemory4K only invalidates the TLB of the current CPU,
+    /// this is needed when removing access to pages of an address space that may be loaded elsewhere.
+    /// Must be called with interrupts enabled, otherwise two CPUs could end up waiting on each other.
+    ///
+    /// \param virt Virtual address of the first page
+    /// \param amount Amount of pages
+    /// \param pageMap PageMap the pages belong to
+    /////////////////////////////
+    void TLBShootdown(uint64_t virt, uint64_t amount, PageMap* pageMap);
+
     uintptr_t GetIOMapping(uintptr_t addr);
 
 	bool CheckKernelPointer(uintptr_t addr, uint64_t len);
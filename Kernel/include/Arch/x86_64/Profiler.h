@@ -0,0 +1,37 @@
+#pragma once
+
+#include <ABI/Profiler.h>
+#include <Compiler.h>
+
+#include <stdint.h>
+
+struct CPU;
+struct RegisterContext;
+
+/////////////////////////////
+/// \brief Sampling CPU profiler
+///
+/// Whilst running, the local APIC timer handler of each CPU records the interrupted instruction
+/// and the frame pointer call chain into a buffer for that CPU.
+/// The samples are read (and removed) through /dev/profile as lemon_profiler_sample_t.
+/// A CPU only starts sampling on its next timer interrupt, idle CPUs with nothing to wake for are not sampled.
+/////////////////////////////
+namespace Profiler {
+extern bool running;
+
+ALWAYS_INLINE bool IsRunning() { return __atomic_load_n(&running, __ATOMIC_ACQUIRE); }
+
+/////////////////////////////
+/// \brief Start sampling, or change the frequency if already running
+///
+/// \return 0 on success, -EINVAL if the frequency is out of range, -ENOMEM if the buffers could not be allocated
+/////////////////////////////
+int Start(unsigned frequency);
+void Stop();
+
+// Called by the timer handler with interrupts disabled
+void Tick(CPU* cpu, RegisterContext* r, uint64_t now);
+
+// Create the profile device
+void Initialize();
+} // namespace Profiler
@@ -2,6 +2,7 @@
 
 #include <CPU.h>
 #include <ELF.h>
+#include <Fs/FileDescriptorTable.h>
 #include <Fs/Filesystem.h>
 #include <Hash.h>
 #include <List.h>
@@ -20,8 +21,8 @@
 
 #define KERNEL_CS 0x08
 #define KERNEL_SS 0x10
-#define USER_CS 0x1B
-#define USER_SS 0x23
+#define USER_CS 0x23
+#define USER_SS 0x1B
 
 typedef void* handle_t;
 
@@ -50,6 +51,7 @@ typedef struct Process {
     char name[NAME_MAX];
 
     MappedRegion* signalTrampoline;
+    MappedRegion* vdso = nullptr; // Time page, process page and vDSO code
     SignalHandler signalHandlers[SIGNAL_MAX]; // Signal handlers
     siginfo_t* siginfoPointer = nullptr;
 
@@ -58,8 +60,7 @@ typedef struct Process {
 
     ReadWriteLock processLock;
 
-    lock_t handleLock = 0;
-    Vector<Handle> handles;
+    HandleTable handles;
     List<Scheduler::ProcessStateThreadBlocker*> blocking; // Threads blocking awaiting a state change
     HashMap<uintptr_t, List<FutexThreadBlocker*>*> futexWaitQueue = HashMap<uintptr_t, List<FutexThreadBlocker*>*>(8);
 
@@ -76,68 +77,10 @@ typedef struct Process {
         return nullptr;
     }
 
-    ALWAYS_INLINE int AllocateFileDescriptor(fs_fd_t* ptr) {
-        ScopedSpinLock lockFds(fileDescriptorsLock);
-
-        unsigned i = 0;
-        for (; i < fileDescriptors.get_length(); i++) {
-            if (!fileDescriptors[i]) {
-                fileDescriptors[i] = ptr;
-                return i;
-            }
-        }
-
-        fileDescriptors.add_back(ptr);
-        return i;
-    }
-
-    ALWAYS_INLINE int ReplaceFileDescriptor(int fd, fs_fd_t* ptr) {
-        ScopedSpinLock lockFds(fileDescriptorsLock);
-        if (fd > fileDescriptors.get_length()) {
-            return 1;
-        } else if (fd == fileDescriptors.get_length()) {
-            fileDescriptors.add_back(ptr);
-            return 0;
-        } else {
-            fs_fd_t*& f = fileDescriptors[fd];
-            if (f) {
-                fs::Close(f);
-                delete f;
-            }
-
-            f = ptr;
-            return 0;
-        }
-    }
-
-    ALWAYS_INLINE int DestroyFileDescriptor(int fd) {
-        ScopedSpinLock lockFds(fileDescriptorsLock);
-        if (fd >= fileDescriptors.get_length()) {
-            return 1;
-        }
-
-        if (fs_fd_t*& f = fileDescriptors[fd]; f) {
-            fs::Close(f);
-            delete f;
-
-            f = nullptr;
-
-            return 0;
-        }
-
-        return 1;
-    }
-
-    ALWAYS_INLINE fs_fd_t* GetFileDescriptor(int fd) {
-        ScopedSpinLock lockFds(fileDescriptorsLock);
-        if (fd < fileDescriptors.get_length()) {
-            return fileDescriptors[fd];
-        }
-
-        return nullptr;
-    }
-
-    ALWAYS_INLINE unsigned FileDescriptorCount() const { return fileDescriptors.get_length(); }
+    ALWAYS_INLINE int AllocateFileDescriptor(fs_fd_t* ptr) { return fileDescriptors.Allocate(ptr); }
+    ALWAYS_INLINE int ReplaceFileDescriptor(int fd, fs_fd_t* ptr) { return fileDescriptors.Replace(fd, ptr); }
+    ALWAYS_INLINE int DestroyFileDescriptor(int fd) { return fileDescriptors.Destroy(fd); }
+    ALWAYS_INLINE fs_fd_t* GetFileDescriptor(int fd) { return fileDescriptors.Get(fd); }
 
     ALWAYS_INLINE PageMap* GetPageMap() { return addressSpace->GetPageMap(); }
 
@@ -163,8 +106,7 @@ typedef struct Process {
         return nullptr;
     }
 
-    lock_t fileDescriptorsLock = 0;
-    Vector<fs_fd_t*> fileDescriptors;
+    FileDescriptorTable fileDescriptors;
 
 private:
 } process_t;
@@ -213,7 +155,7 @@ pid_t CreateChildThread(process_t* process, uintptr_t entry, uintptr_t stack, ui
 process_t* CreateProcess(void* entry);
 process_t* CloneProcess(process_t* process);
 
-process_t* CreateELFProcess(void* elf, int argc = 0, char** argv = nullptr, int envc = 0, char** envp = nullptr,
+process_t* CreateELFProcess(FsNode* node, int argc = 0, char** argv = nullptr, int envc = 0, char** envp = nullptr,
                             const char* execPath = nullptr);
 uintptr_t LoadELF(Process* process, uintptr_t* stack, elf_info_t elf, int argc = 0, char** argv = nullptr, int envc = 0,
                   char** envp = nullptr, const char* execPath = nullptr);
@@ -239,7 +181,7 @@ inline bool CheckUsermodePointer(T* ptr, AddressSpace* addressSpace = GetCurrent
     return addressSpace->RangeInRegion(reinterpret_cast<uintptr_t>(ptr), sizeof(T));
 }
 
-Handle& RegisterHandle(process_t* proc, FancyRefPtr<KernelObject> ko);
+handle_id_t RegisterHandle(process_t* proc, FancyRefPtr<KernelObject> ko);
 long FindHandle(process_t* proc, handle_id_t id, Handle** ref);
 long DestroyHandle(process_t* proc, handle_id_t id);
 
@@ -250,6 +192,13 @@ process_t* FindProcessByPID(pid_t pid);
 pid_t GetNextProccessPID(pid_t pid);
 void InsertNewThreadIntoQueue(Thread* thread);
 
+/////////////////////////////
+/// \brief Send a schedule IPI to a CPU
+///
+/// Idle CPUs do not receive ticks, so they have to be woken when a thread on them becomes runnable.
+/////////////////////////////
+void WakeCPU(CPU* cpu);
+
 void Initialize();
 void Tick(RegisterContext* r);
 
@@ -18,6 +18,7 @@ enum {
 	ThreadStateDying, // Thread is actively being killed
 };
 
+struct CPU;
 struct Process;
 struct Thread;
 
@@ -30,6 +31,7 @@ protected:
 	bool shouldBlock = true; // If Unblock() is called before the thread is blocked or the lock is acquired then tell the thread not to block
 	bool interrupted = false; // Returned by Block so the thread knows it has been interrupted
 	bool removed = false; // Has the blocker been removed from queue(s)?
+	bool interruptible = true; // Can signals interrupt the blocker?
 public:
 	virtual ~ThreadBlocker() = default;
 
@@ -38,6 +40,7 @@ public:
 
 	inline bool ShouldBlock() { return shouldBlock; }
 	inline bool WasInterrupted() { return interrupted; } 
+	inline bool IsInterruptible() { return interruptible; }
 };
 
 class GenericThreadBlocker : public ThreadBlocker{
@@ -61,8 +64,16 @@ struct Thread {
 	RegisterContext lastSyscall; // Last system call
 	void* fxState; // State of the extended registers
 
+	CPU* fpuCPU = nullptr; // CPU the extended registers were last loaded on
+	uint8_t fpuCounter = 0; // Time slices in a row the FPU has been used in
+	bool fpuDisabled = false; // Kernel thread, never touches the extended registers
+	uint64_t fpuSaves = 0; // Times the extended registers were saved on a switch
+	uint64_t fpuRestores = 0; // Times the extended registers were loaded
+	uint64_t fpuTraps = 0; // Times the first FPU instruction in a time slice raised #NM (lazy restore)
+
 	Thread* next = nullptr; // Next thread in queue
 	Thread* prev = nullptr; // Previous thread in queue
+	CPU* cpu = nullptr; // CPU whose run queue the thread is in
 	
 	uint8_t priority = 0; // Thread priority
 	uint8_t state = ThreadStateRunning; // Thread state
@@ -13,12 +13,23 @@ static inline bool operator<(timeval l, timeval r){
 }
 
 struct thread;
+struct CPU;
 
 namespace Timer{
     uint64_t GetSystemUptime();
     uint32_t GetTicks();
     uint32_t GetFrequency();
 
+    // TSC ticks per second
+    uint64_t GetTSCFrequency();
+
+    /////////////////////////////
+    /// \brief Get time since boot in nanoseconds
+    ///
+    /// Read from the TSC, so it has far better resolution than the scheduler tick.
+    /////////////////////////////
+    uint64_t GetSystemUptimeNs();
+
     timeval GetSystemUptimeStruct();
     long TimeDifference(const timeval& newTime, const timeval& oldTime);
 
@@ -26,10 +37,35 @@ namespace Timer{
 
     void SleepCurrentThread(timeval& time);
 
+    /////////////////////////////
+    /// \brief Program the local APIC timer of the current CPU
+    ///
+    /// The timer is one-shot, it is only reprogrammed if the deadline is earlier than the one already set.
+    /// Interrupts must be disabled.
+    ///
+    /// \param cpu Current CPU
+    /// \param deadline Time since boot in nanoseconds
+    /////////////////////////////
+    void ArmLocalTimer(CPU* cpu, uint64_t deadline);
+
+    /////////////////////////////
+    /// \brief Start a new scheduler tick on the current CPU
+    ///
+    /// Sets cpu->sliceDeadline and arms the local APIC timer for it. Does nothing when the CPU is idle so that it is only woken for timer events.
+    /////////////////////////////
+    void ArmTimeSlice(CPU* cpu);
+
     // Initialize
     void Initialize(uint32_t freq);
+
+    /////////////////////////////
+    /// \brief Start the local APIC timer on the current CPU
+    ///
+    /// The first call calibrates the timer against the TSC.
+    /////////////////////////////
+    void InitializeLocalTimer();
 }
 
 inline long operator-(const timeval& l, const timeval& r){
     return Timer::TimeDifference(l, r);
-}
\ No newline at end of file
+}
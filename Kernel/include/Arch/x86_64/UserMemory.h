@@ -0,0 +1,72 @@
+#pragma once
+
+#include <Compiler.h>
+#include <Paging.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define USER_BOUNCE_SIZE 0x10000 // Largest kernel buffer used for data that cannot be copied straight to or from user memory
+
+// Instruction allowed to fault on user memory and where to continue if it does
+typedef struct {
+    uintptr_t instruction;
+    uintptr_t fixup;
+} exception_fixup_t;
+
+namespace Memory {
+    /////////////////////////////
+    /// \brief Find the fixup for a faulting instruction in the exception table
+    ///
+    /// \return Address to continue at, 0 if the instruction is not allowed to fault
+    /////////////////////////////
+    uintptr_t FindExceptionFixup(uintptr_t rip);
+
+    // Usermode is the first PML4 entry, anything else belongs to the kernel
+    ALWAYS_INLINE bool IsUsermodeRange(uintptr_t base, size_t size) {
+        return base + size >= base && base + size <= PDPT_SIZE;
+    }
+}
+
+/////////////////////////////
+/// \brief Copy data from user memory
+///
+/// Any page faults are handled as usual, unmapped memory results in -EFAULT rather than a kernel panic.
+/// There is no need to check the pointer beforehand.
+///
+/// \return 0 on success, -EFAULT if the source is not accessible
+/////////////////////////////
+[[nodiscard]] long copy_from_user(void* dest, const void* src, size_t size);
+
+/////////////////////////////
+/// \brief Copy data to user memory
+///
+/// \return 0 on success, -EFAULT if the destination is not accessible
+/////////////////////////////
+[[nodiscard]] long copy_to_user(void* dest, const void* src, size_t size);
+
+/////////////////////////////
+/// \brief Copy a null terminated string from user memory
+///
+/// \param dest Buffer of at least max bytes
+/// \param src String in user memory
+/// \param max Maximum size of the string including the null terminator
+///
+/// \return Length of the string, -EFAULT if the string is not accessible or -ENAMETOOLONG if it is not terminated within max bytes
+/////////////////////////////
+[[nodiscard]] long strncpy_from_user(char* dest, const char* src, size_t max);
+
+/////////////////////////////
+/// \brief Get the length of a null terminated string in user memory
+///
+/// \return Length of the string, -EFAULT if the string is not accessible or -ENAMETOOLONG if it is not terminated within max bytes
+/////////////////////////////
+[[nodiscard]] long strnlen_user(const char* str, size_t max);
+
+template <typename T> [[nodiscard]] ALWAYS_INLINE long get_user(T* value, const T* ptr) {
+    return copy_from_user(value, ptr, sizeof(T));
+}
+
+template <typename T> [[nodiscard]] ALWAYS_INLINE long put_user(T* ptr, const T& value) {
+    return copy_to_user(ptr, &value, sizeof(T));
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <ABI/VDSO.h>
+
+#include <stdint.h>
+
+struct Process;
+struct MappedRegion;
+
+namespace VDSO {
+    /////////////////////////////
+    /// \brief Set up the time page and copy the vDSO code
+    ///
+    /// The code is in VDSO.asm, which hardcodes the layout of the time and process pages.
+    ///
+    /// \param tscBase TSC value at boot
+    /// \param tscMultiplier Nanoseconds per TSC tick as 32.32 fixed point
+    /////////////////////////////
+    void Initialize(uint64_t tscBase, uint64_t tscMultiplier);
+
+    /////////////////////////////
+    /// \brief Update the coarse time, called from the timer interrupt
+    ///
+    /// Skipped if another CPU is already writing the page.
+    /////////////////////////////
+    void UpdateTime(uint64_t ns);
+
+    /////////////////////////////
+    /// \brief Set the offset of CLOCK_REALTIME from the time since boot
+    ///
+    /// Must be called whenever the real time is set or adjusted,
+    /// otherwise the vDSO and the clock_gettime system call disagree.
+    /////////////////////////////
+    void SetRealtimeOffset(int64_t offset);
+
+    /////////////////////////////
+    /// \brief Offset of CLOCK_REALTIME from the time since boot in nanoseconds
+    /////////////////////////////
+    int64_t RealtimeOffset();
+
+    /////////////////////////////
+    /// \brief Map the vDSO into a process
+    ///
+    /// \param process Process to map the vDSO into, its PID is written to the process page
+    /// \param base Address of a vDSO mapping inherited through fork to replace, or 0.
+    /// The new mapping is placed at exactly the same address.
+    ///
+    /// \return Region of the mapping, the code is at LEMON_VDSO_CODE_OFFSET
+    /////////////////////////////
+    MappedRegion* Map(Process* process, uintptr_t base = 0);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Compiler.h>
+#include <Fs/Filesystem.h>
+#include <SlotTable.h>
+#include <Spinlock.h>
+
+/////////////////////////////
+/// \brief Table of the file descriptors open in a process
+///
+/// New file descriptors always take the lowest free number.
+/// Looking up a file descriptor does not take the table lock.
+/////////////////////////////
+class FileDescriptorTable final {
+public:
+    FileDescriptorTable() : m_lock(LockClassFileDescriptorTable) {}
+
+    /////////////////////////////
+    /// \brief Allocate the lowest free file descriptor
+    ///
+    /// \return File descriptor, -EMFILE if the table is full. The caller keeps ownership of handle on failure.
+    /////////////////////////////
+    int Allocate(fs_fd_t* handle);
+
+    /////////////////////////////
+    /// \brief Set a specific file descriptor, closing what was there before
+    ///
+    /// \return 0 on success, 1 if the file descriptor is out of range
+    /////////////////////////////
+    int Replace(int fd, fs_fd_t* handle);
+
+    /////////////////////////////
+    /// \brief Close and free a file descriptor
+    ///
+    /// \return 0 on success, 1 if the file descriptor is not open
+    /////////////////////////////
+    int Destroy(int fd);
+
+    // Close every file descriptor in the table
+    void Clear();
+
+    ALWAYS_INLINE fs_fd_t* Get(int fd) {
+        if (fd < 0) {
+            return nullptr;
+        }
+
+        fs_fd_t** slot = m_slots.Get(fd);
+        if (!slot) {
+            return nullptr;
+        }
+
+        return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    }
+
+    // File descriptors below this may be open
+    ALWAYS_INLINE unsigned Capacity() const { return m_slots.Capacity(); }
+
+    template <typename F> void ForEach(F func) {
+        for (unsigned i = 0; i < m_slots.Capacity(); i++) {
+            if (fs_fd_t* handle = Get(i); handle) {
+                func(static_cast<int>(i), handle);
+            }
+        }
+    }
+
+private:
+    TicketLock m_lock;
+    SlotTable<fs_fd_t*> m_slots;
+};
@@ -164,6 +164,8 @@ public:
 
     int error = 0;
 
+    class PageCache* pageCache = nullptr; // Pages shared by mappings of the node
+
     virtual ~FsNode();
 
     /////////////////////////////
@@ -190,6 +192,23 @@ public:
     /////////////////////////////
     virtual ssize_t Write(size_t off, size_t size, uint8_t* buffer); // Write Data
 
+    /////////////////////////////
+    /// \brief Read data from filesystem node into user memory
+    ///
+    /// Nodes that can copy their data straight to user memory with copy_to_user override this,
+    /// by default the data is read into a kernel buffer first.
+    ///
+    /// \return Bytes read or if negative an error code, -EFAULT if nothing could be copied to the buffer
+    /////////////////////////////
+    virtual ssize_t ReadUser(size_t off, size_t size, uint8_t* buffer);
+
+    /////////////////////////////
+    /// \brief Write data from user memory to filesystem node
+    ///
+    /// \return Bytes written or if negative an error code, -EFAULT if nothing could be copied from the buffer
+    /////////////////////////////
+    virtual ssize_t WriteUser(size_t off, size_t size, const uint8_t* buffer);
+
     virtual fs_fd_t* Open(size_t flags); // Open
     virtual void Close();                // Close
 
@@ -327,7 +346,7 @@ public:
         releaseLock(&lock);
     }
 
-    FilesystemBlocker(FsNode* _node, size_t len) : node(_node), requestedLength(len) {
+    FilesystemBlocker(FsNode* _node, size_t len, int type = BlockType::BlockRead) : node(_node), blockType(type), requestedLength(len) {
         acquireLock(&lock);
 
         acquireLock(&node->blockedLock);
@@ -357,6 +376,7 @@ public:
     }
 
     inline size_t RequestedLength() { return requestedLength; }
+    inline int Type() const { return blockType; }
 
     ~FilesystemBlocker();
 };
@@ -471,6 +491,24 @@ ssize_t Read(FsNode* node, size_t offset, size_t size, void* buffer);
 /// \return Bytes written or if negative an error code
 /////////////////////////////
 ssize_t Write(FsNode* node, size_t offset, size_t size, void* buffer);
+
+/////////////////////////////
+/// \brief Read data from filesystem node into user memory
+///
+/// \param buffer Buffer in user memory, does not need to be checked beforehand
+///
+/// \return Bytes read or if negative an error code
+/////////////////////////////
+ssize_t ReadUser(FsNode* node, size_t offset, size_t size, void* buffer);
+
+/////////////////////////////
+/// \brief Write data from user memory to filesystem node
+///
+/// \param buffer Buffer in user memory, does not need to be checked beforehand
+///
+/// \return Bytes written or if negative an error code
+/////////////////////////////
+ssize_t WriteUser(FsNode* node, size_t offset, size_t size, const void* buffer);
 fs_fd_t* Open(FsNode* node, uint32_t flags = 0);
 void Close(FsNode* node);
 void Close(fs_fd_t* handle);
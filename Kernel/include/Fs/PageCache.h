@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Hash.h>
+#include <Lock.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+class FsNode;
+
+// Pages of file data shared between every mapping of a node
+//
+// Pages are read from the node on first use and are freed once the last mapping releases them.
+class PageCache final {
+public:
+    /////////////////////////////
+    /// \brief Get the page cache of a node
+    ///
+    /// Creates the page cache if the node does not have one yet.
+    /// The reference must be given back with Release().
+    /////////////////////////////
+    static PageCache* Get(FsNode* node);
+    void Release();
+
+    /////////////////////////////
+    /// \brief Copy data written to a node into its cached pages
+    ///
+    /// Called after data is written to the node with write() and friends
+    /// so that mappings of the node see the new data. Does nothing if the node has no page cache.
+    ///
+    /// \param offset Offset in the node the data was written to
+    /// \param size Amount of data written
+    /// \param data Data that was written
+    /////////////////////////////
+    static void Update(FsNode* node, size_t offset, size_t size, const uint8_t* data);
+
+    /////////////////////////////
+    /// \brief Acquire a page of the node
+    ///
+    /// Reads the page from the node if it is not cached.
+    /// The part of the page past the end of the node is zeroed.
+    ///
+    /// \param offset Page aligned offset in the node
+    ///
+    /// \return Physical address of the page, 0 on failure
+    /////////////////////////////
+    uintptr_t AcquirePage(size_t offset);
+    void ReleasePage(size_t offset);
+
+    /////////////////////////////
+    /// \brief Write a page back to the node
+    ///
+    /// Only the part of the page within the node is written, mappings never grow the node.
+    /// The caller must hold a reference to the page.
+    ///
+    /// \return 0 on success, negative error code on failure
+    /////////////////////////////
+    int WriteBack(size_t offset);
+
+private:
+    struct CachedPage {
+        uintptr_t phys;
+        unsigned refCount;
+    };
+
+    PageCache(FsNode* node);
+    ~PageCache();
+
+    FsNode* node;
+    unsigned refCount = 0;
+
+    lock_t lock = 0;
+    HashMap<unsigned long, CachedPage*> pages;
+};
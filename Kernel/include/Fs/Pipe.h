@@ -4,20 +4,32 @@
 #include <RefPtr.h>
 #include <Stream.h>
 
+#define PIPE_BUFSIZE 0x10000 // 64 KB, writers block once this much data is unread
+
 class UNIXPipe final : public FsNode {
 public:
     UNIXPipe(int end, FancyRefPtr<DataStream> stream);
 
     ssize_t Read(size_t off, size_t size, uint8_t* buffer);
     ssize_t Write(size_t off, size_t size, uint8_t* buffer);
+    ssize_t ReadUser(size_t off, size_t size, uint8_t* buffer);
+    ssize_t WriteUser(size_t off, size_t size, const uint8_t* buffer);
 
     void Watch(FilesystemWatcher& watcher, int events);
     void Unwatch(FilesystemWatcher& watcher);
 
     void Close();
 
+    bool CanRead();
+    bool CanWrite();
+
     static void CreatePipe(UNIXPipe*& read, UNIXPipe*& write);
 protected:
+    // Shared by both ends, protects otherEnd
+    struct PipeLink {
+        lock_t lock = 0;
+    };
+
     enum {
         InvalidPipe,
         ReadEnd,
@@ -26,9 +38,23 @@ protected:
 
     bool widowed = false;
     UNIXPipe* otherEnd = nullptr;
+    FancyRefPtr<PipeLink> link;
+
+    // Open handles hold one reference between them, the rest are held whilst waking the other end
+    unsigned references = 1;
 
     FancyRefPtr<DataStream> stream;
     
     List<FilesystemWatcher*> watching;
     lock_t watchingLock = 0;
+
+    void Wake(int blockType);
+
+    // user is set when buffer is in user memory
+    ssize_t ReadStream(uint8_t* buffer, size_t size, bool user);
+    ssize_t WriteStream(const uint8_t* buffer, size_t size, bool user);
+
+    // Returns the other end with a reference taken, or nullptr if it has been closed
+    UNIXPipe* AcquireOtherEnd();
+    void Unref();
 };
\ No newline at end of file
@@ -36,6 +36,8 @@ namespace fs::Temp{
 
         ssize_t Read(size_t off, size_t size, uint8_t* buffer); // Read Data
         ssize_t Write(size_t off, size_t size, uint8_t* buffer); // Write Data
+        ssize_t ReadUser(size_t off, size_t size, uint8_t* buffer);
+        ssize_t WriteUser(size_t off, size_t size, const uint8_t* buffer);
 
         int Truncate(off_t length); // Truncate file
 
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
+#include <Assert.h>
+#include <Compiler.h>
+#include <Liballoc.h>
 #include <List.h>
+#include <Move.h>
+#include <Spinlock.h>
+#include <String.h>
 
 static inline unsigned HashU(unsigned value){
 	unsigned hash = value;
-	
+
 	hash = ((hash >> 5) ^ hash) * 47499631;
 	hash = ((hash >> 5) ^ hash) * 47499631;
 	hash = (hash >> 5) ^ hash;
@@ -13,187 +20,193 @@ static inline unsigned HashU(unsigned value){
 	return hash;
 }
 
+// Finalizer from MurmurHash3, every input bit affects every output bit
+static inline uint64_t HashU64(uint64_t value){
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdULL;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ULL;
+	value ^= value >> 33;
+
+	return value;
+}
+
+// Mix another hash into seed, for keys made up of several fields
+static inline unsigned HashCombine(unsigned seed, unsigned value){
+	return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+/////////////////////////////
+/// \brief Hash a range of bytes
+///
+/// Reads 8 bytes at a time and mixes with a 64x64->128 bit multiply (as in wyhash).
+/////////////////////////////
+uint64_t HashBytes(const void* data, size_t length, uint64_t seed = 0);
+
 template<typename T>
 unsigned Hash(const T& value);
 
+/////////////////////////////
+/// \brief Open addressing hash map
+///
+/// Uses Robin Hood linear probing: an entry being inserted takes the slot of any entry closer to its home slot,
+/// which keeps probe sequences short. Removal shifts the following entries back instead of leaving tombstones.
+/// The table starts empty and doubles once it is 7/8 full.
+///
+/// Every operation takes the map's lock, see StripedHashMap for maps under contention.
+/////////////////////////////
 template<typename K, typename T> // Key, Value
 class HashMap{
-public:
-	class KeyValuePair{
-		friend class HashMap;
-		friend class HashMapIterator;
-
-	protected:
-		T value;
+	struct Entry{
 		K key;
-
-		KeyValuePair(K key, T value) : value(value), key(key){}
+		T value;
 	};
 
+public:
 	class HashMapIterator {
 		friend class HashMap<K, T>;
 	protected:
 		HashMap<K, T>* map;
+		unsigned index = 0;
 
-		unsigned bucketIndex = 0;
-		List<KeyValuePair>* bucket;
-
-		ListIterator<KeyValuePair> listIt;
+		// Skip to the next occupied slot
+		void Advance(){
+			while(index < map->capacity && !map->distances[index]){
+				index++;
+			}
+		}
 	public:
 		HashMapIterator() = default;
 		HashMapIterator(const HashMapIterator&) = default;
 
 		HashMapIterator& operator++(){
-			assert(listIt != bucket->end());
-
-			listIt++;
-
-			if(listIt == bucket->end() && bucketIndex < map->bucketCount - 1){
-				bucket = map->buckets[++bucketIndex];
-				listIt = bucket->begin();
-			}
+			index++;
+			Advance();
 
 			return *this;
 		}
 
-		HashMapIterator& operator++(int){
-			ListIterator<KeyValuePair> v = ListIterator<KeyValuePair>(*this);
-
-			assert(listIt != bucket->end());
-
-			listIt++;
-
-			if(listIt == bucket->end() && bucketIndex < map->bucketCount - 1){
-				bucket = map->buckets[++bucketIndex];
-				listIt = bucket->begin();
-			}
+		HashMapIterator operator++(int){
+			HashMapIterator v = *this;
+			++(*this);
 
 			return v;
 		}
 
 		T& operator*(){
-			return listIt.operator*().value;
+			return map->entries[index].value;
 		}
 
 		T* operator->(){
-			return &listIt.operator->()->value;
+			return &map->entries[index].value;
 		}
 
 		friend bool operator==(const HashMapIterator& l, const HashMapIterator& r){
-			if(l.listIt == r.listIt){
-				return true;
-			} else {
-				return false;
-			}
+			return l.index == r.index;
 		}
 
 		friend bool operator!=(const HashMapIterator& l, const HashMapIterator& r){
-			if(l.listIt != r.listIt){
-				return true;
-			} else {
-				return false;
-			}
+			return l.index != r.index;
 		}
 	};
 
-	HashMap(){
-		buckets = new List<KeyValuePair>[bucketCount];
-		lock = 0;
+	constexpr HashMap() = default;
+
+	// The map starts with space for at least capacity entries
+	HashMap(unsigned capacity){
+		initialCapacity = 8;
+		while(initialCapacity * 7 / 8 < capacity){
+			initialCapacity <<= 1;
+		}
 	}
 
-	HashMap(unsigned bCount){
-		bucketCount = bCount;
+	HashMap(const HashMap&) = delete;
+	HashMap& operator=(const HashMap&) = delete;
 
-		buckets = new List<KeyValuePair>[bucketCount];
-		lock = 0;
+	HashMap(HashMap&& other){
+		*this = std::move(other);
 	}
 
-	void insert(K key, const T& value){
-		auto& bucket = buckets[Hash(key) % bucketCount];
+	HashMap& operator=(HashMap&& other){
+		Clear();
+
+		entries = other.entries;
+		distances = other.distances;
+		capacity = other.capacity;
+		shift = other.shift;
+		itemCount = other.itemCount;
+		initialCapacity = other.initialCapacity;
+
+		other.entries = nullptr;
+		other.distances = nullptr;
+		other.capacity = 0;
+		other.itemCount = 0;
+
+		return *this;
+	}
 
+	void insert(K key, const T& value){
 		acquireLock(&lock);
-		for(KeyValuePair& v : bucket){
-			if(v.key == key){ // Already exists, just replace
-				v.value = value;
 
-				itemCount++;
+		if(int index = Lookup(key); index >= 0){ // Already exists, just replace
+			entries[index].value = value;
 
-				releaseLock(&lock);
-				return;
-			}
+			releaseLock(&lock);
+			return;
 		}
 
-		bucket.add_back(KeyValuePair(key, value));
+		Entry entry = {std::move(key), value};
+		Insert(entry);
+
+		itemCount++;
 		releaseLock(&lock);
 	}
 
 	T remove(K key){
-		auto& bucket = buckets[Hash(key) % bucketCount];
-
 		acquireLock(&lock);
-		for(unsigned i = 0; i < bucket.get_length(); i++){
-			if(bucket[i].key == key){
-				auto pair = bucket.remove_at(i);
-
-				itemCount--;
 
-				releaseLock(&lock);
-				return pair.value;
-			}
+		int index = Lookup(key);
+		if(index < 0){
+			releaseLock(&lock);
+			return T();
 		}
-		releaseLock(&lock);
 
-		return T();
+		T value = std::move(entries[index].value);
+		Erase(index);
+
+		releaseLock(&lock);
+		return value;
 	}
 
 	void removeValue(T value){
 		acquireLock(&lock);
-		for(unsigned b = 0; b < bucketCount; b++){
-			auto& bucket = buckets[b];
-
-			for(unsigned i = 0; i < bucket.get_length(); i++){
-				if(bucket[i].value == value){
-					bucket.remove_at(i);
-
-					itemCount--;
-					releaseLock(&lock);
-					
-					return;
-				}
+		for(unsigned i = 0; i < capacity; i++){
+			if(distances[i] && entries[i].value == value){
+				Erase(i);
+				break;
 			}
 		}
 		releaseLock(&lock);
-
-		return;
 	}
 
 	int get(const K& key, T& value){
-		auto& bucket = buckets[Hash(key) % bucketCount];
-
 		acquireLock(&lock);
-		for(KeyValuePair& val : bucket){
-			if(val.key == key){
-				releaseLock(&lock);
 
-				value = val.value;
-				return 1;
-			}
+		int index = Lookup(key);
+		if(index >= 0){
+			value = entries[index].value;
 		}
-		releaseLock(&lock);
 
-		return 0;
+		releaseLock(&lock);
+		return index >= 0;
 	}
 
-	int find(K key){
-		auto& bucket = buckets[Hash(key) % bucketCount];
-
-		for(KeyValuePair& val : bucket){
-			if(val.key == key){
-				return 1;
-			}
-		}
+	int find(const K& key){
+		acquireLock(&lock);
+		int index = Lookup(key);
+		releaseLock(&lock);
 
-		return 0;
+		return index >= 0;
 	}
 
 	unsigned get_length(){
@@ -203,12 +216,9 @@ public:
 	HashMapIterator begin(){
 		HashMapIterator it;
 
-		it.bucket = buckets[0];
-		it.bucketIndex = 0;
-
 		it.map = this;
-
-		it.listIt = it.bucket->begin();
+		it.index = 0;
+		it.Advance();
 
 		return it;
 	}
@@ -216,24 +226,196 @@ public:
 	HashMapIterator end(){
 		HashMapIterator it;
 
-		it.bucket = buckets[bucketCount - 1];
-		it.bucketIndex = bucketCount - 1;
-
 		it.map = this;
-
-		it.listIt = it.bucket->end();
+		it.index = capacity;
 
 		return it;
 	}
 
 	~HashMap(){
-		delete[](buckets);
+		Clear();
 	}
 private:
-	List<KeyValuePair>* buckets;
-	unsigned bucketCount = 512;
+	// Map a hash onto the table using its top bits (Fibonacci hashing), so weak hashes still spread out
+	ALWAYS_INLINE unsigned HomeSlot(const K& key) const {
+		return (Hash(key) * 2654435769U) >> shift;
+	}
+
+	// Returns the slot of key or -1
+	int Lookup(const K& key) const {
+		if(!itemCount){
+			return -1;
+		}
+
+		unsigned mask = capacity - 1;
+		unsigned index = HomeSlot(key);
+
+		// An entry for key can only be in a slot at the same distance from the home slot,
+		// and once we reach an entry closer to home than we are there is no entry for key
+		for(uint16_t distance = 1; distances[index] >= distance; distance++){
+			if(distances[index] == distance && entries[index].key == key){
+				return index;
+			}
+
+			index = (index + 1) & mask;
+		}
+
+		return -1;
+	}
+
+	// Expects the key not to be present
+	void Insert(Entry& carry){
+		if(!capacity || (itemCount + 1) * 8 > capacity * 7){
+			Grow();
+		}
+
+		unsigned mask = capacity - 1;
+		unsigned index = HomeSlot(carry.key);
+		uint16_t distance = 1;
+
+		for(;;){
+			if(!distances[index]){
+				new (&entries[index]) Entry(std::move(carry));
+				distances[index] = distance;
+				return;
+			}
+
+			// Take the slot from an entry that is closer to its home slot, then keep going with that entry
+			if(distances[index] < distance){
+				Entry temp = std::move(entries[index]);
+				entries[index] = std::move(carry);
+				carry = std::move(temp);
+
+				uint16_t tempDistance = distances[index];
+				distances[index] = distance;
+				distance = tempDistance;
+			}
+
+			index = (index + 1) & mask;
+			distance++;
+
+			assert(distance != UINT16_MAX); // Only happens when tens of thousands of keys share a hash
+		}
+	}
+
+	void Erase(unsigned index){
+		unsigned mask = capacity - 1;
+
+		entries[index].~Entry();
+
+		// Shift back entries that are not in their home slot
+		unsigned next = (index + 1) & mask;
+		while(distances[next] > 1){
+			new (&entries[index]) Entry(std::move(entries[next]));
+			distances[index] = distances[next] - 1;
+
+			entries[next].~Entry();
+
+			index = next;
+			next = (next + 1) & mask;
+		}
+
+		distances[index] = 0;
+		itemCount--;
+	}
+
+	void Grow(){
+		Entry* oldEntries = entries;
+		uint16_t* oldDistances = distances;
+		unsigned oldCapacity = capacity;
+
+		capacity = capacity ? capacity * 2 : initialCapacity;
+		shift = 32 - __builtin_ctz(capacity);
+
+		// One allocation, entries followed by the distances
+		entries = reinterpret_cast<Entry*>(kmalloc(capacity * (sizeof(Entry) + sizeof(uint16_t))));
+		distances = reinterpret_cast<uint16_t*>(entries + capacity);
+		memset(distances, 0, capacity * sizeof(uint16_t));
+
+		for(unsigned i = 0; i < oldCapacity; i++){
+			if(oldDistances[i]){
+				Insert(oldEntries[i]);
+				oldEntries[i].~Entry();
+			}
+		}
+
+		if(oldEntries){
+			kfree(oldEntries);
+		}
+	}
+
+	void Clear(){
+		for(unsigned i = 0; i < capacity; i++){
+			if(distances[i]){
+				entries[i].~Entry();
+			}
+		}
+
+		if(entries){
+			kfree(entries);
+		}
+
+		entries = nullptr;
+		distances = nullptr;
+		capacity = 0;
+		itemCount = 0;
+	}
+
+	Entry* entries = nullptr;
+	uint16_t* distances = nullptr; // 0 if the slot is empty, otherwise the distance from the home slot + 1
+	unsigned capacity = 0; // Always a power of two
+	unsigned shift = 32; // 32 - log2(capacity)
 
 	unsigned itemCount = 0;
+	unsigned initialCapacity = 16;
 
 	lock_t lock = 0;
-};
\ No newline at end of file
+};
+
+/////////////////////////////
+/// \brief HashMap split into independently locked stripes
+///
+/// Keys are spread over the stripes by hash, so threads working on different keys rarely contend.
+/////////////////////////////
+template<typename K, typename T, unsigned StripeCount = 8>
+class StripedHashMap{
+public:
+	void insert(K key, const T& value){
+		Stripe(key).insert(std::move(key), value);
+	}
+
+	T remove(K key){
+		return Stripe(key).remove(std::move(key));
+	}
+
+	void removeValue(T value){
+		for(auto& stripe : stripes){
+			stripe.removeValue(value);
+		}
+	}
+
+	int get(const K& key, T& value){
+		return Stripe(key).get(key, value);
+	}
+
+	int find(const K& key){
+		return Stripe(key).find(key);
+	}
+
+	unsigned get_length(){
+		unsigned length = 0;
+		for(auto& stripe : stripes){
+			length += stripe.get_length();
+		}
+
+		return length;
+	}
+
+private:
+	// HashMap uses the top bits of the hash, use the bottom bits here
+	ALWAYS_INLINE HashMap<K, T>& Stripe(const K& key){
+		return stripes[Hash(key) % StripeCount];
+	}
+
+	HashMap<K, T> stripes[StripeCount];
+};
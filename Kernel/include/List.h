@@ -321,7 +321,7 @@ public:
 		acquireLock(&lock);
 
 		ListNode<T>* node = front;
-		while (node && node->next) {
+		while (node) {
 			ListNode<T>* n = node->next;
 			
 			DestroyNode(node);
@@ -455,11 +455,10 @@ public:
 	}
 
 	T& insert(const T& obj, ListIterator<T>& it){
-		if(it.node == back){
-			return add_back(obj);
+		if(!it.node){
+			return add_back(obj); // Inserting before the end
 		}
-		
-		assert(it.node);
+
 		ListNode<T>* current = it.node;
 
 		acquireLock(&lock);
@@ -476,11 +475,10 @@ public:
 	}
 
 	T& insert(T&& obj, ListIterator<T>& it){
-		if(it.node == back){
-			return add_back(obj);
+		if(!it.node){
+			return add_back(obj); // Inserting before the end
 		}
-		
-		assert(it.node);
+
 		ListNode<T>* current = it.node;
 
 		acquireLock(&lock);
@@ -624,7 +622,7 @@ public:
 
 		ListNode<T>* current = front;
 
-		while(current && current != back && current->obj != val) current = current->next;
+		while(current && current->obj != val) current = current->next;
 
 		if(current){
 			if (current->prev) current->prev->next = current->next;
@@ -83,6 +83,132 @@ public:
     void Signal();
 };
 
+/////////////////////////////
+/// \brief Blocker for threads waiting on a Mutex or ReadWriteMutex
+///
+/// queue is protected by queueLock (the lock of the mutex).
+/// Signals do not interrupt it, only killing the thread does.
+/////////////////////////////
+class LockBlocker final : public ThreadBlocker {
+public:
+    LockBlocker* next = nullptr;
+    LockBlocker* prev = nullptr;
+
+    LockBlocker(lock_t* queueLock, FastList<LockBlocker*>* queue) : queueLock(queueLock), queue(queue) {
+        interruptible = false;
+    }
+
+    void Interrupt();
+
+    // Expects queueLock to be held
+    void Unblock();
+
+    ~LockBlocker();
+
+private:
+    lock_t* queueLock;
+    FastList<LockBlocker*>* queue;
+};
+
+/////////////////////////////
+/// \brief Adaptive sleeping mutex
+///
+/// Spins for a short time in case the holder is about to release, then blocks.
+/// Must not be used with interrupts disabled.
+/////////////////////////////
+class Mutex final {
+public:
+    static const unsigned spinIterations = 1000;
+
+    Mutex() = default;
+    Mutex([[maybe_unused]] LockClass lockClass)
+#ifdef KERNEL_LOCK_STATS
+        : lockClass(lockClass)
+#endif
+    {}
+
+    ALWAYS_INLINE bool TryAcquire(){
+        if(!Take()){
+            return false;
+        }
+
+#ifdef KERNEL_LOCK_STATS
+        acquiredAt = LockStats::Timestamp();
+        LockStats::Acquired(lockClass, false, 0);
+#endif
+        return true;
+    }
+
+    void Acquire();
+    void Release();
+
+    ALWAYS_INLINE bool IsLocked() const { return state; }
+
+private:
+    lock_t lock = 0; // Protects blocked
+    int state = 0; // 0 unlocked, 1 locked, 2 locked and may have waiters
+
+    FastList<LockBlocker*> blocked;
+
+#ifdef KERNEL_LOCK_STATS
+    LockClass lockClass = LockClassAnonymous;
+    uint64_t acquiredAt = 0;
+#endif
+
+    // Take the mutex if it is unlocked without recording statistics
+    ALWAYS_INLINE bool Take(){
+        int expected = 0;
+        return __atomic_compare_exchange_n(&state, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+    }
+};
+
+class ScopedMutex final {
+public:
+    ALWAYS_INLINE ScopedMutex(Mutex& mutex) : m_mutex(mutex) { m_mutex.Acquire(); }
+    ALWAYS_INLINE ~ScopedMutex() { m_mutex.Release(); }
+private:
+    Mutex& m_mutex;
+};
+
+/////////////////////////////
+/// \brief Sleeping reader-biased read/write lock
+///
+/// Readers may enter whenever there is no writer, even if writers are waiting.
+/// When a writer releases the lock all waiting readers are woken before the next writer.
+/// Must not be used with interrupts disabled.
+/////////////////////////////
+class ReadWriteMutex final {
+public:
+    ReadWriteMutex() = default;
+    ReadWriteMutex([[maybe_unused]] LockClass lockClass)
+#ifdef KERNEL_LOCK_STATS
+        : lockClass(lockClass)
+#endif
+    {}
+
+    void AcquireRead();
+    void AcquireWrite();
+    bool TryAcquireWrite();
+
+    void ReleaseRead();
+    void ReleaseWrite();
+
+    ALWAYS_INLINE bool IsWriteLocked() const { return writer; }
+
+private:
+    lock_t lock = 0; // Protects everything below
+    unsigned activeReaders = 0;
+    bool writer = false;
+
+    FastList<LockBlocker*> readers;
+    FastList<LockBlocker*> writers;
+
+#ifdef KERNEL_LOCK_STATS
+    LockClass lockClass = LockClassAnonymous;
+    uint64_t writeAcquiredAt = 0; // Hold times are only recorded for writers
+#endif
+};
+
 class ReadWriteLock {
     unsigned activeReaders = 0;
     lock_t fileLock = 0;
@@ -139,4 +265,4 @@ public:
     ALWAYS_INLINE bool IsWriteLocked() const { return lock && activeReaders == 0; }
 };
 
-using FilesystemLock = ReadWriteLock;
\ No newline at end of file
+using FilesystemLock = ReadWriteMutex;
\ No newline at end of file
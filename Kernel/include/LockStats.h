@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Compiler.h>
+#include <stdint.h>
+
+// Locks are grouped into classes for contention statistics,
+// every lock in a class (e.g. the run queue of each CPU) counts towards the same statistics
+enum LockClass : uint8_t {
+    LockClassAnonymous,
+    LockClassRunQueue,
+    LockClassPhysicalAllocator,
+    LockClassHeap,
+    LockClassSleepQueue,
+    LockClassHandleTable,
+    LockClassAHCIPort,
+    LockClassATADrive,
+    LockClassFileData,
+    LockClassKernelVM,
+    LockClassFileDescriptorTable,
+    LockClassCount,
+};
+
+#ifdef KERNEL_LOCK_STATS
+/////////////////////////////
+/// \brief Lock contention statistics
+///
+/// Only built with the kernel_lock_stats option, exported as text through /dev/lockstat.
+/// Times are in TSC cycles.
+/////////////////////////////
+namespace LockStats {
+struct Counters {
+    uint64_t acquisitions;
+    uint64_t contended; // Acquisitions that had to wait
+    uint64_t waitCycles; // Total time spent waiting
+    uint64_t maxHoldCycles; // Longest time the lock was held
+} __attribute__((aligned(64)));
+
+extern Counters counters[LockClassCount];
+
+ALWAYS_INLINE uint64_t Timestamp() { return __builtin_ia32_rdtsc(); }
+
+ALWAYS_INLINE void Acquired(LockClass lockClass, bool contended, uint64_t waitCycles) {
+    Counters& c = counters[lockClass];
+
+    __atomic_fetch_add(&c.acquisitions, 1, __ATOMIC_RELAXED);
+    if (contended) {
+        __atomic_fetch_add(&c.contended, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&c.waitCycles, waitCycles, __ATOMIC_RELAXED);
+    }
+}
+
+ALWAYS_INLINE void Released(LockClass lockClass, uint64_t holdCycles) {
+    Counters& c = counters[lockClass];
+
+    uint64_t max = __atomic_load_n(&c.maxHoldCycles, __ATOMIC_RELAXED);
+    while (holdCycles > max &&
+           !__atomic_compare_exchange_n(&c.maxHoldCycles, &max, holdCycles, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+// Create the lockstat device
+void Initialize();
+} // namespace LockStats
+#endif
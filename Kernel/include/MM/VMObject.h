@@ -10,6 +10,10 @@
 
 #define PHYS_BLOCK_MAX (0xffffffff << PAGE_SHIFT_4K)
 
+class FsNode;
+class PageCache;
+struct fs_fd;
+
 class VMObject {
     friend class AddressSpace;
     friend void ::Memory::PageFaultHandler(void*, struct RegisterContext*);
@@ -17,9 +21,16 @@ public:
     VMObject(size_t size, bool anonymous, bool shared);
     virtual ~VMObject() = default;
 
-    virtual int Hit(uintptr_t base, uintptr_t offset, PageMap* pMap);
+    virtual int Hit(uintptr_t base, uintptr_t offset, PageMap* pMap, bool write);
     virtual void MapAllocatedBlocks(uintptr_t base, PageMap* pMap) = 0;
 
+    // msync(), write modified pages in [offset, offset + size) back to their backing store
+    virtual int Sync(uintptr_t base, uintptr_t offset, size_t size, PageMap* pMap) { return 0; }
+    // madvise(MADV_WILLNEED), map in pages ahead of use
+    virtual void Prefetch(uintptr_t base, uintptr_t offset, size_t size, PageMap* pMap) {}
+    // madvise(MADV_DONTNEED), give up pages, they are refilled on the next access
+    virtual void Discard(uintptr_t base, uintptr_t offset, size_t size, PageMap* pMap) {}
+
     virtual VMObject* Clone() = 0;
     virtual VMObject* Split(uintptr_t offset);
 
@@ -50,10 +61,12 @@ public:
     PhysicalVMObject(size_t size, bool anonymous, bool shared);
     virtual ~PhysicalVMObject();
 
-    int Hit(uintptr_t base, uintptr_t offset, PageMap* pMap) final;
+    int Hit(uintptr_t base, uintptr_t offset, PageMap* pMap, bool write) final;
     void ForceAllocate(); // Force allocate all blocks
     virtual void MapAllocatedBlocks(uintptr_t base, PageMap* pMap);
 
+    void Discard(uintptr_t base, uintptr_t offset, size_t size, PageMap* pMap) override;
+
     virtual VMObject* Clone();
 
     virtual size_t UsedPhysicalMemory() const;
@@ -81,6 +94,55 @@ class AnonymousVMObject : public PhysicalVMObject{
     ALWAYS_INLINE bool CanMunmap() const override { return true; }
 };
 
+// VMObject backed by the data of a filesystem node
+//
+// Pages come from the node's page cache so every mapping of the node shares them.
+// Shared mappings write modified pages back to the node,
+// private mappings get their own copy of a page on the first write to it.
+class FileVMObject final : public VMObject {
+public:
+    FileVMObject(FsNode* node, size_t offset, size_t size, bool shared, bool writable);
+    ~FileVMObject();
+
+    int Hit(uintptr_t base, uintptr_t offset, PageMap* pMap, bool write) override;
+    void MapAllocatedBlocks(uintptr_t base, PageMap* pMap) override;
+
+    VMObject* Clone() override;
+
+    int Sync(uintptr_t base, uintptr_t offset, size_t size, PageMap* pMap) override;
+    void Prefetch(uintptr_t base, uintptr_t offset, size_t size, PageMap* pMap) override;
+    void Discard(uintptr_t base, uintptr_t offset, size_t size, PageMap* pMap) override;
+
+    size_t UsedPhysicalMemory() const override;
+
+    ALWAYS_INLINE bool CanMunmap() const override { return true; }
+
+    // Stop the process from writing to a private mapping, any private pages we have already taken are kept.
+    // The caller should call MapAllocatedBlocks afterwards to remove write access from present pages
+    ALWAYS_INLINE void SetReadOnly() { readOnly = true; }
+
+private:
+    enum {
+        PageCached = 1, // Page belongs to the page cache
+        PagePrivate = 2, // Our own copy of the page
+        PageDirty = 4, // Page has been written to since it was last written back
+    };
+
+    uint64_t PageFlags(unsigned index) const;
+    void ReleasePage(unsigned index);
+
+    fs_fd* handle; // Keeps the node open whilst it is mapped
+    PageCache* cache;
+
+    size_t fileOffset;
+    bool writable : 1 = false; // Node was opened for writing
+    bool readOnly : 1 = false; // Write faults are errors (e.g. read-only ELF segments)
+
+    lock_t lock = 0;
+    uint32_t* physicalBlocks = nullptr;
+    uint8_t* pageState = nullptr;
+};
+
 struct MappedRegion {
     uintptr_t base;
     size_t size;
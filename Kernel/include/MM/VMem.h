@@ -0,0 +1,134 @@
+#pragma once
+
+#include <Compiler.h>
+#include <Spinlock.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define VMEM_FREELIST_COUNT 64
+#define VMEM_HASH_SIZE 1024 // Buckets for looking up allocated segments, must be a power of two
+#define VMEM_QCACHE_MAX 4 // Largest allocation (in quanta) served from the quantum caches
+#define VMEM_QCACHE_DEPTH 32 // Amount of spans each quantum cache can hold
+#define VMEM_BOOTSTRAP_TAGS 128 // Boundary tags available before the arena can populate memory for more
+#define VMEM_TAG_RESERVE (VMEM_QCACHE_DEPTH / 2 + 4) // Tags kept free so an operation never runs out halfway
+
+// Boundary tag, describes one span of the arena
+struct VMemSegment {
+    uintptr_t base;
+    size_t size;
+
+    VMemSegment* prev; // Address ordered list of all segments
+    VMemSegment* next;
+
+    VMemSegment* listPrev; // Freelist whilst free, hash chain whilst allocated
+    VMemSegment* listNext;
+
+    bool free;
+};
+
+/////////////////////////////
+/// \brief vmem style resource arena
+///
+/// Hands out ranges of an integer resource (e.g. kernel virtual addresses) in multiples of the quantum.
+/// The arena only keeps track of the ranges, populating them is up to the caller.
+///
+/// Free segments are kept on power of two freelists. An allocation takes the first segment of the smallest
+/// list that is guaranteed to fit, so allocation does not depend on the amount of segments.
+/// Allocated segments are found by address through a hash table and are merged with free neighbours
+/// through the boundary tags when freed.
+///
+/// Allocations of up to VMEM_QCACHE_MAX quanta are served from per size quantum caches first,
+/// which keeps the most common sizes from splitting and merging segments.
+/////////////////////////////
+class VMemArena final {
+public:
+    constexpr VMemArena(LockClass lockClass) : m_lock(lockClass) {}
+
+    /////////////////////////////
+    /// \brief Initialize the arena
+    ///
+    /// \param base Start of the range managed by the arena
+    /// \param size Size of the range
+    /// \param quantum Allocation granularity, must be a power of two
+    /// \param populate Called to back a quantum of the arena with memory so it can be used for boundary tags
+    /////////////////////////////
+    void Initialize(uintptr_t base, size_t size, size_t quantum, void (*populate)(uintptr_t base, size_t size));
+
+    /////////////////////////////
+    /// \brief Allocate a range
+    ///
+    /// \param size Size of the range, rounded up to the quantum
+    ///
+    /// \return Base of the range, 0 if there is no space left
+    /////////////////////////////
+    uintptr_t Allocate(size_t size);
+
+    /////////////////////////////
+    /// \brief Free a range
+    ///
+    /// \param base Base of the range as returned by Allocate
+    /// \param size Size of the range, must match the size given to Allocate
+    /////////////////////////////
+    void Free(uintptr_t base, size_t size);
+
+    ALWAYS_INLINE size_t Size() const { return m_size; }
+    ALWAYS_INLINE size_t InUse() const { return m_inUse; }
+
+private:
+    struct QuantumCache {
+        TicketLock lock;
+        unsigned count = 0;
+        uintptr_t spans[VMEM_QCACHE_DEPTH] = {};
+    };
+
+    ALWAYS_INLINE size_t RoundSize(size_t size) const {
+        if (!size) {
+            return m_quantum;
+        }
+
+        return (size + m_quantum - 1) & ~(m_quantum - 1);
+    }
+
+    ALWAYS_INLINE static unsigned FreelistIndex(size_t quanta) { return 63 - __builtin_clzll(quanta); }
+    ALWAYS_INLINE unsigned HashIndex(uintptr_t base) const {
+        return (base >> m_quantumShift) & (VMEM_HASH_SIZE - 1);
+    }
+
+    // The following expect the arena lock to be held
+    uintptr_t AllocateLocked(size_t size);
+    uintptr_t AllocateSegment(size_t size); // Does not make sure there are enough tags
+    void FreeLocked(uintptr_t base, size_t size);
+
+    VMemSegment* FindFree(size_t size);
+
+    void FreelistInsert(VMemSegment* seg);
+    void FreelistRemove(VMemSegment* seg);
+
+    void HashInsert(VMemSegment* seg);
+    VMemSegment* HashRemove(uintptr_t base);
+
+    VMemSegment* GetTag();
+    void PutTag(VMemSegment* tag);
+    void RefillTags();
+
+    TicketLock m_lock;
+
+    uintptr_t m_base = 0;
+    size_t m_size = 0;
+    size_t m_inUse = 0;
+    size_t m_quantum = 0;
+    unsigned m_quantumShift = 0;
+
+    void (*m_populate)(uintptr_t base, size_t size) = nullptr;
+
+    VMemSegment* m_freelists[VMEM_FREELIST_COUNT] = {};
+    uint64_t m_freelistMap = 0; // Bit set for each non-empty freelist
+    VMemSegment* m_hash[VMEM_HASH_SIZE] = {};
+
+    VMemSegment* m_freeTags = nullptr;
+    unsigned m_freeTagCount = 0;
+    VMemSegment m_bootstrapTags[VMEM_BOOTSTRAP_TAGS] = {};
+
+    QuantumCache m_qcaches[VMEM_QCACHE_MAX] = {};
+};
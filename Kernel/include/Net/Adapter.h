@@ -47,6 +47,19 @@ namespace Network{
         virtual NetworkPacket* DequeueBlocking();
         virtual void CachePacket(NetworkPacket* pkt);
 
+        // NAPI style receive
+        // The driver masks its receive interrupts and calls ScheduleReceive from its interrupt handler,
+        // the adapter's network worker then calls Poll until it runs dry and interrupts get unmasked again.
+        // Under heavy traffic we stay in polling mode and take no receive interrupts at all.
+        void ScheduleReceive();
+
+        // Hand up to budget packets to Network::ReceivePacket, returns the amount of packets processed
+        // By default packets are taken from queue
+        virtual int Poll(int budget);
+        virtual void EnableReceiveInterrupts() {}
+
+        volatile bool receiveScheduled = false;
+
         void BindToSocket(IPSocket* sock);
         void UnbindSocket(IPSocket* sock);
         void UnbindAllSockets();
@@ -20,13 +20,34 @@ class Socket;
 
 #define TCP_RETRY_MIN 200000 // 200 ms minimum retry period
 #define TCP_RETRY_MAX 32000000 // 32s
+#define TCP_RTO_INITIAL 1000000 // 1s initial retransmission timeout (RFC 6298)
+
+#define TCP_MSS 1460 // Our maximum segment size, Ethernet MTU (1500) - IPv4 header (20) - TCP header (20)
+#define TCP_DEFAULT_MSS 536 // Assumed when the peer does not send an MSS option (RFC 1122)
+#define TCP_SEND_BUFFER_SIZE 65536
+#define TCP_DUPLICATE_ACK_THRESHOLD 3 // Duplicate ACKs before fast retransmit
+
+#define TCP_RECEIVE_BUFFER_INITIAL 65536
+#define TCP_RECEIVE_BUFFER_MAX 0x400000 // 4 MiB, the receive buffer grows up to this to match the bandwidth-delay product
+#define TCP_WINDOW_SCALE 7 // Window scale we advertise, large enough for TCP_RECEIVE_BUFFER_MAX
+#define TCP_DELAYED_ACK 40000 // 40 ms
+#define TCP_MAX_SACK_BLOCKS 4 // As many as fit in the 40 bytes of option space
+
+#define NET_POLL_BUDGET 64 // Maximum packets taken from an adapter per poll before other adapters get a turn
+#define NET_MAX_BACKLOG 1024 // Packets queued on a network worker before we start dropping
 
 namespace Network{ class NetworkAdapter; }
+// Packet buffer
+// The buffer is owned by the NIC driver (usually the buffer the NIC DMA'd into)
+// and is lent to the network stack until it is given back with NetworkAdapter::CachePacket
 struct NetworkPacket{
-    size_t length;
-    uint8_t data[1518];
+    uint8_t* data = nullptr;
+    size_t length = 0;
+
+    uintptr_t bufferPhys = 0; // Physical address of data, for drivers which swap buffers with the NIC
+    uint32_t flowHash = 0; // Used to pick the worker which processes the packet
 
-    Network::NetworkAdapter* adapter;
+    Network::NetworkAdapter* adapter = nullptr;
 
     NetworkPacket* next;
     NetworkPacket* prev;
@@ -201,6 +222,15 @@ struct TCPHeader {
 } __attribute__((packed));
 static_assert(!(sizeof(TCPHeader) & (sizeof(uint32_t) - 1)));
 
+enum TCPOption {
+    TCPOptionEnd = 0,
+    TCPOptionNoOp = 1,
+    TCPOptionMaximumSegmentSize = 2,
+    TCPOptionWindowScale = 3,
+    TCPOptionSACKPermitted = 4,
+    TCPOptionSACK = 5,
+};
+
 struct ICMPHeader{
     uint8_t type;
     uint8_t code;
@@ -209,8 +239,6 @@ struct ICMPHeader{
 } __attribute__((packed));
 
 namespace Network {
-    extern Semaphore packetQueueSemaphore;
-    
     enum {
         EtherTypeIPv4 = 0x800,
         EtherTypeARP = 0x806,
@@ -266,7 +294,10 @@ namespace Network {
     int IPLookup(NetworkAdapter* adapter, const IPv4Address& ip, MACAddress& mac);
     int Route(const IPv4Address& local, const IPv4Address& dest, MACAddress& mac, NetworkAdapter*& adapter);
 
-    void InitializeNetworkThread();
+    void InitializeNetworkWorkers();
+    // Hand a received packet to the network stack, called from NetworkAdapter::Poll
+    // The packet is returned to the adapter with CachePacket once processed
+    void ReceivePacket(NetworkPacket* packet);
 
     void Send(void* data, size_t length, NetworkAdapter* adapter = nullptr);
     int SendIPv4(void* data, size_t length, IPv4Address& source, IPv4Address& destination, uint8_t protocol, NetworkAdapter* adapter = nullptr);
@@ -285,5 +316,7 @@ namespace Network {
 
         int SendTCP(void* data, size_t length, IPv4Address& source, IPv4Address& destination, BigEndian<uint16_t> sourcePort, BigEndian<uint16_t> destinationPort, NetworkAdapter* adapter = nullptr);
         void OnReceiveTCP(IPv4Header& ipHeader, void* data, size_t length);
+
+        void Initialize();
     }
 }
\ No newline at end of file
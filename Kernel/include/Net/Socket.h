@@ -7,7 +7,9 @@
 
 #include <List.h>
 #include <Lock.h>
+#include <RefPtr.h>
 #include <Stream.h>
+#include <Timer.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -19,6 +21,10 @@
 
 #define STREAM_MAX_BUFSIZE 0x20000 // 128 KB
 
+namespace Timer {
+class TimerEvent;
+}
+
 struct rtentry {
     unsigned long rt_pad1;
     struct sockaddr rt_dst;
@@ -118,6 +124,16 @@ class Socket : public FsNode {
     virtual int64_t Send(void* buffer, size_t len, int flags);
     virtual ssize_t Write(size_t offset, size_t size, uint8_t* buffer);
 
+    // Same as ReceiveFrom and SendTo but buffer is in user memory.
+    // Sockets that can copy straight to or from user memory override these,
+    // by default the data goes through a kernel buffer of at most USER_BOUNCE_SIZE bytes.
+    virtual int64_t ReceiveFromUser(void* buffer, size_t len, int flags, sockaddr* src, socklen_t* addrlen,
+                                    const void* ancillary = nullptr, size_t ancillaryLen = 0);
+    virtual int64_t SendToUser(const void* buffer, size_t len, int flags, const sockaddr* src, socklen_t addrlen,
+                               const void* ancillary = nullptr, size_t ancillaryLen = 0);
+    ssize_t ReadUser(size_t offset, size_t size, uint8_t* buffer);
+    ssize_t WriteUser(size_t offset, size_t size, const uint8_t* buffer);
+
     virtual int SetSocketOptions(int level, int opt, const void* optValue, socklen_t optLength);
     virtual int GetSocketOptions(int level, int opt, void* optValue, socklen_t* optLength);
 
@@ -146,8 +162,25 @@ class LocalSocket final : public Socket {
 
     sockaddr_un m_binding;
 
+    // Shared by both sockets of a connection, protects peer
+    struct PeerLink {
+        lock_t lock = 0;
+    };
+    FancyRefPtr<PeerLink> m_link;
+
+    // Open handles hold one reference between them, the rest are held whilst waking the peer
+    unsigned m_references = 1;
+
+    // Returns the peer with a reference taken, or nullptr if it has disconnected
+    LocalSocket* AcquirePeer();
+    void Unref();
+
+    // user is set when buffer is in user memory
+    int64_t ReceiveStream(void* buffer, size_t len, int flags, sockaddr* src, socklen_t* addrlen, bool user);
+    int64_t SendStream(const void* buffer, size_t len, int flags, const sockaddr* src, socklen_t addrlen, bool user);
+
   public:
-    LocalSocket* peer = nullptr;
+    LocalSocket* peer = nullptr; // Protected by m_link
 
     Stream* inbound = nullptr;
     Stream* outbound = nullptr;
@@ -161,6 +194,7 @@ class LocalSocket final : public Socket {
     void DisconnectPeer();
 
     void OnDisconnect();
+    void Wake(int blockType); // Unblock threads blocked on the socket and signal watchers
 
     int IsConnected() { return m_connected; }
 
@@ -176,6 +210,10 @@ class LocalSocket final : public Socket {
                         const void* ancillary = nullptr, size_t ancillaryLen = 0);
     int64_t SendTo(void* buffer, size_t len, int flags, const sockaddr* src, socklen_t addrlen,
                    const void* ancillary = nullptr, size_t ancillaryLen = 0);
+    int64_t ReceiveFromUser(void* buffer, size_t len, int flags, sockaddr* src, socklen_t* addrlen,
+                            const void* ancillary = nullptr, size_t ancillaryLen = 0);
+    int64_t SendToUser(const void* buffer, size_t len, int flags, const sockaddr* src, socklen_t addrlen,
+                       const void* ancillary = nullptr, size_t ancillaryLen = 0);
 
     void Watch(FilesystemWatcher& watcher, int events);
     void Unwatch(FilesystemWatcher& watcher);
@@ -186,6 +224,13 @@ class LocalSocket final : public Socket {
         else
             return false;
     }
+
+    bool CanWrite() {
+        if (outbound)
+            return !IsConnected() || outbound->Space();
+        else
+            return false;
+    }
 };
 
 class IPSocket : public Socket {
@@ -286,26 +331,62 @@ class TCPSocket final : public IPSocket {
                         const void* ancillary = nullptr, size_t ancillaryLen = 0);
     int64_t SendTo(void* buffer, size_t len, int flags, const sockaddr* src, socklen_t addrlen,
                    const void* ancillary = nullptr, size_t ancillaryLen = 0);
+    int64_t ReceiveFromUser(void* buffer, size_t len, int flags, sockaddr* src, socklen_t* addrlen,
+                            const void* ancillary = nullptr, size_t ancillaryLen = 0);
 
     int SetSocketOptions(int level, int opt, const void* optValue, socklen_t optLength);
     int GetSocketOptions(int level, int opt, void* optValue, socklen_t* optLength);
 
     int IsConnected() { return state == TCPStateEstablished; }
-    bool CanWrite() { return IsConnected(); }
+    bool CanWrite() { return IsConnected() && m_sendQueueSize < TCP_SEND_BUFFER_SIZE; }
 
     void Close();
 
   protected:
     bool m_fileClosed = false;
-    bool m_noDelay = false;   // Disable 'Nagle's algorithm', we don't actualy implement this yet
+    bool m_noDelay = false;   // Disable Nagle's algorithm
     bool m_keepAlive = false; // We haven't implmented this yet
 
     friend void OnReceiveTCP(IPv4Header& ipHeader, void* data, size_t length);
+    friend void TimerThread();
 
     void OnReceive(const IPv4Address& source, const IPv4Address& dest, uint8_t* data, size_t length);
 
+    // Process an acknowledgement from the peer, returns false if it acknowledges data we have not sent.
+    // window is already scaled, with window scaling it can be as large as 65535 << 14 so it must not be narrowed
+    bool OnAcknowledgement(uint32_t ackNumber, uint32_t window, bool canBeDuplicate);
+    // Called from the timer thread once the retransmission timer has expired
+    void OnRetransmitTimeout();
+    // Called from the timer thread once the delayed ACK timer has expired
+    void OnDelayedAckTimeout();
+
+    // Read from m_inboundData, user is set when buffer is in user memory
+    int64_t ReceiveInbound(void* buffer, size_t len, int flags, sockaddr* src, socklen_t* addrlen, bool user);
+    // Handle inbound data, reassembling out of order segments
+    void ReceiveData(uint32_t sequence, uint8_t* data, size_t length);
+    // Expects m_receiveLock to be held
+    void InsertOutOfOrder(uint32_t sequence, uint8_t* data, size_t length);
+    // Free space in the receive buffer, expects m_receiveLock to be held
+    uint32_t ReceiveWindow();
+
+    // Send as many queued segments as the peer's window, congestion window and Nagle's algorithm allow
+    void Transmit();
+    // Queue as much data as there is space for in the send queue, expects m_sendLock to be held
+    size_t QueueData(uint8_t* data, size_t length);
+    // Send a FIN once all queued data has been acknowledged
+    void SendFinish();
+
+    // Expects m_sendLock to be held
+    void ArmRetransmitTimer();
+    void CancelRetransmitTimer();
+    void UpdateRTO(long rtt);
+
+    void UnblockWriters();
+
+    int SendSegment(uint32_t sequence, uint16_t flags, void* data = nullptr, size_t length = 0);
+
     int Synchronize(uint32_t seqNumber); // TCP SYN (Establish a connection to the server)
-    int Acknowledge(uint32_t ackNumber); // TCP ACK (Acknowledge connection)
+    int Acknowledge();                   // TCP ACK (Acknowledge everything received so far)
     int SynchronizeAcknowledge(
         uint32_t seqNumber,
         uint32_t ackNumber); // TCP SYN-ACK (Establish connection to client and acknowledge the connection)
@@ -317,13 +398,22 @@ class TCPSocket final : public IPSocket {
     int AcquirePort(uint16_t port);
     int ReleasePort();
 
-    struct TCPPacket {
-        TCPHeader header;
+    struct TCPReceivedSegment {
         uint32_t sequenceNumber;
         uint32_t length;
         uint8_t* data;
     };
 
+    struct TCPSegment {
+        uint32_t sequenceNumber;
+        uint32_t length;
+        uint8_t* data; // Has a capacity of the MSS
+
+        timeval sent; // Time of the last transmission
+        bool transmitted;
+        bool retransmitted; // As per Karn's algorithm retransmitted segments are not used to measure the RTT
+    };
+
     // As per RFC 793
     enum State {
         TCPStateUnknown,
@@ -335,17 +425,61 @@ class TCPSocket final : public IPSocket {
         TCPStateFinWait2,    // Waiting for the peer to send FIN
         TCPStateCloseWait,   // Waiting for the last process to close the socket
         TCPStateLastAck,     // Waiting for a final ACK after our FIN
+        TCPStateClosing,     // Both sides sent FIN at the same time, waiting for an ACK of our FIN
         TCPStateTimeWait,    // Waiting to ensure that the peer recieved its ACK
     };
 
     State state = TCPStateUnknown;
-    uint32_t m_sequenceNumber;
-    uint32_t m_lastAcknowledged; // Last acknowledged sequence number
+    uint32_t m_sequenceNumber;   // Next sequence number to send (SND.NXT), moved back on a retransmission timeout
+    uint32_t m_sendMax;          // Highest sequence number sent so far (SND.MAX), ACKs are validated against this
+    uint32_t m_lastAcknowledged; // Oldest unacknowledged sequence number (SND.UNA)
 
     uint32_t m_remoteSequenceNumber; // Sequence number of the remote endpoint
 
-    lock_t m_unacknowledgedPacketsLock = 0;
-    List<TCPPacket> m_unacknowledgedPackets; // Unacknowledged outbound packets
-    DataStream m_inboundData = DataStream(512);
+    lock_t m_sendLock = 0;
+    List<TCPSegment> m_sendQueue; // Unacknowledged and unsent outbound segments in sequence order
+    size_t m_sendQueueSize = 0;   // Amount of data in the send queue, the queue starts at m_lastAcknowledged
+
+    uint16_t m_mss = TCP_DEFAULT_MSS; // Maximum segment size of the peer
+    uint32_t m_peerWindow = 0;        // Receive window advertised by the peer (SND.WND)
+
+    // NewReno congestion control (RFC 5681, RFC 6582)
+    uint32_t m_congestionWindow = TCP_DEFAULT_MSS;
+    uint32_t m_slowStartThreshold = TCP_SEND_BUFFER_SIZE;
+    uint32_t m_recover = 0; // Highest sequence number sent when entering fast recovery
+    int m_duplicateAcks = 0;
+    bool m_fastRecovery = false;
+
+    // Retransmission timeout in microseconds (RFC 6298)
+    long m_smoothedRTT = 0;
+    long m_rttVariance = 0;
+    long m_rto = TCP_RTO_INITIAL;
+
+    Timer::TimerEvent* m_retransmitTimer = nullptr;
+    volatile bool m_retransmitPending = false; // Set by the timer callback, handled by the retransmission thread
+    bool m_timerActive = false; // The timer thread is working on the socket outside of timerSocketsLock
+
+    bool m_finPending = false; // Close has been called, waiting for the send queue to drain
+    bool m_finSent = false;
+
+    lock_t m_receiveLock = 0;
+    List<TCPReceivedSegment> m_outOfOrderSegments; // Segments received ahead of m_remoteSequenceNumber in sequence order
+    uint32_t m_lastOutOfOrderSequence = 0;          // Most recently received out of order segment, reported first in SACKs
+
+    size_t m_receiveBufferSize = TCP_RECEIVE_BUFFER_INITIAL;
+    uint32_t m_advertisedEdge = 0; // Right edge of the last window we advertised
+
+    // Receive buffer auto tuning, data received over the last RTT
+    size_t m_receivedThisPeriod = 0;
+    timeval m_receivePeriodStart = {};
+
+    int m_windowScale = 0;     // Shift applied to windows we advertise
+    int m_peerWindowScale = 0; // Shift applied to windows the peer advertises
+    bool m_sackPermitted = false;
+
+    int m_unacknowledgedSegments = 0; // Segments received since we last sent an ACK
+    Timer::TimerEvent* m_delayedAckTimer = nullptr;
+    volatile bool m_delayedAckPending = false;
+    DataStream m_inboundData = DataStream(TCP_RECEIVE_BUFFER_MAX); // Pages are only allocated as data arrives
 };
 } // namespace Network::TCP
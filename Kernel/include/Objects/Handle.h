@@ -3,10 +3,74 @@
 #include <Objects/KObject.h>
 #include <RefPtr.h>
 #include <Compiler.h>
+#include <SlotTable.h>
+#include <Spinlock.h>
 
 typedef long long handle_id_t;
 
 struct Handle {
     handle_id_t id = 0;
     FancyRefPtr<KernelObject> ko;
-};
\ No newline at end of file
+};
+
+/////////////////////////////
+/// \brief Table of the handles held by a process
+///
+/// A handle ID is made up of the slot index plus one in the low 32 bits
+/// and the generation of the slot in the high bits.
+/// The generation is bumped every time a handle is destroyed, so a stale ID
+/// never refers to whatever ends up in the slot next.
+/////////////////////////////
+class HandleTable final {
+public:
+    HandleTable() : m_lock(LockClassHandleTable) {}
+
+    /////////////////////////////
+    /// \brief Create a handle to a kernel object
+    ///
+    /// \return Handle ID, -EMFILE if the table is full
+    /////////////////////////////
+    handle_id_t Register(FancyRefPtr<KernelObject> ko);
+
+    /////////////////////////////
+    /// \brief Look up a handle, does not take the table lock
+    ///
+    /// \return Handle, nullptr if the ID is invalid or the handle has been destroyed
+    /////////////////////////////
+    Handle* Find(handle_id_t id);
+
+    /////////////////////////////
+    /// \brief Destroy a handle
+    ///
+    /// \return 0 on success, 1 if the ID is invalid
+    /////////////////////////////
+    long Destroy(handle_id_t id);
+
+    // Destroy every handle in the table
+    void Clear();
+
+    template <typename F> void ForEach(F func) {
+        for (unsigned i = 0; i < m_slots.Capacity(); i++) {
+            Entry* entry = m_slots.Get(i);
+            if (__atomic_load_n(&entry->handle.id, __ATOMIC_ACQUIRE)) {
+                func(entry->handle);
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        Handle handle;
+        uint32_t generation = 0;
+    };
+
+    ALWAYS_INLINE static handle_id_t MakeID(unsigned index, uint32_t generation) {
+        return (static_cast<handle_id_t>(generation) << 32) | (index + 1);
+    }
+
+    // Returns the reference held by the handle so it can be dropped outside of the lock
+    FancyRefPtr<KernelObject> DestroyLocked(unsigned index, Entry* entry);
+
+    TicketLock m_lock;
+    SlotTable<Entry> m_slots;
+};
@@ -5,6 +5,8 @@
 
 #include <List.h>
 
+struct Process;
+
 class MessageInterface final : public KernelObject{
 protected:
     bool active = true;
@@ -19,6 +21,10 @@ protected:
     lock_t waitingLock = 0;
     List<KernelObjectWatcher*> waiting;
 
+    // Accepted endpoints with messages (or a disconnect) waiting to be read
+    lock_t readyLock = 0;
+    FastList<MessageEndpoint*> ready;
+
     friend class Service;
 public:
     MessageInterface(const char* _name, uint16_t msgSize);
@@ -44,14 +50,51 @@ public:
     /////////////////////////////
     FancyRefPtr<MessageEndpoint> Connect();
 
+    /////////////////////////////
+    /// \brief Register an accepted endpoint
+    ///
+    /// Once registered the interface is notified whenever the endpoint receives a message
+    /// so that it can be read with Dequeue.
+    ///
+    /// \param self Reference to this interface, held by the endpoint
+    /// \param endpoint Endpoint returned by Accept
+    /// \param handle Handle ID of the endpoint in the owning process
+    /////////////////////////////
+    void Register(const FancyRefPtr<MessageInterface>& self, const FancyRefPtr<MessageEndpoint>& endpoint, handle_id_t handle);
+
+    // Called by the endpoint with its ownerLock held
+    void Unregister(MessageEndpoint* endpoint);
+    void MarkReady(MessageEndpoint* endpoint);
+
+    /////////////////////////////
+    /// \brief Dequeue messages from all registered endpoints
+    ///
+    /// Fills buffer with lemon_message_record_t records. Endpoints are serviced round robin,
+    /// one message at a time. Cost depends on the amount of messages, not the amount of endpoints.
+    ///
+    /// \param process Process owning the endpoint handles
+    /// \param buffer User buffer
+    /// \param size Size of buffer
+    /// \param maxCount Maximum amount of records
+    ///
+    /// \return Amount of records written
+    /////////////////////////////
+    long Dequeue(Process* process, uint8_t* buffer, size_t size, unsigned maxCount);
+
     void Watch(KernelObjectWatcher& watcher, int events){
         acquireLock(&waitingLock);
-        waiting.add_back(&watcher);
+        if(ready.get_length() || incoming.get_length()){
+            watcher.Signal();
+        } else {
+            waiting.add_back(&watcher);
+        }
         releaseLock(&waitingLock)
     }
 
     virtual void Unwatch(KernelObjectWatcher& watcher){
+        acquireLock(&waitingLock);
         waiting.remove(&watcher);
+        releaseLock(&waitingLock);
     }
     
     inline static constexpr kobject_id_t TypeID() { return KOBJECT_ID_INTERFACE; }
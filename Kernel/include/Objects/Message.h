@@ -8,8 +8,11 @@
 #include <Lock.h>
 #include <RingBuffer.h>
 
+#include <Objects/Handle.h>
 #include <Objects/KObject.h>
 
+class MessageInterface;
+
 struct MessageEndpointInfo{
     uint16_t msgSize;
 };
@@ -42,7 +45,7 @@ public:
     /// \param size Pointer to the message size to be populated
     /// \param data Pointer to data
     ///
-    /// \return 0 on success, 1 on empty, negative error code on failure
+    /// \return 1 on success, 0 on empty, negative error code on failure
     /////////////////////////////
     int64_t Read(uint64_t* id, uint16_t* size, uint8_t* data);
     
@@ -95,6 +98,15 @@ public:
 
     inline uint16_t GetMaxMessageSize() const { return maxMessageSize; }
 
+    /////////////////////////////
+    /// \brief Notify the interface the endpoint was accepted on that it has something to read
+    /////////////////////////////
+    void NotifyOwner();
+
+    // Links for the ready list of the owning interface, protected by its readyLock
+    MessageEndpoint* next = nullptr;
+    MessageEndpoint* prev = nullptr;
+
     inline static constexpr kobject_id_t TypeID() { return KOBJECT_ID_MESSAGE_ENDPOINT; }
     inline kobject_id_t InstanceTypeID() const { return TypeID(); }
 
@@ -134,4 +146,12 @@ private:
 
     lock_t waitingLock = 0;
     lock_t waitingResponseLock = 0;
+
+    // Interface the endpoint was accepted on and the handle it was given in the owning process
+    lock_t ownerLock = 0;
+    FancyRefPtr<MessageInterface> owner;
+    handle_id_t ownerHandle = 0;
+    bool ready = false; // On the ready list of owner
+
+    friend class MessageInterface;
 };
\ No newline at end of file
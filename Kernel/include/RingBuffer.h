@@ -2,6 +2,7 @@
 
 #include <stddef.h>
 #include <Memory.h>
+#include <Pair.h>
 #include <Spinlock.h>
 
 template<typename T = uint8_t>
@@ -27,7 +28,7 @@ public:
     }
 
     virtual ~RingBuffer(){
-        delete buffer;
+        kfree(buffer);
     }
 
     void Enqueue(const T& data){
@@ -35,6 +36,7 @@ public:
         acquireLock(&dequeueLock);
 
         *enqueuePointer++ = data;
+        size++;
         
         if(enqueuePointer >= bufferEnd){
             enqueuePointer = buffer; // Wrap around to start
@@ -53,9 +55,10 @@ public:
         size_t contiguousCount = count;
         size_t wrappedCount = 0;
 
-        if(enqueuePointer < dequeuePointer && enqueuePointer + count > dequeuePointer){
+        // The enqueue pointer must not catch up with the dequeue pointer, otherwise the buffer looks empty
+        if(enqueuePointer < dequeuePointer && enqueuePointer + count >= dequeuePointer){
             Resize((bufferSize << 1) + count); // Ring buffer is full
-        } else if(enqueuePointer + contiguousCount > bufferEnd){
+        } else if(enqueuePointer + contiguousCount >= bufferEnd){
             contiguousCount = (uintptr_t)(bufferEnd - enqueuePointer); // Get number of contiguous elements to copy
             wrappedCount = count - contiguousCount; // Get number of elements that did not fit
 
@@ -128,6 +131,7 @@ public:
         }
 
         data = *dequeuePointer++;
+        size--;
 
         if(dequeuePointer >= bufferEnd){
             dequeuePointer = buffer;
@@ -154,12 +158,13 @@ public:
         if(dequeuePointer <= enqueuePointer && dequeuePointer + count > enqueuePointer){
             size = 0;
             dequeuePointer = enqueuePointer;
-        } else if(dequeuePointer + count > bufferEnd){
-            if(buffer + count > enqueuePointer){
+        } else if(dequeuePointer + count >= bufferEnd){
+            size_t wrapped = count - (bufferEnd - dequeuePointer);
+            if(buffer + wrapped > enqueuePointer){
                 size = 0;
                 dequeuePointer = enqueuePointer;
             } else {
-                dequeuePointer = buffer + count;
+                dequeuePointer = buffer + wrapped;
                 size -= count;
             }
         } else {
@@ -173,19 +178,23 @@ public:
     inline unsigned Count() { return size; }
     inline bool Empty() { return dequeuePointer == enqueuePointer; }
 protected:
-    void Resize(size_t size){
+    void Resize(size_t newSize){
         T* oldBuffer = buffer;
         T* oldBufferEnd = bufferEnd;
 
-        bufferSize = size;
+        // Equal pointers mean the buffer is either full or empty
+        bool wrapped = dequeuePointer > enqueuePointer || (dequeuePointer == enqueuePointer && size);
+
+        bufferSize = newSize;
 
         buffer = reinterpret_cast<T*>(kmalloc(sizeof(T) * bufferSize));
         bufferEnd = &buffer[bufferSize];
         
+        // Keep everything from the dequeue pointer at the end of the new buffer
         memcpy(bufferEnd - (oldBufferEnd - dequeuePointer), dequeuePointer, (oldBufferEnd - dequeuePointer) * sizeof(T));
         dequeuePointer = bufferEnd - (oldBufferEnd - dequeuePointer);
 
-        if(dequeuePointer > enqueuePointer){
+        if(wrapped){
             memcpy(buffer, oldBuffer, (enqueuePointer - oldBuffer) * sizeof(T));
             enqueuePointer = buffer + (enqueuePointer - oldBuffer);
         } else {
@@ -202,7 +211,7 @@ protected:
     T* enqueuePointer = nullptr;
     T* dequeuePointer = nullptr;
 
-    unsigned size;
+    unsigned size = 0;
 
     lock_t enqueueLock = 0;
     lock_t dequeueLock = 0;
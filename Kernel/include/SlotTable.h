@@ -0,0 +1,184 @@
+#pragma once
+
+#include <Compiler.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SLOT_TABLE_FIRST_SHIFT 6 // The first two chunks hold 64 slots, every chunk after that doubles in size
+#define SLOT_TABLE_CHUNK_COUNT 13
+#define SLOT_TABLE_MAX_SLOTS (1U << (SLOT_TABLE_FIRST_SHIFT + SLOT_TABLE_CHUNK_COUNT - 1)) // 262144 slots
+
+/////////////////////////////
+/// \brief Table of slots indexed by small integers (e.g. file descriptors and handles)
+///
+/// Slots are stored in chunks which double in size as the table grows. Chunks are never moved or freed
+/// whilst the table is alive, so a slot can be looked up without any locking.
+/// Everything else changes the table and must be serialized by the owner.
+///
+/// Used slots are tracked with a three level bitmap, finding the lowest free slot takes three bit scans
+/// regardless of how many slots are in use.
+/////////////////////////////
+template <typename T> class SlotTable final {
+public:
+    SlotTable() = default;
+    SlotTable(const SlotTable&) = delete;
+    SlotTable& operator=(const SlotTable&) = delete;
+
+    ~SlotTable() {
+        for (unsigned i = 0; i < SLOT_TABLE_CHUNK_COUNT; i++) {
+            delete[] m_chunks[i];
+            delete[] m_words[i];
+        }
+    }
+
+    /////////////////////////////
+    /// \brief Get a slot, does not need to be serialized
+    ///
+    /// \return Pointer to the slot, nullptr if the table has not grown to index yet
+    /////////////////////////////
+    ALWAYS_INLINE T* Get(unsigned index) {
+        if (index >= SLOT_TABLE_MAX_SLOTS) {
+            return nullptr;
+        }
+
+        unsigned chunk = ChunkIndex(index);
+        T* slots = __atomic_load_n(&m_chunks[chunk], __ATOMIC_ACQUIRE);
+        if (!slots) {
+            return nullptr;
+        }
+
+        return &slots[index - ChunkBase(chunk)];
+    }
+
+    // Amount of slots that can be used without growing the table
+    ALWAYS_INLINE unsigned Capacity() const { return __atomic_load_n(&m_capacity, __ATOMIC_ACQUIRE); }
+
+    /////////////////////////////
+    /// \brief Mark the lowest free slot as used
+    ///
+    /// \return Index of the slot, -1 if the table is full
+    /////////////////////////////
+    long Allocate() {
+        if (m_fullGroups == ~0ULL) {
+            return -1;
+        }
+
+        unsigned group = __builtin_ctzll(~m_fullGroups);
+        unsigned word = group * 64 + __builtin_ctzll(~m_fullWords[group]);
+
+        uint64_t* bits = Word(word);
+        unsigned index = word * 64 + (bits ? __builtin_ctzll(~*bits) : 0);
+
+        // Every slot below index is in use, the table only needs to grow when it is out of slots
+        if (index >= m_capacity && !Grow(index)) {
+            return -1;
+        }
+
+        SetUsed(index);
+        return index;
+    }
+
+    /////////////////////////////
+    /// \brief Mark a specific slot as used, growing the table to fit it
+    ///
+    /// \return true on success, false if the index is out of range or memory could not be allocated
+    /////////////////////////////
+    bool Reserve(unsigned index) {
+        if (index >= SLOT_TABLE_MAX_SLOTS || (index >= m_capacity && !Grow(index))) {
+            return false;
+        }
+
+        SetUsed(index);
+        return true;
+    }
+
+    // Mark a slot as free
+    void Release(unsigned index) {
+        uint64_t* bits = Word(index / 64);
+        *bits &= ~(1ULL << (index % 64));
+
+        m_fullWords[index / 4096] &= ~(1ULL << (index / 64 % 64));
+        m_fullGroups &= ~(1ULL << (index / 4096));
+    }
+
+    ALWAYS_INLINE bool IsUsed(unsigned index) {
+        if (index >= m_capacity) {
+            return false;
+        }
+
+        return *Word(index / 64) & (1ULL << (index % 64));
+    }
+
+private:
+    static_assert(SLOT_TABLE_MAX_SLOTS == 64 * 64 * 64);
+
+    ALWAYS_INLINE static unsigned ChunkIndex(unsigned index) {
+        if (index < (1U << SLOT_TABLE_FIRST_SHIFT)) {
+            return 0;
+        }
+
+        return 31 - __builtin_clz(index) - SLOT_TABLE_FIRST_SHIFT + 1;
+    }
+
+    ALWAYS_INLINE static unsigned ChunkBase(unsigned chunk) {
+        return chunk ? (1U << (chunk + SLOT_TABLE_FIRST_SHIFT - 1)) : 0;
+    }
+
+    ALWAYS_INLINE static unsigned ChunkSize(unsigned chunk) {
+        return chunk ? ChunkBase(chunk) : (1U << SLOT_TABLE_FIRST_SHIFT);
+    }
+
+    // Bitmap word covering slots word * 64 to word * 64 + 63, nullptr if the chunk does not exist
+    ALWAYS_INLINE uint64_t* Word(unsigned word) {
+        unsigned chunk = ChunkIndex(word * 64);
+        if (!m_words[chunk]) {
+            return nullptr;
+        }
+
+        return &m_words[chunk][(word * 64 - ChunkBase(chunk)) / 64];
+    }
+
+    void SetUsed(unsigned index) {
+        uint64_t* bits = Word(index / 64);
+        *bits |= (1ULL << (index % 64));
+
+        if (*bits == ~0ULL) {
+            uint64_t& words = m_fullWords[index / 4096];
+            words |= (1ULL << (index / 64 % 64));
+
+            if (words == ~0ULL) {
+                m_fullGroups |= (1ULL << (index / 4096));
+            }
+        }
+    }
+
+    bool Grow(unsigned index) {
+        while (m_capacity <= index) {
+            unsigned chunk = ChunkIndex(m_capacity);
+            unsigned size = ChunkSize(chunk);
+
+            T* slots = new T[size]();
+            uint64_t* words = new uint64_t[size / 64]();
+            if (!slots || !words) {
+                delete[] slots;
+                delete[] words;
+                return false;
+            }
+
+            m_words[chunk] = words;
+
+            // Make sure the slots are initialized before they can be seen
+            __atomic_store_n(&m_chunks[chunk], slots, __ATOMIC_RELEASE);
+            __atomic_store_n(&m_capacity, m_capacity + size, __ATOMIC_RELEASE);
+        }
+
+        return true;
+    }
+
+    T* m_chunks[SLOT_TABLE_CHUNK_COUNT] = {};
+    uint64_t* m_words[SLOT_TABLE_CHUNK_COUNT] = {}; // Bit set for each used slot
+    uint64_t m_fullWords[64] = {};                  // Bit set for each full word
+    uint64_t m_fullGroups = 0;                      // Bit set for each full group of 64 words
+    unsigned m_capacity = 0;
+};
@@ -3,6 +3,8 @@
 typedef volatile int lock_t;
 
 #include <Compiler.h>
+#include <LockStats.h>
+#include <stdint.h>
 
 #define CHECK_DEADLOCK
 #ifdef CHECK_DEADLOCK
@@ -27,4 +29,107 @@ public:
     ALWAYS_INLINE ~ScopedSpinLock() { releaseLock(&m_lock); }
 private:
     lock_t& m_lock;
-};
\ No newline at end of file
+};
+
+/////////////////////////////
+/// \brief Fair spinlock
+///
+/// Waiters take a ticket and are served in order, so no CPU can be starved under contention.
+/// Waiters only read the lock whilst spinning so the cache line is only contended on acquire and release.
+/////////////////////////////
+class TicketLock final {
+public:
+    constexpr TicketLock() = default;
+    constexpr TicketLock([[maybe_unused]] LockClass lockClass)
+#ifdef KERNEL_LOCK_STATS
+        : m_class(lockClass)
+#endif
+    {}
+
+    ALWAYS_INLINE void Acquire(){
+        uint16_t ticket = __atomic_fetch_add(&m_value, 1U << 16, __ATOMIC_RELAXED) >> 16;
+
+#ifdef KERNEL_LOCK_STATS
+        uint64_t start = LockStats::Timestamp();
+        bool contended = __atomic_load_n(&m_owner, __ATOMIC_RELAXED) != ticket;
+#endif
+
+#ifdef CHECK_DEADLOCK
+        unsigned i = 0;
+        while(__atomic_load_n(&m_owner, __ATOMIC_ACQUIRE) != ticket){
+            asm volatile("pause");
+
+            if(++i >= 0xFFFFFFF){
+                assert(!"Deadlock!");
+            }
+        }
+#else
+        while(__atomic_load_n(&m_owner, __ATOMIC_ACQUIRE) != ticket){
+            asm volatile("pause");
+        }
+#endif
+
+#ifdef KERNEL_LOCK_STATS
+        m_acquiredAt = LockStats::Timestamp();
+        LockStats::Acquired(m_class, contended, m_acquiredAt - start);
+#endif
+    }
+
+    /////////////////////////////
+    /// \brief Acquire the lock only if it is free
+    ///
+    /// \return true on success
+    /////////////////////////////
+    ALWAYS_INLINE bool TryAcquire(){
+        uint32_t value = __atomic_load_n(&m_value, __ATOMIC_RELAXED);
+        if((value & 0xFFFF) != (value >> 16)){
+            return false; // Held or contended
+        }
+
+        if(!__atomic_compare_exchange_n(&m_value, &value, value + (1U << 16), false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+            return false;
+        }
+
+#ifdef KERNEL_LOCK_STATS
+        m_acquiredAt = LockStats::Timestamp();
+        LockStats::Acquired(m_class, false, 0);
+#endif
+        return true;
+    }
+
+    ALWAYS_INLINE void Release(){
+#ifdef KERNEL_LOCK_STATS
+        LockStats::Released(m_class, LockStats::Timestamp() - m_acquiredAt);
+#endif
+
+        // Only the holder writes the owner half
+        __atomic_store_n(&m_owner, static_cast<uint16_t>(m_owner + 1), __ATOMIC_RELEASE);
+    }
+
+    ALWAYS_INLINE bool IsLocked() const {
+        uint32_t value = __atomic_load_n(&m_value, __ATOMIC_RELAXED);
+        return (value & 0xFFFF) != (value >> 16);
+    }
+
+private:
+    union {
+        uint32_t m_value = 0;
+        struct {
+            uint16_t m_owner; // Ticket being served
+            uint16_t m_next; // Next ticket to be given out
+        };
+    };
+
+#ifdef KERNEL_LOCK_STATS
+    LockClass m_class = LockClassAnonymous;
+    uint64_t m_acquiredAt = 0;
+#endif
+};
+
+class ScopedTicketLock final {
+public:
+    ALWAYS_INLINE ScopedTicketLock(TicketLock& lock) : m_lock(lock) { m_lock.Acquire(); }
+    ALWAYS_INLINE ~ScopedTicketLock() { m_lock.Release(); }
+private:
+    TicketLock& m_lock;
+};
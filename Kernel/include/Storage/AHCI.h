@@ -374,7 +374,7 @@ namespace AHCI{
 		lock_t bufferLocks[8];
 
 		Semaphore bufferSemaphore = Semaphore(8);
-		Semaphore portLock = Semaphore(1); // Binary semaphore for the AHCI port
+		Mutex portLock = Mutex(LockClassAHCIPort); // Held for the duration of a command
 	};
 
 	int Init();
@@ -24,6 +24,6 @@ namespace ATA{
         int blocksize = 512;
         
     private:
-        Semaphore driveLock = Semaphore(1);
+        Mutex driveLock = Mutex(LockClassATADrive);
     };
 }
\ No newline at end of file
@@ -7,7 +7,7 @@
 #include <Lock.h>
 #include <Scheduler.h>
 
-#define DATASTREAM_BUFSIZE_DEFAULT 1024
+#define DATASTREAM_BUFSIZE_DEFAULT 0x10000 // 64 KB
 
 typedef struct {
     uint8_t* data;
@@ -25,21 +25,36 @@ public:
     virtual int64_t Peek(void* buffer, size_t len);
     virtual int64_t Write(void* buffer, size_t len);
 
+    // Same as above but the buffer is in user memory, it is accessed with copy_to_user/copy_from_user.
+    // Returns the amount of data copied, or -EFAULT if the buffer is not accessible and nothing was copied
+    virtual int64_t ReadUser(void* buffer, size_t len);
+    virtual int64_t PeekUser(void* buffer, size_t len);
+    virtual int64_t WriteUser(const void* buffer, size_t len);
+
     virtual int64_t Pos() { return 0; }
+    virtual int64_t Space() { return INT64_MAX; } // Amount of data that can be written without blocking
     virtual int64_t Empty();
 
     virtual ~Stream();
 };
 
+// Bounded ring buffer of pages
+//
+// Pages are allocated as they are written to and freed once they have been read,
+// so a large capacity costs nothing until the data actually arrives.
+// Write never blocks, it writes as much as fits and the caller applies backpressure.
 class DataStream final : public Stream {
     lock_t streamLock = 0;
 
-    size_t bufferSize = 0;
-    size_t bufferPos = 0;
+    size_t capacity = 0; // Maximum amount of unread data
+    size_t pageCount = 0;
+    uint8_t** pages = nullptr;
+    uint8_t* sparePage = nullptr; // Most recently freed page, saves an allocation when streaming
 
-    uint8_t* buffer = nullptr;
+    size_t readPos = 0; // Offset in the ring of the first unread byte
+    size_t count = 0; // Amount of unread data
 public:
-    DataStream(size_t bufSize);
+    DataStream(size_t bufSize = DATASTREAM_BUFSIZE_DEFAULT);
     ~DataStream();
 
     void Wait();
@@ -47,9 +62,20 @@ public:
     int64_t Read(void* buffer, size_t len);
     int64_t Peek(void* buffer, size_t len);
     int64_t Write(void* buffer, size_t len);
+
+    int64_t ReadUser(void* buffer, size_t len);
+    int64_t PeekUser(void* buffer, size_t len);
+    int64_t WriteUser(const void* buffer, size_t len);
     
-    int64_t Pos() { return bufferPos; }
+    int64_t Pos() { return count; }
+    int64_t Space() { return capacity - count; }
+    inline size_t Capacity() const { return capacity; }
     virtual int64_t Empty();
+
+private:
+    // Stops at the first chunk that cannot be copied to or from user memory
+    int64_t CopyOut(uint8_t* data, size_t len, bool consume, bool user);
+    int64_t CopyIn(const uint8_t* data, size_t len, bool user);
 };
 
 class PacketStream final : public Stream {
@@ -60,5 +86,9 @@ public:
     int64_t Read(void* buffer, size_t len);
     int64_t Peek(void* buffer, size_t len);
     int64_t Write(void* buffer, size_t len);
+
+    int64_t ReadUser(void* buffer, size_t len);
+    int64_t PeekUser(void* buffer, size_t len);
+    int64_t WriteUser(const void* buffer, size_t len);
     virtual int64_t Empty();
 };
\ No newline at end of file
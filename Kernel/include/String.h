@@ -8,15 +8,6 @@
 #include <TTraits.h>
 #include <stddef.h>
 
-/////////////////////////////
-/// \brief safe strlen
-///
-/// Get the length of a usermode string and check if the pointer is valid
-///
-/// \return 0 on success, 1 when invalid pointer / not null terminated
-/////////////////////////////
-long strlenSafe(const char* str, size_t& size, AddressSpace* aSpace);
-
 char* itoa(unsigned long long num, char* str, int base);
 
 int HexStringToPointer(const char* buffer, size_t bufferSize, uintptr_t& pointerValue);
@@ -27,6 +18,24 @@ extern "C" int memcmp(const void* s1, const void* s2, size_t n);
 
 void memcpy_optimized(void* dest, void* src, size_t count);
 
+// Picks the fastest memcpy and memset for the CPU, called once during boot
+void InitializeStringFunctions();
+
+/////////////////////////////
+/// \brief Zero a page aligned 4KB page
+///
+/// Uses non-temporal stores so the page does not evict anything from the cache,
+/// for pages that are not going to be accessed straight away
+/////////////////////////////
+void ZeroPage(void* page);
+
+/////////////////////////////
+/// \brief Copy a page aligned 4KB page
+///
+/// Uses non-temporal stores for the destination, see ZeroPage
+/////////////////////////////
+void CopyPage(void* dest, const void* src);
+
 void strcpy(char* dest, const char* src);
 void strncpy(char* dest, const char* src, size_t n);
 int strcmp(const char* s1, const char* s2);
@@ -113,12 +122,17 @@ public:
         ScopedSpinLock acq(m_lock);
         ScopedSpinLock acqOther(other.m_lock);
 
+        if (m_buffer) {
+            delete[] m_buffer;
+        }
+
         m_len = other.m_len;
         m_bufferSize = other.m_bufferSize;
         m_buffer = other.m_buffer;
 
         other.m_len = 0;
         other.m_buffer = 0;
+        other.m_bufferSize = 0;
 
         return *this;
     }
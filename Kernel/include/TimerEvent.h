@@ -1,7 +1,8 @@
 #pragma once
 
 #include <Spinlock.h>
-#include <List.h>
+
+#include <stdint.h>
 
 struct RegisterContext;
 
@@ -9,29 +10,62 @@ namespace Timer{
     using TimerCallback = void(*)(void*);
     void Handler(void*, RegisterContext* r);
 
+    class TimerEvent;
+
+    /////////////////////////////
+    /// \brief Per-CPU queue of pending timer events
+    ///
+    /// Pairing heap ordered by deadline, insertion is O(1) and removal O(log n) amortized.
+    /// The lock must be held with interrupts disabled as it is taken in the timer interrupt.
+    /////////////////////////////
+    class TimerQueue final {
+    public:
+        inline TimerEvent* Front() const { return m_root; }
+
+        void Insert(TimerEvent* ev);
+        void Remove(TimerEvent* ev);
+
+        TicketLock lock = TicketLock(LockClassSleepQueue);
+
+    private:
+        static TimerEvent* Meld(TimerEvent* a, TimerEvent* b);
+        static TimerEvent* MergePairs(TimerEvent* first);
+
+        TimerEvent* m_root = nullptr;
+    };
+
     class TimerEvent final {
         friend void Timer::Handler(void*, RegisterContext* r);
-        friend class ::FastList<TimerEvent*>;
+        friend class TimerQueue;
     protected:
-        long ticks = 0;
-        bool dispatched = false;
+        enum {
+            TimerEventPending, // In the queue
+            TimerEventDispatching, // Removed from the queue, callback is running
+            TimerEventDispatched, // Callback has run or the event was cancelled
+        };
 
-        lock_t lock = 0;
+        uint64_t deadline = 0; // Time since boot in nanoseconds
+        int state = TimerEventPending; // Only changes from pending with the queue lock held
 
-        TimerEvent* next = nullptr;
-        TimerEvent* prev = nullptr;
+        TimerQueue* queue = nullptr; // Queue of the CPU the event was armed on
+        TimerEvent* child = nullptr;
+        TimerEvent* sibling = nullptr;
+        TimerEvent* prev = nullptr; // Parent if this is the first child, otherwise the previous sibling
 
         TimerCallback callback;
         void* data = nullptr; // Generic data pointer (Could be used to point to a class, etc.)
-
-        void Dispatch();
     public:
         TimerEvent(long _us, TimerCallback _callback, void* data);
-        ~TimerEvent();
 
-        inline long GetTicks() const { return ticks; }
+        /////////////////////////////
+        /// \brief Cancel the event
+        ///
+        /// Once destroyed the callback is guaranteed not to run.
+        /// Does not touch the queue if the event has already been dispatched.
+        /////////////////////////////
+        ~TimerEvent();
 
-        __attribute__((always_inline)) inline void Lock() { acquireLock(&lock); }
-        __attribute__((always_inline)) inline void Unlock() { releaseLock(&lock); }
+        inline uint64_t GetDeadline() const { return deadline; }
+        inline bool Dispatched() const { return __atomic_load_n(&state, __ATOMIC_ACQUIRE) == TimerEventDispatched; }
     };
-}
\ No newline at end of file
+}
@@ -65,8 +65,9 @@ public:
 		EnsureCapacity(x.get_length());
 
 		for(unsigned i = 0; i < x.get_length(); i++){
-			data[i] = x.data[i];
+			new (&data[i]) T(x.data[i]);
 		}
+		count = x.get_length();
 	}
 
 	ALWAYS_INLINE T& at(size_t pos) const{
@@ -171,7 +172,7 @@ public:
 		for(unsigned i = 0; i < count; i++){
 			if(data[i] == val){
 				EraseUnlocked(i);
-				return;
+				break;
 			}
 		}
 
@@ -225,14 +226,11 @@ private:
 					memcpy(data, oldData, capacity * sizeof(T));
 					memset(data + capacity, 0, sizeof(T) * (size - capacity));
 				} else {
+					// Only move the existing objects, callers construct any new ones
 					for(unsigned i = 0; i < count && i < capacity; i++){
 						new (&data[i]) T(std::move(oldData[i]));
 						oldData[i].~T();
 					}
-
-					for(unsigned i = capacity; i < size; i++){
-						new (&data[i]) T();
-					}
 				}
 				
 				kfree(oldData);
@@ -247,12 +245,13 @@ private:
 	ALWAYS_INLINE void EraseUnlocked(unsigned pos){
 		assert(pos < count);
 
-		if constexpr(TTraits<T>::is_trivial()){
-			memcpy(&data[pos], &data[pos + 1], (count - pos - 1) * sizeof(T));
-		} else {
-			for(unsigned i = pos; i < count - 1; i++){
-				data[i] = std::move(data[i + 1]);
-			}
+		// The source and destination overlap so memcpy cannot be used
+		for(unsigned i = pos; i < count - 1; i++){
+			data[i] = std::move(data[i + 1]);
+		}
+
+		if constexpr(!TTraits<T>::is_trivial()){
+			data[count - 1].~T();
 		}
 
 		count--;
@@ -265,17 +265,8 @@ uint16_t laihost_inw(uint16_t port) { return inportw(port); }
 uint32_t laihost_ind(uint16_t port) { return inportd(port); }
 
 void laihost_sleep(uint64_t ms) {
-    uint64_t freq = Timer::GetFrequency();
-    uint64_t delayInTicks = (freq / 1000) * ms;
-    uint64_t seconds = Timer::GetSystemUptime();
-    uint64_t ticks = Timer::GetTicks();
-    uint64_t totalTicks = seconds * freq + ticks;
-
-    for (;;) {
-        uint64_t totalTicksNew = Timer::GetSystemUptime() * freq + Timer::GetTicks();
-        if (totalTicksNew - totalTicks == delayInTicks) {
-            break;
-        }
+    if (ms) {
+        Timer::Wait(ms);
     }
 }
 
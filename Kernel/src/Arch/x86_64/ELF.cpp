@@ -1,5 +1,6 @@
 #include <ELF.h>
 
+#include <Fs/Filesystem.h>
 #include <Logging.h>
 #include <Math.h>
 #include <Paging.h>
@@ -19,61 +20,192 @@ int VerifyELF(void* elf) {
         return 1;
 }
 
-elf_info_t LoadELFSegments(process_t* proc, void* _elf, uintptr_t base) {
-    uint8_t* elf = reinterpret_cast<uint8_t*>(_elf);
+// Fallback for segments we cannot map from the page cache,
+// the file offset and virtual address of the segment are not aligned the same way within a page
+// or the segment shares a page with another segment
+static bool CopyELFSegment(process_t* proc, FsNode* node, const elf64_program_header_t& elfPHdr, uintptr_t base) {
     CPU* cpuLocal = GetCPULocal();
 
-    elf_info_t elfInfo;
-    memset(&elfInfo, 0, sizeof(elfInfo));
+    uintptr_t mapBase = (base + elfPHdr.vaddr) & ~static_cast<uintptr_t>(PAGE_SIZE_4K - 1);
+    uintptr_t mapEnd = (base + elfPHdr.vaddr + elfPHdr.memSize + PAGE_SIZE_4K - 1) & ~static_cast<uintptr_t>(PAGE_SIZE_4K - 1);
 
-    if (!VerifyELF(elf))
-        return elfInfo; // Invalid ELF Header
+    // The first page may have been mapped by the previous segment, it is private and writable so copy into it
+    if (proc->addressSpace->RangeInRegion(mapBase, PAGE_SIZE_4K)) {
+        mapBase += PAGE_SIZE_4K;
+    }
 
-    elf64_header_t elfHdr = *(elf64_header_t*)elf;
+    if (mapEnd > mapBase &&
+        !proc->addressSpace->MapVMO(new ProcessImageVMObject(mapBase, mapEnd - mapBase, true), mapBase, true)) {
+        return false;
+    }
 
-    elfInfo.entry = base + elfHdr.entry;
-    elfInfo.phEntrySize = elfHdr.phEntrySize;
-    elfInfo.phNum = elfHdr.phNum;
+    uint8_t* buffer = (uint8_t*)kmalloc(elfPHdr.fileSize);
+    if (fs::Read(node, elfPHdr.offset, elfPHdr.fileSize, buffer) != static_cast<ssize_t>(elfPHdr.fileSize)) {
+        kfree(buffer);
+        return false;
+    }
 
-    for (uint16_t i = 0; i < elfHdr.phNum; i++) {
-        elf64_program_header_t elfPHdr = *((elf64_program_header_t*)(elf + elfHdr.phOff + i * elfHdr.phEntrySize));
+    uintptr_t pml4Phys = Scheduler::GetCurrentProcess()->GetPageMap()->pml4Phys;
 
-        if (elfPHdr.memSize == 0 || elfPHdr.type != PT_LOAD)
+    cpuLocal->runQueueLock.Acquire();
+    asm("cli");
+    asm volatile("mov %%rax, %%cr3" ::"a"(proc->GetPageMap()->pml4Phys));
+    memset((void*)(base + elfPHdr.vaddr), 0, elfPHdr.memSize);
+    memcpy((void*)(base + elfPHdr.vaddr), buffer, elfPHdr.fileSize);
+    asm volatile("mov %%rax, %%cr3" ::"a"(pml4Phys));
+    asm("sti");
+    cpuLocal->runQueueLock.Release();
+
+    kfree(buffer);
+    return true;
+}
+
+// Each segment gets its own mappings so segments must not share pages,
+// some linkers pack segments together in which case the image is loaded with CopyELFSegment like it used to be
+static bool SegmentsSharePages(const elf64_header_t& elfHdr, const uint8_t* pHdrs) {
+    for (uint16_t i = 0; i < elfHdr.phNum; i++) {
+        const elf64_program_header_t* a = reinterpret_cast<const elf64_program_header_t*>(pHdrs + i * elfHdr.phEntrySize);
+        if (a->type != PT_LOAD || !a->memSize) {
             continue;
+        }
 
-        proc->usedMemoryBlocks += (elfPHdr.memSize + (elfPHdr.vaddr & 0xFFF) + 0xFFF) >> 12;
-        proc->addressSpace->MapVMO(new ProcessImageVMObject((base + elfPHdr.vaddr) & ~0xFFFUL,
-                                                            ((elfPHdr.memSize + (elfPHdr.vaddr & 0xFFF) + 0xFFF) &
-                                                             ~static_cast<uintptr_t>(PAGE_SIZE_4K - 1)),
-                                                            true),
-                                   (elfPHdr.vaddr + base) & ~0xFFFUL, true);
+        for (uint16_t j = i + 1; j < elfHdr.phNum; j++) {
+            const elf64_program_header_t* b = reinterpret_cast<const elf64_program_header_t*>(pHdrs + j * elfHdr.phEntrySize);
+            if (b->type != PT_LOAD || !b->memSize) {
+                continue;
+            }
+
+            uintptr_t aStart = a->vaddr & ~static_cast<uintptr_t>(PAGE_SIZE_4K - 1);
+            uintptr_t bStart = b->vaddr & ~static_cast<uintptr_t>(PAGE_SIZE_4K - 1);
+            if (aStart < b->vaddr + b->memSize && bStart < a->vaddr + a->memSize) {
+                return true;
+            }
+        }
     }
 
-    char* linkPath = nullptr;
-    uintptr_t pml4Phys = Scheduler::GetCurrentProcess()->GetPageMap()->pml4Phys;
+    return false;
+}
 
-    for (int i = 0; i < elfHdr.phNum; i++) {
-        elf64_program_header_t elfPHdr = *((elf64_program_header_t*)(elf + elfHdr.phOff + i * elfHdr.phEntrySize));
+static bool MapELFSegment(process_t* proc, FsNode* node, const elf64_program_header_t& elfPHdr, uintptr_t base,
+                          bool copy) {
+    uintptr_t segmentBase = (base + elfPHdr.vaddr) & ~static_cast<uintptr_t>(PAGE_SIZE_4K - 1);
+    uintptr_t segmentEnd = (base + elfPHdr.vaddr + elfPHdr.memSize + PAGE_SIZE_4K - 1) & ~static_cast<uintptr_t>(PAGE_SIZE_4K - 1);
 
-        if (elfPHdr.type == PT_LOAD && elfPHdr.memSize > 0) {
-            acquireLock(&cpuLocal->runQueueLock);
+    proc->usedMemoryBlocks += (segmentEnd - segmentBase) >> 12;
+
+    if (copy || (elfPHdr.fileSize && ((elfPHdr.vaddr - elfPHdr.offset) & (PAGE_SIZE_4K - 1)))) {
+        return CopyELFSegment(proc, node, elfPHdr, base);
+    }
+
+    uintptr_t fileEnd = base + elfPHdr.vaddr + elfPHdr.fileSize; // End of the data present in the file
+    uintptr_t fileMappingEnd = elfPHdr.fileSize ? ((fileEnd + PAGE_SIZE_4K - 1) & ~static_cast<uintptr_t>(PAGE_SIZE_4K - 1)) : segmentBase;
+
+    if (fileMappingEnd > segmentBase) {
+        // The rest of the last page has to be zeroed if it is part of the segment (e.g. .bss),
+        // so that page at least must be a private copy
+        bool zeroTail = (fileEnd & (PAGE_SIZE_4K - 1)) && elfPHdr.memSize > elfPHdr.fileSize;
+        bool shared = !(elfPHdr.flags & PF_W) && !zeroTail;
+
+        FancyRefPtr<FileVMObject> vmo = new FileVMObject(node, elfPHdr.offset & ~static_cast<uintptr_t>(PAGE_SIZE_4K - 1),
+                                                         fileMappingEnd - segmentBase, shared, false);
+        MappedRegion* region = proc->addressSpace->MapVMO(static_pointer_cast<VMObject>(vmo), segmentBase, true);
+        if (!region) {
+            return false;
+        }
+
+        if (zeroTail) {
+            CPU* cpuLocal = GetCPULocal();
+            uintptr_t pml4Phys = Scheduler::GetCurrentProcess()->GetPageMap()->pml4Phys;
+
+            // Take our copy of the page now, we cannot fault on it with the other address space loaded
+            if (vmo->Hit(segmentBase, (fileEnd & ~static_cast<uintptr_t>(PAGE_SIZE_4K - 1)) - segmentBase,
+                         proc->GetPageMap(), true)) {
+                return false;
+            }
+
+            cpuLocal->runQueueLock.Acquire();
             asm("cli");
             asm volatile("mov %%rax, %%cr3" ::"a"(proc->GetPageMap()->pml4Phys));
-            memset((void*)(base + elfPHdr.vaddr), 0, elfPHdr.memSize);
-            memcpy((void*)(base + elfPHdr.vaddr), (void*)(elf + elfPHdr.offset), elfPHdr.fileSize);
+            memset((void*)fileEnd, 0, fileMappingEnd - fileEnd);
             asm volatile("mov %%rax, %%cr3" ::"a"(pml4Phys));
             asm("sti");
-            releaseLock(&cpuLocal->runQueueLock);
+            cpuLocal->runQueueLock.Release();
+
+            // We needed to write to the page, the process may only do so if the segment is writable
+            if (!(elfPHdr.flags & PF_W)) {
+                vmo->SetReadOnly();
+                vmo->MapAllocatedBlocks(segmentBase, proc->GetPageMap());
+            }
+        }
+    }
+
+    if (segmentEnd > fileMappingEnd) { // Zero filled part of the segment
+        if (!proc->addressSpace->AllocateAnonymousVMObject(segmentEnd - fileMappingEnd, fileMappingEnd, true)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+elf_info_t LoadELFSegments(process_t* proc, FsNode* node, uintptr_t base) {
+    elf_info_t elfInfo;
+    memset(&elfInfo, 0, sizeof(elfInfo));
+
+    elf64_header_t elfHdr;
+    if (fs::Read(node, 0, sizeof(elf64_header_t), reinterpret_cast<uint8_t*>(&elfHdr)) != sizeof(elf64_header_t) ||
+        !VerifyELF(&elfHdr)) {
+        return elfInfo; // Invalid ELF Header
+    }
+
+    if (elfHdr.phEntrySize < sizeof(elf64_program_header_t)) {
+        Log::Warning("Invalid ELF program header size: %u", elfHdr.phEntrySize);
+        return elfInfo;
+    }
+
+    // Only read the program headers, everything else is faulted in when used
+    size_t pHdrsSize = static_cast<size_t>(elfHdr.phNum) * elfHdr.phEntrySize;
+    uint8_t* pHdrs = new uint8_t[pHdrsSize];
+    if (fs::Read(node, elfHdr.phOff, pHdrsSize, pHdrs) != static_cast<ssize_t>(pHdrsSize)) {
+        delete[] pHdrs;
+        return elfInfo;
+    }
+
+    bool copySegments = SegmentsSharePages(elfHdr, pHdrs);
+
+    char* linkPath = nullptr;
+    for (uint16_t i = 0; i < elfHdr.phNum; i++) {
+        elf64_program_header_t elfPHdr = *((elf64_program_header_t*)(pHdrs + i * elfHdr.phEntrySize));
+
+        if (elfPHdr.type == PT_LOAD && elfPHdr.memSize > 0) {
+            if (!MapELFSegment(proc, node, elfPHdr, base, copySegments)) {
+                Log::Warning("Failed to map ELF segment (%x - %x)", base + elfPHdr.vaddr,
+                             base + elfPHdr.vaddr + elfPHdr.memSize);
+
+                if (linkPath) {
+                    kfree(linkPath);
+                }
+
+                delete[] pHdrs;
+                memset(&elfInfo, 0, sizeof(elfInfo));
+                return elfInfo;
+            }
         } else if (elfPHdr.type == PT_PHDR) {
             elfInfo.pHdrSegment = base + elfPHdr.vaddr;
-        } else if (elfPHdr.type == PT_INTERP) {
+        } else if (elfPHdr.type == PT_INTERP && !linkPath) {
             linkPath = (char*)kmalloc(elfPHdr.fileSize + 1);
-            strncpy(linkPath, (char*)(elf + elfPHdr.offset), elfPHdr.fileSize);
-            linkPath[elfPHdr.fileSize] = 0; // Null terminate the path
+            ssize_t read = fs::Read(node, elfPHdr.offset, elfPHdr.fileSize, reinterpret_cast<uint8_t*>(linkPath));
+            linkPath[(read > 0) ? read : 0] = 0; // Null terminate the path
 
             elfInfo.linkerPath = linkPath;
         }
     }
 
+    delete[] pHdrs;
+
+    elfInfo.entry = base + elfHdr.entry;
+    elfInfo.phEntrySize = elfHdr.phEntrySize;
+    elfInfo.phNum = elfHdr.phNum;
+
     return elfInfo;
-}
\ No newline at end of file
+}
@@ -64,19 +64,20 @@ GDT64:                           ; Global Descriptor Table (64-bit).
     db 10010010b                 ; Access (read/write).
     db 00000000b                 ; Granularity.
     db 0                         ; Base (high).
-    .UserCode: equ $ - GDT64     ; The usermode code descriptor.
+    ; SYSRET expects the user data descriptor to come right before the user code descriptor
+    .UserData: equ $ - GDT64     ; The usermode data descriptor.
     dw 0                         ; Limit (low).
     dw 0                         ; Base (low).
     db 0                         ; Base (middle)
-    db 11111010b                 ; Access (exec/read).
-    db 00100000b                 ; Granularity, 64 bits flag, limit19:16.
+    db 11110010b                 ; Access (read/write).
+    db 00000000b                 ; Granularity.
     db 0                         ; Base (high).
-    .UserData: equ $ - GDT64     ; The usermode data descriptor.
+    .UserCode: equ $ - GDT64     ; The usermode code descriptor.
     dw 0                         ; Limit (low).
     dw 0                         ; Base (low).
     db 0                         ; Base (middle)
-    db 11110010b                 ; Access (read/write).
-    db 00000000b                 ; Granularity.
+    db 11111010b                 ; Access (exec/read).
+    db 00100000b                 ; Granularity, 64 bits flag, limit19:16.
     db 0                         ; Base (high).
     .TSS: ;equ $ - GDT64         ; TSS Descriptor
     .len:
@@ -0,0 +1,228 @@
+#include <FPU.h>
+
+#include <Assert.h>
+#include <CPU.h>
+#include <HAL.h>
+#include <IDT.h>
+#include <Logging.h>
+#include <Paging.h>
+#include <PhysicalAllocator.h>
+#include <String.h>
+#include <Thread.h>
+
+namespace FPU {
+bool useXSave = false;
+bool useXSaveOpt = false;
+uint64_t xcr0 = XCR0_X87 | XCR0_SSE;
+size_t stateSize = sizeof(fx_state_t);
+
+static inline void SetTaskSwitched(CPU* cpu) {
+    uintptr_t cr0;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    asm volatile("mov %0, %%cr0" ::"r"(cr0 | CR0_TS));
+
+    cpu->fpuTrap = true;
+}
+
+static inline void ClearTaskSwitched(CPU* cpu) {
+    asm volatile("clts");
+
+    cpu->fpuTrap = false;
+}
+
+static inline void Save(void* state) {
+    if (useXSaveOpt) {
+        // Skips components that are in their initial state or have not changed since the last XRSTOR
+        asm volatile("xsaveopt64 (%0)" ::"r"(state), "a"(UINT32_MAX), "d"(UINT32_MAX) : "memory");
+    } else if (useXSave) {
+        asm volatile("xsave64 (%0)" ::"r"(state), "a"(UINT32_MAX), "d"(UINT32_MAX) : "memory");
+    } else {
+        asm volatile("fxsave64 (%0)" ::"r"(state) : "memory");
+    }
+}
+
+static inline void Restore(void* state) {
+    if (useXSave) {
+        asm volatile("xrstor64 (%0)" ::"r"(state), "a"(UINT32_MAX), "d"(UINT32_MAX) : "memory");
+    } else {
+        asm volatile("fxrstor64 (%0)" ::"r"(state) : "memory");
+    }
+}
+
+// Make sure the registers hold the state of the thread and allow access to them
+static void Load(CPU* cpu, Thread* thread) {
+    if (cpu->fpuTrap) {
+        ClearTaskSwitched(cpu);
+    }
+
+    // The registers may still hold our state if no other thread has used the FPU on this CPU
+    // and we have not run anywhere else since
+    if (cpu->fpuOwner != thread || thread->fpuCPU != cpu) {
+        Restore(thread->fxState);
+
+        cpu->fpuOwner = thread;
+        thread->fpuCPU = cpu;
+        thread->fpuRestores++;
+    }
+}
+
+// #NM, raised by FPU/SSE/AVX instructions when CR0.TS is set
+void DeviceNotAvailableHandler(void*, RegisterContext* r) {
+    CPU* cpu = GetCPULocal();
+    Thread* thread = cpu->currentThread;
+
+    // The kernel is built without SSE, so this should only ever happen in usermode
+    assert(thread && !thread->fpuDisabled);
+
+    thread->fpuTraps++;
+    Load(cpu, thread);
+}
+
+void Initialize() {
+    cpuid_info_t cpuid = CPUID();
+
+    if (cpuid.features_ecx & CPUID_ECX_XSAVE) {
+        uint32_t eax, ebx, ecx, edx;
+        CPUIDLeaf(0xD, 0, eax, ebx, ecx, edx);
+
+        uint64_t supported = (static_cast<uint64_t>(edx) << 32) | eax;
+        if (cpuid.features_ecx & CPUID_ECX_AVX) {
+            xcr0 |= supported & XCR0_AVX;
+        }
+
+        if ((supported & XCR0_AVX512) == XCR0_AVX512 && (xcr0 & XCR0_AVX)) {
+            xcr0 |= XCR0_AVX512; // All or nothing
+        }
+
+        CPUIDLeaf(0xD, 1, eax, ebx, ecx, edx);
+        useXSaveOpt = eax & 1;
+        useXSave = true;
+    }
+
+    InitializeCPU();
+
+    if (useXSave) {
+        uint32_t eax, ebx, ecx, edx;
+        CPUIDLeaf(0xD, 0, eax, ebx, ecx, edx);
+        stateSize = ebx; // Size for the components enabled in XCR0
+    }
+
+    // Each thread gets a page for its state
+    assert(stateSize <= PAGE_SIZE_4K);
+
+    IDT::RegisterInterruptHandler(7, DeviceNotAvailableHandler);
+
+    Log::Info("[FPU] Using %s, XCR0: %x, state size: %u bytes%s",
+              useXSaveOpt ? "XSAVEOPT" : (useXSave ? "XSAVE" : "FXSAVE"), xcr0, stateSize,
+              HAL::useLazyFPU ? ", lazy restore" : "");
+}
+
+void InitializeCPU() {
+    uintptr_t cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+
+    cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+    if (useXSave) {
+        cr4 |= CR4_OSXSAVE;
+    }
+
+    asm volatile("mov %0, %%cr4" ::"r"(cr4));
+
+    if (useXSave) {
+        asm volatile("xsetbv" ::"a"(xcr0 & 0xFFFFFFFF), "d"(xcr0 >> 32), "c"(0));
+    }
+}
+
+size_t StateSize() { return stateSize; }
+
+void* AllocateState() {
+    void* state = Memory::KernelAllocate4KPages(1);
+    Memory::KernelMapVirtualMemory4K(Memory::AllocatePhysicalMemoryBlock(), (uintptr_t)state, 1);
+
+    InitializeState(state);
+    return state;
+}
+
+void InitializeState(void* state) {
+    memset(state, 0, PAGE_SIZE_4K); // The XSAVE header must be zeroed
+
+    fx_state_t* fxState = reinterpret_cast<fx_state_t*>(state);
+    fxState->mxcsr = 0x1f80; // Default MXCSR (SSE Control Word) State
+    fxState->mxcsrMask = 0xffbf;
+    fxState->fcw = 0x33f; // Default FPU Control Word State
+
+    if (useXSave) {
+        // Load the control words above, everything else starts in its initial state
+        xsave_header_t* header = reinterpret_cast<xsave_header_t*>(reinterpret_cast<uintptr_t>(state) + 512);
+        header->xstateBV = XCR0_X87 | XCR0_SSE;
+    }
+}
+
+void SwitchOut(CPU* cpu, Thread* thread) {
+    if (thread->fpuDisabled) {
+        return;
+    }
+
+    // The thread only has access to the registers if it owns them and CR0.TS is clear
+    if (cpu->fpuOwner == thread && !cpu->fpuTrap) {
+        Save(thread->fxState);
+
+        thread->fpuSaves++;
+        thread->fpuCounter++; // Wraps around so lazy restore gets tried again every so often
+    } else {
+        thread->fpuCounter = 0;
+    }
+}
+
+void SwitchIn(CPU* cpu, Thread* thread) {
+    if (thread->fpuDisabled) {
+        return; // Leave the registers to whoever owns them
+    }
+
+    if (!HAL::useLazyFPU || thread->fpuCounter > FPU_EAGER_THRESHOLD) {
+        Load(cpu, thread);
+    } else if (!cpu->fpuTrap) {
+        SetTaskSwitched(cpu);
+    }
+}
+
+void Reset(Thread* thread) {
+    int intEnable = CheckInterrupts();
+    asm("cli");
+
+    CPU* cpu = GetCPULocal();
+    assert(cpu->currentThread == thread);
+
+    InitializeState(thread->fxState);
+    thread->fpuCPU = nullptr; // Force a restore
+    thread->fpuCounter = 0;
+
+    Load(cpu, thread);
+
+    if (intEnable) {
+        asm("sti");
+    }
+}
+
+void Fork(Thread* thread, Thread* newThread) {
+    int intEnable = CheckInterrupts();
+    asm("cli");
+
+    CPU* cpu = GetCPULocal();
+    assert(cpu->currentThread == thread);
+
+    if (cpu->fpuOwner == thread && !cpu->fpuTrap) {
+        Save(thread->fxState); // Make sure the saved state is up to date
+    }
+
+    if (intEnable) {
+        asm("sti");
+    }
+
+    memcpy(newThread->fxState, thread->fxState, stateSize);
+
+    newThread->fpuCPU = nullptr;
+    newThread->fpuCounter = thread->fpuCounter;
+    newThread->fpuSaves = newThread->fpuRestores = newThread->fpuTraps = 0;
+}
+} // namespace FPU
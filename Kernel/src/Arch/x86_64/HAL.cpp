@@ -33,6 +33,7 @@ bool debugMode = false;
 bool disableSMP = false;
 bool useKCon = false;
 bool runTests = false;
+bool useLazyFPU = false;
 VideoConsole* con;
 
 void InitMultiboot2(multiboot2_info_header_t* mbInfo);
@@ -44,6 +45,9 @@ void InitCore() { // ALWAYS call this first
 
     asm("cli");
 
+    // Pick memcpy/memset implementations before anything large gets copied
+    InitializeStringFunctions();
+
     // Initialize IDT
     IDT::Initialize();
 
@@ -83,6 +87,8 @@ void InitExtra() {
     APIC::Initialize();
     Log::Write("OK");
 
+    Timer::InitializeLocalTimer();
+
     Log::Info("Initializing SMP...");
     SMP::Initialize();
     Log::Write("OK");
@@ -204,6 +210,8 @@ void InitMultiboot2(multiboot2_info_header_t* mbInfo) {
                 disableSMP = true;
             else if (strcmp(cmdLine, "kcon") == 0)
                 useKCon = true;
+            else if (strcmp(cmdLine, "lazyfpu") == 0)
+                useLazyFPU = true;
             cmdLine = strtok(NULL, " ");
         }
     }
@@ -344,6 +352,8 @@ void InitStivale2(stivale2_info_header_t* st2Info) {
                 disableSMP = true;
             else if (strcmp(cmdLine, "kcon") == 0)
                 useKCon = true;
+            else if (strcmp(cmdLine, "lazyfpu") == 0)
+                useLazyFPU = true;
             else if (strcmp(cmdLine, "runtests") == 0)
                 runTests = true;
             cmdLine = strtok(NULL, " ");
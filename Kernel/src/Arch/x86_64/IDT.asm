@@ -56,6 +56,7 @@ idt_flush:
 	global isr%1
 	isr%1:
         cli
+        cld ; The kernel expects DF clear, user code may have set it
         push qword [rsp+5*8] ; SS
         push qword [rsp+5*8] ; RSP
         push qword [rsp+5*8] ; RFLAGS
@@ -75,6 +76,7 @@ idt_flush:
 	global isr%1
 	isr%1:
 		cli
+		cld
         pushaq
         mov rdi, %1
         mov rsi, rsp
@@ -89,6 +91,7 @@ idt_flush:
 	global ipi%1
 	ipi%1:
 		cli
+		cld
         pushaq
         mov rdi, %1
         mov rsi, rsp
@@ -103,6 +106,7 @@ idt_flush:
   global irq%1
   irq%1:
     cli
+    cld
     pushaq
     mov rdi, %2
     mov rsi, rsp
@@ -151,6 +155,7 @@ extern SyscallHandler ; Syscall
 global isr0x69
 isr0x69:
     cli
+    cld
     pushaq
     mov rdi, rsp
     xor rbp, rbp
@@ -158,6 +163,47 @@ isr0x69:
     popaq
     iretq
 
+; SYSCALL entry point
+; RCX holds the user RIP and R11 the user RFLAGS, interrupts are masked by FMASK
+; Builds the same register context as isr0x69 on the kernel stack of the current thread
+global syscall_entry
+syscall_entry:
+    swapgs
+    mov [gs:16], rsp ; CPU::userStack
+    mov rsp, [gs:8] ; CPU::kernelStack
+    push qword 0x1B ; SS
+    push qword [gs:16] ; RSP
+    swapgs
+    push r11 ; RFLAGS
+    push qword 0x23 ; CS
+    push rcx ; RIP
+    pushaq
+    mov rdi, rsp
+    xor rbp, rbp
+    call SyscallHandler
+    cli
+
+    ; Signal handling, sigreturn and exec change the register context.
+    ; Only use SYSRET if RCX and R11 still hold RIP and RFLAGS
+    ; and RIP is canonical (SYSRET would fault in kernel mode otherwise)
+    mov rcx, [rsp + 15*8] ; RIP
+    cmp rcx, [rsp + 12*8] ; RCX
+    jne .iret
+    mov r11, [rsp + 17*8] ; RFLAGS
+    cmp r11, [rsp + 4*8] ; R11
+    jne .iret
+    cmp qword [rsp + 16*8], 0x23 ; CS
+    jne .iret
+    shr rcx, 47
+    jnz .iret
+
+    popaq
+    mov rsp, [rsp + 3*8] ; User RSP
+    o64 sysret
+.iret:
+    popaq
+    iretq
+
 %assign num 48
 %rep 256-48
     IPI num
@@ -111,7 +111,7 @@ void Initialize() {
 
     SetGate(0, (uint64_t)isr0, 0x08, 0x8E);
     SetGate(1, (uint64_t)isr1, 0x08, 0x8E);
-    SetGate(2, (uint64_t)isr2, 0x08, 0x8E);
+    SetGate(2, (uint64_t)isr2, 0x08, 0x8E, 1); // NMI, can arrive on SYSCALL before the kernel stack is loaded
     SetGate(3, (uint64_t)isr3, 0x08, 0x8E);
     SetGate(4, (uint64_t)isr4, 0x08, 0x8E);
     SetGate(5, (uint64_t)isr5, 0x08, 0x8E);
@@ -127,7 +127,7 @@ void Initialize() {
     SetGate(15, (uint64_t)isr15, 0x08, 0x8E);
     SetGate(16, (uint64_t)isr16, 0x08, 0x8E);
     SetGate(17, (uint64_t)isr17, 0x08, 0x8E);
-    SetGate(18, (uint64_t)isr18, 0x08, 0x8E);
+    SetGate(18, (uint64_t)isr18, 0x08, 0x8E, 3); // Machine Check, same as NMI
     SetGate(19, (uint64_t)isr19, 0x08, 0x8E);
     SetGate(20, (uint64_t)isr20, 0x08, 0x8E);
     SetGate(21, (uint64_t)isr21, 0x08, 0x8E);
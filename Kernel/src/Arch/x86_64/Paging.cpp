@@ -1,20 +1,24 @@
 #include <APIC.h>
 #include <IDT.h>
 #include <Logging.h>
+#include <MM/VMem.h>
 #include <Memory.h>
 #include <Paging.h>
 #include <Panic.h>
 #include <PhysicalAllocator.h>
+#include <SMP.h>
 #include <Scheduler.h>
 #include <StackTrace.h>
 #include <String.h>
 #include <Syscalls.h>
 #include <System.h>
+#include <UserMemory.h>
 
 // extern uint32_t kernel_end;
 
 #define KERNEL_HEAP_PDPT_INDEX 511
 #define KERNEL_HEAP_PML4_INDEX 511
+#define KERNEL_HEAP_VIRTUAL_BASE 0xFFFFFFFFC0000000ULL // Last GB of the address space
 
 uint64_t kernelPML4Phys;
 extern int lastSyscall;
@@ -27,6 +31,26 @@ page_dir_t kernelHeapDir __attribute__((aligned(4096)));
 page_t kernelHeapDirTables[TABLES_PER_DIR][PAGES_PER_TABLE] __attribute__((aligned(4096)));
 page_dir_t ioDirs[4] __attribute__((aligned(4096)));
 
+// Kernel virtual address space of the heap directory
+VMemArena kernelVirtualArena(LockClassKernelVM);
+
+// One shootdown at a time, the other CPUs read the request in the IPI handler
+static lock_t shootdownLock = 0;
+static uint64_t shootdownPML4 = 0;
+static uint64_t shootdownBase = 0;
+static uint64_t shootdownAmount = 0;
+static unsigned shootdownPending = 0;
+
+static void TLBShootdownHandler(void*, RegisterContext*) {
+    if (GetCR3() == shootdownPML4) { // Nothing is cached for address spaces that are not loaded
+        for (uint64_t i = 0; i < shootdownAmount; i++) {
+            invlpg(shootdownBase + (i << PAGE_SHIFT_4K));
+        }
+    }
+
+    __atomic_sub_fetch(&shootdownPending, 1, __ATOMIC_RELEASE);
+}
+
 uint64_t VirtualToPhysicalAddress(uint64_t addr) {
     uint64_t address = 0;
 
@@ -99,6 +123,7 @@ page_table_t CreatePageTable(uint16_t pdptIndex, uint16_t pageDirIndex, PageMap*
 
 void InitializeVirtualMemory() {
     IDT::RegisterInterruptHandler(14, PageFaultHandler);
+    IDT::RegisterInterruptHandler(IPI_TLB_SHOOTDOWN, TLBShootdownHandler);
     memset(kernelPML4, 0, sizeof(pml4_t));
     memset(kernelPDPT, 0, sizeof(pdpt_t));
     memset(kernelHeapDir, 0, sizeof(page_dir_t));
@@ -129,8 +154,20 @@ void InitializeVirtualMemory() {
 
     for (int i = 0; i < TABLES_PER_DIR; i++) {
         memset(&(kernelHeapDirTables[i]), 0, sizeof(page_t) * PAGES_PER_TABLE);
+
+        // The page tables are static, so just keep them present
+        SetPageFrame(&(kernelHeapDir[i]), (uintptr_t) & (kernelHeapDirTables[i]) - KERNEL_VIRTUAL_BASE);
+        kernelHeapDir[i] |= PDE_WRITABLE | PDE_PRESENT;
     }
 
+    // Leave out the last page so ranges never wrap around to 0
+    kernelVirtualArena.Initialize(KERNEL_HEAP_VIRTUAL_BASE, PAGE_SIZE_1G - PAGE_SIZE_4K, PAGE_SIZE_4K,
+                                  [](uintptr_t base, size_t size) -> void {
+                                      for (size_t offset = 0; offset < size; offset += PAGE_SIZE_4K) {
+                                          KernelMapVirtualMemory4K(AllocatePhysicalMemoryBlock(), base + offset, 1);
+                                      }
+                                  });
+
     kernelPML4Phys = (uint64_t)kernelPML4 - KERNEL_VIRTUAL_BASE;
     asm("mov %%rax, %%cr3" ::"a"((uint64_t)kernelPML4 - KERNEL_VIRTUAL_BASE));
 }
@@ -314,240 +351,30 @@ bool CheckUsermodePointer(uintptr_t addr, uint64_t len, AddressSpace* addressSpa
     return addressSpace->RangeInRegion(addr, len);
 }
 
-void* Allocate4KPages(uint64_t amount, PageMap* pageMap) {
-    uint64_t offset = 0;
-    uint64_t pageDirOffset = 0;
-    uint64_t counter = 0;
-    uintptr_t address = 0;
-
-    uint64_t pml4Index = 0;
-    for (int d = 0; d < 512; d++) {
-        uint64_t pdptIndex = d;
-        if (!(pageMap->pdpt[d] & 0x1)) {
-            continue;
-        }
-        /* Attempt 1: Already Allocated Page Tables*/
-        int i = 0;
-        if (d == 0) {
-            i = 1; // Prevent 0 from being allocated
-            pageDirOffset = 1;
-        }
-        for (; i < TABLES_PER_DIR; i++) {
-            if (pageMap->pageDirs[d][i] & 0x1 && !(pageMap->pageDirs[d][i] & 0x80)) {
-                for (int j = 0; j < PAGES_PER_TABLE; j++) {
-                    if (pageMap->pageTables[d][i][j] & 0x1) {
-                        pageDirOffset = i;
-                        offset = j + 1;
-                        counter = 0;
-                        continue;
-                    }
-
-                    counter++;
-
-                    if (counter >= amount) {
-                        address = (PDPT_SIZE * pml4Index) + (pdptIndex * PAGE_SIZE_1G) +
-                                  (pageDirOffset * PAGE_SIZE_2M) + (offset * PAGE_SIZE_4K);
-                        while (counter--) {
-                            if (offset >= 512) {
-                                pageDirOffset++;
-                                offset = 0;
-                            }
-                            pageMap->pageTables[d][pageDirOffset][offset] = 0x3;
-                            offset++;
-                        }
-
-                        return (void*)address;
-                    }
-                }
-            } else {
-                pageDirOffset = i + 1;
-                offset = 0;
-                counter = 0;
-            }
-        }
-
-        pageDirOffset = 0;
-        offset = 0;
-        counter = 0;
-
-        /* Attempt 2: Allocate Page Tables*/
-        i = 0;
-        if (d == 0) {
-            i = 1; // Prevent 0 from being allocated
-            pageDirOffset = 1;
-        }
-        for (; i < TABLES_PER_DIR; i++) {
-            if (!(pageMap->pageDirs[d][i] & 0x1)) {
-                CreatePageTable(d, i, pageMap);
-                for (int j = 0; j < PAGES_PER_TABLE; j++) {
-
-                    address = (PDPT_SIZE * pml4Index) + (pdptIndex * PAGE_SIZE_1G) + (pageDirOffset * PAGE_SIZE_2M) +
-                              (offset * PAGE_SIZE_4K);
-                    counter++;
-
-                    if (counter >= amount) {
-                        address = (PDPT_SIZE * pml4Index) + (pdptIndex * PAGE_SIZE_1G) +
-                                  (pageDirOffset * PAGE_SIZE_2M) + (offset * PAGE_SIZE_4K);
-                        while (counter--) {
-                            if (offset >= 512) {
-                                pageDirOffset++;
-                                offset = 0;
-                            }
-                            pageMap->pageTables[d][pageDirOffset][offset] = 0x3;
-                            offset++;
-                        }
-                        return (void*)address;
-                    }
-                }
-            } else {
-                pageDirOffset = i + 1;
-                offset = 0;
-                counter = 0;
-            }
-        }
-        Log::Info("new dir");
-    }
-
-    assert(!"Out of virtual memory!");
-}
-
 void* KernelAllocate4KPages(uint64_t amount) {
-    uint64_t offset = 0;
-    uint64_t pageDirOffset = 0;
-    uint64_t counter = 0;
-    uintptr_t address = 0;
-
-    uint64_t pml4Index = KERNEL_HEAP_PML4_INDEX;
-    uint64_t pdptIndex = KERNEL_HEAP_PDPT_INDEX;
-
-    /* Attempt 1: Already Allocated Page Tables*/
-    for (int i = 0; i < TABLES_PER_DIR; i++) {
-        if (kernelHeapDir[i] & 0x1 && !(kernelHeapDir[i] & 0x80)) {
-            for (int j = 0; j < TABLES_PER_DIR; j++) {
-                if (kernelHeapDirTables[i][j] & 0x1) {
-                    pageDirOffset = i;
-                    offset = j + 1;
-                    counter = 0;
-                    continue;
-                }
-
-                counter++;
-
-                if (counter >= amount) {
-                    address = (PDPT_SIZE * pml4Index) + (pdptIndex * PAGE_SIZE_1G) + (pageDirOffset * PAGE_SIZE_2M) +
-                              (offset * PAGE_SIZE_4K);
-                    address |= 0xFFFF000000000000;
-                    while (counter--) {
-                        if (offset >= 512) {
-                            pageDirOffset++;
-                            offset = 0;
-                        }
-                        kernelHeapDirTables[pageDirOffset][offset] = 0x3;
-                        offset++;
-                    }
-
-                    return (void*)address;
-                }
-            }
-        } else {
-            pageDirOffset = i + 1;
-            offset = 0;
-            counter = 0;
-        }
+    uintptr_t address = kernelVirtualArena.Allocate(amount * PAGE_SIZE_4K);
+    if (!address) {
+        Log::Error("Kernel Out of Virtual Memory");
+        const char* reasons[1] = {"Kernel Out of Virtual Memory!"};
+        KernelPanic(reasons, 1);
     }
 
-    pageDirOffset = 0;
-    offset = 0;
-    counter = 0;
-
-    /* Attempt 2: Allocate Page Tables*/
-    for (int i = 0; i < TABLES_PER_DIR; i++) {
-        if (!(kernelHeapDir[i] & 0x1)) {
-            counter += 512;
-
-            if (counter >= amount) {
-                address = (PDPT_SIZE * pml4Index) + (pdptIndex * PAGE_SIZE_1G) + (pageDirOffset * PAGE_SIZE_2M) +
-                          (offset * PAGE_SIZE_4K);
-                address |= 0xFFFF000000000000;
-                // kernelHeapDir[i] = (PAGE_FRAME & ((uintptr_t)&(kernelHeapDirTables[i]) - KERNEL_VIRTUAL_BASE)) | 0x3;
-                SetPageFrame(&(kernelHeapDir[pageDirOffset]),
-                             ((uintptr_t) & (kernelHeapDirTables[pageDirOffset]) - KERNEL_VIRTUAL_BASE));
-                kernelHeapDir[pageDirOffset] |= 0x3;
-                while (amount--) {
-                    if (offset >= 512) {
-                        pageDirOffset++;
-                        offset = 0;
-                        SetPageFrame(&(kernelHeapDir[pageDirOffset]),
-                                     ((uintptr_t) & (kernelHeapDirTables[pageDirOffset]) - KERNEL_VIRTUAL_BASE));
-                        kernelHeapDir[pageDirOffset] |= 0x3;
-                    }
-                    kernelHeapDirTables[pageDirOffset][offset] = 0x3;
-                    offset++;
-                }
-                return (void*)address;
-            }
-        } else {
-            pageDirOffset = i + 1;
-            offset = 0;
-            counter = 0;
-        }
-    }
-
-    assert(!"Kernel Out of Virtual Memory");
-}
-
-void* KernelAllocate2MPages(uint64_t amount) {
-    uint64_t address = 0;
-    uint64_t offset = 0;
-    uint64_t counter = 0;
-    uint64_t pdptIndex = KERNEL_HEAP_PDPT_INDEX;
-    uint64_t pml4Index = KERNEL_HEAP_PML4_INDEX;
-
-    for (int i = 0; i < TABLES_PER_DIR; i++) {
-        if (kernelHeapDir[i] & 0x1) {
-            offset = i + 1;
-            counter = 0;
-            continue;
-        }
-        counter++;
-
-        if (counter >= amount) {
-            address = (PDPT_SIZE * pml4Index) + (pdptIndex * PAGE_SIZE_1G) + offset * PAGE_SIZE_2M;
-            address |= 0xFFFF000000000000;
-            while (counter--) {
-                kernelHeapDir[offset] = 0x83;
-                offset++;
-            }
-            return (void*)address;
-        }
-    }
-
-    Log::Error("Kernel Out of Virtual Memory");
-    const char* reasons[1] = {"Kernel Out of Virtual Memory!"};
-    KernelPanic(reasons, 1);
-    for (;;)
-        ;
+    return reinterpret_cast<void*>(address);
 }
 
 void KernelFree4KPages(void* addr, uint64_t amount) {
     uint64_t pageDirIndex, pageIndex;
     uint64_t virt = (uint64_t)addr;
 
-    while (amount--) {
+    for (uint64_t i = 0; i < amount; i++) {
         pageDirIndex = PAGE_DIR_GET_INDEX(virt);
         pageIndex = PAGE_TABLE_GET_INDEX(virt);
         kernelHeapDirTables[pageDirIndex][pageIndex] = 0;
         invlpg(virt);
         virt += PAGE_SIZE_4K;
     }
-}
 
-void KernelFree2MPages(void* addr, uint64_t amount) {
-    while (amount--) {
-        uint64_t pageDirIndex = PAGE_DIR_GET_INDEX((uint64_t)addr);
-        kernelHeapDir[pageDirIndex] = 0;
-        addr = (void*)((uint64_t)addr + 0x200000);
-    }
+    kernelVirtualArena.Free(reinterpret_cast<uintptr_t>(addr), amount * PAGE_SIZE_4K);
 }
 
 void Free4KPages(void* addr, uint64_t amount, page_map_t* addressSpace) {
@@ -576,18 +403,6 @@ void Free4KPages(void* addr, uint64_t amount, page_map_t* addressSpace) {
     }
 }
 
-void KernelMapVirtualMemory2M(uint64_t phys, uint64_t virt, uint64_t amount) {
-    uint64_t pageDirIndex = PAGE_DIR_GET_INDEX(virt);
-
-    while (amount--) {
-        kernelHeapDir[pageDirIndex] = 0x83;
-        SetPageFrame(&(kernelHeapDir[pageDirIndex]), phys);
-        kernelHeapDir[pageDirIndex] |= 0x83;
-        pageDirIndex++;
-        phys += PAGE_SIZE_2M;
-    }
-}
-
 void KernelMapVirtualMemory4K(uint64_t phys, uint64_t virt, uint64_t amount, uint64_t flags) {
     uint64_t pageDirIndex, pageIndex;
 
@@ -665,6 +480,25 @@ void MapVirtualMemory4K(uint64_t phys, uint64_t virt, uint64_t amount, uint64_t
     }
 }
 
+void TLBShootdown(uint64_t virt, uint64_t amount, PageMap* pageMap) {
+    if (SMP::processorCount <= 1) {
+        return;
+    }
+
+    acquireLock(&shootdownLock);
+    shootdownPML4 = pageMap->pml4Phys;
+    shootdownBase = virt;
+    shootdownAmount = amount;
+    __atomic_store_n(&shootdownPending, SMP::processorCount - 1, __ATOMIC_RELEASE);
+
+    APIC::Local::SendIPI(0, ICR_DSH_OTHER, ICR_MESSAGE_TYPE_FIXED, IPI_TLB_SHOOTDOWN);
+    while (__atomic_load_n(&shootdownPending, __ATOMIC_ACQUIRE)) {
+        asm volatile("pause");
+    }
+
+    releaseLock(&shootdownLock);
+}
+
 uintptr_t GetIOMapping(uintptr_t addr) {
     if (addr > 0xffffffff) { // Typically most MMIO will not reside > 4GB, but check just in case
         Log::Error("MMIO >4GB current unsupported");
@@ -742,55 +576,49 @@ void PageFaultHandler(void*, RegisterContext* regs) {
             faultRegion->vmObject.get()) { // If there is a corresponding VMO for the fault then this is not an error
             FancyRefPtr<VMObject> vmo = faultRegion->vmObject;
             if (vmo->IsCopyOnWrite() && rw /* Attempted to write to read-only page */) {
+                VMObject* writable = vmo.get();
                 if (vmo->refCount <= 1) { // Last reference, no need to clone
                     vmo->copyOnWrite = false;
-                    vmo->MapAllocatedBlocks(
-                        faultRegion->Base(),
-                        addressSpace->GetPageMap()); // This should remap all allocated blocks as writable
-
-                    asm("sti");
-                    vmo->Hit(faultRegion->Base(), faultAddress - faultRegion->Base(),
-                             addressSpace->GetPageMap()); // In case the block was never allocated in the first place
-                    asm("cli");
-
-                    faultRegion->lock.ReleaseRead();
-                    if ((regs->cs & 0x3)) {
-                        releaseLock(&Scheduler::GetCurrentThread()->lock);
-                    }
-                    return;
                 } else {
                     asm("sti");
-                    VMObject* clone = vmo->Clone();
+                    writable = vmo->Clone();
 
                     vmo->refCount--;
-                    faultRegion->vmObject = clone;
-                    asm("cli");
+                    faultRegion->vmObject = writable;
+                }
 
-                    clone->MapAllocatedBlocks(faultRegion->Base(), addressSpace->GetPageMap());
-                    clone->Hit(faultRegion->Base(), faultAddress - faultRegion->Base(),
-                               addressSpace->GetPageMap()); // In case the block was never allocated in the first place
+                // Only the page table update needs interrupts disabled, Hit may allocate memory or block on I/O
+                asm("cli");
+                writable->MapAllocatedBlocks(faultRegion->Base(),
+                                             addressSpace->GetPageMap()); // Remap all allocated blocks as writable
+                asm("sti");
 
-                    faultRegion->lock.ReleaseRead();
+                int status = writable->Hit(faultRegion->Base(), faultAddress - faultRegion->Base(),
+                                           addressSpace->GetPageMap(), true); // In case the block was never allocated in the first place
+                faultRegion->lock.ReleaseRead();
 
+                if (!status) {
                     if ((regs->cs & 0x3)) {
                         releaseLock(&Scheduler::GetCurrentThread()->lock);
                     }
                     return;
                 }
-            }
 
-            asm("sti");
-            int status = faultRegion->vmObject->Hit(faultRegion->Base(), faultAddress - faultRegion->Base(),
-                                                    addressSpace->GetPageMap());
-            faultRegion->lock.ReleaseRead();
+                asm("cli"); // The object cannot be written to (e.g. a read-only ELF segment)
+            } else {
+                asm("sti");
+                int status = faultRegion->vmObject->Hit(faultRegion->Base(), faultAddress - faultRegion->Base(),
+                                                        addressSpace->GetPageMap(), rw);
+                faultRegion->lock.ReleaseRead();
 
-            if (!status) {
-                if ((regs->cs & 0x3)) {
-                    releaseLock(&Scheduler::GetCurrentThread()->lock);
+                if (!status) {
+                    if ((regs->cs & 0x3)) {
+                        releaseLock(&Scheduler::GetCurrentThread()->lock);
+                    }
+                    return; // Success!
                 }
-                return; // Success!
+                asm("cli");
             }
-            asm("cli");
         }
     }
 
@@ -808,6 +636,13 @@ void PageFaultHandler(void*, RegisterContext* regs) {
         return;
     }
 
+    // Kernel accessing user memory through copy_from_user and friends,
+    // continue at the fixup which will return -EFAULT
+    if (uintptr_t fixup = FindExceptionFixup(regs->rip); fixup) {
+        regs->rip = fixup;
+        return;
+    }
+
     asm("cli");
     dumpFaultInformation();
 
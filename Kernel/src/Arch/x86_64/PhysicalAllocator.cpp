@@ -15,7 +15,7 @@ uint64_t maxPhysicalBlocks = PHYSALLOC_BITMAP_SIZE_DWORDS * 32;
 
 uint64_t nextChunk = 1;
 
-lock_t allocatorLock = 0;
+TicketLock allocatorLock(LockClassPhysicalAllocator);
 
 // Initialize the physical page allocator
 void InitializePhysicalAllocator(memory_info_t* mem_info) {
@@ -102,7 +102,7 @@ void MarkMemoryRegionFree(uint64_t base, size_t size) {
 
 // Allocates a block of physical memory
 uint64_t AllocatePhysicalMemoryBlock() {
-    acquireLock(&allocatorLock);
+    allocatorLock.Acquire();
 
     uint64_t index = GetFirstFreeMemoryBlock();
     if (!index) {
@@ -116,7 +116,7 @@ uint64_t AllocatePhysicalMemoryBlock() {
     SetBit(index);
     usedPhysicalBlocks++;
 
-    releaseLock(&allocatorLock);
+    allocatorLock.Release();
 
     return index << PHYSALLOC_BLOCK_SHIFT;
 }
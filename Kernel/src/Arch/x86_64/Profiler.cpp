@@ -0,0 +1,239 @@
+#include <Profiler.h>
+
+#include <CPU.h>
+#include <Device.h>
+#include <Errno.h>
+#include <Lock.h>
+#include <Logging.h>
+#include <MM/AddressSpace.h>
+#include <Paging.h>
+#include <SMP.h>
+#include <Scheduler.h>
+#include <String.h>
+#include <Timer.h>
+#include <UserMemory.h>
+
+#define PROFILER_BUFFER_SAMPLES 1024 // Per CPU, must be a power of two
+
+// Written by its CPU in the timer interrupt, read by whoever holds the device lock
+struct ProfilerBuffer {
+    uint64_t head = 0; // Next sample to be written
+    uint64_t tail = 0; // Next sample to be read
+    uint64_t dropped = 0; // Samples lost because the reader fell behind
+    lemon_profiler_sample_t samples[PROFILER_BUFFER_SAMPLES];
+};
+
+namespace Profiler {
+bool running = false;
+static uint64_t intervalNs = 0;
+
+// Walk the page tables rather than touching the memory, we cannot take a page fault in the timer interrupt
+static bool IsUserAddressPresent(PageMap* pageMap, uintptr_t addr) {
+    if (!Memory::IsUsermodeRange(addr, sizeof(uint64_t))) {
+        return false;
+    }
+
+    uint64_t pdptIndex = PDPT_GET_INDEX(addr);
+    uint64_t pageDirIndex = PAGE_DIR_GET_INDEX(addr);
+
+    pd_entry_t dirEntry = pageMap->pageDirs[pdptIndex][pageDirIndex];
+    if (!(dirEntry & PAGE_PRESENT)) {
+        return false;
+    } else if (dirEntry & PDE_2M) {
+        return dirEntry & PAGE_USER;
+    }
+
+    page_t* pageTable = pageMap->pageTables[pdptIndex][pageDirIndex];
+    if (!pageTable) {
+        return false;
+    }
+
+    page_t entry = pageTable[PAGE_TABLE_GET_INDEX(addr)];
+    return (entry & PAGE_PRESENT) && (entry & PAGE_USER);
+}
+
+// Frames are a saved RBP followed by the return address
+static bool IsFrameReadable(uintptr_t rbp, PageMap* userPageMap) {
+    if (rbp & (sizeof(uint64_t) - 1)) {
+        return false;
+    }
+
+    uintptr_t last = rbp + sizeof(uint64_t); // May be on the next page
+    if (userPageMap) {
+        return IsUserAddressPresent(userPageMap, rbp) && IsUserAddressPresent(userPageMap, last);
+    }
+
+    return Memory::CheckKernelPointer(rbp, sizeof(uint64_t)) && Memory::CheckKernelPointer(last, sizeof(uint64_t));
+}
+
+// The current address space is the one being walked, so user pointers can be read directly once known to be present.
+// Any TLB shootdown for this address space waits on us as interrupts are disabled.
+static unsigned WalkStack(uintptr_t rbp, PageMap* userPageMap, uint64_t* frames, unsigned max) {
+    unsigned depth = 0;
+    while (depth < max && rbp && IsFrameReadable(rbp, userPageMap)) {
+        uint64_t* frame = reinterpret_cast<uint64_t*>(rbp);
+        frames[depth++] = frame[1];
+
+        // The stack grows down so the caller frame is always above, this stops us from looping on a bad stack
+        if (frame[0] <= rbp) {
+            break;
+        }
+
+        rbp = frame[0];
+    }
+
+    return depth;
+}
+
+static void Sample(CPU* cpu, RegisterContext* r, uint64_t now) {
+    Thread* thread = cpu->currentThread;
+    ProfilerBuffer* buffer = cpu->profilerBuffer;
+    if (!thread || !buffer) {
+        return;
+    }
+
+    uint64_t head = buffer->head;
+    if (head - __atomic_load_n(&buffer->tail, __ATOMIC_ACQUIRE) >= PROFILER_BUFFER_SAMPLES) {
+        __atomic_store_n(&buffer->dropped, buffer->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    lemon_profiler_sample_t& sample = buffer->samples[head & (PROFILER_BUFFER_SAMPLES - 1)];
+    sample.timestamp = now;
+    sample.pid = thread->parent->pid;
+    sample.tid = thread->tid;
+    sample.cpu = cpu->id;
+    sample.frames[0] = r->rip;
+
+    if (r->cs & 0x3) {
+        sample.flags = LEMON_PROFILER_SAMPLE_USER;
+        sample.depth = 1 + WalkStack(r->rbp, thread->parent->addressSpace->GetPageMap(), sample.frames + 1,
+                                     LEMON_PROFILER_MAX_DEPTH - 1);
+    } else {
+        sample.flags = 0;
+        sample.depth = 1 + WalkStack(r->rbp, nullptr, sample.frames + 1, LEMON_PROFILER_MAX_DEPTH - 1);
+    }
+
+    __atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void Tick(CPU* cpu, RegisterContext* r, uint64_t now) {
+    if (now >= cpu->profilerDeadline) {
+        Sample(cpu, r, now);
+        cpu->profilerDeadline = now + __atomic_load_n(&intervalNs, __ATOMIC_RELAXED);
+    }
+
+    Timer::ArmLocalTimer(cpu, cpu->profilerDeadline);
+}
+
+int Start(unsigned frequency) {
+    if (!frequency || frequency > LEMON_PROFILER_MAX_FREQUENCY) {
+        return -EINVAL;
+    }
+
+    // The buffers are never freed, a CPU may still be writing to its buffer after we stop
+    for (unsigned i = 0; i < SMP::processorCount; i++) {
+        CPU* cpu = SMP::cpus[i];
+        if (!cpu->profilerBuffer && !(cpu->profilerBuffer = new ProfilerBuffer)) {
+            return -ENOMEM;
+        }
+    }
+
+    __atomic_store_n(&intervalNs, 1000000000 / frequency, __ATOMIC_RELAXED);
+    __atomic_store_n(&running, true, __ATOMIC_RELEASE);
+
+    Log::Info("[Profiler] Sampling at %u Hz", static_cast<uint64_t>(frequency));
+    return 0;
+}
+
+void Stop() {
+    if (!IsRunning()) {
+        return;
+    }
+
+    __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+
+    uint64_t dropped = 0;
+    for (unsigned i = 0; i < SMP::processorCount; i++) {
+        if (ProfilerBuffer* buffer = SMP::cpus[i]->profilerBuffer) {
+            dropped += __atomic_exchange_n(&buffer->dropped, 0, __ATOMIC_RELAXED);
+        }
+    }
+
+    Log::Info("[Profiler] Stopped, %u samples dropped", dropped);
+}
+
+// Reads remove whole samples from the CPU buffers,
+// writing a frequency in Hz starts the profiler and writing 0 stops it
+class ProfilerDevice : public Device {
+public:
+    ProfilerDevice(const char* name) : Device(name, DeviceTypeUNIXPseudo) { flags = FS_NODE_FILE; }
+
+    ssize_t Read(size_t, size_t size, uint8_t* buffer) {
+        ScopedMutex acq(m_lock);
+
+        size_t count = size / sizeof(lemon_profiler_sample_t);
+        if (!count) {
+            return -EINVAL;
+        }
+
+        size_t read = 0;
+        for (unsigned i = 0; i < SMP::processorCount && read < count; i++) {
+            ProfilerBuffer* cpuBuffer = SMP::cpus[i]->profilerBuffer;
+            if (!cpuBuffer) {
+                continue;
+            }
+
+            uint64_t tail = cpuBuffer->tail;
+            uint64_t head = __atomic_load_n(&cpuBuffer->head, __ATOMIC_ACQUIRE);
+            for (; tail != head && read < count; tail++, read++) {
+                memcpy(buffer + read * sizeof(lemon_profiler_sample_t),
+                       &cpuBuffer->samples[tail & (PROFILER_BUFFER_SAMPLES - 1)], sizeof(lemon_profiler_sample_t));
+            }
+
+            // Hand the slots back to the CPU
+            __atomic_store_n(&cpuBuffer->tail, tail, __ATOMIC_RELEASE);
+        }
+
+        return read * sizeof(lemon_profiler_sample_t);
+    }
+
+    ssize_t Write(size_t, size_t size, uint8_t* buffer) {
+        ScopedMutex acq(m_lock);
+
+        char text[16];
+        size_t length = size < sizeof(text) ? size : sizeof(text) - 1;
+        memcpy(text, buffer, length);
+
+        unsigned frequency = 0;
+        for (size_t i = 0; i < length && text[i] != '\n'; i++) {
+            if (text[i] < '0' || text[i] > '9') {
+                return -EINVAL;
+            }
+
+            frequency = frequency * 10 + (text[i] - '0');
+            if (frequency > LEMON_PROFILER_MAX_FREQUENCY) {
+                return -EINVAL;
+            }
+        }
+
+        if (!frequency) {
+            Stop();
+            return size;
+        }
+
+        if (int e = Start(frequency); e) {
+            return e;
+        }
+
+        return size;
+    }
+
+private:
+    Mutex m_lock;
+};
+
+static ProfilerDevice* profilerDevice = nullptr;
+
+void Initialize() { profilerDevice = new ProfilerDevice("profile"); }
+} // namespace Profiler
@@ -4,23 +4,17 @@
 #include <APIC.h>
 #include <CPU.h>
 #include <Device.h>
+#include <FPU.h>
 #include <HAL.h>
 #include <IDT.h>
 #include <Logging.h>
 #include <Memory.h>
+#include <Scheduler.h>
 #include <TSS.h>
 #include <Timer.h>
 
 #include "smpdefines.inc"
 
-static inline void wait(uint64_t ms) {
-    uint64_t ticksPerMs = (Timer::GetFrequency() / 1000);
-    uint64_t timeMs = Timer::GetSystemUptime() * 1000 + (Timer::GetTicks() * ticksPerMs);
-
-    while ((Timer::GetSystemUptime() * 1000 + (Timer::GetTicks() * ticksPerMs)) - timeMs <= ms)
-        ;
-}
-
 extern void* _binary_SMPTrampoline_bin_start;
 extern void* _binary_SMPTrampoline_bin_size;
 
@@ -35,15 +29,27 @@ volatile bool doneInit = false;
 
 extern gdt_ptr_t GDT64Pointer64;
 
+extern "C" void syscall_entry();
+
 namespace SMP {
 CPU* cpus[256];
 unsigned processorCount = 1;
 tss_t tss1 __attribute__((aligned(16)));
 
+// Program the SYSCALL/SYSRET MSRs for the current CPU, int 0x69 remains available
+void InitializeSyscalls() {
+    WriteMSR(MSR_EFER, ReadMSR(MSR_EFER) | EFER_SCE);
+
+    // SYSCALL loads CS from bits 32-47 and SS from CS + 8,
+    // SYSRET loads SS from bits 48-63 + 8 and CS from bits 48-63 + 16
+    WriteMSR(MSR_STAR, (static_cast<uint64_t>(KERNEL_SS | 3) << 48) | (static_cast<uint64_t>(KERNEL_CS) << 32));
+    WriteMSR(MSR_LSTAR, reinterpret_cast<uintptr_t>(syscall_entry));
+    WriteMSR(MSR_FMASK, 0x44700); // Clear IF, TF, DF, NT and AC
+}
+
 void SMPEntry(uint16_t id) {
     CPU* cpu = cpus[id];
     cpu->currentThread = nullptr;
-    cpu->runQueueLock = 0;
     SetCPULocal(cpu);
 
     cpu->gdt = Memory::KernelAllocate4KPages(
@@ -57,8 +63,11 @@ void SMPEntry(uint16_t id) {
     idt_flush();
 
     TSS::InitializeTSS(&cpu->tss, cpu->gdt);
+    InitializeSyscalls();
+    FPU::InitializeCPU();
 
     APIC::Local::Enable();
+    Timer::InitializeLocalTimer();
 
     cpu->runQueue = new FastList<Thread*>();
 
@@ -77,7 +86,6 @@ void PrepareTrampoline() {
 void InitializeCPU(uint16_t id) {
     CPU* cpu = new CPU;
     cpu->id = id;
-    cpu->runQueueLock = 0;
     cpus[id] = cpu;
 
     *smpMagic = 0;                                          // Set magic to 0
@@ -92,16 +100,16 @@ void InitializeCPU(uint16_t id) {
 
     APIC::Local::SendIPI(id, ICR_DSH_DEST, ICR_MESSAGE_TYPE_INIT, 0);
 
-    wait(20);
+    Timer::Wait(20);
 
     if ((*smpMagic) != 0xB33F) { // Check if the trampoline code set the flag to let us know it has started
         APIC::Local::SendIPI(id, ICR_DSH_DEST, ICR_MESSAGE_TYPE_STARTUP, (SMP_TRAMPOLINE_ENTRY >> 12));
 
-        wait(80);
+        Timer::Wait(80);
     }
 
     if ((*smpMagic) != 0xB33F) {
-        wait(100);
+        Timer::Wait(100);
     }
 
     if ((*smpMagic) != 0xB33F) {
@@ -121,12 +129,15 @@ void Initialize() {
     cpus[0]->gdt = (void*)GDT64Pointer64.base;
     cpus[0]->gdtPtr = GDT64Pointer64;
     cpus[0]->currentThread = nullptr;
-    cpus[0]->runQueueLock = 0;
     cpus[0]->runQueue = new FastList<Thread*>();
     SetCPULocal(cpus[0]);
 
+    FPU::Initialize(); // Before the other processors are started
+
     if (HAL::disableSMP) {
         TSS::InitializeTSS(&cpus[0]->tss, cpus[0]->gdt);
+        InitializeSyscalls();
+
         ACPI::processorCount = 1;
         processorCount = 1;
         return;
@@ -142,6 +153,7 @@ void Initialize() {
     }
 
     TSS::InitializeTSS(&cpus[0]->tss, cpus[0]->gdt);
+    InitializeSyscalls();
 
     Log::Info("[SMP] %u processors initialized!", processorCount);
 }
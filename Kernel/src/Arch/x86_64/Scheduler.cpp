@@ -4,6 +4,7 @@
 #include <APIC.h>
 #include <Debug.h>
 #include <ELF.h>
+#include <FPU.h>
 #include <Fs/Initrd.h>
 #include <IDT.h>
 #include <Liballoc.h>
@@ -19,6 +20,7 @@
 #include <System.h>
 #include <TSS.h>
 #include <Timer.h>
+#include <VDSO.h>
 
 extern "C" [[noreturn]] void TaskSwitch(RegisterContext* r, uint64_t pml4);
 
@@ -60,13 +62,34 @@ void InsertNewThreadIntoQueue(Thread* thread) {
     }
 
     asm("sti");
-    acquireLock(&cpu->runQueueLock);
+    cpu->runQueueLock.Acquire();
     asm("cli");
+    thread->cpu = cpu;
     cpu->runQueue->add_back(thread);
-    releaseLock(&cpu->runQueueLock);
+    cpu->runQueueLock.Release();
+
+    // Idle CPUs do not receive ticks, so let it know there is a thread to run
+    if (schedulerReady && cpu->IsIdle()) {
+        WakeCPU(cpu);
+    }
     asm("sti");
 }
 
+void WakeCPU(CPU* cpu) {
+    int intEnable = CheckInterrupts();
+    asm("cli"); // Make sure we are not interrupted between writing the two ICR registers
+
+    if (cpu == GetCPULocal()) {
+        APIC::Local::SendIPI(0, ICR_DSH_SELF, ICR_MESSAGE_TYPE_FIXED, IPI_SCHEDULE);
+    } else {
+        APIC::Local::SendIPI(cpu->id, ICR_DSH_DEST, ICR_MESSAGE_TYPE_FIXED, IPI_SCHEDULE);
+    }
+
+    if (intEnable) {
+        asm("sti");
+    }
+}
+
 void Initialize() {
     processes = new List<process_t*>();
     destroyedProcesses = new List<process_t*>();
@@ -83,7 +106,6 @@ void Initialize() {
 
     for (unsigned i = 0; i < SMP::processorCount; i++) {
         SMP::cpus[i]->runQueue->clear();
-        releaseLock(&SMP::cpus[i]->runQueueLock);
     }
 
     IDT::RegisterInterruptHandler(IPI_SCHEDULE, Schedule);
@@ -93,6 +115,9 @@ void Initialize() {
 
     cpu->currentThread = nullptr;
     schedulerReady = true;
+
+    // There is no periodic tick, so get every CPU to pick up its first thread
+    APIC::Local::SendIPI(0, ICR_DSH_ALL, ICR_MESSAGE_TYPE_FIXED, IPI_SCHEDULE);
     asm("sti");
     for (;;)
         ;
@@ -114,42 +139,21 @@ ProcessStateThreadBlocker::~ProcessStateThreadBlocker() {
     releaseLock(&lock);
 }
 
-Handle& RegisterHandle(process_t* proc, FancyRefPtr<KernelObject> ko) {
-    Handle h;
-    h.ko = ko;
-
-    acquireLock(&proc->handleLock); // Prevent handle ID race conditions
-
-    h.id = proc->handles.get_length() + 1; // Handle IDs start at 1
-    Handle& ref = proc->handles.add_back(h);
-
-    releaseLock(&proc->handleLock);
-
-    return ref;
-}
+handle_id_t RegisterHandle(process_t* proc, FancyRefPtr<KernelObject> ko) { return proc->handles.Register(ko); }
 
 long FindHandle(process_t* proc, handle_id_t id, Handle** handle) {
-    if (id < 1 || id - 1 > static_cast<handle_id_t>(proc->handles.get_length())) {
+    *handle = proc->handles.Find(id);
+    if (!(*handle)) {
         return 1;
     }
 
-    *handle = &proc->handles[id - 1]; // Handle IDs start at 1
-
     if (!(*handle)->ko.get())
         return 2;
 
     return 0;
 }
 
-long DestroyHandle(process_t* proc, handle_id_t id) {
-    if (id < 1 || id - 1 > static_cast<handle_id_t>(proc->handles.get_length())) {
-        return 1;
-    }
-
-    proc->handles[id - 1] = {0, FancyRefPtr<KernelObject>(nullptr)}; // Handle IDs start at 1
-
-    return 0;
-}
+long DestroyHandle(process_t* proc, handle_id_t id) { return proc->handles.Destroy(id); }
 
 process_t* FindProcessByPID(pid_t pid) {
     for (process_t* proc : *processes) {
@@ -179,8 +183,6 @@ process_t* InitializeProcessStructure() {
     // Create process structure
     process_t* proc = new process_t;
 
-    proc->fileDescriptorsLock = 0;
-    proc->fileDescriptors.clear();
     proc->children.clear();
     proc->blocking.clear();
     proc->threads.clear();
@@ -226,9 +228,7 @@ process_t* InitializeProcessStructure() {
     registers->cs = KERNEL_CS; // Kernel CS
     registers->ss = KERNEL_SS; // Kernel SS
 
-    thread->fxState = Memory::KernelAllocate4KPages(1); // Allocate Memory for the FPU/Extended Register State
-    Memory::KernelMapVirtualMemory4K(Memory::AllocatePhysicalMemoryBlock(), (uintptr_t)thread->fxState, 1);
-    memset(thread->fxState, 0, 4096);
+    thread->fxState = FPU::AllocateState(); // Allocate Memory for the FPU/Extended Register State
 
     void* kernelStack = Memory::KernelAllocate4KPages(32); // Allocate Memory For Kernel Stack (128KB)
     for (int i = 0; i < 32; i++) {
@@ -238,10 +238,6 @@ process_t* InitializeProcessStructure() {
     memset(kernelStack, 0, PAGE_SIZE_4K * 32);
     thread->kernelStack = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(kernelStack) + PAGE_SIZE_4K * 32);
 
-    ((fx_state_t*)thread->fxState)->mxcsr = 0x1f80; // Default MXCSR (SSE Control Word) State
-    ((fx_state_t*)thread->fxState)->mxcsrMask = 0xffbf;
-    ((fx_state_t*)thread->fxState)->fcw = 0x33f; // Default FPU Control Word State
-
     strcpy(proc->workingDir, "/"); // set root as default working dir
     strcpy(proc->name, "unknown");
 
@@ -264,6 +260,7 @@ process_t* CreateProcess(void* entry) {
     proc->addressSpace = new AddressSpace(Memory::CreatePageMap());
 
     Thread* thread = proc->threads.get_front();
+    thread->fpuDisabled = true; // The kernel is built without SSE
 
     void* stack = (void*)Memory::KernelAllocate4KPages(32);
     for (int i = 0; i < 32; i++) {
@@ -314,9 +311,7 @@ pid_t CreateChildThread(process_t* process, uintptr_t entry, uintptr_t stack, ui
     thread.state = ThreadStateRunning;
     thread.stack = thread.stackLimit = reinterpret_cast<void*>(stack);
 
-    thread.fxState = Memory::KernelAllocate4KPages(1); // Allocate Memory for the FPU/Extended Register State
-    Memory::KernelMapVirtualMemory4K(Memory::AllocatePhysicalMemoryBlock(), (uintptr_t)thread.fxState, 1);
-    memset(thread.fxState, 0, 1024);
+    thread.fxState = FPU::AllocateState(); // Allocate Memory for the FPU/Extended Register State
 
     void* kernelStack = Memory::KernelAllocate4KPages(32); // Allocate Memory For Kernel Stack (128KB)
     for (int i = 0; i < 32; i++) {
@@ -334,10 +329,6 @@ pid_t CreateChildThread(process_t* process, uintptr_t entry, uintptr_t stack, ui
     thread.timeSlice = thread.timeSliceDefault;
     thread.priority = 4;
 
-    ((fx_state_t*)thread.fxState)->mxcsr = 0x1f80; // Default MXCSR (SSE Control Word) State
-    ((fx_state_t*)thread.fxState)->mxcsrMask = 0xffbf;
-    ((fx_state_t*)thread.fxState)->fcw = 0x33f; // Default FPU Control Word State
-
     InsertNewThreadIntoQueue(&thread);
 
     return threadID;
@@ -406,7 +397,7 @@ void EndProcess(process_t* process) {
 
     IF_DEBUG(debugLevelScheduler >= DebugLevelVerbose, { Log::Info("removing threads from run queue..."); });
 
-    acquireLock(&cpu->runQueueLock);
+    cpu->runQueueLock.Acquire();
     asm("cli");
 
     for (unsigned j = 0; j < cpu->runQueue->get_length(); j++) {
@@ -415,7 +406,7 @@ void EndProcess(process_t* process) {
         }
     }
 
-    releaseLock(&cpu->runQueueLock);
+    cpu->runQueueLock.Release();
     asm("sti");
 
     for (unsigned i = 0; i < SMP::processorCount; i++) {
@@ -424,7 +415,7 @@ void EndProcess(process_t* process) {
 
         CPU* other = SMP::cpus[i];
         asm("sti");
-        acquireLock(&other->runQueueLock);
+        other->runQueueLock.Acquire();
         asm("cli");
 
         while (other->currentThread && other->currentThread->parent == process)
@@ -442,38 +433,27 @@ void EndProcess(process_t* process) {
             }
         }
 
-        releaseLock(&other->runQueueLock);
+        other->runQueueLock.Release();
         asm("sti");
 
         if (other->currentThread == nullptr) {
-            APIC::Local::SendIPI(i, ICR_DSH_SELF, ICR_MESSAGE_TYPE_FIXED, IPI_SCHEDULE);
+            WakeCPU(other);
         }
     }
     asm("sti");
 
     IF_DEBUG(debugLevelScheduler >= DebugLevelVerbose, { Log::Info("closing fds..."); });
 
-    for (fs_fd_t* fd : process->fileDescriptors) {
-        if (fd && fd->node) {
-            fd->node->Close();
-            fd->node = nullptr;
-
-            delete fd;
-        } else if (fd) {
-            delete fd;
-        }
-    }
-    process->fileDescriptors.clear();
+    process->fileDescriptors.Clear();
 
     IF_DEBUG(debugLevelScheduler >= DebugLevelVerbose, { Log::Info("closing handles..."); });
 
-    for (auto& h : process->handles) {
-        if (h.id && h.ko.get()) {
+    process->handles.ForEach([](Handle& h) {
+        if (h.ko.get()) {
             h.ko->Destroy();
         }
-    }
-
-    process->handles.clear();
+    });
+    process->handles.Clear();
 
     IF_DEBUG(debugLevelScheduler >= DebugLevelVerbose, { Log::Info("removing process..."); });
 
@@ -526,8 +506,6 @@ void Tick(RegisterContext* r) {
     if (!schedulerReady)
         return;
 
-    APIC::Local::SendIPI(0, ICR_DSH_OTHER, ICR_MESSAGE_TYPE_FIXED, IPI_SCHEDULE);
-
     Schedule(nullptr, r);
 }
 
@@ -535,27 +513,40 @@ void Schedule(__attribute__((unused)) void* data, RegisterContext* r) {
     CPU* cpu = GetCPULocal();
 
     if (cpu->currentThread) {
+        // The local timer also fires for timer events and profiler samples,
+        // only take from the time slice once a whole tick has passed
+        if (cpu->currentThread->timeSlice > 0 && !cpu->IsIdle() &&
+            Timer::GetSystemUptimeNs() < cpu->sliceDeadline) {
+            Timer::ArmLocalTimer(cpu, cpu->sliceDeadline);
+            return;
+        }
+
         cpu->currentThread->parent->activeTicks++;
         if (cpu->currentThread->timeSlice > 0) {
             cpu->currentThread->timeSlice--;
+
+            Timer::ArmTimeSlice(cpu);
             return;
         }
     }
 
-    while (__builtin_expect(acquireTestLock(&cpu->runQueueLock), 0)) {
+    while (__builtin_expect(!cpu->runQueueLock.TryAcquire(), 0)) {
+        Timer::ArmTimeSlice(cpu);
         return;
     }
 
-    if (__builtin_expect(cpu->runQueue->get_length() <= 0 || !cpu->currentThread, 0)) {
+    if (__builtin_expect(cpu->runQueue->get_length() <= 0, 0)) {
         cpu->currentThread = cpu->idleProcess->threads[0];
     } else {
-        if (__builtin_expect(cpu->currentThread->state == ThreadStateDying, 0)) {
+        if (__builtin_expect(!cpu->currentThread, 0)) {
+            cpu->currentThread = cpu->runQueue->front;
+        } else if (__builtin_expect(cpu->currentThread->state == ThreadStateDying, 0)) {
             cpu->runQueue->remove(cpu->currentThread);
             cpu->currentThread = cpu->idleProcess->threads[0];
         } else if (__builtin_expect(cpu->currentThread->parent != cpu->idleProcess, 1)) {
             cpu->currentThread->timeSlice = cpu->currentThread->timeSliceDefault;
 
-            asm volatile("fxsave64 (%0)" ::"r"((uintptr_t)cpu->currentThread->fxState) : "memory");
+            FPU::SwitchOut(cpu, cpu->currentThread);
 
             cpu->currentThread->registers = *r;
 
@@ -577,14 +568,34 @@ void Schedule(__attribute__((unused)) void* data, RegisterContext* r) {
         }
     }
 
-    releaseLock(&cpu->runQueueLock);
+    if (cpu->currentThread == cpu->idleProcess->threads[0] && cpu->runQueue->get_length()) {
+        // Without a tick nothing would wake us for a thread unblocked after it was checked.
+        // Thread::Unblock sets the state then checks for an idle CPU, so check the states again
+        // now that currentThread is set.
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
 
-    asm volatile("fxrstor64 (%0)" ::"r"((uintptr_t)cpu->currentThread->fxState) : "memory");
+        Thread* thread = cpu->runQueue->front;
+        do {
+            if (thread->state != ThreadStateBlocked) {
+                cpu->currentThread = thread;
+                break;
+            }
+
+            thread = thread->next;
+        } while (thread != cpu->runQueue->front);
+    }
+
+    cpu->runQueueLock.Release();
+
+    Timer::ArmTimeSlice(cpu);
+
+    FPU::SwitchIn(cpu, cpu->currentThread);
 
     asm volatile("wrmsr" ::"a"(cpu->currentThread->fsBase & 0xFFFFFFFF) /*Value low*/,
                  "d"((cpu->currentThread->fsBase >> 32) & 0xFFFFFFFF) /*Value high*/, "c"(0xC0000100) /*Set FS Base*/);
 
     TSS::SetKernelStack(&cpu->tss, (uintptr_t)cpu->currentThread->kernelStack);
+    cpu->kernelStack = (uintptr_t)cpu->currentThread->kernelStack; // Loaded on SYSCALL
 
     // Check for a few things
     // - Process is in usermode
@@ -604,8 +615,10 @@ void Schedule(__attribute__((unused)) void* data, RegisterContext* r) {
     TaskSwitch(&cpu->currentThread->registers, cpu->currentThread->parent->GetPageMap()->pml4Phys);
 }
 
-process_t* CreateELFProcess(void* elf, int argc, char** argv, int envc, char** envp, const char* execPath) {
-    if (!VerifyELF(elf)) {
+process_t* CreateELFProcess(FsNode* node, int argc, char** argv, int envc, char** envp, const char* execPath) {
+    elf64_header_t header;
+    if (fs::Read(node, 0, sizeof(elf64_header_t), reinterpret_cast<uint8_t*>(&header)) != sizeof(elf64_header_t) ||
+        !VerifyELF(&header)) {
         return nullptr;
     }
 
@@ -620,7 +633,7 @@ process_t* CreateELFProcess(void* elf, int argc, char** argv, int envc, char** e
     thread->timeSlice = thread->timeSliceDefault;
     thread->priority = 4;
 
-    elf_info_t elfInfo = LoadELFSegments(proc, elf, 0);
+    elf_info_t elfInfo = LoadELFSegments(proc, node, 0);
 
     MappedRegion* stackRegion = proc->addressSpace->AllocateAnonymousVMObject(0x400000, 0, false); // 4MB max stacksize
 
@@ -629,9 +642,9 @@ process_t* CreateELFProcess(void* elf, int argc, char** argv, int envc, char** e
     thread->registers.rbp = (uintptr_t)thread->stack + 0x400000;
 
     // Force the first 12KB to be allocated
-    stackRegion->vmObject->Hit(stackRegion->base, 0x400000 - 0x1000, proc->GetPageMap());
-    stackRegion->vmObject->Hit(stackRegion->base, 0x400000 - 0x2000, proc->GetPageMap());
-    stackRegion->vmObject->Hit(stackRegion->base, 0x400000 - 0x3000, proc->GetPageMap());
+    stackRegion->vmObject->Hit(stackRegion->base, 0x400000 - 0x1000, proc->GetPageMap(), true);
+    stackRegion->vmObject->Hit(stackRegion->base, 0x400000 - 0x2000, proc->GetPageMap(), true);
+    stackRegion->vmObject->Hit(stackRegion->base, 0x400000 - 0x3000, proc->GetPageMap(), true);
 
     thread->registers.rbp = thread->registers.rsp;
 
@@ -650,20 +663,15 @@ process_t* CreateELFProcess(void* elf, int argc, char** argv, int envc, char** e
     FsNode* logDev = fs::ResolvePath("/dev/kernellog");
 
     if (nullDev) {
-        proc->fileDescriptors.add_back(fs::Open(nullDev));
+        proc->ReplaceFileDescriptor(0, fs::Open(nullDev));
     } else {
-        proc->fileDescriptors.add_back(nullptr);
-
         Log::Warning("Failed to find /dev/null");
     }
 
     if (logDev) {
-        proc->fileDescriptors.add_back(fs::Open(logDev));
-        proc->fileDescriptors.add_back(fs::Open(logDev));
+        proc->ReplaceFileDescriptor(1, fs::Open(logDev));
+        proc->ReplaceFileDescriptor(2, fs::Open(logDev));
     } else {
-        proc->fileDescriptors.add_back(nullptr);
-        proc->fileDescriptors.add_back(nullptr);
-
         Log::Warning("Failed to find /dev/kernellog");
     }
 
@@ -700,22 +708,17 @@ uintptr_t LoadELF(Process* process, uintptr_t* stackPointer, elf_info_t elfInfo,
             KernelPanic("Failed to load dynamic linker!");
         }
 
-        void* linkerElf = kmalloc(node->size);
-
-        fs::Read(node, 0, node->size, (uint8_t*)linkerElf); // Load Dynamic Linker
-
-        if (!VerifyELF(linkerElf)) {
+        elf_info_t linkerELFInfo = LoadELFSegments(process, node, linkerBaseAddress); // Load Dynamic Linker
+        if (!linkerELFInfo.entry) {
             Log::Warning("Invalid Dynamic Linker ELF");
             return 0;
         }
 
-        elf_info_t linkerELFInfo = LoadELFSegments(process, linkerElf, linkerBaseAddress);
-
         rip = linkerELFInfo.entry;
-
-        kfree(linkerElf);
     }
 
+    process->vdso = VDSO::Map(process);
+
     char* tempArgv[argc];
     char* tempEnvp[envc];
 
@@ -769,6 +772,9 @@ uintptr_t LoadELF(Process* process, uintptr_t* stackPointer, elf_info_t elfInfo,
     stack -= sizeof(auxv_t) / sizeof(*stack);
     *((auxv_t*)stack) = {.a_type = AT_ENTRY, .a_val = elfInfo.entry}; // AT_ENTRY
 
+    stack -= sizeof(auxv_t) / sizeof(*stack);
+    *((auxv_t*)stack) = {.a_type = AT_LEMON_VDSO, .a_val = process->vdso->Base() + LEMON_VDSO_CODE_OFFSET}; // AT_LEMON_VDSO
+
     if (execPath && execPathValue) {
         stack -= sizeof(auxv_t) / sizeof(*stack);
         *((auxv_t*)stack) = {.a_type = AT_EXECPATH, .a_val = (uint64_t)execPathValue}; // AT_EXECPATH
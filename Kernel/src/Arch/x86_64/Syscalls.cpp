@@ -4,6 +4,7 @@
 #include <Debug.h>
 #include <Device.h>
 #include <Errno.h>
+#include <FPU.h>
 #include <Framebuffer.h>
 #include <Fs/Pipe.h>
 #include <HAL.h>
@@ -24,6 +25,8 @@
 #include <Signal.h>
 #include <StackTrace.h>
 #include <Timer.h>
+#include <UserMemory.h>
+#include <VDSO.h>
 #include <Video/Video.h>
 
 #include <ABI/Process.h>
@@ -39,7 +42,7 @@
 #define SC_ARG4(r) ((r)->r9)
 #define SC_ARG5(r) ((r)->r8)
 
-#define NUM_SYSCALLS 106
+#define NUM_SYSCALLS 111
 
 #define EXEC_CHILD 1
 
@@ -50,8 +53,55 @@
 #define WNOWAIT 16
 #define WSTOPPED 32
 
+// Same values as Linux, only SPLICE_F_NONBLOCK changes anything
+#define SPLICE_F_MOVE 1
+#define SPLICE_F_NONBLOCK 2
+#define SPLICE_F_MORE 4
+#define SPLICE_F_GIFT 8
+
+#define ARG_MAX 0x20000 // Maximum length of an argument or environment string
+
 typedef long (*syscall_t)(RegisterContext*);
 
+// Copy a string from user memory into a new buffer allocated with kmalloc
+static long CopyUserString(const char* str, char** kernelString) {
+    long len = strnlen_user(str, ARG_MAX);
+    if (len < 0) {
+        return len;
+    }
+
+    char* buffer = (char*)kmalloc(len + 1);
+    if (long e = copy_from_user(buffer, str, len); e) {
+        kfree(buffer);
+        return e;
+    }
+
+    buffer[len] = 0; // The string may have changed since we got the length
+    *kernelString = buffer;
+    return 0;
+}
+
+// Copy a null terminated array of user strings, returns the amount of strings or a negative error code
+static long CopyUserStringArray(char* const* array, Vector<char*>& kernelArray) {
+    for (;;) {
+        char* str;
+        if (get_user(&str, array + kernelArray.size())) {
+            return -EFAULT;
+        }
+
+        if (!str) {
+            return kernelArray.size(); // End of array
+        }
+
+        char* kernelString;
+        if (long e = CopyUserString(str, &kernelString); e) {
+            return e;
+        }
+
+        kernelArray.add_back(kernelString);
+    }
+}
+
 long SysExit(RegisterContext* r) {
     int64_t code = SC_ARG0(r);
 
@@ -70,17 +120,12 @@ long SysExit(RegisterContext* r) {
 long SysExec(RegisterContext* r) {
     Process* currentProcess = Scheduler::GetCurrentProcess();
 
-    size_t filePathLength;
-    long filePathInvalid =
-        strlenSafe(reinterpret_cast<char*>(SC_ARG0(r)), filePathLength, currentProcess->addressSpace);
-    if (filePathInvalid) {
-        Log::Warning("SysExec: Reached unallocated memory reading file path");
-        return -EFAULT;
+    char filepath[PATH_MAX];
+    if (long e = strncpy_from_user(filepath, reinterpret_cast<const char*>(SC_ARG0(r)), PATH_MAX); e < 0) {
+        Log::Warning("SysExec: Invalid file path");
+        return e;
     }
 
-    char filepath[filePathLength + 1];
-
-    strncpy(filepath, (char*)SC_ARG0(r), filePathLength);
     int argc = SC_ARG1(r);
     char** argv = (char**)SC_ARG2(r);
     uint64_t flags = SC_ARG3(r);
@@ -91,69 +136,54 @@ long SysExec(RegisterContext* r) {
         return -ENOENT;
     }
 
-    int envCount = 0;
-    if (envp) {
-        int i = 0;
-        while (envp[i])
-            i++;
-        envCount = i;
-    }
-
-    char* kernelEnvp[envCount];
-    if (envCount > 0) {
-        for (int i = 0; i < envCount; i++) {
-            size_t len;
-            if (strlenSafe(envp[i], len, currentProcess->addressSpace)) {
-                Log::Warning("SysExec: Reached unallocated memory reading environment");
-                return -EFAULT;
-            }
-            kernelEnvp[i] = (char*)kmalloc(len + 1);
-            strcpy(kernelEnvp[i], envp[i]);
-            kernelEnvp[i][len] = 0;
+    Vector<char*> kernelEnv;
+    if (envp && CopyUserStringArray(envp, kernelEnv) < 0) {
+        Log::Warning("SysExec: Invalid environment");
+        for (char* env : kernelEnv) {
+            kfree(env);
         }
+
+        return -EFAULT;
     }
 
-    Log::Info("Loading: %s", (char*)SC_ARG0(r));
+    int envCount = kernelEnv.size();
+    char** kernelEnvp = kernelEnv.Data();
+
+    Log::Info("Loading: %s", filepath);
 
     char* kernelArgv[argc];
     for (int i = 0; i < argc; i++) {
-        if (!argv[i]) { // Some programs may attempt to terminate argv with a null pointer
-            argc = i;
-            break;
-        }
+        char* arg;
+        if (get_user(&arg, argv + i) || (arg && CopyUserString(arg, &kernelArgv[i]))) {
+            Log::Warning("SysExec: Invalid argv");
+            for (int j = 0; j < i; j++) {
+                kfree(kernelArgv[j]);
+            }
+
+            for (char* env : kernelEnv) {
+                kfree(env);
+            }
 
-        size_t len;
-        if (strlenSafe(argv[i], len, currentProcess->addressSpace)) {
-            Log::Warning("SysExec: Reached unallocated memory reading argv");
             return -EFAULT;
         }
 
-        kernelArgv[i] = (char*)kmalloc(len + 1);
-        strncpy(kernelArgv[i], argv[i], len);
-    }
-
-    timeval tv = Timer::GetSystemUptimeStruct();
-    uint8_t* buffer = (uint8_t*)kmalloc(node->size);
-    size_t read = fs::Read(node, 0, node->size, buffer);
-    if (!read) {
-        Log::Warning("Could not read file: %s", filepath);
-        return 0;
+        if (!arg) { // Some programs may attempt to terminate argv with a null pointer
+            argc = i;
+            break;
+        }
     }
-    timeval tvnew = Timer::GetSystemUptimeStruct();
-    Log::Info("Done (took %d us)", Timer::TimeDifference(tvnew, tv));
 
-    Process* proc = Scheduler::CreateELFProcess((void*)buffer, argc, kernelArgv, envCount, kernelEnvp, filepath);
-    kfree(buffer);
+    Process* proc = Scheduler::CreateELFProcess(node, argc, kernelArgv, envCount, kernelEnvp, filepath);
 
     for (int i = 0; i < envCount; i++) {
         kfree(kernelEnvp[i]);
     }
 
-    for (int i = 0; i < argc; i++) {
-        kfree(kernelArgv[i]);
-    }
-
     if (!proc) {
+        for (int i = 0; i < argc; i++) {
+            kfree(kernelArgv[i]);
+        }
+
         Log::Warning("SysExec: Proc is null!");
         return -EIO; // Failed to create process
     }
@@ -181,6 +211,10 @@ long SysExec(RegisterContext* r) {
 
     kfree(name);
 
+    for (int i = 0; i < argc; i++) {
+        kfree(kernelArgv[i]);
+    }
+
     Scheduler::StartProcess(proc);
 
     return proc->pid;
@@ -198,12 +232,11 @@ long SysRead(RegisterContext* r) {
     uint8_t* buffer = (uint8_t*)SC_ARG1(r);
     uint64_t count = SC_ARG2(r);
 
-    if (!Memory::CheckUsermodePointer(SC_ARG1(r), count, proc->addressSpace)) {
-        Log::Warning("SysRead: Invalid Memory Buffer: %x", SC_ARG1(r));
-        return -EFAULT;
+    ssize_t ret = fs::ReadUser(handle->node, handle->pos, count, buffer);
+    if (ret > 0) {
+        handle->pos += ret;
     }
 
-    ssize_t ret = fs::Read(handle, count, buffer);
     return ret;
 }
 
@@ -219,12 +252,11 @@ long SysWrite(RegisterContext* r) {
     uint8_t* buffer = (uint8_t*)SC_ARG1(r);
     uint64_t count = SC_ARG2(r);
 
-    if (!Memory::CheckUsermodePointer(SC_ARG1(r), count, proc->addressSpace)) {
-        Log::Warning("SysWrite: Invalid Memory Buffer: %x", SC_ARG1(r));
-        return -EFAULT;
+    ssize_t ret = fs::WriteUser(handle->node, handle->pos, count, buffer);
+    if (ret > 0) {
+        handle->pos += ret;
     }
 
-    ssize_t ret = fs::Write(handle, SC_ARG2(r), buffer);
     return ret;
 }
 
@@ -237,8 +269,11 @@ long SysWrite(RegisterContext* r) {
  * On failure: return -1
  */
 long SysOpen(RegisterContext* r) {
-    char* filepath = (char*)kmalloc(strlen((char*)SC_ARG0(r)) + 1);
-    strcpy(filepath, (char*)SC_ARG0(r));
+    char filepath[PATH_MAX];
+    if (long e = strncpy_from_user(filepath, reinterpret_cast<const char*>(SC_ARG0(r)), PATH_MAX); e < 0) {
+        return e;
+    }
+
     FsNode* root = fs::GetRoot();
 
     uint64_t flags = SC_ARG1(r);
@@ -323,15 +358,19 @@ long SysCreate(RegisterContext* r) {
 }
 
 long SysLink(RegisterContext* r) {
-    const char* oldpath = (const char*)SC_ARG0(r);
-    const char* newpath = (const char*)SC_ARG1(r);
+    char oldpath[PATH_MAX];
+    char newpath[PATH_MAX];
 
     Process* proc = Scheduler::GetCurrentProcess();
 
-    if (!(Memory::CheckUsermodePointer(SC_ARG0(r), 1, proc->addressSpace) &&
-          Memory::CheckUsermodePointer(SC_ARG1(r), 1, proc->addressSpace))) {
+    if (long e = strncpy_from_user(oldpath, reinterpret_cast<const char*>(SC_ARG0(r)), PATH_MAX); e < 0) {
         Log::Warning("SysLink: Invalid path pointer");
-        return -EFAULT;
+        return e;
+    }
+
+    if (long e = strncpy_from_user(newpath, reinterpret_cast<const char*>(SC_ARG1(r)), PATH_MAX); e < 0) {
+        Log::Warning("SysLink: Invalid path pointer");
+        return e;
     }
 
     FsNode* file = fs::ResolvePath(oldpath);
@@ -361,13 +400,13 @@ long SysLink(RegisterContext* r) {
 }
 
 long SysUnlink(RegisterContext* r) {
-    const char* path = (const char*)SC_ARG0(r);
+    char path[PATH_MAX];
 
     Process* proc = Scheduler::GetCurrentProcess();
 
-    if (!Memory::CheckUsermodePointer(SC_ARG0(r), 1, proc->addressSpace)) {
+    if (long e = strncpy_from_user(path, reinterpret_cast<const char*>(SC_ARG0(r)), PATH_MAX); e < 0) {
         Log::Warning("sys_unlink: Invalid path pointer");
-        return -EFAULT;
+        return e;
     }
 
     FsNode* parentDirectory = fs::ResolveParent(path, proc->workingDir);
@@ -395,16 +434,13 @@ long SysExecve(RegisterContext* r) {
     char** argv = (char**)SC_ARG1(r);
     char** envp = (char**)SC_ARG2(r);
 
-    size_t pathLength = 0;
-    if (strlenSafe(path, pathLength, proc->addressSpace)) {
+    char* kernelPath = new char[PATH_MAX];
+    if (long e = strncpy_from_user(kernelPath, path, PATH_MAX); e < 0) {
         Log::Debug(debugLevelSyscalls, DebugLevelNormal, "SysExecve: Invalid path pointer");
-        return -EFAULT;
+        delete[] kernelPath;
+        return e;
     }
 
-    char* kernelPath = new char[pathLength + 1];
-    strncpy(kernelPath, path, pathLength);
-    kernelPath[pathLength] = 0;
-
     FsNode* node = fs::ResolvePath(kernelPath, proc->workingDir, true /* Follow Symlinks */);
     if (!node) {
         Log::Debug(debugLevelSyscalls, DebugLevelNormal, "SysExecve: Invalid path '%s'!", kernelPath);
@@ -416,100 +452,59 @@ long SysExecve(RegisterContext* r) {
         return -EACCES;
     }
 
-    int argc = 0;
     Vector<char*> kernelArgv;
-
-    for (;;) {
-        if (!argv[argc]) {
-            break; // End of args
-        }
-
-        if (!Memory::CheckUsermodePointer(reinterpret_cast<uintptr_t>(argv + argc), sizeof(char*),
-                                          proc->addressSpace)) {
-            Log::Debug(debugLevelSyscalls, DebugLevelNormal, "SysExecve: Invalid argument pointer");
-            return -EFAULT;
-        }
-
-        size_t argLength = 0;
-        if (strlenSafe(argv[argc], argLength, proc->addressSpace)) {
-            Log::Debug(debugLevelSyscalls, DebugLevelNormal, "SysExecve: Invalid argument pointer");
-
-            for (char* arg : kernelArgv) {
-                delete[] arg;
-            }
-
-            return -EFAULT;
-        }
-
-        char* buf = new char[argLength + 1];
-        strncpy(buf, argv[argc], argLength);
-        buf[argLength] = 0;
-
-        argc++;
-    }
-
-    int envc = 0;
     Vector<char*> kernelEnv;
 
-    for (;;) {
-        if (!envp[envc]) {
-            break; // End of args
+    auto freeArgs = [&]() {
+        for (char* arg : kernelArgv) {
+            kfree(arg);
         }
 
-        if (!Memory::CheckUsermodePointer(reinterpret_cast<uintptr_t>(envp + envc), sizeof(char*),
-                                          proc->addressSpace)) {
-            Log::Debug(debugLevelSyscalls, DebugLevelNormal, "SysExecve: Invalid environment pointer");
-            return -EFAULT;
-        }
-
-        size_t envLength = 0;
-        if (strlenSafe(envp[envc], envLength, proc->addressSpace)) {
-            Log::Debug(debugLevelSyscalls, DebugLevelNormal, "SysExecve: Invalid environment pointer");
-
-            for (char* arg : kernelArgv) {
-                delete[] arg;
-            }
-
-            for (char* env : kernelEnv) {
-                delete[] env;
-            }
-
-            return -EFAULT;
+        for (char* env : kernelEnv) {
+            kfree(env);
         }
+    };
 
-        char* buf = new char[envLength + 1];
-        strncpy(buf, envp[envc], envLength);
-        buf[envLength] = 0;
+    if (long e = CopyUserStringArray(argv, kernelArgv); e < 0) {
+        Log::Debug(debugLevelSyscalls, DebugLevelNormal, "SysExecve: Invalid argument pointer");
+        freeArgs();
+        return e;
+    }
 
-        envc++;
+    // A null environment is treated as an empty one
+    if (long e = envp ? CopyUserStringArray(envp, kernelEnv) : 0; e < 0) {
+        Log::Debug(debugLevelSyscalls, DebugLevelNormal, "SysExecve: Invalid environment pointer");
+        freeArgs();
+        return e;
     }
 
-    timeval tv = Timer::GetSystemUptimeStruct();
-    uint8_t* buffer = (uint8_t*)kmalloc(node->size);
-    ssize_t read = fs::Read(node, 0, node->size, buffer);
-    if (read < 0) {
+    elf64_header_t header;
+    if (ssize_t read = fs::Read(node, 0, sizeof(elf64_header_t), reinterpret_cast<uint8_t*>(&header)); read < 0) {
         Log::Warning("Could not read file: %s", kernelPath);
+        freeArgs();
         return read;
+    } else if (read != sizeof(elf64_header_t) || !VerifyELF(&header)) {
+        freeArgs();
+        return -ENOEXEC; // Check before we tear down the current image
     }
-    timeval tvnew = Timer::GetSystemUptimeStruct();
-    Log::Info("Done (took %d us)", Timer::TimeDifference(tvnew, tv));
 
     Thread* currentThread = Scheduler::GetCurrentThread();
 
     proc->addressSpace->UnmapAll();
+    proc->vdso = nullptr; // Mapped again by LoadELF
 
     MappedRegion* stackRegion = proc->addressSpace->AllocateAnonymousVMObject(0x200000, 0, false); // 2MB max stacksize
     currentThread->stack = reinterpret_cast<void*>(stackRegion->base);                             // 256KB stack size
     r->rsp = (uintptr_t)currentThread->stack + 0x200000;
 
     // Force the first 8KB to be allocated
-    stackRegion->vmObject->Hit(stackRegion->base, 0x200000 - 0x1000, proc->GetPageMap());
-    stackRegion->vmObject->Hit(stackRegion->base, 0x200000 - 0x2000, proc->GetPageMap());
+    stackRegion->vmObject->Hit(stackRegion->base, 0x200000 - 0x1000, proc->GetPageMap(), true);
+    stackRegion->vmObject->Hit(stackRegion->base, 0x200000 - 0x2000, proc->GetPageMap(), true);
 
-    elf_info_t elfInfo = LoadELFSegments(proc, buffer, 0);
+    elf_info_t elfInfo = LoadELFSegments(proc, node, 0);
     r->rip = Scheduler::LoadELF(proc, &r->rsp, elfInfo, kernelArgv.size(), kernelArgv.Data(), kernelEnv.size(),
                                 kernelEnv.Data(), kernelPath);
-    kfree(buffer);
+    freeArgs(); // Copied onto the new stack
 
     if (!r->rip) {
         Scheduler::EndProcess(Scheduler::GetCurrentProcess());
@@ -520,20 +515,13 @@ long SysExecve(RegisterContext* r) {
 
     r->rbp = r->rsp;
     r->rflags = 0x202; // IF - Interrupt Flag, bit 1 should be 1
-    memset(currentThread->fxState, 0, 4096);
+    FPU::Reset(currentThread);
 
-    ((fx_state_t*)currentThread->fxState)->mxcsr = 0x1f80; // Default MXCSR (SSE Control Word) State
-    ((fx_state_t*)currentThread->fxState)->mxcsrMask = 0xffbf;
-    ((fx_state_t*)currentThread->fxState)->fcw = 0x33f; // Default FPU Control Word State
-
-    for (fs_fd_t*& fd : proc->fileDescriptors) {
-        if (fd) {
-            if (fd->mode & O_CLOEXEC) {
-                fs::Close(fd);
-                fd = nullptr;
-            }
+    proc->fileDescriptors.ForEach([proc](int fd, fs_fd_t* handle) {
+        if (handle->mode & O_CLOEXEC) {
+            proc->DestroyFileDescriptor(fd);
         }
-    }
+    });
 
     return 0;
 }
@@ -599,18 +587,11 @@ long SysChmod(RegisterContext* r) {
     const char* path = reinterpret_cast<const char*>(SC_ARG0(r));
     mode_t mode = SC_ARG1(r);
 
-    size_t pathLen = 0;
-    if (strlenSafe(path, pathLen, proc->addressSpace)) {
-        return -EFAULT;
-    }
-
-    if (pathLen > PATH_MAX) {
-        return -ENAMETOOLONG;
+    char tempPath[PATH_MAX];
+    if (long e = strncpy_from_user(tempPath, path, PATH_MAX); e < 0) {
+        return e;
     }
 
-    char tempPath[pathLen + 1];
-    strcpy(tempPath, path);
-
     FsNode* file = fs::ResolvePath(tempPath, proc->workingDir);
     if (!file) {
         return -ENOENT;
@@ -623,18 +604,7 @@ long SysChmod(RegisterContext* r) {
     return 0;
 }
 
-long SysFStat(RegisterContext* r) {
-    Process* process = Scheduler::GetCurrentProcess();
-
-    stat_t* stat = (stat_t*)SC_ARG0(r);
-    fs_fd_t* handle = process->GetFileDescriptor(SC_ARG1(r));
-    if (!handle) {
-        Log::Warning("sys_fstat: Invalid File Descriptor, %d", SC_ARG1(r));
-        return -EBADF;
-    }
-
-    FsNode* const& node = handle->node;
-
+static void FillStat(FsNode* node, stat_t* stat) {
     stat->st_dev = 0;
     stat->st_ino = node->inode;
     stat->st_mode = 0;
@@ -659,22 +629,33 @@ long SysFStat(RegisterContext* r) {
     stat->st_size = node->size;
     stat->st_blksize = 0;
     stat->st_blocks = 0;
+}
 
-    return 0;
+long SysFStat(RegisterContext* r) {
+    Process* process = Scheduler::GetCurrentProcess();
+
+    stat_t* stat = (stat_t*)SC_ARG0(r);
+    fs_fd_t* handle = process->GetFileDescriptor(SC_ARG1(r));
+    if (!handle) {
+        Log::Warning("sys_fstat: Invalid File Descriptor, %d", SC_ARG1(r));
+        return -EBADF;
+    }
+
+    stat_t kernelStat;
+    FillStat(handle->node, &kernelStat);
+
+    return put_user(stat, kernelStat);
 }
 
 long SysStat(RegisterContext* r) {
     stat_t* stat = (stat_t*)SC_ARG0(r);
-    char* filepath = (char*)SC_ARG1(r);
     uint64_t flags = SC_ARG2(r);
     Process* proc = Scheduler::GetCurrentProcess();
 
-    if (!Memory::CheckUsermodePointer(SC_ARG0(r), sizeof(stat_t), proc->addressSpace)) {
-        Log::Warning("SysStat: stat structure points to invalid address %x", SC_ARG0(r));
-    }
-
-    if (!Memory::CheckUsermodePointer(SC_ARG1(r), 1, proc->addressSpace)) {
-        Log::Warning("SysStat: filepath points to invalid address %x", SC_ARG0(r));
+    char filepath[PATH_MAX];
+    if (long e = strncpy_from_user(filepath, reinterpret_cast<const char*>(SC_ARG1(r)), PATH_MAX); e < 0) {
+        Log::Warning("SysStat: filepath points to invalid address %x", SC_ARG1(r));
+        return e;
     }
 
     bool followSymlinks = !(flags & AT_SYMLINK_NOFOLLOW);
@@ -685,32 +666,10 @@ long SysStat(RegisterContext* r) {
         return -ENOENT;
     }
 
-    stat->st_dev = 0;
-    stat->st_ino = node->inode;
-    stat->st_mode = 0;
-
-    if ((node->flags & FS_NODE_TYPE) == FS_NODE_DIRECTORY)
-        stat->st_mode |= S_IFDIR;
-    if ((node->flags & FS_NODE_TYPE) == FS_NODE_FILE)
-        stat->st_mode |= S_IFREG;
-    if ((node->flags & FS_NODE_TYPE) == FS_NODE_BLKDEVICE)
-        stat->st_mode |= S_IFBLK;
-    if ((node->flags & FS_NODE_TYPE) == FS_NODE_CHARDEVICE)
-        stat->st_mode |= S_IFCHR;
-    if ((node->flags & FS_NODE_TYPE) == FS_NODE_SYMLINK)
-        stat->st_mode |= S_IFLNK;
-    if ((node->flags & FS_NODE_TYPE) == FS_NODE_SOCKET)
-        stat->st_mode |= S_IFSOCK;
-
-    stat->st_nlink = 0;
-    stat->st_uid = node->uid;
-    stat->st_gid = 0;
-    stat->st_rdev = 0;
-    stat->st_size = node->size;
-    stat->st_blksize = 0;
-    stat->st_blocks = 0;
+    stat_t kernelStat;
+    FillStat(node, &kernelStat);
 
-    return 0;
+    return put_user(stat, kernelStat);
 }
 
 long SysLSeek(RegisterContext* r) {
@@ -740,22 +699,20 @@ long SysLSeek(RegisterContext* r) {
 long SysGetPID(RegisterContext* r) {
     uint64_t* pid = (uint64_t*)SC_ARG0(r);
 
-    *pid = Scheduler::GetCurrentProcess()->pid;
-
-    return 0;
+    return put_user<uint64_t>(pid, Scheduler::GetCurrentProcess()->pid);
 }
 
 long SysMount(RegisterContext* r) { return 0; }
 
 long SysMkdir(RegisterContext* r) {
-    char* path = (char*)SC_ARG0(r);
+    char path[PATH_MAX];
     mode_t mode = SC_ARG1(r);
 
     Process* proc = Scheduler::GetCurrentProcess();
 
-    if (!Memory::CheckUsermodePointer(SC_ARG0(r), 0, proc->addressSpace)) {
+    if (long e = strncpy_from_user(path, reinterpret_cast<const char*>(SC_ARG0(r)), PATH_MAX); e < 0) {
         Log::Warning("sys_mkdir: Invalid path pointer %x", SC_ARG0(r));
-        return -EFAULT;
+        return e;
     }
 
     FsNode* parentDirectory = fs::ResolveParent(path, proc->workingDir);
@@ -782,11 +739,12 @@ long SysMkdir(RegisterContext* r) {
 
 long SysRmdir(RegisterContext* r) {
     Process* proc = Scheduler::GetCurrentProcess();
-    if (!Memory::CheckUsermodePointer(SC_ARG0(r), 1, proc->addressSpace)) {
-        return -EFAULT;
+
+    char path[PATH_MAX];
+    if (long e = strncpy_from_user(path, reinterpret_cast<const char*>(SC_ARG0(r)), PATH_MAX); e < 0) {
+        return e;
     }
 
-    char* path = reinterpret_cast<char*>(SC_ARG0(r));
     FsNode* node = fs::ResolvePath(path, proc->workingDir);
     if (!node) {
         return -ENOENT;
@@ -810,19 +768,19 @@ long SysRmdir(RegisterContext* r) {
 }
 
 long SysRename(RegisterContext* r) {
-    char* oldpath = (char*)SC_ARG0(r);
-    char* newpath = (char*)SC_ARG1(r);
+    char oldpath[PATH_MAX];
+    char newpath[PATH_MAX];
 
     Process* proc = Scheduler::GetCurrentProcess();
 
-    if (!Memory::CheckUsermodePointer(SC_ARG0(r), 0, proc->addressSpace)) {
+    if (long e = strncpy_from_user(oldpath, reinterpret_cast<const char*>(SC_ARG0(r)), PATH_MAX); e < 0) {
         Log::Warning("sys_rename: Invalid oldpath pointer %x", SC_ARG0(r));
-        return -EFAULT;
+        return e;
     }
 
-    if (!Memory::CheckUsermodePointer(SC_ARG1(r), 0, proc->addressSpace)) {
-        Log::Warning("sys_rename: Invalid newpath pointer %x", SC_ARG0(r));
-        return -EFAULT;
+    if (long e = strncpy_from_user(newpath, reinterpret_cast<const char*>(SC_ARG1(r)), PATH_MAX); e < 0) {
+        Log::Warning("sys_rename: Invalid newpath pointer %x", SC_ARG1(r));
+        return e;
     }
 
     FsNode* olddir = fs::ResolveParent(oldpath, proc->workingDir);
@@ -861,10 +819,6 @@ long SysReadDirNext(RegisterContext* r) {
     }
 
     fs_dirent_t* direntPointer = (fs_dirent_t*)SC_ARG1(r);
-    if (!Memory::CheckUsermodePointer((uintptr_t)direntPointer, sizeof(fs_dirent_t),
-                                      Scheduler::GetCurrentProcess()->addressSpace)) {
-        return -EFAULT;
-    }
 
     if ((handle->node->flags & FS_NODE_TYPE) != FS_NODE_DIRECTORY) {
         return -ENOTDIR;
@@ -873,8 +827,13 @@ long SysReadDirNext(RegisterContext* r) {
     DirectoryEntry tempent;
     int ret = fs::ReadDir(handle, &tempent, handle->pos++);
 
-    strcpy(direntPointer->name, tempent.name);
-    direntPointer->type = tempent.flags;
+    fs_dirent_t dirent;
+    strcpy(dirent.name, tempent.name);
+    dirent.type = tempent.flags;
+
+    if (put_user(direntPointer, dirent)) {
+        return -EFAULT;
+    }
 
     return ret;
 }
@@ -899,17 +858,49 @@ long SysReceiveMessage(RegisterContext* r) {
 long SysUptime(RegisterContext* r) {
     uint64_t* seconds = (uint64_t*)SC_ARG0(r);
     uint64_t* milliseconds = (uint64_t*)SC_ARG1(r);
-    if (seconds) {
-        *seconds = Timer::GetSystemUptime();
+    if (seconds && put_user<uint64_t>(seconds, Timer::GetSystemUptime())) {
+        return -EFAULT;
     }
-    if (milliseconds) {
-        *milliseconds = Timer::GetTicks() * 1000 / Timer::GetFrequency();
+    if (milliseconds && put_user<uint64_t>(milliseconds, (Timer::GetSystemUptimeNs() / 1000000) % 1000)) {
+        return -EFAULT;
     }
     return 0;
 }
 
+/////////////////////////////
+/// \name SysClockGetTime - Get the time of a clock with nanosecond resolution
+///
+/// There is no real time clock driver yet, so every clock counts from boot.
+/// CLOCK_REALTIME adds the same offset as the vDSO.
+///
+/// \param clock (clockid_t) Clock ID
+/// \param t (timespec*) Pointer to the time
+///
+/// \return 0 on success, negative error code on failure
+/////////////////////////////
+long SysClockGetTime(RegisterContext* r) {
+    timespec* t = reinterpret_cast<timespec*>(SC_ARG1(r));
+
+    uint64_t ns = Timer::GetSystemUptimeNs();
+    if (SC_ARG0(r) == LEMON_CLOCK_REALTIME || SC_ARG0(r) == LEMON_CLOCK_REALTIME_COARSE) {
+        ns += VDSO::RealtimeOffset();
+    }
+
+    timespec time;
+    time.tv_sec = ns / 1000000000;
+    time.tv_nsec = ns % 1000000000;
+    return put_user(t, time);
+}
+
 long SysDebug(RegisterContext* r) {
-    Log::Info("(%s): %s, %d", Scheduler::GetCurrentProcess()->name, (char*)SC_ARG0(r), SC_ARG1(r));
+    char message[512];
+    if (long e = strncpy_from_user(message, reinterpret_cast<const char*>(SC_ARG0(r)), sizeof(message)); e == -EFAULT) {
+        return e;
+    } else if (e < 0) {
+        message[sizeof(message) - 1] = 0; // Truncate long messages
+    }
+
+    Log::Info("(%s): %s, %d", Scheduler::GetCurrentProcess()->name, message, SC_ARG1(r));
     return 0;
 }
 
@@ -923,19 +914,11 @@ long SysGetVideoMode(RegisterContext* r) {
     fbInfo.bpp = vMode.bpp;
     fbInfo.pitch = vMode.pitch;
 
-    *((fb_info_t*)SC_ARG0(r)) = fbInfo;
-
-    return 0;
+    return put_user((fb_info_t*)SC_ARG0(r), fbInfo);
 }
 
 long SysUName(RegisterContext* r) {
-    if (Memory::CheckUsermodePointer(SC_ARG0(r), strlen(Lemon::versionString),
-                                     Scheduler::GetCurrentProcess()->addressSpace)) {
-        strcpy((char*)SC_ARG0(r), Lemon::versionString);
-        return 0;
-    }
-
-    return -EFAULT;
+    return copy_to_user((char*)SC_ARG0(r), Lemon::versionString, strlen(Lemon::versionString) + 1);
 }
 
 long SysReadDir(RegisterContext* r) {
@@ -947,10 +930,6 @@ long SysReadDir(RegisterContext* r) {
     }
 
     fs_dirent_t* direntPointer = (fs_dirent_t*)SC_ARG1(r);
-    if (!Memory::CheckUsermodePointer(SC_ARG1(r), sizeof(fs_dirent_t), Scheduler::GetCurrentProcess()->addressSpace)) {
-        return -EFAULT;
-    }
-
     unsigned int count = SC_ARG2(r);
 
     if ((handle->node->flags & FS_NODE_TYPE) != FS_NODE_DIRECTORY) {
@@ -960,8 +939,13 @@ long SysReadDir(RegisterContext* r) {
     DirectoryEntry tempent;
     int ret = fs::ReadDir(handle, &tempent, count);
 
-    strcpy(direntPointer->name, tempent.name);
-    direntPointer->type = tempent.flags;
+    fs_dirent_t dirent;
+    strcpy(dirent.name, tempent.name);
+    dirent.type = tempent.flags;
+
+    if (put_user(direntPointer, dirent)) {
+        return -EFAULT;
+    }
 
     return ret;
 }
@@ -973,6 +957,20 @@ long SysSetFsBase(RegisterContext* r) {
     return 0;
 }
 
+/*
+ * SysMmap (address, size, hint, flags, fd, offset) - Map memory
+ * address - Pointer to store the address of the mapping
+ * size - Size of the mapping
+ * hint - Preferred address (required with MAP_FIXED)
+ * flags - MAP_ flags
+ * fd - File descriptor to map (if not MAP_ANON)
+ * offset - Offset into the file, must be page aligned
+ *
+ * Shared file mappings are writable only if the file was opened for writing
+ *
+ * On success - return 0
+ * On failure - return error code
+ */
 long SysMmap(RegisterContext* r) {
     uint64_t* address = (uint64_t*)SC_ARG0(r);
     size_t size = SC_ARG1(r);
@@ -983,19 +981,46 @@ long SysMmap(RegisterContext* r) {
         return -EINVAL; // We do not accept 0-length mappings
     }
 
+    size = (size + PAGE_SIZE_4K - 1) & ~static_cast<size_t>(PAGE_SIZE_4K - 1);
+
     Process* proc = Scheduler::GetCurrentProcess();
 
     bool fixed = flags & MAP_FIXED;
     bool anon = flags & MAP_ANON;
-    // bool privateMapping = flags & MAP_PRIVATE;
+    bool sharedMapping = flags & MAP_SHARED;
+    bool privateMapping = flags & MAP_PRIVATE;
 
-    uint64_t unknownFlags = flags & ~static_cast<uint64_t>(MAP_ANON | MAP_FIXED | MAP_PRIVATE);
-    if (unknownFlags || !anon) {
+    uint64_t unknownFlags = flags & ~static_cast<uint64_t>(MAP_ANON | MAP_FIXED | MAP_PRIVATE | MAP_SHARED);
+    if (unknownFlags || (anon && sharedMapping) || (!anon && sharedMapping == privateMapping)) {
         Log::Warning("SysMmap: Unsupported mmap flags %x", flags);
         return -EINVAL;
     }
 
-    MappedRegion* region = proc->addressSpace->AllocateAnonymousVMObject(size, hint, fixed);
+    MappedRegion* region;
+    if (anon) {
+        region = proc->addressSpace->AllocateAnonymousVMObject(size, hint, fixed);
+    } else {
+        fs_fd_t* handle = proc->GetFileDescriptor(SC_ARG4(r));
+        off_t offset = SC_ARG5(r);
+
+        if (!handle) {
+            return -EBADF;
+        }
+
+        if (offset < 0 || (offset & (PAGE_SIZE_4K - 1))) {
+            return -EINVAL;
+        }
+
+        if (!handle->node->IsFile()) {
+            return -ENODEV;
+        }
+
+        bool writable = (handle->mode & O_ACCESS) == O_RDWR || (handle->mode & O_ACCESS) == O_WRONLY;
+        FancyRefPtr<VMObject> vmo = new FileVMObject(handle->node, offset, size, sharedMapping, writable);
+
+        region = proc->addressSpace->MapVMO(vmo, hint, fixed);
+    }
+
     if (!region || !region->base) {
         IF_DEBUG((debugLevelSyscalls >= DebugLevelNormal), {
             Log::Error("SysMmap: Failed to map region (hint %x)!", hint);
@@ -1006,8 +1031,7 @@ long SysMmap(RegisterContext* r) {
         return -1;
     }
 
-    *address = region->base;
-    return 0;
+    return put_user<uint64_t>(address, region->base);
 }
 
 long SysGrantPTY(RegisterContext* r) {
@@ -1018,13 +1042,11 @@ long SysGrantPTY(RegisterContext* r) {
 
     Process* currentProcess = Scheduler::GetCurrentProcess();
 
-    currentProcess->fileDescriptors[0] = fs::Open(&pty->slaveFile); // Stdin
-    currentProcess->fileDescriptors[1] = fs::Open(&pty->slaveFile); // Stdout
-    currentProcess->fileDescriptors[2] = fs::Open(&pty->slaveFile); // Stderr
+    currentProcess->ReplaceFileDescriptor(0, fs::Open(&pty->slaveFile)); // Stdin
+    currentProcess->ReplaceFileDescriptor(1, fs::Open(&pty->slaveFile)); // Stdout
+    currentProcess->ReplaceFileDescriptor(2, fs::Open(&pty->slaveFile)); // Stderr
 
-    *((int*)SC_ARG0(r)) = currentProcess->AllocateFileDescriptor(fs::Open(&pty->masterFile));
-
-    return 0;
+    return put_user<int>((int*)SC_ARG0(r), currentProcess->AllocateFileDescriptor(fs::Open(&pty->masterFile)));
 }
 
 long SysGetCWD(RegisterContext* r) {
@@ -1032,14 +1054,12 @@ long SysGetCWD(RegisterContext* r) {
     size_t sz = SC_ARG1(r);
 
     char* workingDir = Scheduler::GetCurrentProcess()->workingDir;
-    if (strlen(workingDir) > sz) {
+    size_t len = strlen(workingDir);
+    if (len >= sz) {
         return 1;
-    } else {
-        strcpy(buf, workingDir);
-        return 0;
     }
 
-    return 0;
+    return copy_to_user(buf, workingDir, len + 1);
 }
 
 long SysWaitPID(RegisterContext* r) {
@@ -1133,7 +1153,7 @@ long SysWaitPID(RegisterContext* r) {
 long SysNanoSleep(RegisterContext* r) {
     uint64_t nanoseconds = SC_ARG0(r);
 
-    Scheduler::GetCurrentThread()->Sleep(nanoseconds / 1000);
+    Scheduler::GetCurrentThread()->Sleep((nanoseconds + 999) / 1000); // Sleep for at least the time requested
 
     return 0;
 }
@@ -1147,14 +1167,10 @@ long SysPRead(RegisterContext* r) {
         return -EBADF;
     }
 
-    if (!Memory::CheckUsermodePointer(SC_ARG1(r), SC_ARG2(r), currentProcess->addressSpace)) {
-        return -EFAULT;
-    }
-
     uint8_t* buffer = (uint8_t*)SC_ARG1(r);
     uint64_t count = SC_ARG2(r);
     uint64_t off = SC_ARG4(r);
-    return fs::Read(handle->node, off, count, buffer);
+    return fs::ReadUser(handle->node, off, count, buffer);
 }
 
 long SysPWrite(RegisterContext* r) {
@@ -1162,18 +1178,14 @@ long SysPWrite(RegisterContext* r) {
 
     fs_fd_t* handle = currentProcess->GetFileDescriptor(SC_ARG0(r));
     if (!handle) {
-        Log::Warning("SysPRead: Invalid file descriptor: %d", SC_ARG0(r));
+        Log::Warning("SysPWrite: Invalid file descriptor: %d", SC_ARG0(r));
         return -EBADF;
     }
 
-    if (!Memory::CheckUsermodePointer(SC_ARG1(r), SC_ARG2(r), currentProcess->addressSpace)) {
-        return -EFAULT;
-    }
-
     uint8_t* buffer = (uint8_t*)SC_ARG1(r);
     uint64_t count = SC_ARG2(r);
     uint64_t off = SC_ARG4(r);
-    return fs::Read(handle->node, off, count, buffer);
+    return fs::WriteUser(handle->node, off, count, buffer);
 }
 
 long SysIoctl(RegisterContext* r) {
@@ -1183,15 +1195,6 @@ long SysIoctl(RegisterContext* r) {
 
     Process* process = Scheduler::GetCurrentProcess();
 
-    if (result && !Memory::CheckUsermodePointer((uintptr_t)result, sizeof(int), process->addressSpace)) {
-        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, {
-            Log::Warning("(%s): SysIoctl: Invalid result value %x", process->name, SC_ARG0(r));
-            Log::Info("%x", r->rip);
-            UserPrintStackTrace(r->rbp, process->addressSpace);
-        });
-        return -EFAULT;
-    }
-
     fs_fd_t* handle = process->GetFileDescriptor(SC_ARG0(r));
     if (!handle) {
         Log::Warning("SysIoctl: Invalid File Descriptor: %d", SC_ARG0(r));
@@ -1205,8 +1208,13 @@ long SysIoctl(RegisterContext* r) {
 
     int ret = fs::Ioctl(handle, request, arg);
 
-    if (result && ret > 0) {
-        *result = ret;
+    if (result && ret > 0 && put_user(result, ret)) {
+        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, {
+            Log::Warning("(%s): SysIoctl: Invalid result value %x", process->name, SC_ARG0(r));
+            Log::Info("%x", r->rip);
+            UserPrintStackTrace(r->rbp, process->addressSpace);
+        });
+        return -EFAULT;
     }
 
     return ret;
@@ -1242,9 +1250,218 @@ long SysMunmap(RegisterContext* r) {
         return -EINVAL; // Must be aligned
     }
 
+    // process->vdso is used by fork, so the vDSO stays for the lifetime of the image
+    if (MappedRegion* vdso = process->vdso;
+        vdso && address < vdso->Base() + vdso->Size() && address + size > vdso->Base()) {
+        return -EINVAL;
+    }
+
     return process->addressSpace->UnmapMemory(address, size);
 }
 
+/*
+ * SysMsync - Write back modified pages of file mappings (addr, size, flags)
+ *
+ * On success - return 0
+ * On failure - return error code
+ */
+long SysMsync(RegisterContext* r) {
+    Process* process = Scheduler::GetCurrentProcess();
+
+    uintptr_t address = SC_ARG0(r);
+    size_t size = SC_ARG1(r);
+    uint64_t flags = SC_ARG2(r);
+
+    if (address & (PAGE_SIZE_4K - 1) || flags & ~static_cast<uint64_t>(MS_ASYNC | MS_SYNC | MS_INVALIDATE)) {
+        return -EINVAL;
+    }
+
+    // Writes go straight to the node so MS_ASYNC is treated as MS_SYNC
+    // and our mappings never hold stale data, so there is nothing to invalidate
+    uintptr_t end = address + size;
+    while (address < end) {
+        MappedRegion* region = process->addressSpace->AddressToRegionReadLock(address);
+        if (!region) {
+            return -ENOMEM; // Range is not mapped
+        }
+
+        size_t length = ((end < region->End()) ? end : region->End()) - address;
+        long ret = region->vmObject->Sync(region->Base(), address - region->Base(), length, process->GetPageMap());
+
+        address = region->End();
+        region->lock.ReleaseRead();
+
+        if (ret) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * SysMadvise - Advise how memory will be used (addr, size, advice)
+ *
+ * On success - return 0
+ * On failure - return error code
+ */
+long SysMadvise(RegisterContext* r) {
+    Process* process = Scheduler::GetCurrentProcess();
+
+    uintptr_t address = SC_ARG0(r);
+    size_t size = SC_ARG1(r);
+    int advice = SC_ARG2(r);
+
+    if (address & (PAGE_SIZE_4K - 1)) {
+        return -EINVAL;
+    }
+
+    if (advice == MADV_NORMAL || advice == MADV_RANDOM || advice == MADV_SEQUENTIAL) {
+        return 0; // Nothing we can do with these yet
+    } else if (advice != MADV_WILLNEED && advice != MADV_DONTNEED) {
+        return -EINVAL;
+    }
+
+    uintptr_t end = address + size;
+    while (address < end) {
+        MappedRegion* region = process->addressSpace->AddressToRegionReadLock(address);
+        if (!region) {
+            return -ENOMEM; // Range is not mapped
+        }
+
+        size_t length = ((end < region->End()) ? end : region->End()) - address;
+        if (advice == MADV_WILLNEED) {
+            region->vmObject->Prefetch(region->Base(), address - region->Base(), length, process->GetPageMap());
+        } else {
+            region->vmObject->Discard(region->Base(), address - region->Base(), length, process->GetPageMap());
+        }
+
+        address = region->End();
+        region->lock.ReleaseRead();
+    }
+
+    return 0;
+}
+
+/*
+ * SysSplice - Move data between two file descriptors without copying through user space
+ * (fdIn, offIn, fdOut, offOut, len, flags)
+ *
+ * offIn and offOut may be null in which case the file position of the descriptor is used and updated,
+ * otherwise the offset is used and updated instead. Pipes and sockets cannot be given an offset.
+ * With SPLICE_F_NONBLOCK, EAGAIN is returned instead of blocking on the first chunk.
+ * The data is copied through a kernel buffer, pages are not yet moved between streams.
+ *
+ * On success - return amount of data moved, 0 at end of file
+ * On failure - return error code
+ */
+long SysSplice(RegisterContext* r) {
+    Process* proc = Scheduler::GetCurrentProcess();
+
+    fs_fd_t* in = proc->GetFileDescriptor(SC_ARG0(r));
+    fs_fd_t* out = proc->GetFileDescriptor(SC_ARG2(r));
+    if (!(in && out)) {
+        return -EBADF;
+    }
+
+    if ((in->mode & O_ACCESS) == O_WRONLY || (out->mode & O_ACCESS) == O_RDONLY) {
+        return -EBADF;
+    }
+
+    int64_t* offIn = reinterpret_cast<int64_t*>(SC_ARG1(r));
+    int64_t* offOut = reinterpret_cast<int64_t*>(SC_ARG3(r));
+    size_t len = SC_ARG4(r);
+    uint64_t flags = SC_ARG5(r);
+
+    if (flags & ~static_cast<uint64_t>(SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE | SPLICE_F_GIFT)) {
+        return -EINVAL;
+    }
+
+    auto isSeekable = [](FsNode* node) -> bool {
+        return (node->flags & FS_NODE_TYPE) == FS_NODE_FILE || (node->flags & FS_NODE_TYPE) == FS_NODE_BLKDEVICE;
+    };
+
+    if ((offIn && !isSeekable(in->node)) || (offOut && !isSeekable(out->node))) {
+        return -ESPIPE;
+    }
+
+    int64_t inOffset = 0;
+    int64_t outOffset = 0;
+    if ((offIn && get_user(&inOffset, offIn)) || (offOut && get_user(&outOffset, offOut))) {
+        return -EFAULT;
+    }
+
+    if ((flags & SPLICE_F_NONBLOCK) && len && (!in->node->CanRead() || !out->node->CanWrite())) {
+        return -EAGAIN;
+    }
+
+    size_t inPos = offIn ? inOffset : in->pos;
+    size_t outPos = offOut ? outOffset : out->pos;
+
+    uint8_t* buffer = reinterpret_cast<uint8_t*>(kmalloc(PAGE_SIZE_4K));
+    size_t moved = 0;
+    long error = 0;
+    while (moved < len) {
+        // Only block for the first chunk, after that return whatever is available
+        if (moved && !in->node->CanRead()) {
+            break;
+        }
+
+        size_t chunk = (len - moved > PAGE_SIZE_4K) ? PAGE_SIZE_4K : (len - moved);
+        ssize_t read = fs::Read(in->node, inPos, chunk, buffer);
+        if (read <= 0) {
+            error = read;
+            break;
+        }
+
+        inPos += read;
+
+        ssize_t written = 0;
+        while (written < read) {
+            ssize_t ret = fs::Write(out->node, outPos, read - written, buffer + written);
+            if (ret <= 0) {
+                error = ret ? ret : -EIO;
+                break;
+            }
+
+            written += ret;
+            outPos += ret;
+        }
+
+        moved += written;
+        if (error && isSeekable(in->node)) {
+            inPos -= read - written; // Leave what could not be written to be read again
+        }
+
+        if (error || static_cast<size_t>(read) < chunk) {
+            break;
+        }
+    }
+    kfree(buffer);
+
+    if (offIn) {
+        if (put_user<int64_t>(offIn, inPos)) {
+            return -EFAULT;
+        }
+    } else {
+        in->pos = inPos;
+    }
+
+    if (offOut) {
+        if (put_user<int64_t>(offOut, outPos)) {
+            return -EFAULT;
+        }
+    } else {
+        out->pos = outPos;
+    }
+
+    if (moved) {
+        return moved;
+    }
+
+    return error;
+}
+
 /*
  * SysCreateSharedMemory (key, size, flags, recipient) - Create Shared Memory
  * key - Pointer to memory key
@@ -1448,13 +1665,14 @@ long SysAccept(RegisterContext* r) {
     }
 
     socklen_t* len = (socklen_t*)SC_ARG2(r);
-    if (len && !Memory::CheckUsermodePointer(SC_ARG2(r), sizeof(socklen_t), proc->addressSpace)) {
+    socklen_t addrLen = 0;
+    if (len && get_user(&addrLen, len)) {
         Log::Warning("SysAccept: Invalid socklen ptr");
         return -EFAULT;
     }
 
     sockaddr_t* addr = (sockaddr_t*)SC_ARG1(r);
-    if (addr && !Memory::CheckUsermodePointer(SC_ARG1(r), *len, proc->addressSpace)) {
+    if (addr && !Memory::CheckUsermodePointer(SC_ARG1(r), addrLen, proc->addressSpace)) {
         Log::Warning("SysAccept: Invalid sockaddr ptr");
         return -EFAULT;
     }
@@ -1699,7 +1917,7 @@ long SysSetUID(RegisterContext* r) {
  * On Failure - return -1
  */
 long SysPoll(RegisterContext* r) {
-    pollfd* fds = (pollfd*)SC_ARG0(r);
+    pollfd* userFds = (pollfd*)SC_ARG0(r);
     unsigned nfds = SC_ARG1(r);
     long timeout = SC_ARG2(r);
 
@@ -1709,19 +1927,27 @@ long SysPoll(RegisterContext* r) {
     if (!nfds) {
         thread->Sleep(timeout * 1000); // Caller must have been using poll to wait/sleep
         return 0;
+    } else if (nfds > MAX(proc->fileDescriptors.Capacity(), (unsigned)FD_SETSIZE)) {
+        return -EINVAL; // More entries than the process could have file descriptors
     }
 
-    if (!Memory::CheckUsermodePointer(SC_ARG0(r), nfds * sizeof(pollfd), proc->addressSpace)) {
+    pollfd* fds = (pollfd*)kmalloc(nfds * sizeof(pollfd));
+    fs_fd_t** files = (fs_fd_t**)kmalloc(nfds * sizeof(fs_fd_t*));
+    auto freeArrays = [&]() {
+        kfree(fds);
+        kfree(files);
+    };
+
+    if (copy_from_user(fds, userFds, nfds * sizeof(pollfd))) {
         Log::Warning("SysPoll: Invalid pointer to file descriptor array");
         IF_DEBUG(debugLevelSyscalls >= DebugLevelVerbose, {
             Log::Info("rip: %x", r->rip);
             UserPrintStackTrace(r->rbp, Scheduler::GetCurrentProcess()->addressSpace);
         });
+        freeArrays();
         return -EFAULT;
     }
 
-    fs_fd_t* files[nfds];
-
     unsigned eventCount = 0; // Amount of fds with events
     for (unsigned i = 0; i < nfds; i++) {
         fds[i].revents = 0;
@@ -1789,11 +2015,15 @@ long SysPoll(RegisterContext* r) {
 
         if (timeout > 0) {
             if (fsWatcher.WaitTimeout(timeout)) {
+                freeArrays();
                 return -EINTR; // Interrupted
             } else if (timeout <= 0) {
-                return 0; // Timed out
+                long ret = copy_to_user(userFds, fds, nfds * sizeof(pollfd)); // Timed out
+                freeArrays();
+                return ret;
             }
         } else if (fsWatcher.Wait()) {
+            freeArrays();
             return -EINTR; // Interrupted
         }
 
@@ -1844,6 +2074,12 @@ long SysPoll(RegisterContext* r) {
                                 timeout)); // Wait until timeout, unless timeout is negative in which wait infinitely
     }
 
+    long ret = copy_to_user(userFds, fds, nfds * sizeof(pollfd));
+    freeArrays();
+    if (ret) {
+        return ret;
+    }
+
     return eventCount;
 }
 
@@ -1866,7 +2102,7 @@ long SysSendMsg(RegisterContext* r) {
         return -EBADF;
     }
 
-    msghdr* msg = (msghdr*)SC_ARG1(r);
+    msghdr msg;
     uint64_t flags = SC_ARG3(r);
 
     if ((handle->node->flags & FS_NODE_TYPE) != FS_NODE_SOCKET) {
@@ -1876,27 +2112,21 @@ long SysSendMsg(RegisterContext* r) {
         return -ENOTSOCK;
     }
 
-    if (!Memory::CheckUsermodePointer(SC_ARG1(r), sizeof(msghdr), proc->addressSpace)) {
+    if (get_user(&msg, (msghdr*)SC_ARG1(r))) {
 
         IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, { Log::Warning("SysSendMsg: Invalid msg ptr"); });
         return -EFAULT;
     }
 
-    if (!Memory::CheckUsermodePointer((uintptr_t)msg->msg_iov, sizeof(iovec) * msg->msg_iovlen, proc->addressSpace)) {
-
-        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, { Log::Warning("SysSendMsg: msg: Invalid iovec ptr"); });
-        return -EFAULT;
-    }
-
-    if (msg->msg_name && msg->msg_namelen &&
-        !Memory::CheckUsermodePointer((uintptr_t)msg->msg_name, msg->msg_namelen, proc->addressSpace)) {
+    if (msg.msg_name && msg.msg_namelen &&
+        !Memory::CheckUsermodePointer((uintptr_t)msg.msg_name, msg.msg_namelen, proc->addressSpace)) {
         IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal,
                  { Log::Warning("SysSendMsg: msg: Invalid name ptr and name not null"); });
         return -EFAULT;
     }
 
-    if (msg->msg_control && msg->msg_controllen &&
-        !Memory::CheckUsermodePointer((uintptr_t)msg->msg_control, msg->msg_controllen, proc->addressSpace)) {
+    if (msg.msg_control && msg.msg_controllen &&
+        !Memory::CheckUsermodePointer((uintptr_t)msg.msg_control, msg.msg_controllen, proc->addressSpace)) {
         IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal,
                  { Log::Warning("SysSendMsg: msg: Invalid control ptr and control null"); });
         return -EFAULT;
@@ -1905,20 +2135,23 @@ long SysSendMsg(RegisterContext* r) {
     long sent = 0;
     Socket* sock = (Socket*)handle->node;
 
-    for (unsigned i = 0; i < msg->msg_iovlen; i++) {
-        if (!Memory::CheckUsermodePointer((uintptr_t)msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len,
-                                          proc->addressSpace)) {
-            Log::Warning("SysSendMsg: msg: Invalid iovec entry base");
-            return -EFAULT;
+    for (unsigned i = 0; i < msg.msg_iovlen; i++) {
+        iovec iov;
+        if (get_user(&iov, msg.msg_iov + i)) {
+            IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, { Log::Warning("SysSendMsg: msg: Invalid iovec ptr"); });
+            return sent ? sent : -EFAULT;
         }
 
-        long ret = sock->SendTo(msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len, flags, (sockaddr*)msg->msg_name,
-                                msg->msg_namelen, msg->msg_control, msg->msg_controllen);
-
-        if (ret < 0)
-            return ret;
+        long ret = sock->SendToUser(iov.iov_base, iov.iov_len, flags, (sockaddr*)msg.msg_name, msg.msg_namelen,
+                                    msg.msg_control, msg.msg_controllen);
+        if (ret < 0) {
+            return sent ? sent : ret;
+        }
 
         sent += ret;
+        if (static_cast<size_t>(ret) < iov.iov_len) {
+            break;
+        }
     }
 
     return sent;
@@ -1943,7 +2176,8 @@ long SysRecvMsg(RegisterContext* r) {
         return -EBADF;
     }
 
-    msghdr* msg = (msghdr*)SC_ARG1(r);
+    msghdr* userMsg = (msghdr*)SC_ARG1(r);
+    msghdr msg;
     uint64_t flags = SC_ARG3(r);
 
     if (handle->mode & O_NONBLOCK) {
@@ -1956,18 +2190,19 @@ long SysRecvMsg(RegisterContext* r) {
         return -ENOTSOCK;
     }
 
-    if (!Memory::CheckUsermodePointer(SC_ARG1(r), sizeof(msghdr), proc->addressSpace)) {
+    if (get_user(&msg, userMsg)) {
         IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, { Log::Warning("SysRecvMsg: Invalid msg ptr"); });
         return -EFAULT;
     }
 
-    if (!Memory::CheckUsermodePointer((uintptr_t)msg->msg_iov, sizeof(iovec) * msg->msg_iovlen, proc->addressSpace)) {
-        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, { Log::Warning("SysRecvMsg: msg: Invalid iovec ptr"); });
+    if (msg.msg_name && msg.msg_namelen &&
+        !Memory::CheckUsermodePointer((uintptr_t)msg.msg_name, msg.msg_namelen, proc->addressSpace)) {
+        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, { Log::Warning("SysRecvMsg: msg: Invalid name ptr"); });
         return -EFAULT;
     }
 
-    if (msg->msg_control && msg->msg_controllen &&
-        !Memory::CheckUsermodePointer((uintptr_t)msg->msg_control, msg->msg_controllen, proc->addressSpace)) {
+    if (msg.msg_control && msg.msg_controllen &&
+        !Memory::CheckUsermodePointer((uintptr_t)msg.msg_control, msg.msg_controllen, proc->addressSpace)) {
         IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal,
                  { Log::Warning("SysRecvMsg: msg: Invalid control ptr and control null"); });
         return -EFAULT;
@@ -1976,21 +2211,23 @@ long SysRecvMsg(RegisterContext* r) {
     long read = 0;
     Socket* sock = (Socket*)handle->node;
 
-    for (unsigned i = 0; i < msg->msg_iovlen; i++) {
-        if (!Memory::CheckUsermodePointer((uintptr_t)msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len,
-                                          proc->addressSpace)) {
-            Log::Warning("SysRecvMsg: msg: Invalid iovec entry base");
-            return -EFAULT;
+    for (unsigned i = 0; i < msg.msg_iovlen; i++) {
+        iovec iov;
+        if (get_user(&iov, msg.msg_iov + i)) {
+            IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, { Log::Warning("SysRecvMsg: msg: Invalid iovec ptr"); });
+            return read ? read : -EFAULT;
         }
 
-        socklen_t len = msg->msg_namelen;
-        long ret =
-            sock->ReceiveFrom(msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len, flags,
-                              reinterpret_cast<sockaddr*>(msg->msg_name), &len, msg->msg_control, msg->msg_controllen);
-        msg->msg_namelen = len;
+        socklen_t len = msg.msg_namelen;
+        long ret = sock->ReceiveFromUser(iov.iov_base, iov.iov_len, flags, reinterpret_cast<sockaddr*>(msg.msg_name),
+                                         &len, msg.msg_control, msg.msg_controllen);
+        if (put_user(&userMsg->msg_namelen, len)) {
+            return read ? read : -EFAULT;
+        }
 
         if (ret < 0) {
-            return ret;
+            // Whatever was received has been consumed, so report it rather than the error
+            return read ? read : ret;
         }
 
         read += ret;
@@ -2042,33 +2279,37 @@ long SysGetProcessInfo(RegisterContext* r) {
     uint64_t pid = SC_ARG0(r);
     lemon_process_info_t* pInfo = reinterpret_cast<lemon_process_info_t*>(SC_ARG1(r));
 
-    Process* cProcess = Scheduler::GetCurrentProcess();
-    if (!Memory::CheckUsermodePointer(SC_ARG1(r), sizeof(lemon_process_info_t), cProcess->addressSpace)) {
-        return -EFAULT;
-    }
-
     Process* reqProcess;
     if (!(reqProcess = Scheduler::FindProcessByPID(pid))) {
         return -EINVAL;
     }
 
-    pInfo->pid = pid;
+    lemon_process_info_t info;
 
-    pInfo->threadCount = reqProcess->threads.get_length();
+    info.pid = pid;
 
-    pInfo->uid = reqProcess->uid;
-    pInfo->gid = reqProcess->gid;
+    info.threadCount = reqProcess->threads.get_length();
 
-    pInfo->state = reqProcess->threads.get_front()->state;
+    info.uid = reqProcess->uid;
+    info.gid = reqProcess->gid;
 
-    strcpy(pInfo->name, reqProcess->name);
+    info.state = reqProcess->threads.get_front()->state;
 
-    pInfo->runningTime = Timer::GetSystemUptime() - reqProcess->creationTime.tv_sec;
-    pInfo->activeUs = reqProcess->activeTicks * 1000000 / Timer::GetFrequency();
+    strcpy(info.name, reqProcess->name);
 
-    pInfo->usedMem = reqProcess->addressSpace->UsedPhysicalMemory();
+    info.runningTime = Timer::GetSystemUptime() - reqProcess->creationTime.tv_sec;
+    info.activeUs = reqProcess->activeTicks * 1000000 / Timer::GetFrequency();
 
-    return 0;
+    info.usedMem = reqProcess->addressSpace->UsedPhysicalMemory();
+
+    info.fpuSaves = info.fpuRestores = info.fpuTraps = 0;
+    for (Thread* t : reqProcess->threads) {
+        info.fpuSaves += t->fpuSaves;
+        info.fpuRestores += t->fpuRestores;
+        info.fpuTraps += t->fpuTraps;
+    }
+
+    return put_user(pInfo, info);
 }
 
 /////////////////////////////
@@ -2085,42 +2326,50 @@ long SysGetNextProcessInfo(RegisterContext* r) {
     pid_t* pidP = reinterpret_cast<pid_t*>(SC_ARG0(r));
     lemon_process_info_t* pInfo = reinterpret_cast<lemon_process_info_t*>(SC_ARG1(r));
 
-    Process* cProcess = Scheduler::GetCurrentProcess();
-    if (!Memory::CheckUsermodePointer(SC_ARG1(r), sizeof(lemon_process_info_t), cProcess->addressSpace)) {
+    pid_t pid;
+    if (get_user(&pid, pidP)) {
         return -EFAULT;
     }
 
-    if (!Memory::CheckUsermodePointer(SC_ARG0(r), sizeof(pid_t), cProcess->addressSpace)) {
+    pid = Scheduler::GetNextProccessPID(pid);
+    if (put_user(pidP, pid)) {
         return -EFAULT;
     }
 
-    *pidP = Scheduler::GetNextProccessPID(*pidP);
-
-    if (!(*pidP)) {
+    if (!pid) {
         return 1; // No more processes
     }
 
     Process* reqProcess;
-    if (!(reqProcess = Scheduler::FindProcessByPID(*pidP))) {
+    if (!(reqProcess = Scheduler::FindProcessByPID(pid))) {
         return -EINVAL;
     }
 
-    pInfo->pid = *pidP;
+    lemon_process_info_t info;
+    info.pid = pid;
 
-    pInfo->threadCount = reqProcess->threads.get_length();
+    info.threadCount = reqProcess->threads.get_length();
 
-    pInfo->uid = reqProcess->uid;
-    pInfo->gid = reqProcess->gid;
+    info.uid = reqProcess->uid;
+    info.gid = reqProcess->gid;
 
-    pInfo->state = reqProcess->threads.get_front()->state;
+    info.state = reqProcess->threads.get_front()->state;
 
-    strcpy(pInfo->name, reqProcess->name);
+    strcpy(info.name, reqProcess->name);
 
-    pInfo->runningTime = Timer::GetSystemUptime() - reqProcess->creationTime.tv_sec;
-    pInfo->activeUs = reqProcess->activeTicks * 1000000 / Timer::GetFrequency();
+    info.runningTime = Timer::GetSystemUptime() - reqProcess->creationTime.tv_sec;
+    info.activeUs = reqProcess->activeTicks * 1000000 / Timer::GetFrequency();
 
-    pInfo->usedMem = reqProcess->usedMemoryBlocks / 4;
-    return 0;
+    info.usedMem = reqProcess->usedMemoryBlocks / 4;
+
+    info.fpuSaves = info.fpuRestores = info.fpuTraps = 0;
+    for (Thread* t : reqProcess->threads) {
+        info.fpuSaves += t->fpuSaves;
+        info.fpuRestores += t->fpuRestores;
+        info.fpuTraps += t->fpuTraps;
+    }
+
+    return put_user(pInfo, info);
 }
 
 /////////////////////////////
@@ -2136,15 +2385,15 @@ long SysGetNextProcessInfo(RegisterContext* r) {
 long SysReadLink(RegisterContext* r) {
     Process* proc = Scheduler::GetCurrentProcess();
 
-    if (!Memory::CheckUsermodePointer(SC_ARG0(r), 0, proc->addressSpace)) {
-        return -EFAULT; // Invalid path pointer
+    char path[PATH_MAX];
+    if (long e = strncpy_from_user(path, reinterpret_cast<const char*>(SC_ARG0(r)), PATH_MAX); e < 0) {
+        return e; // Invalid path pointer
     }
 
     if (!Memory::CheckUsermodePointer(SC_ARG1(r), SC_ARG2(r), proc->addressSpace)) {
         return -EFAULT; // Invalid buffer
     }
 
-    const char* path = reinterpret_cast<const char*>(SC_ARG0(r));
     char* buffer = reinterpret_cast<char*>(SC_ARG1(r));
     size_t bufferSize = SC_ARG2(r);
 
@@ -2201,8 +2450,9 @@ long SysSpawnThread(RegisterContext* r) {
 long SysFutexWake(RegisterContext* r) {
     int* futex = reinterpret_cast<int*>(SC_ARG0(r));
 
-    if (!Memory::CheckUsermodePointer(SC_ARG0(r), sizeof(int), Scheduler::GetCurrentProcess()->addressSpace)) {
-        return EFAULT;
+    // The futex is only used as a key, it never gets accessed
+    if (!Memory::IsUsermodeRange(SC_ARG0(r), sizeof(int))) {
+        return -EFAULT;
     }
 
     Process* currentProcess = Scheduler::GetCurrentProcess();
@@ -2233,14 +2483,14 @@ long SysFutexWake(RegisterContext* r) {
 /////////////////////////////
 long SysFutexWait(RegisterContext* r) {
     int* futex = reinterpret_cast<int*>(SC_ARG0(r));
+    int expected = static_cast<int>(SC_ARG1(r));
 
-    if (!Memory::CheckUsermodePointer(SC_ARG0(r), sizeof(int), Scheduler::GetCurrentProcess()->addressSpace)) {
-        return EFAULT;
+    int value;
+    if (get_user(&value, futex)) {
+        return -EFAULT;
     }
 
-    int expected = static_cast<int>(SC_ARG1(r));
-
-    if (*futex != expected) {
+    if (value != expected) {
         return 0;
     }
 
@@ -2298,20 +2548,20 @@ long SysDup(RegisterContext* r) {
     }
 
     if (requestedFd >= 0) {
-        if (static_cast<unsigned>(requestedFd) >= currentProcess->FileDescriptorCount()) {
-            Log::Error("SysDup: We do not support (yet) requesting unallocated fds."); // TODO: Requested file
-                                                                                       // descriptors out of range
-            return -ENOSYS;
-        }
-
-        currentProcess->DestroyFileDescriptor(requestedFd); // If it exists destroy existing fd
-
+        // Closes the existing file descriptor if there is one
         if (currentProcess->ReplaceFileDescriptor(requestedFd, newHandle)) {
+            fs::Close(newHandle);
+            delete newHandle;
             return -EBADF;
         }
         return requestedFd;
     } else {
-        return currentProcess->AllocateFileDescriptor(newHandle);
+        int newFd = currentProcess->AllocateFileDescriptor(newHandle);
+        if (newFd < 0) {
+            fs::Close(newHandle);
+            delete newHandle;
+        }
+        return newFd;
     }
 }
 
@@ -2371,19 +2621,29 @@ long SysSelect(RegisterContext* r) {
     Process* currentProcess = Scheduler::GetCurrentProcess();
 
     int nfds = static_cast<int>(SC_ARG0(r));
-    fd_set_t* readFdsMask = reinterpret_cast<fd_set_t*>(SC_ARG1(r));
-    fd_set_t* writeFdsMask = reinterpret_cast<fd_set_t*>(SC_ARG2(r));
-    fd_set_t* exceptFdsMask = reinterpret_cast<fd_set_t*>(SC_ARG3(r));
-    timespec_t* timeout = reinterpret_cast<timespec_t*>(SC_ARG4(r));
-
-    if (!((!readFdsMask || Memory::CheckUsermodePointer(SC_ARG1(r), sizeof(fd_set_t), currentProcess->addressSpace)) &&
-          (!writeFdsMask || Memory::CheckUsermodePointer(SC_ARG2(r), sizeof(fd_set_t), currentProcess->addressSpace)) &&
-          (!exceptFdsMask ||
-           Memory::CheckUsermodePointer(SC_ARG3(r), sizeof(fd_set_t), currentProcess->addressSpace)) &&
-          Memory::CheckUsermodePointer(SC_ARG4(r), sizeof(timespec_t), currentProcess->addressSpace))) {
+    fd_set_t* userReadFds = reinterpret_cast<fd_set_t*>(SC_ARG1(r));
+    fd_set_t* userWriteFds = reinterpret_cast<fd_set_t*>(SC_ARG2(r));
+    fd_set_t* userExceptFds = reinterpret_cast<fd_set_t*>(SC_ARG3(r));
+    timespec_t* userTimeout = reinterpret_cast<timespec_t*>(SC_ARG4(r));
+
+    // Work on kernel copies of the sets and copy them back once done
+    fd_set_t readFds, writeFds, exceptFds;
+    timespec_t timeoutSpec;
+    if ((userReadFds && get_user(&readFds, userReadFds)) || (userWriteFds && get_user(&writeFds, userWriteFds)) ||
+        (userExceptFds && get_user(&exceptFds, userExceptFds)) || (userTimeout && get_user(&timeoutSpec, userTimeout))) {
         return -EFAULT; // Only return EFAULT if read/write/exceptfds is not null
     }
 
+    fd_set_t* readFdsMask = userReadFds ? &readFds : nullptr;
+    fd_set_t* writeFdsMask = userWriteFds ? &writeFds : nullptr;
+    fd_set_t* exceptFdsMask = userExceptFds ? &exceptFds : nullptr;
+    timespec_t* timeout = userTimeout ? &timeoutSpec : nullptr;
+
+    auto copySetsToUser = [&]() -> bool {
+        return (userReadFds && put_user(userReadFds, readFds)) || (userWriteFds && put_user(userWriteFds, writeFds)) ||
+               (userExceptFds && put_user(userExceptFds, exceptFds));
+    };
+
     List<Pair<fs_fd_t*, int>> readfds;
     List<Pair<fs_fd_t*, int>> writefds;
     List<Pair<fs_fd_t*, int>> exceptfds;
@@ -2464,6 +2724,10 @@ long SysSelect(RegisterContext* r) {
     }
 
     if (evCount) {
+        if (copySetsToUser()) {
+            return -EFAULT;
+        }
+
         return evCount;
     }
 
@@ -2498,6 +2762,10 @@ long SysSelect(RegisterContext* r) {
 
     // for(fs_fd_t* handle : exceptfds);
 
+    if (copySetsToUser()) {
+        return -EFAULT;
+    }
+
     return evCount;
 }
 
@@ -2514,14 +2782,12 @@ long SysSelect(RegisterContext* r) {
 long SysCreateService(RegisterContext* r) {
     Process* currentProcess = Scheduler::GetCurrentProcess();
 
-    size_t nameLength;
-    if (strlenSafe(reinterpret_cast<const char*>(SC_ARG0(r)), nameLength, currentProcess->addressSpace)) {
-        return -EFAULT;
+    char name[PATH_MAX];
+    long nameLength = strncpy_from_user(name, reinterpret_cast<const char*>(SC_ARG0(r)), PATH_MAX);
+    if (nameLength < 0) {
+        return nameLength;
     }
 
-    char name[nameLength + 1];
-    strncpy(name, reinterpret_cast<const char*>(SC_ARG0(r)), nameLength);
-    name[nameLength] = 0;
     for (auto& svc : ServiceFS::Instance()->services) {
         if (strncmp(svc->GetName(), name, nameLength) == 0) {
             return -EEXIST;
@@ -2529,9 +2795,7 @@ long SysCreateService(RegisterContext* r) {
     }
 
     FancyRefPtr<Service> svc = ServiceFS::Instance()->CreateService(name);
-    Handle& handle = Scheduler::RegisterHandle(currentProcess, static_pointer_cast<KernelObject, Service>(svc));
-
-    return handle.id;
+    return Scheduler::RegisterHandle(currentProcess, static_pointer_cast<KernelObject, Service>(svc));
 }
 
 /////////////////////////////
@@ -2559,15 +2823,11 @@ long SysCreateInterface(RegisterContext* r) {
         return -EINVAL;
     }
 
-    size_t nameLength;
-    if (strlenSafe(reinterpret_cast<const char*>(SC_ARG1(r)), nameLength, currentProcess->addressSpace)) {
-        return -EFAULT;
+    char name[PATH_MAX];
+    if (long e = strncpy_from_user(name, reinterpret_cast<const char*>(SC_ARG1(r)), PATH_MAX); e < 0) {
+        return e;
     }
 
-    char name[nameLength + 1];
-    strncpy(name, reinterpret_cast<const char*>(SC_ARG1(r)), nameLength);
-    name[nameLength] = 0;
-
     Service* svc = reinterpret_cast<Service*>(svcHandle->ko.get());
 
     FancyRefPtr<MessageInterface> interface;
@@ -2577,10 +2837,7 @@ long SysCreateInterface(RegisterContext* r) {
         return ret;
     }
 
-    Handle& handle =
-        Scheduler::RegisterHandle(currentProcess, static_pointer_cast<KernelObject, MessageInterface>(interface));
-
-    return handle.id;
+    return Scheduler::RegisterHandle(currentProcess, static_pointer_cast<KernelObject, MessageInterface>(interface));
 }
 
 /////////////////////////////
@@ -2612,10 +2869,14 @@ long SysInterfaceAccept(RegisterContext* r) {
         return ret;
     }
 
-    Handle& handle =
-        Scheduler::RegisterHandle(currentProcess, static_pointer_cast<KernelObject, MessageEndpoint>(endp));
+    handle_id_t id = Scheduler::RegisterHandle(currentProcess, static_pointer_cast<KernelObject, MessageEndpoint>(endp));
+    if (id < 0) {
+        return id;
+    }
+
+    interface->Register(FancyRefPtr<MessageInterface>(ifHandle->ko, interface), endp, id);
 
-    return handle.id;
+    return id;
 }
 
 /////////////////////////////
@@ -2630,15 +2891,11 @@ long SysInterfaceAccept(RegisterContext* r) {
 long SysInterfaceConnect(RegisterContext* r) {
     Process* currentProcess = Scheduler::GetCurrentProcess();
 
-    size_t sz = 0;
-    if (strlenSafe(reinterpret_cast<const char*>(SC_ARG0(r)), sz, currentProcess->addressSpace)) {
-        return -EFAULT;
+    char path[PATH_MAX];
+    if (long e = strncpy_from_user(path, reinterpret_cast<const char*>(SC_ARG0(r)), PATH_MAX); e < 0) {
+        return e;
     }
 
-    char path[sz + 1];
-    strncpy(path, reinterpret_cast<const char*>(SC_ARG0(r)), sz);
-    path[sz] = 0;
-
     if (!strchr(path, '/')) { // Interface name given by '/' separator
         Log::Warning("SysInterfaceConnect: No interface name given!");
         return -EINVAL;
@@ -2661,9 +2918,7 @@ long SysInterfaceConnect(RegisterContext* r) {
         return -EINVAL; // Some error connecting, interface destroyed?
     }
 
-    Handle& handle = Scheduler::RegisterHandle(currentProcess, static_pointer_cast<KernelObject>(endp));
-
-    return handle.id;
+    return Scheduler::RegisterHandle(currentProcess, static_pointer_cast<KernelObject>(endp));
 }
 
 /////////////////////////////
@@ -2770,6 +3025,47 @@ long SysEndpointDequeue(RegisterContext* r) {
                           reinterpret_cast<uint8_t*>(SC_ARG3(r)));
 }
 
+/////////////////////////////
+/// \brief SysInterfaceDequeue (interface, buffer, size, count)
+///
+/// Dequeue messages from every endpoint accepted on an interface
+///
+/// Each record (lemon_message_record_t) is followed by the message data and padded to 8 bytes.
+/// A message is only dequeued if there is space left for one of the maximum message size.
+///
+/// \param interface (handle_id_t) Handle ID of specified interface
+/// \param buffer (uint8_t*) Record buffer
+/// \param size (size_t) Size of buffer
+/// \param count (unsigned) Maximum amount of records
+///
+/// \return Amount of records on success, negative error code on failure
+/////////////////////////////
+long SysInterfaceDequeue(RegisterContext* r) {
+    Process* currentProcess = Scheduler::GetCurrentProcess();
+
+    Handle* ifHandle;
+    if (Scheduler::FindHandle(currentProcess, SC_ARG0(r), &ifHandle)) {
+        Log::Warning("(%s): SysInterfaceDequeue: Invalid handle ID %d", currentProcess->name, SC_ARG0(r));
+        return -EINVAL;
+    }
+
+    if (!ifHandle->ko->IsType(MessageInterface::TypeID())) {
+        Log::Warning("SysInterfaceDequeue: Invalid handle type (ID %d)", SC_ARG0(r));
+        return -EINVAL;
+    }
+
+    size_t size = SC_ARG2(r);
+    if (!Memory::CheckUsermodePointer(SC_ARG1(r), size, currentProcess->addressSpace)) {
+        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, {
+            Log::Warning("(%s): SysInterfaceDequeue: Invalid buffer %x", currentProcess->name, SC_ARG1(r));
+        });
+        return -EFAULT;
+    }
+
+    MessageInterface* interface = reinterpret_cast<MessageInterface*>(ifHandle->ko.get());
+    return interface->Dequeue(currentProcess, reinterpret_cast<uint8_t*>(SC_ARG1(r)), size, SC_ARG3(r));
+}
+
 /////////////////////////////
 /// \brief SysEndpointCall (endpoint, id, data, rID, rData, size, timeout)
 ///
@@ -2800,13 +3096,18 @@ long SysEndpointCall(RegisterContext* r) {
     }
 
     uint16_t* size = reinterpret_cast<uint16_t*>(SC_ARG5(r));
-    if (*size && !Memory::CheckUsermodePointer(SC_ARG2(r), *size, currentProcess->addressSpace)) {
+    uint16_t messageSize;
+    if (get_user(&messageSize, size)) {
+        return -EFAULT; // Invalid size pointer
+    }
+
+    if (messageSize && !Memory::CheckUsermodePointer(SC_ARG2(r), messageSize, currentProcess->addressSpace)) {
         return -EFAULT; // Invalid data pointer
     }
 
     MessageEndpoint* endpoint = reinterpret_cast<MessageEndpoint*>(endpHandle->ko.get());
 
-    return endpoint->Call(SC_ARG1(r), *size, SC_ARG2(r), SC_ARG3(r), size, reinterpret_cast<uint8_t*>(SC_ARG4(r)), -1);
+    return endpoint->Call(SC_ARG1(r), messageSize, SC_ARG2(r), SC_ARG3(r), size, reinterpret_cast<uint8_t*>(SC_ARG4(r)), -1);
 }
 
 /////////////////////////////
@@ -2824,10 +3125,6 @@ long SysEndpointInfo(RegisterContext* r) {
 
     MessageEndpointInfo* info = reinterpret_cast<MessageEndpointInfo*>(SC_ARG1(r));
 
-    if (!Memory::CheckUsermodePointer(SC_ARG1(r), sizeof(MessageEndpointInfo), currentProcess->addressSpace)) {
-        return -EFAULT; // Data greater than 8 and invalid pointer
-    }
-
     Handle* endpHandle;
     if (Scheduler::FindHandle(currentProcess, SC_ARG0(r), &endpHandle)) {
         Log::Warning("SysEndpointInfo: Invalid handle ID %d", SC_ARG0(r));
@@ -2841,8 +3138,7 @@ long SysEndpointInfo(RegisterContext* r) {
 
     MessageEndpoint* endpoint = reinterpret_cast<MessageEndpoint*>(endpHandle->ko.get());
 
-    *info = {.msgSize = endpoint->GetMaxMessageSize()};
-    return 0;
+    return put_user(info, MessageEndpointInfo{.msgSize = endpoint->GetMaxMessageSize()});
 }
 
 /////////////////////////////
@@ -2899,15 +3195,17 @@ long SysKernelObjectWait(RegisterContext* r) {
     unsigned count = SC_ARG1(r);
     long timeout = SC_ARG2(r);
 
-    if (!Memory::CheckUsermodePointer(SC_ARG0(r), count * sizeof(handle_id_t), currentProcess->addressSpace)) {
-        return -EFAULT;
-    }
-
+    const handle_id_t* ids = reinterpret_cast<const handle_id_t*>(SC_ARG0(r));
     Handle* handles[count];
 
     KernelObjectWatcher watcher;
     for (unsigned i = 0; i < count; i++) {
-        if (Scheduler::FindHandle(currentProcess, reinterpret_cast<handle_id_t*>(SC_ARG0(r))[i], &handles[i])) {
+        handle_id_t id;
+        if (get_user(&id, ids + i)) {
+            return -EFAULT;
+        }
+
+        if (Scheduler::FindHandle(currentProcess, id, &handles[i])) {
             IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal,
                      { Log::Warning("SysKernelObjectWait: Invalid handle ID %d", SC_ARG0(r)); });
             return -EINVAL;
@@ -3033,11 +3331,12 @@ long SysGetSocketOptions(RegisterContext* r) {
         return -ENOTSOCK; //  Not a socket
     }
 
-    if (!Memory::CheckUsermodePointer(SC_ARG4(r), sizeof(socklen_t), currentProcess->addressSpace)) {
+    socklen_t optBufferLen;
+    if (get_user(&optBufferLen, optLen)) {
         return -EFAULT;
     }
 
-    if (*optLen && !Memory::CheckUsermodePointer(SC_ARG3(r), *optLen, currentProcess->addressSpace)) {
+    if (optBufferLen && !Memory::CheckUsermodePointer(SC_ARG3(r), optBufferLen, currentProcess->addressSpace)) {
         return -EFAULT;
     }
 
@@ -3066,11 +3365,9 @@ long SysDeviceManagement(RegisterContext* r) {
 
     switch (request) {
     case DeviceManager::RequestDeviceResolveFromPath: {
-        const char* path = reinterpret_cast<const char*>(SC_ARG1(r));
-
-        size_t pathLen;
-        if (strlenSafe(path, pathLen, process->addressSpace)) {
-            return -EFAULT;
+        char path[PATH_MAX];
+        if (long e = strncpy_from_user(path, reinterpret_cast<const char*>(SC_ARG1(r)), PATH_MAX); e < 0) {
+            return e;
         }
 
         Device* dev = DeviceManager::ResolveDevice(path);
@@ -3085,34 +3382,26 @@ long SysDeviceManagement(RegisterContext* r) {
         char* name = reinterpret_cast<char*>(SC_ARG2(r));
         size_t nameBufferSize = SC_ARG3(r);
 
-        if (!Memory::CheckUsermodePointer(SC_ARG2(r), nameBufferSize, process->addressSpace)) {
-            return -EFAULT;
-        }
-
         Device* dev = DeviceManager::DeviceFromID(deviceID);
         if (!dev) {
             return -ENOENT;
         }
 
-        strncpy(name, dev->DeviceName(), nameBufferSize);
-        return 0;
+        size_t nameLength = strlen(dev->DeviceName()) + 1;
+        return copy_to_user(name, dev->DeviceName(), nameLength < nameBufferSize ? nameLength : nameBufferSize);
     }
     case DeviceManager::RequestDeviceGetInstanceName: {
         int64_t deviceID = SC_ARG1(r);
         char* name = reinterpret_cast<char*>(SC_ARG2(r));
         size_t nameBufferSize = SC_ARG3(r);
 
-        if (!Memory::CheckUsermodePointer(SC_ARG2(r), nameBufferSize, process->addressSpace)) {
-            return -EFAULT;
-        }
-
         Device* dev = DeviceManager::DeviceFromID(deviceID);
         if (!dev) {
             return -ENOENT;
         }
 
-        strncpy(name, dev->InstanceName(), nameBufferSize);
-        return 0;
+        size_t nameLength = strlen(dev->InstanceName()) + 1;
+        return copy_to_user(name, dev->InstanceName(), nameLength < nameBufferSize ? nameLength : nameBufferSize);
     }
     case DeviceManager::RequestDeviceGetPCIInformation:
         return -ENOSYS;
@@ -3175,16 +3464,12 @@ long SysLoadKernelModule(RegisterContext* r) {
         return -EPERM; // Must be root
     }
 
-    size_t filePathLength;
-    long filePathInvalid = strlenSafe(reinterpret_cast<char*>(SC_ARG0(r)), filePathLength, process->addressSpace);
-    if (filePathInvalid) {
-        Log::Warning("SysLoadKernelModule: Reached unallocated memory reading file path");
-        return -EFAULT;
+    char filepath[PATH_MAX];
+    if (long e = strncpy_from_user(filepath, reinterpret_cast<const char*>(SC_ARG0(r)), PATH_MAX); e < 0) {
+        Log::Warning("SysLoadKernelModule: Failed to read file path");
+        return e;
     }
 
-    char filepath[filePathLength + 1];
-    strncpy(filepath, (char*)SC_ARG0(r), filePathLength);
-
     ModuleLoadStatus status = ModuleManager::LoadModule(filepath);
     if (status.status != ModuleLoadStatus::ModuleOK) {
         return -EINVAL;
@@ -3209,16 +3494,12 @@ long SysUnloadKernelModule(RegisterContext* r) {
         return -EPERM; // Must be root
     }
 
-    size_t nameLength;
-    long nameInvalid = strlenSafe(reinterpret_cast<char*>(SC_ARG0(r)), nameLength, process->addressSpace);
-    if (nameInvalid) {
-        Log::Warning("SysUnloadKernelModule: Reached unallocated memory reading file path");
-        return -EFAULT;
+    char name[NAME_MAX + 1];
+    if (long e = strncpy_from_user(name, reinterpret_cast<const char*>(SC_ARG0(r)), NAME_MAX + 1); e < 0) {
+        Log::Warning("SysUnloadKernelModule: Failed to read module name");
+        return e;
     }
 
-    char name[nameLength + 1];
-    strncpy(name, (char*)SC_ARG0(r), nameLength);
-
     return ModuleManager::UnloadModule(name);
 }
 
@@ -3237,9 +3518,12 @@ long SysFork(RegisterContext* r) {
     Process* newProcess = Scheduler::CloneProcess(process);
     Thread* thread = newProcess->threads.get_front();
     void* threadKStack = thread->kernelStack; // Save the allocated kernel stack
+    void* threadFxState = thread->fxState;
 
     *thread = *currentThread;
     thread->kernelStack = threadKStack;
+    thread->fxState = threadFxState;
+    FPU::Fork(currentThread, thread);
     thread->state = ThreadStateRunning;
     thread->parent = newProcess;
     thread->registers = *r;
@@ -3254,18 +3538,16 @@ long SysFork(RegisterContext* r) {
 
     thread->registers.rax = 0; // To the child we return 0
 
-    newProcess->fileDescriptors.resize(process->fileDescriptors.get_length());
-    for (unsigned i = 0; i < process->fileDescriptors.get_length(); i++) {
-        fs_fd_t* fd = process->fileDescriptors[i];
-        if (fd) {
-            fs_fd_t* newFd = fs::Open(fd->node);
-            newFd->pos = fd->pos;
-            newFd->mode = fd->mode;
+    process->fileDescriptors.ForEach([newProcess](int i, fs_fd_t* fd) {
+        fs_fd_t* newFd = fs::Open(fd->node);
+        newFd->pos = fd->pos;
+        newFd->mode = fd->mode;
 
-            newProcess->fileDescriptors[i] = newFd;
-        } else {
-            newProcess->fileDescriptors[i] = nullptr;
-        }
+        newProcess->ReplaceFileDescriptor(i, newFd);
+    });
+
+    if (process->vdso) {
+        newProcess->vdso = VDSO::Map(newProcess, process->vdso->Base()); // Our own process page
     }
 
     Scheduler::StartProcess(newProcess);
@@ -3352,25 +3634,24 @@ long SysGetEntropy(RegisterContext* r) {
         return -EIO;
     }
 
-    uint8_t* buffer = reinterpret_cast<uint8_t*>(SC_ARG0(r));
-    if (!Memory::CheckUsermodePointer(SC_ARG0(r), length, Scheduler::GetCurrentProcess()->addressSpace)) {
-        return -EFAULT; // buffer is invalid
-    }
+    uint8_t entropy[256];
+    uint8_t* buffer = entropy;
+    size_t remaining = length;
 
-    while (length >= 8) {
+    while (remaining >= 8) {
         uint64_t value = Hash<uint64_t>(rand() % 65535 * Timer::GetTicks());
 
-        *(reinterpret_cast<uint64_t*>(buffer)) = value;
+        memcpy(buffer, &value, sizeof(uint64_t));
         buffer += 8;
-        length -= 8;
+        remaining -= 8;
     }
 
-    if (length > 0) {
+    if (remaining > 0) {
         uint64_t value = Hash<uint64_t>(rand() % 65535 * Timer::GetTicks());
-        memcpy(buffer, &value, length);
+        memcpy(buffer, &value, remaining);
     }
 
-    return 0;
+    return copy_to_user(reinterpret_cast<void*>(SC_ARG0(r)), entropy, length);
 }
 
 /////////////////////////////
@@ -3391,7 +3672,7 @@ long SysSocketPair(RegisterContext* r) {
     int protocol = SC_ARG2(r);
     int* sv = reinterpret_cast<int*>(SC_ARG3(r));
 
-    if (!Memory::CheckUsermodePointer(SC_ARG3(r), sizeof(int) * 2, process->addressSpace)) {
+    if (!Memory::IsUsermodeRange(SC_ARG3(r), sizeof(int) * 2)) {
         Log::Warning("SysSocketPair: Invalid fd array!");
         return -EFAULT;
     }
@@ -3417,10 +3698,17 @@ long SysSocketPair(RegisterContext* r) {
     s1Handle->mode = nonBlock * O_NONBLOCK;
     s2Handle->mode = s1Handle->mode;
 
-    sv[0] = process->AllocateFileDescriptor(s1Handle);
-    sv[1] = process->AllocateFileDescriptor(s2Handle);
+    int fds[2];
+    fds[0] = process->AllocateFileDescriptor(s1Handle);
+    fds[1] = process->AllocateFileDescriptor(s2Handle);
 
     assert(s1->IsConnected() && s2->IsConnected());
+    if (copy_to_user(sv, fds, sizeof(fds))) {
+        process->DestroyFileDescriptor(fds[0]);
+        process->DestroyFileDescriptor(fds[1]);
+        return -EFAULT;
+    }
+
     return 0;
 }
 
@@ -3485,33 +3773,30 @@ long SysSignalAction(RegisterContext* r) {
     }
     assert(signal < SIGNAL_MAX);
 
-    const sigaction* sa = reinterpret_cast<sigaction*> SC_ARG1(r); // If non-null, new sigaction to set
-    sigaction* oldSA = reinterpret_cast<sigaction*> SC_ARG2(r);    // If non-null, filled with old sigaction
+    const sigaction* userSA = reinterpret_cast<sigaction*> SC_ARG1(r); // If non-null, new sigaction to set
+    sigaction* oldSA = reinterpret_cast<sigaction*> SC_ARG2(r);        // If non-null, filled with old sigaction
 
     Process* proc = Scheduler::GetCurrentProcess();
 
-    if (sa && !Scheduler::CheckUsermodePointer(sa)) {
+    sigaction newSA;
+    if (userSA && get_user(&newSA, userSA)) {
         Log::Debug(debugLevelSyscalls, DebugLevelNormal, "SysSignalAction: Invalid sigaction pointer!");
         return -EFAULT;
     }
 
     if (oldSA) {
-        if (!Scheduler::CheckUsermodePointer(oldSA)) {
-            Log::Debug(debugLevelSyscalls, DebugLevelNormal, "SysSignalAction: Invalid old sigaction pointer!");
-            return -EFAULT;
-        }
-
+        sigaction old;
         const SignalHandler& sigHandler = proc->signalHandlers[signal - 1];
         if (sigHandler.action == SignalHandler::ActionUsermodeHandler) {
             if (sigHandler.flags & SignalHandler::FlagSignalInfo) {
-                *oldSA = {
+                old = {
                     .sa_handler = nullptr,
                     .sa_mask = sigHandler.mask,
                     .sa_flags = sigHandler.flags,
                     .sa_sigaction = reinterpret_cast<void (*)(int, siginfo_t*, void*)>(sigHandler.userHandler),
                 };
             } else {
-                *oldSA = {
+                old = {
                     .sa_handler = reinterpret_cast<void (*)(int)>(sigHandler.userHandler),
                     .sa_mask = sigHandler.mask,
                     .sa_flags = sigHandler.flags,
@@ -3519,14 +3804,14 @@ long SysSignalAction(RegisterContext* r) {
                 };
             }
         } else if (sigHandler.action == SignalHandler::ActionDefault) {
-            *oldSA = {
+            old = {
                 .sa_handler = SIG_DFL,
                 .sa_mask = sigHandler.mask,
                 .sa_flags = sigHandler.flags,
                 .sa_sigaction = nullptr,
             };
         } else if (sigHandler.action == SignalHandler::ActionIgnore) {
-            *oldSA = {
+            old = {
                 .sa_handler = SIG_IGN,
                 .sa_mask = sigHandler.mask,
                 .sa_flags = sigHandler.flags,
@@ -3536,31 +3821,36 @@ long SysSignalAction(RegisterContext* r) {
             Log::Error("Invalid signal action!");
             assert(!"Invalid signal action");
         }
+
+        if (put_user(oldSA, old)) {
+            Log::Debug(debugLevelSyscalls, DebugLevelNormal, "SysSignalAction: Invalid old sigaction pointer!");
+            return -EFAULT;
+        }
     }
 
-    if (!sa) {
+    if (!userSA) {
         return 0; // sa not specified, nothing left to do
     }
 
-    if (sa->sa_flags & (~SignalHandler::supportedFlags)) {
-        Log::Error("SysSignalAction: (sig %d) sa_flags %x not supported!", signal, sa->sa_flags);
+    if (newSA.sa_flags & (~SignalHandler::supportedFlags)) {
+        Log::Error("SysSignalAction: (sig %d) sa_flags %x not supported!", signal, newSA.sa_flags);
         return -EINVAL;
     }
 
     SignalHandler handler;
-    if (sa->sa_handler == SIG_DFL) {
+    if (newSA.sa_handler == SIG_DFL) {
         handler.action = SignalHandler::ActionDefault;
-    } else if (sa->sa_handler == SIG_IGN) {
+    } else if (newSA.sa_handler == SIG_IGN) {
         handler.action = SignalHandler::ActionIgnore;
     } else {
         handler.action = SignalHandler::ActionUsermodeHandler;
-        if (sa->sa_flags & SignalHandler::FlagSignalInfo) {
-            handler.userHandler = (void*)sa->sa_sigaction;
+        if (newSA.sa_flags & SignalHandler::FlagSignalInfo) {
+            handler.userHandler = (void*)newSA.sa_sigaction;
         } else {
-            handler.userHandler = (void*)sa->sa_handler;
+            handler.userHandler = (void*)newSA.sa_handler;
         }
     }
-    handler.mask = sa->sa_mask;
+    handler.mask = newSA.sa_mask;
 
     proc->signalHandlers[signal - 1] = handler;
     return 0;
@@ -3714,6 +4004,11 @@ syscall_t syscalls[NUM_SYSCALLS]{
     SysProcMask,
     SysKill,
     SysSignalReturn, // 105
+    SysMsync,
+    SysMadvise,
+    SysSplice,
+    SysInterfaceDequeue,
+    SysClockGetTime, // 110
 };
 
 void DumpLastSyscall(Thread* t) {
@@ -19,9 +19,9 @@ void InitializeTSS(tss_t* tss, void* gdt) {
     tss->ist3 = (uint64_t)Memory::KernelAllocate4KPages(8);
 
     for (unsigned i = 0; i < 8; i++) {
-        Memory::KernelMapVirtualMemory4K(Memory::AllocatePhysicalMemoryBlock(), tss->ist1 + 8 * PAGE_SIZE_4K, 1);
-        Memory::KernelMapVirtualMemory4K(Memory::AllocatePhysicalMemoryBlock(), tss->ist2 + 8 * PAGE_SIZE_4K, 1);
-        Memory::KernelMapVirtualMemory4K(Memory::AllocatePhysicalMemoryBlock(), tss->ist3 + 8 * PAGE_SIZE_4K, 1);
+        Memory::KernelMapVirtualMemory4K(Memory::AllocatePhysicalMemoryBlock(), tss->ist1 + i * PAGE_SIZE_4K, 1);
+        Memory::KernelMapVirtualMemory4K(Memory::AllocatePhysicalMemoryBlock(), tss->ist2 + i * PAGE_SIZE_4K, 1);
+        Memory::KernelMapVirtualMemory4K(Memory::AllocatePhysicalMemoryBlock(), tss->ist3 + i * PAGE_SIZE_4K, 1);
     }
 
     memset((void*)tss->ist1, 0, PAGE_SIZE_4K);
@@ -44,7 +44,7 @@ void Thread::Signal(int signal) {
     pendingSignals |= 1 << (signal - 1); // Set corresponding bit for signal
 
     // TODO: Race condition?
-    if (blocker && state == ThreadStateBlocked) {
+    if (blocker && state == ThreadStateBlocked && blocker->IsInterruptible()) {
         blocker->Interrupt(); // Stop the thread from blocking
     }
 }
@@ -182,7 +182,7 @@ bool Thread::Block(ThreadBlocker* newBlocker) {
         return false;
     }
 
-    if (pendingSignals & (~signalMask)) {
+    if (newBlocker->IsInterruptible() && (pendingSignals & (~signalMask))) {
         releaseLock(&newBlocker->lock); // Pending signals, don't block
         asm("sti");
 
@@ -285,4 +285,11 @@ void Thread::Unblock() {
 
     if (state != ThreadStateZombie)
         state = ThreadStateRunning;
+
+    // Pairs with the fence in Scheduler::Schedule, either the CPU sees the new state
+    // or we see that it has gone idle and wake it
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (cpu && cpu->IsIdle()) {
+        Scheduler::WakeCPU(cpu);
+    }
 }
\ No newline at end of file
@@ -6,98 +6,195 @@
 #include <APIC.h>
 #include <CPU.h>
 #include <IDT.h>
-#include <List.h>
 #include <Logging.h>
+#include <Profiler.h>
 #include <Scheduler.h>
 #include <System.h>
+#include <VDSO.h>
+
+#define PIT_FREQUENCY 1193182
+#define TSC_CALIBRATION_MS 50
+
+#define LOCAL_APIC_TIMER_MASKED (1 << 16)
+#define LOCAL_APIC_TIMER_DIVIDE_16 0x3
 
 namespace Timer {
-int frequency;         // Timer frequency
-long ticks = 0;        // Timer tick counter
-long pendingTicks = 0; // If the sleep queue is locked add ticks here
-long long uptime = 0;  // System uptime in seconds since the timer was initialized
+int frequency;       // Scheduler tick frequency
+uint64_t tickNs = 0; // Length of a scheduler tick in nanoseconds
 
-lock_t sleepQueueLock = 0;
+uint64_t tscFrequency = 0; // TSC ticks per second
+uint64_t tscBase = 0;      // TSC value when the timer was initialized
+uint64_t tscMultiplier;    // Nanoseconds per TSC tick as 32.32 fixed point
 
-// In the sleep queue, all waiting threads have a counter as an offset from the previous waiting thread.
-// For example there are 2 threads, thread 1 is waiting for 10 ticks and thread 2 is waiting for 15 ticks.
-// Thread 1's ticks value will be 10, and as 15 - 10 is 5, thread 2's value will be 5 so it waits 5 ticks after thread 1
-FastList<TimerEvent*> sleeping;
+uint64_t localTimerFrequency = 0; // Local APIC timer ticks per second
+uint64_t localTimerMultiplier;    // Local APIC timer ticks per nanosecond as 32.32 fixed point
 
-TimerEvent::TimerEvent(long _us, void (*_callback)(void*), void* _data)
-    : ticks(_us * frequency / 1000000), callback(_callback), data(_data) {
-    if (ticks <= 0) {
-        callback(data);
-        return;
-    }
+void TimerQueue::Insert(TimerEvent* ev) {
+    ev->child = ev->sibling = ev->prev = nullptr;
 
-    acquireLock(&sleepQueueLock);
+    m_root = Meld(m_root, ev);
+}
 
-    TimerEvent* ev = sleeping.get_front();
-    while (ev) {
-        if (ev->ticks >= ticks) { // See if we need to insert in middle of queue
-            ev->ticks -= ticks;
-            sleeping.insert(this, ev); // Insert before
+void TimerQueue::Remove(TimerEvent* ev) {
+    if (ev == m_root) {
+        m_root = MergePairs(ev->child);
+    } else {
+        // Unlink from the parent or previous sibling
+        if (ev->prev->child == ev) {
+            ev->prev->child = ev->sibling;
+        } else {
+            ev->prev->sibling = ev->sibling;
+        }
 
-            releaseLock(&sleepQueueLock);
-            return;
+        if (ev->sibling) {
+            ev->sibling->prev = ev->prev;
         }
 
-        ticks -= ev->ticks;
-        ev = ev->next;
+        m_root = Meld(m_root, MergePairs(ev->child));
+    }
 
-        if (ev == sleeping.get_front()) {
-            break;
-        }
+    ev->child = ev->sibling = ev->prev = nullptr;
+}
+
+// Both events are expected to be roots (no siblings)
+TimerEvent* TimerQueue::Meld(TimerEvent* a, TimerEvent* b) {
+    if (!a) {
+        return b;
+    } else if (!b) {
+        return a;
     }
 
-    sleeping.add_back(this); // Add to back
-    releaseLock(&sleepQueueLock);
+    if (b->deadline < a->deadline) {
+        TimerEvent* temp = a;
+        a = b;
+        b = temp;
+    }
+
+    // b becomes the first child of a
+    b->prev = a;
+    b->sibling = a->child;
+    if (a->child) {
+        a->child->prev = b;
+    }
+    a->child = b;
+
+    return a;
 }
 
-TimerEvent::~TimerEvent() {
-    acquireLock(&sleepQueueLock);
-    acquireLock(&lock);
+TimerEvent* TimerQueue::MergePairs(TimerEvent* first) {
+    if (!first) {
+        return nullptr;
+    }
 
-    if (!dispatched) {
-        dispatched = true;
+    // Meld the children in pairs from left to right,
+    // keeping the results in a stack linked through sibling
+    TimerEvent* pairs = nullptr;
+    while (first) {
+        TimerEvent* a = first;
+        TimerEvent* b = a->sibling;
 
-        if (next) {
-            if (next && ticks >= 0 && next != sleeping.get_front()) { // Make sure not at end of list
-                next->ticks += ticks;
-            }
+        first = b ? b->sibling : nullptr;
 
-            sleeping.remove(this); // Remove from queue
+        a->sibling = a->prev = nullptr;
+        if (b) {
+            b->sibling = b->prev = nullptr;
+            a = Meld(a, b);
         }
+
+        a->sibling = pairs;
+        pairs = a;
     }
 
-    releaseLock(&sleepQueueLock);
-    releaseLock(&lock);
-}
+    // Then meld the pairs from right to left
+    TimerEvent* root = pairs;
+    pairs = pairs->sibling;
+    root->sibling = nullptr;
+
+    while (pairs) {
+        TimerEvent* next = pairs->sibling;
+        pairs->sibling = nullptr;
 
-void TimerEvent::Dispatch() {
-    acquireLock(&lock);
-    if (!dispatched) {
-        dispatched = true;
-        sleeping.remove(this);
+        root = Meld(root, pairs);
+        pairs = next;
+    }
+
+    return root;
+}
 
+TimerEvent::TimerEvent(long _us, void (*_callback)(void*), void* _data) : callback(_callback), data(_data) {
+    if (_us <= 0) {
+        state = TimerEventDispatched;
         callback(data);
+        return;
+    }
+
+    deadline = GetSystemUptimeNs() + _us * 1000;
+
+    int intEnable = CheckInterrupts();
+    asm("cli");
+
+    CPU* cpu = GetCPULocal();
+    queue = &cpu->timers;
+
+    queue->lock.Acquire();
+    queue->Insert(this);
+
+    ArmLocalTimer(cpu, deadline);
+    queue->lock.Release();
+
+    if (intEnable) {
+        asm("sti");
+    }
+}
+
+TimerEvent::~TimerEvent() {
+    if (Dispatched()) {
+        return; // Most events are only destroyed after they fire, leave the queue alone
+    }
+
+    int intEnable = CheckInterrupts();
+    asm("cli");
+
+    queue->lock.Acquire();
+
+    if (state == TimerEventPending) {
+        // Should the event have been at the front, the local timer will fire early and just be rearmed
+        queue->Remove(this);
+        __atomic_store_n(&state, TimerEventDispatched, __ATOMIC_RELAXED);
+    }
+
+    queue->lock.Release();
+
+    if (intEnable) {
+        asm("sti");
+    }
+
+    // The callback is running on the CPU the event was armed on, wait for it
+    while (!Dispatched()) {
+        asm volatile("pause");
     }
-    releaseLock(&lock);
 }
 
-uint64_t GetSystemUptime() { return uptime; }
+uint64_t GetSystemUptimeNs() {
+    uint64_t elapsed = __builtin_ia32_rdtsc() - tscBase;
 
-uint32_t GetTicks() { return ticks; }
+    return (static_cast<unsigned __int128>(elapsed) * tscMultiplier) >> 32;
+}
+
+uint64_t GetSystemUptime() { return GetSystemUptimeNs() / 1000000000; }
+
+uint32_t GetTicks() { return (GetSystemUptimeNs() % 1000000000) * frequency / 1000000000; }
 
 uint32_t GetFrequency() { return frequency; }
 
-inline uint64_t UsToTicks(long us) { return us * frequency / 1000000; }
+uint64_t GetTSCFrequency() { return tscFrequency; }
 
 timeval GetSystemUptimeStruct() {
+    uint64_t ns = GetSystemUptimeNs();
+
     timeval tval;
-    tval.tv_sec = uptime;
-    tval.tv_usec = ticks * 1000000 / frequency;
+    tval.tv_sec = ns / 1000000000;
+    tval.tv_usec = (ns % 1000000000) / 1000;
     return tval;
 }
 
@@ -113,61 +210,145 @@ void SleepCurrentThread(timeval& time) { Scheduler::GetCurrentThread()->Sleep(ti
 void Wait(long ms) {
     assert(ms > 0);
 
-    uint64_t timeMs = uptime * 1000 + (ticks * frequency / 1000);
-    while ((uptime * 1000 + (ticks * frequency / 1000)) - timeMs <= static_cast<unsigned long>(ms))
-        ;
+    uint64_t end = GetSystemUptimeNs() + ms * 1000000;
+    while (GetSystemUptimeNs() < end) {
+        asm volatile("pause");
+    }
 }
 
-// Timer handler
-void Handler(void*, RegisterContext* r) {
-    ticks++;
-    if (ticks >= frequency) {
-        uptime++;
-        ticks -= frequency;
+void ArmLocalTimer(CPU* cpu, uint64_t deadline) {
+    if (deadline >= cpu->timerDeadline) {
+        return; // Timer will fire before then anyway
     }
 
-    pendingTicks++;
-    if (!(acquireTestLock(&sleepQueueLock))) {
-        while (sleeping.get_length() &&
-               pendingTicks-- >
-                   0) { // Make sure the queue has not changed inbetween checking the length and acquiring the lock
-            TimerEvent* cnt = sleeping.get_front();
-
-            assert(cnt);
-            cnt->ticks--;
+    cpu->timerDeadline = deadline;
 
-            if (cnt->ticks <= 0) {
-                sleeping.get_front()->Dispatch();
+    uint64_t now = GetSystemUptimeNs();
+    uint64_t count = 1;
+    if (deadline > now) {
+        // Keep the multiplication from overflowing, if the count gets clamped the timer is just rearmed when it fires
+        uint64_t delta = deadline - now;
+        if (delta > 10000000000) {
+            delta = 10000000000;
+        }
 
-                while (sleeping.get_length() && sleeping.get_front()->ticks <= 0) {
-                    sleeping.get_front()->Dispatch();
-                }
-            }
+        count = (static_cast<unsigned __int128>(delta) * localTimerMultiplier) >> 32;
+        if (count > UINT32_MAX) {
+            count = UINT32_MAX;
+        } else if (!count) {
+            count = 1;
         }
-        pendingTicks = 0;
+    }
+
+    APIC::Local::Write(LOCAL_APIC_TIMER_INITIAL_COUNT, count);
+}
+
+void ArmTimeSlice(CPU* cpu) {
+    if (!cpu->IsIdle()) {
+        cpu->sliceDeadline = GetSystemUptimeNs() + tickNs;
+        ArmLocalTimer(cpu, cpu->sliceDeadline);
+    }
+}
+
+// Local APIC timer handler
+void Handler(void*, RegisterContext* r) {
+    CPU* cpu = GetCPULocal();
+    cpu->timerDeadline = UINT64_MAX; // One-shot timer, nothing is armed anymore
+
+    uint64_t now = GetSystemUptimeNs();
+    VDSO::UpdateTime(now);
+
+    TimerQueue& queue = cpu->timers;
+    queue.lock.Acquire();
+
+    TimerEvent* ev;
+    while ((ev = queue.Front()) && ev->deadline <= now) {
+        queue.Remove(ev);
+
+        // The event cannot be destroyed until it is marked dispatched
+        ev->state = TimerEvent::TimerEventDispatching;
+        queue.lock.Release();
+
+        TimerCallback callback = ev->callback;
+        void* data = ev->data;
+        callback(data);
+
+        __atomic_store_n(&ev->state, TimerEvent::TimerEventDispatched, __ATOMIC_RELEASE);
+        queue.lock.Acquire();
+    }
+
+    if (ev) {
+        ArmLocalTimer(cpu, ev->deadline);
+    }
 
-        releaseLock(&sleepQueueLock);
+    queue.lock.Release();
+
+    if (Profiler::IsRunning()) {
+        Profiler::Tick(cpu, r, now);
     }
 
     Scheduler::Tick(r);
 }
 
+// Measure the TSC frequency against PIT channel 2, which can be polled without interrupts
+static uint64_t CalibrateTSC() {
+    const uint16_t latch = PIT_FREQUENCY * TSC_CALIBRATION_MS / 1000;
+
+    outportb(0x61, (inportb(0x61) & ~0x02) | 0x01); // Gate channel 2 on, speaker off
+
+    outportb(0x43, 0xB0); // Channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count)
+    outportb(0x42, latch & 0xFF);
+    outportb(0x42, latch >> 8);
+
+    uint64_t start = __builtin_ia32_rdtsc();
+    while (!(inportb(0x61) & 0x20))
+        ; // Wait for the output to go high
+    uint64_t end = __builtin_ia32_rdtsc();
+
+    return (end - start) * 1000 / TSC_CALIBRATION_MS;
+}
+
 // Initialize
 void Initialize(uint32_t freq) {
-    IDT::RegisterInterruptHandler(IRQ0, Handler);
-
     frequency = freq;
-    uint32_t divisor = 1193182 / freq;
+    tickNs = 1000000000 / freq;
 
-    // Send the command byte.
-    outportb(0x43, 0x36);
+    tscFrequency = CalibrateTSC();
+    tscMultiplier = (1000000000ULL << 32) / tscFrequency;
+    tscBase = __builtin_ia32_rdtsc();
 
-    // Divisor has to be sent byte-wise, so split here into upper/lower bytes.
-    uint8_t l = divisor & 0xff;
-    uint8_t h = divisor >> 8;
+    VDSO::Initialize(tscBase, tscMultiplier);
+
+    // The PIT is only used for calibration,
+    // put channel 0 in one-shot mode so it stops firing
+    IDT::RegisterInterruptHandler(IRQ0, [](void*, RegisterContext*) {});
+
+    outportb(0x43, 0x30); // Channel 0, lobyte/hibyte, mode 0
+    outportb(0x40, 0);
+    outportb(0x40, 0);
+}
+
+void InitializeLocalTimer() {
+    APIC::Local::Write(LOCAL_APIC_TIMER_DIVIDE, LOCAL_APIC_TIMER_DIVIDE_16);
+
+    if (!localTimerFrequency) {
+        APIC::Local::Write(LOCAL_APIC_LVT_TIMER, LOCAL_APIC_TIMER_MASKED);
+        APIC::Local::Write(LOCAL_APIC_TIMER_INITIAL_COUNT, UINT32_MAX);
+
+        Wait(10);
+
+        uint32_t elapsed = UINT32_MAX - APIC::Local::Read(LOCAL_APIC_TIMER_CURRENT_COUNT);
+        APIC::Local::Write(LOCAL_APIC_TIMER_INITIAL_COUNT, 0);
+
+        localTimerFrequency = elapsed * 100ULL;
+        localTimerMultiplier = (localTimerFrequency << 32) / 1000000000;
+
+        Log::Info("[Timer] TSC: %u kHz, Local APIC timer: %u kHz", tscFrequency / 1000, localTimerFrequency / 1000);
+
+        IDT::RegisterInterruptHandler(IRQ_LOCAL_TIMER, Handler);
+    }
 
-    // Send the frequency divisor.
-    outportb(0x40, l);
-    outportb(0x40, h);
+    // One-shot mode, armed on demand
+    APIC::Local::Write(LOCAL_APIC_LVT_TIMER, IRQ_LOCAL_TIMER);
 }
 } // namespace Timer
@@ -0,0 +1,65 @@
+BITS 64
+
+; Routines for accessing user memory.
+; Instructions that touch user memory are listed in the exception table,
+; on a page fault that cannot be resolved the page fault handler resumes at the fixup.
+
+global UserCopy
+global UserStrncpy
+global UserStrnlen
+
+section .text
+
+; size_t UserCopy(void* dest, const void* src, size_t count)
+; Returns the amount of bytes that were not copied
+UserCopy:
+    cld
+    mov rcx, rdx
+.copy:
+    rep movsb
+.fault: ; RCX holds the amount of bytes left
+    mov rax, rcx
+    ret
+
+; long UserStrncpy(char* dest, const char* src, size_t max)
+; Returns the length of the string, max if it was not terminated within max bytes or -1 on fault
+UserStrncpy:
+    xor eax, eax
+.next:
+    cmp rax, rdx
+    je .done
+.load:
+    movzx ecx, byte [rsi + rax]
+    mov byte [rdi + rax], cl
+    test cl, cl
+    jz .done
+    inc rax
+    jmp .next
+.done:
+    ret
+.fault:
+    mov rax, -1
+    ret
+
+; long UserStrnlen(const char* str, size_t max)
+; Returns the length of the string, max if it was not terminated within max bytes or -1 on fault
+UserStrnlen:
+    xor eax, eax
+.next:
+    cmp rax, rsi
+    je .done
+.load:
+    cmp byte [rdi + rax], 0
+    je .done
+    inc rax
+    jmp .next
+.done:
+    ret
+.fault:
+    mov rax, -1
+    ret
+
+section .ex_table progbits alloc noexec nowrite align=8
+    dq UserCopy.copy, UserCopy.fault
+    dq UserStrncpy.load, UserStrncpy.fault
+    dq UserStrnlen.load, UserStrnlen.fault
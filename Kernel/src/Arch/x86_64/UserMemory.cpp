@@ -0,0 +1,91 @@
+#include <UserMemory.h>
+
+#include <Errno.h>
+
+extern "C" size_t UserCopy(void* dest, const void* src, size_t count);
+extern "C" long UserStrncpy(char* dest, const char* src, size_t max);
+extern "C" long UserStrnlen(const char* str, size_t max);
+
+// Defined in the linker script, the entries come from UserMemory.asm
+extern exception_fixup_t _ex_table_start[];
+extern exception_fixup_t _ex_table_end[];
+
+namespace Memory {
+uintptr_t FindExceptionFixup(uintptr_t rip) {
+    for (exception_fixup_t* entry = _ex_table_start; entry < _ex_table_end; entry++) {
+        if (entry->instruction == rip) {
+            return entry->fixup;
+        }
+    }
+
+    return 0;
+}
+} // namespace Memory
+
+long copy_from_user(void* dest, const void* src, size_t size) {
+    if (!Memory::IsUsermodeRange(reinterpret_cast<uintptr_t>(src), size)) {
+        return -EFAULT;
+    }
+
+    if (UserCopy(dest, src, size)) {
+        return -EFAULT;
+    }
+
+    return 0;
+}
+
+long copy_to_user(void* dest, const void* src, size_t size) {
+    if (!Memory::IsUsermodeRange(reinterpret_cast<uintptr_t>(dest), size)) {
+        return -EFAULT;
+    }
+
+    if (UserCopy(dest, src, size)) {
+        return -EFAULT;
+    }
+
+    return 0;
+}
+
+long strncpy_from_user(char* dest, const char* src, size_t max) {
+    // The string may end anywhere, so only make sure it starts in usermode
+    // and stop at the end of usermode
+    uintptr_t base = reinterpret_cast<uintptr_t>(src);
+    if (!max || !Memory::IsUsermodeRange(base, 1)) {
+        return -EFAULT;
+    }
+
+    size_t limit = max;
+    if (!Memory::IsUsermodeRange(base, limit)) {
+        limit = PDPT_SIZE - base;
+    }
+
+    long len = UserStrncpy(dest, src, limit);
+    if (len < 0) {
+        return -EFAULT;
+    } else if (static_cast<size_t>(len) == limit) {
+        return limit == max ? -ENAMETOOLONG : -EFAULT;
+    }
+
+    return len;
+}
+
+long strnlen_user(const char* str, size_t max) {
+    uintptr_t base = reinterpret_cast<uintptr_t>(str);
+    if (!max || !Memory::IsUsermodeRange(base, 1)) {
+        return -EFAULT;
+    }
+
+    size_t limit = max;
+    if (!Memory::IsUsermodeRange(base, limit)) {
+        limit = PDPT_SIZE - base;
+    }
+
+    long len = UserStrnlen(str, limit);
+    if (len < 0) {
+        return -EFAULT;
+    } else if (static_cast<size_t>(len) == limit) {
+        return limit == max ? -ENAMETOOLONG : -EFAULT;
+    }
+
+    return len;
+}
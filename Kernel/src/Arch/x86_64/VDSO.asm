@@ -0,0 +1,137 @@
+BITS 64
+
+; Code run in user mode, copied into the vDSO region of every process.
+; Everything is position independent, the time and process pages come right before the code.
+
+%define TIME_PAGE vdsoStart - 0x2000
+%define PROCESS_PAGE vdsoStart - 0x1000
+
+; lemon_vdso_time_page_t
+%define TIME_SEQUENCE 0
+%define TIME_TSC_BASE 8
+%define TIME_TSC_MULTIPLIER 16
+%define TIME_COARSE_NS 24
+%define TIME_REALTIME_OFFSET 32
+
+; lemon_vdso_process_page_t
+%define PROCESS_PID 0
+
+%define CLOCK_REALTIME 0
+%define CLOCK_MONOTONIC 1
+%define CLOCK_REALTIME_COARSE 5
+%define CLOCK_MONOTONIC_COARSE 6
+%define CLOCK_BOOTTIME 7 ; Nothing is suspended, same as CLOCK_MONOTONIC
+
+%define SYS_CLOCK_GETTIME 110
+
+global vdsoStart
+global vdsoEnd
+
+section .text
+
+vdsoStart: ; lemon_vdso_header_t
+    dd 0x4F53444C ; Magic
+    dd 1 ; Version
+    dq vdsoClockGetTime - vdsoStart
+    dq vdsoUptime - vdsoStart
+    dq vdsoGetPID - vdsoStart
+
+; Reads the time of a clock in nanoseconds into rax
+; edi - Clock ID
+; Clobbers rdx and r8
+ReadClock:
+.retry:
+    mov r8d, dword [rel TIME_PAGE + TIME_SEQUENCE]
+    test r8d, 1
+    jnz .wait ; Being written
+
+    cmp edi, CLOCK_REALTIME_COARSE
+    je .coarse
+    cmp edi, CLOCK_MONOTONIC_COARSE
+    je .coarse
+
+    lfence ; Keep rdtsc from running before the sequence is read
+    rdtsc
+    shl rdx, 32
+    or rax, rdx
+    sub rax, qword [rel TIME_PAGE + TIME_TSC_BASE]
+    mul qword [rel TIME_PAGE + TIME_TSC_MULTIPLIER]
+    shrd rax, rdx, 32 ; 32.32 fixed point to nanoseconds
+    jmp .realtime
+.coarse:
+    mov rax, qword [rel TIME_PAGE + TIME_COARSE_NS]
+.realtime:
+    cmp edi, CLOCK_REALTIME
+    je .offset
+    cmp edi, CLOCK_REALTIME_COARSE
+    jne .check
+.offset:
+    add rax, qword [rel TIME_PAGE + TIME_REALTIME_OFFSET]
+.check:
+    ; Loads are not reordered with other loads, so the sequence is read again after everything else
+    cmp r8d, dword [rel TIME_PAGE + TIME_SEQUENCE]
+    jne .retry
+    ret
+.wait:
+    pause
+    jmp .retry
+
+; int clock_gettime(clockid_t clock, timespec* t)
+vdsoClockGetTime:
+    cmp edi, CLOCK_REALTIME
+    je .read
+    cmp edi, CLOCK_MONOTONIC
+    je .read
+    cmp edi, CLOCK_REALTIME_COARSE
+    je .read
+    cmp edi, CLOCK_MONOTONIC_COARSE
+    je .read
+    cmp edi, CLOCK_BOOTTIME
+    je .read
+
+    ; Let the kernel handle any other clock, the arguments are already in rdi and rsi
+    mov eax, SYS_CLOCK_GETTIME
+    syscall
+    ret
+.read:
+    call ReadClock
+
+    xor edx, edx
+    mov ecx, 1000000000
+    div rcx
+    mov qword [rsi], rax ; tv_sec
+    mov qword [rsi + 8], rdx ; tv_nsec
+
+    xor eax, eax
+    ret
+
+; int uptime(uint64_t* seconds, uint64_t* milliseconds), same as SYS_UPTIME
+vdsoUptime:
+    mov r9, rdi
+    mov edi, CLOCK_MONOTONIC
+    call ReadClock
+
+    xor edx, edx
+    mov ecx, 1000000000
+    div rcx
+
+    test r9, r9
+    jz .milliseconds
+    mov qword [r9], rax
+.milliseconds:
+    test rsi, rsi
+    jz .done
+    mov rax, rdx
+    xor edx, edx
+    mov ecx, 1000000
+    div rcx
+    mov qword [rsi], rax
+.done:
+    xor eax, eax
+    ret
+
+; pid_t getpid()
+vdsoGetPID:
+    mov rax, qword [rel PROCESS_PAGE + PROCESS_PID]
+    ret
+vdsoEnd:
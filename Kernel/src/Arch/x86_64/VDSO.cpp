@@ -0,0 +1,159 @@
+#include <VDSO.h>
+
+#include <Assert.h>
+#include <Math.h>
+#include <MM/VMObject.h>
+#include <Paging.h>
+#include <PhysicalAllocator.h>
+#include <Scheduler.h>
+#include <Spinlock.h>
+#include <String.h>
+#include <System.h>
+
+extern uint8_t vdsoStart[];
+extern uint8_t vdsoEnd[];
+
+namespace VDSO {
+lemon_vdso_time_page_t* timePage = nullptr; // Kernel mapping of the time page
+uintptr_t timePagePhys = 0;
+lock_t timePageLock = 0; // Only one CPU writes at a time
+
+uintptr_t* codePhys = nullptr;
+unsigned codePageCount = 0;
+
+// Time page and code are shared between all processes, the process page is our own.
+// Everything is mapped read only.
+class VDSOVMObject final : public VMObject {
+public:
+    VDSOVMObject(pid_t pid) : VMObject(LEMON_VDSO_CODE_OFFSET + (codePageCount << PAGE_SHIFT_4K), false, true) {
+        processPagePhys = Memory::AllocatePhysicalMemoryBlock();
+
+        lemon_vdso_process_page_t* page = reinterpret_cast<lemon_vdso_process_page_t*>(Memory::KernelAllocate4KPages(1));
+        Memory::KernelMapVirtualMemory4K(processPagePhys, reinterpret_cast<uintptr_t>(page), 1);
+
+        memset(page, 0, PAGE_SIZE_4K);
+        page->pid = pid;
+
+        Memory::KernelFree4KPages(page, 1);
+    }
+
+    ~VDSOVMObject() { Memory::FreePhysicalMemoryBlock(processPagePhys); }
+
+    int Hit(uintptr_t base, uintptr_t offset, PageMap* pMap, bool write) override {
+        if (write) {
+            return 1; // Read only
+        }
+
+        MapAllocatedBlocks(base, pMap);
+        return 0;
+    }
+
+    void MapAllocatedBlocks(uintptr_t base, PageMap* pMap) override {
+        Memory::MapVirtualMemory4K(timePagePhys, base + LEMON_VDSO_TIME_PAGE_OFFSET, 1, PAGE_USER | PAGE_PRESENT, pMap);
+        Memory::MapVirtualMemory4K(processPagePhys, base + LEMON_VDSO_PROCESS_PAGE_OFFSET, 1, PAGE_USER | PAGE_PRESENT,
+                                   pMap);
+
+        for (unsigned i = 0; i < codePageCount; i++) {
+            Memory::MapVirtualMemory4K(codePhys[i], base + LEMON_VDSO_CODE_OFFSET + (i << PAGE_SHIFT_4K), 1,
+                                       PAGE_USER | PAGE_PRESENT, pMap);
+        }
+    }
+
+    [[noreturn]] VMObject* Clone() override { assert(!"vDSO VMO cannot be cloned!"); }
+
+private:
+    uintptr_t processPagePhys;
+};
+
+void Initialize(uint64_t tscBase, uint64_t tscMultiplier) {
+    timePagePhys = Memory::AllocatePhysicalMemoryBlock();
+    timePage = reinterpret_cast<lemon_vdso_time_page_t*>(Memory::KernelAllocate4KPages(1));
+    Memory::KernelMapVirtualMemory4K(timePagePhys, reinterpret_cast<uintptr_t>(timePage), 1);
+
+    memset(timePage, 0, PAGE_SIZE_4K);
+    timePage->tscBase = tscBase;
+    timePage->tscMultiplier = tscMultiplier;
+
+    // Copy the code into its own pages so nothing else from the kernel image is visible
+    size_t codeSize = vdsoEnd - vdsoStart;
+    codePageCount = PAGE_COUNT_4K(codeSize);
+    codePhys = new uintptr_t[codePageCount];
+
+    uint8_t* mapping = reinterpret_cast<uint8_t*>(Memory::KernelAllocate4KPages(1));
+    for (unsigned i = 0; i < codePageCount; i++) {
+        codePhys[i] = Memory::AllocatePhysicalMemoryBlock();
+        Memory::KernelMapVirtualMemory4K(codePhys[i], reinterpret_cast<uintptr_t>(mapping), 1);
+
+        size_t offset = i << PAGE_SHIFT_4K;
+        memset(mapping, 0, PAGE_SIZE_4K);
+        memcpy(mapping, vdsoStart + offset, MIN(codeSize - offset, PAGE_SIZE_4K));
+    }
+    Memory::KernelFree4KPages(mapping, 1);
+}
+
+void SetRealtimeOffset(int64_t offset) {
+    if (!timePage) {
+        return;
+    }
+
+    // Unlike UpdateTime this must not be skipped.
+    // Keep the timer interrupt from skipping its update whilst we hold the lock.
+    int intEnable = CheckInterrupts();
+    asm("cli");
+    acquireLock(&timePageLock);
+
+    uint32_t sequence = timePage->sequence;
+
+    __atomic_store_n(&timePage->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    __atomic_store_n(&timePage->realtimeOffset, offset, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&timePage->sequence, sequence + 2, __ATOMIC_RELEASE);
+
+    releaseLock(&timePageLock);
+    if (intEnable) {
+        asm("sti");
+    }
+}
+
+int64_t RealtimeOffset() { return timePage ? __atomic_load_n(&timePage->realtimeOffset, __ATOMIC_RELAXED) : 0; }
+
+void UpdateTime(uint64_t ns) {
+    if (!timePage || acquireTestLock(&timePageLock)) {
+        return;
+    }
+
+    if (ns > timePage->coarseNs) {
+        uint32_t sequence = timePage->sequence;
+
+        __atomic_store_n(&timePage->sequence, sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        __atomic_store_n(&timePage->coarseNs, ns, __ATOMIC_RELAXED);
+
+        __atomic_store_n(&timePage->sequence, sequence + 2, __ATOMIC_RELEASE);
+    }
+
+    releaseLock(&timePageLock);
+}
+
+MappedRegion* Map(Process* process, uintptr_t base) {
+    if (base) {
+        // Forked processes start with the parent's mapping, which has the wrong PID
+        MappedRegion* inherited = process->addressSpace->AddressToRegionWriteLock(base);
+        if (inherited) {
+            long r = process->addressSpace->UnmapRegion(inherited);
+            assert(!r);
+        }
+    }
+
+    FancyRefPtr<VMObject> vmo = FancyRefPtr<VMObject>(new VDSOVMObject(process->pid));
+
+    // The child inherits AT_LEMON_VDSO and any pointers into the code, it must stay at the same address
+    MappedRegion* region = process->addressSpace->MapVMO(vmo, base, base != 0);
+    assert(region && (!base || region->Base() == base));
+
+    return region;
+}
+} // namespace VDSO
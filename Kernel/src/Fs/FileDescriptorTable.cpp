@@ -0,0 +1,78 @@
+#include <Fs/FileDescriptorTable.h>
+
+#include <Errno.h>
+
+static void CloseAndFree(fs_fd_t* handle) {
+    if (handle->node) {
+        fs::Close(handle);
+    }
+
+    delete handle;
+}
+
+int FileDescriptorTable::Allocate(fs_fd_t* handle) {
+    ScopedTicketLock acq(m_lock);
+
+    long fd = m_slots.Allocate();
+    if (fd < 0) {
+        return -EMFILE;
+    }
+
+    __atomic_store_n(m_slots.Get(fd), handle, __ATOMIC_RELEASE);
+    return fd;
+}
+
+int FileDescriptorTable::Replace(int fd, fs_fd_t* handle) {
+    fs_fd_t* old = nullptr;
+
+    {
+        ScopedTicketLock acq(m_lock);
+        if (fd < 0 || static_cast<unsigned>(fd) >= SLOT_TABLE_MAX_SLOTS) {
+            return 1;
+        }
+
+        if (!handle) {
+            // An empty slot is a free slot
+            if (m_slots.IsUsed(fd)) {
+                old = __atomic_exchange_n(m_slots.Get(fd), nullptr, __ATOMIC_ACQ_REL);
+                m_slots.Release(fd);
+            }
+        } else if (m_slots.Reserve(fd)) {
+            old = __atomic_exchange_n(m_slots.Get(fd), handle, __ATOMIC_ACQ_REL);
+        } else {
+            return 1;
+        }
+    }
+
+    if (old) {
+        CloseAndFree(old);
+    }
+
+    return 0;
+}
+
+int FileDescriptorTable::Destroy(int fd) {
+    fs_fd_t* old = nullptr;
+
+    {
+        ScopedTicketLock acq(m_lock);
+        if (fd < 0 || !m_slots.IsUsed(fd)) {
+            return 1;
+        }
+
+        old = __atomic_exchange_n(m_slots.Get(fd), nullptr, __ATOMIC_ACQ_REL);
+        m_slots.Release(fd);
+    }
+
+    if (old) {
+        CloseAndFree(old);
+    }
+
+    return 0;
+}
+
+void FileDescriptorTable::Clear() {
+    for (unsigned i = 0; i < m_slots.Capacity(); i++) {
+        Destroy(i);
+    }
+}
@@ -2,6 +2,7 @@
 
 #include <Errno.h>
 #include <Fs/FsVolume.h>
+#include <Fs/PageCache.h>
 #include <Fs/VolumeManager.h>
 #include <Logging.h>
 #include <Panic.h>
@@ -467,7 +468,29 @@ ssize_t Read(FsNode* node, size_t offset, size_t size, void* buffer) {
 ssize_t Write(FsNode* node, size_t offset, size_t size, void* buffer) {
     assert(node);
 
-    return node->Write(offset, size, reinterpret_cast<uint8_t*>(buffer));
+    ssize_t ret = node->Write(offset, size, reinterpret_cast<uint8_t*>(buffer));
+    if (ret > 0 && node->pageCache) {
+        PageCache::Update(node, offset, ret, reinterpret_cast<uint8_t*>(buffer)); // Mappings of the node must see the write
+    }
+
+    return ret;
+}
+
+ssize_t ReadUser(FsNode* node, size_t offset, size_t size, void* buffer) {
+    assert(node);
+
+    return node->ReadUser(offset, size, reinterpret_cast<uint8_t*>(buffer));
+}
+
+ssize_t WriteUser(FsNode* node, size_t offset, size_t size, const void* buffer) {
+    assert(node);
+
+    if (node->pageCache) {
+        // The page cache is updated from the data written, which has to be in kernel memory
+        return node->FsNode::WriteUser(offset, size, reinterpret_cast<const uint8_t*>(buffer));
+    }
+
+    return node->WriteUser(offset, size, reinterpret_cast<const uint8_t*>(buffer));
 }
 
 fs_fd_t* Open(FsNode* node, uint32_t flags) { return node->Open(flags); }
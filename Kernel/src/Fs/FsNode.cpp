@@ -2,6 +2,8 @@
 
 #include <Errno.h>
 #include <Logging.h>
+#include <Math.h>
+#include <UserMemory.h>
 
 FsNode::~FsNode(){
     
@@ -17,6 +19,76 @@ ssize_t FsNode::Write(size_t, size_t, uint8_t *){
     return -ENOSYS;
 }
 
+// Nodes read and write straight into the buffer they are given and cannot recover from a fault,
+// so by default the data goes through a kernel buffer.
+// Only regular files are read in more than one chunk, anything else could block on the next chunk
+ssize_t FsNode::ReadUser(size_t off, size_t size, uint8_t* buffer){
+    if(!size){
+        return 0;
+    }
+
+    size_t chunkSize = MIN(size, (size_t)USER_BOUNCE_SIZE);
+    uint8_t* kernelBuffer = (uint8_t*)kmalloc(chunkSize);
+    if(!kernelBuffer){
+        return -ENOMEM;
+    }
+
+    ssize_t total = 0;
+    while(static_cast<size_t>(total) < size){
+        ssize_t ret = fs::Read(this, off + total, MIN(size - total, chunkSize), kernelBuffer);
+        if(ret < 0){
+            kfree(kernelBuffer);
+            return total ? total : ret;
+        } else if(ret && copy_to_user(buffer + total, kernelBuffer, ret)){
+            kfree(kernelBuffer);
+            return total ? total : -EFAULT;
+        }
+
+        total += ret;
+        if(static_cast<size_t>(ret) < chunkSize || !IsFile()){
+            break; // End of file or a short read
+        }
+    }
+
+    kfree(kernelBuffer);
+    return total;
+}
+
+ssize_t FsNode::WriteUser(size_t off, size_t size, const uint8_t* buffer){
+    if(!size){
+        return 0;
+    }
+
+    size_t chunkSize = MIN(size, (size_t)USER_BOUNCE_SIZE);
+    uint8_t* kernelBuffer = (uint8_t*)kmalloc(chunkSize);
+    if(!kernelBuffer){
+        return -ENOMEM;
+    }
+
+    ssize_t total = 0;
+    while(static_cast<size_t>(total) < size){
+        size_t chunk = MIN(size - total, chunkSize);
+        if(copy_from_user(kernelBuffer, buffer + total, chunk)){
+            kfree(kernelBuffer);
+            return total ? total : -EFAULT;
+        }
+
+        ssize_t ret = fs::Write(this, off + total, chunk, kernelBuffer);
+        if(ret < 0){
+            kfree(kernelBuffer);
+            return total ? total : ret;
+        }
+
+        total += ret;
+        if(static_cast<size_t>(ret) < chunk){
+            break;
+        }
+    }
+
+    kfree(kernelBuffer);
+    return total;
+}
+
 fs_fd_t* FsNode::Open(size_t flags){
     fs_fd_t* fDesc = new fs_fd_t;
 
@@ -0,0 +1,174 @@
+#include <Fs/PageCache.h>
+
+#include <Fs/Filesystem.h>
+#include <Paging.h>
+#include <PhysicalAllocator.h>
+#include <Assert.h>
+#include <Errno.h>
+#include <Logging.h>
+
+static lock_t pageCacheLock = 0; // Protects FsNode::pageCache
+
+PageCache* PageCache::Get(FsNode* node){
+    ScopedSpinLock acquired(pageCacheLock);
+
+    if(!node->pageCache){
+        node->pageCache = new PageCache(node);
+    }
+
+    node->pageCache->refCount++;
+    return node->pageCache;
+}
+
+void PageCache::Release(){
+    ScopedSpinLock acquired(pageCacheLock);
+
+    assert(refCount > 0);
+    if(--refCount == 0){
+        node->pageCache = nullptr;
+        delete this;
+    }
+}
+
+void PageCache::Update(FsNode* node, size_t offset, size_t size, const uint8_t* data){
+    PageCache* cache;
+    {
+        ScopedSpinLock acquired(pageCacheLock);
+        if(!(cache = node->pageCache)){
+            return; // Nothing has the node mapped
+        }
+
+        cache->refCount++;
+    }
+
+    size_t end = offset + size;
+    for(size_t pageOffset = offset & ~static_cast<size_t>(PAGE_SIZE_4K - 1); pageOffset < end; pageOffset += PAGE_SIZE_4K){
+        CachedPage* page;
+        {
+            ScopedSpinLock acquired(cache->lock);
+            if(!cache->pages.get(pageOffset, page)){
+                continue; // Read from the node once it is mapped
+            }
+
+            page->refCount++; // The data may be in user memory so copy without holding the lock
+        }
+
+        size_t start = offset > pageOffset ? offset : pageOffset;
+        size_t stop = end < pageOffset + PAGE_SIZE_4K ? end : pageOffset + PAGE_SIZE_4K;
+
+        uint8_t* mapping = reinterpret_cast<uint8_t*>(Memory::KernelAllocate4KPages(1));
+        Memory::KernelMapVirtualMemory4K(page->phys, (uintptr_t)mapping, 1);
+
+        memcpy(mapping + (start - pageOffset), data + (start - offset), stop - start);
+
+        Memory::KernelFree4KPages(mapping, 1);
+        cache->ReleasePage(pageOffset);
+    }
+
+    cache->Release();
+}
+
+PageCache::PageCache(FsNode* node) : node(node), pages(64) {}
+
+PageCache::~PageCache(){
+    // Every mapping releases its pages before releasing the cache
+}
+
+uintptr_t PageCache::AcquirePage(size_t offset){
+    assert(!(offset & (PAGE_SIZE_4K - 1)));
+
+    CachedPage* page;
+    {
+        ScopedSpinLock acquired(lock);
+        if(pages.get(offset, page)){
+            page->refCount++;
+            return page->phys;
+        }
+    }
+
+    // Reading from the node may block so read the page without holding the lock
+    uintptr_t phys = Memory::AllocatePhysicalMemoryBlock();
+    if(!phys){
+        return 0;
+    }
+
+    void* mapping = Memory::KernelAllocate4KPages(1);
+    Memory::KernelMapVirtualMemory4K(phys, (uintptr_t)mapping, 1);
+
+    size_t read = 0;
+    if(offset < node->size){
+        ssize_t ret = node->Read(offset, (node->size - offset) < PAGE_SIZE_4K ? (node->size - offset) : PAGE_SIZE_4K, reinterpret_cast<uint8_t*>(mapping));
+        if(ret < 0){
+            IF_DEBUG(debugLevelUsermodeMM >= DebugLevelNormal, {
+                Log::Warning("[PageCache] Failed to read page at offset %x: %d", offset, ret);
+            });
+
+            Memory::KernelFree4KPages(mapping, 1);
+            Memory::FreePhysicalMemoryBlock(phys);
+            return 0;
+        }
+
+        read = ret;
+    }
+
+    memset(reinterpret_cast<uint8_t*>(mapping) + read, 0, PAGE_SIZE_4K - read); // Zero anything past the end of the node
+    Memory::KernelFree4KPages(mapping, 1);
+
+    ScopedSpinLock acquired(lock);
+    if(pages.get(offset, page)){ // Someone else read the page in the meantime
+        Memory::FreePhysicalMemoryBlock(phys);
+
+        page->refCount++;
+        return page->phys;
+    }
+
+    page = new CachedPage{phys, 1};
+    pages.insert(offset, page);
+
+    return phys;
+}
+
+void PageCache::ReleasePage(size_t offset){
+    ScopedSpinLock acquired(lock);
+
+    CachedPage* page;
+    if(!pages.get(offset, page)){
+        assert(!"PageCache::ReleasePage: Page is not cached!");
+        return;
+    }
+
+    assert(page->refCount > 0);
+    if(--page->refCount == 0){
+        pages.remove(offset);
+
+        Memory::FreePhysicalMemoryBlock(page->phys);
+        delete page;
+    }
+}
+
+int PageCache::WriteBack(size_t offset){
+    CachedPage* page;
+    {
+        ScopedSpinLock acquired(lock);
+        if(!pages.get(offset, page)){
+            return -EINVAL;
+        }
+    }
+
+    if(offset >= node->size){
+        return 0; // Page lies past the end of the node
+    }
+
+    void* mapping = Memory::KernelAllocate4KPages(1);
+    Memory::KernelMapVirtualMemory4K(page->phys, (uintptr_t)mapping, 1);
+
+    ssize_t ret = node->Write(offset, (node->size - offset) < PAGE_SIZE_4K ? (node->size - offset) : PAGE_SIZE_4K, reinterpret_cast<uint8_t*>(mapping));
+
+    Memory::KernelFree4KPages(mapping, 1);
+
+    if(ret < 0){
+        return ret;
+    }
+
+    return 0;
+}
@@ -8,45 +8,81 @@ UNIXPipe::UNIXPipe(int _end, FancyRefPtr<DataStream> stream)
 }
 
 ssize_t UNIXPipe::Read(size_t off, size_t size, uint8_t* buffer){
+    return ReadStream(buffer, size, false);
+}
+
+ssize_t UNIXPipe::Write(size_t off, size_t size, uint8_t* buffer){
+    return WriteStream(buffer, size, false);
+}
+
+ssize_t UNIXPipe::ReadUser(size_t off, size_t size, uint8_t* buffer){
+    return ReadStream(buffer, size, true);
+}
+
+ssize_t UNIXPipe::WriteUser(size_t off, size_t size, const uint8_t* buffer){
+    return WriteStream(buffer, size, true);
+}
+
+ssize_t UNIXPipe::ReadStream(uint8_t* buffer, size_t size, bool user){
     if(end != ReadEnd){
         return -ESPIPE;
     }
 
-    if(!widowed && stream->Empty()){
+    while(!widowed && stream->Empty()){
         FilesystemBlocker bl(this, size);
 
-        if(Scheduler::GetCurrentThread()->Block(&bl)){
+        if(!widowed && stream->Empty() && Scheduler::GetCurrentThread()->Block(&bl)){
             return -EINTR;
         }
     }
 
-    if(size > stream->Pos()){
-        size = stream->Pos();
+    ssize_t ret = user ? stream->ReadUser(buffer, size) : stream->Read(buffer, size);
+
+    // Space has been freed, let the writer continue
+    if(ret > 0){
+        if(UNIXPipe* other = AcquireOtherEnd(); other){
+            other->Wake(FilesystemBlocker::BlockWrite);
+            other->Unref();
+        }
     }
 
-    return stream->Read(buffer, size);
+    return ret;
 }
 
-ssize_t UNIXPipe::Write(size_t off, size_t size, uint8_t* buffer){
+ssize_t UNIXPipe::WriteStream(const uint8_t* buffer, size_t size, bool user){
     if(end != WriteEnd){
         return -ESPIPE;
-    } else if(widowed){
-        return -EPIPE;
     }
 
-    ssize_t ret = stream->Write(buffer, size);
-
-    {
-        ScopedSpinLock acq(otherEnd->watchingLock);
+    size_t written = 0;
+    while(written < size){
+        if(widowed){
+            return written ? written : -EPIPE;
+        }
 
-        for(auto& w : otherEnd->watching){
-            w->Signal();
+        ssize_t ret = user ? stream->WriteUser(buffer + written, size - written)
+                           : stream->Write(const_cast<uint8_t*>(buffer) + written, size - written);
+        if(ret > 0){
+            written += ret;
+
+            if(UNIXPipe* other = AcquireOtherEnd(); other){
+                other->Wake(FilesystemBlocker::BlockRead);
+                other->Unref();
+            }
+            continue;
+        } else if(ret < 0){
+            return written ? written : ret;
         }
 
-        otherEnd->watching.clear();
+        // The pipe is full, wait for the reader to make space
+        FilesystemBlocker bl(this, size - written, FilesystemBlocker::BlockWrite);
+
+        if(!widowed && !stream->Space() && Scheduler::GetCurrentThread()->Block(&bl)){
+            return written ? written : -EINTR;
+        }
     }
 
-    return ret;
+    return written;
 }
 
 void UNIXPipe::Watch(FilesystemWatcher& watcher, int events){
@@ -63,20 +99,90 @@ void UNIXPipe::Close(){
     handleCount--;
 
     if(handleCount <= 0){
-        if(otherEnd){
-            otherEnd->widowed = true;
+        UNIXPipe* other;
+        {
+            ScopedSpinLock acq(link->lock);
+
+            other = otherEnd;
+            if(other){
+                other->widowed = true;
+                other->otherEnd = nullptr;
+                __atomic_add_fetch(&other->references, 1, __ATOMIC_RELAXED);
+            }
+
+            otherEnd = nullptr;
+        }
+
+        if(other){
+            // Readers see EOF and writers see EPIPE
+            other->Wake(FilesystemBlocker::BlockRead);
+            other->Wake(FilesystemBlocker::BlockWrite);
+            other->Unref();
         }
 
+        Unref();
+    }
+}
+
+bool UNIXPipe::CanRead(){
+    return end == ReadEnd && (widowed || !stream->Empty());
+}
+
+bool UNIXPipe::CanWrite(){
+    return end == WriteEnd && (widowed || stream->Space());
+}
+
+void UNIXPipe::Wake(int blockType){
+    {
+        ScopedSpinLock acq(blockedLock);
+
+        FilesystemBlocker* bl = blocked.get_front();
+        while(bl){
+            FilesystemBlocker* next = blocked.next(bl);
+
+            if(bl->Type() == blockType){
+                bl->Unblock();
+            }
+
+            bl = next;
+        }
+    }
+
+    ScopedSpinLock acq(watchingLock);
+    for(auto& w : watching){
+        w->Signal();
+    }
+
+    watching.clear();
+}
+
+UNIXPipe* UNIXPipe::AcquireOtherEnd(){
+    ScopedSpinLock acq(link->lock);
+
+    UNIXPipe* other = otherEnd;
+    if(other){
+        __atomic_add_fetch(&other->references, 1, __ATOMIC_RELAXED);
+    }
+
+    return other;
+}
+
+void UNIXPipe::Unref(){
+    if(__atomic_sub_fetch(&references, 1, __ATOMIC_ACQ_REL) == 0){
         delete this;
     }
 }
 
 void UNIXPipe::CreatePipe(UNIXPipe*& read, UNIXPipe*& write){
-    FancyRefPtr<DataStream> stream = new DataStream(1024);
+    FancyRefPtr<DataStream> stream = new DataStream(PIPE_BUFSIZE);
+    FancyRefPtr<PipeLink> link = new PipeLink;
     
     read = new UNIXPipe(UNIXPipe::ReadEnd, stream);
     write = new UNIXPipe(UNIXPipe::WriteEnd, stream);
 
+    read->link = link;
+    write->link = link;
+
     read->otherEnd = write;
     write->otherEnd = read;
-}
\ No newline at end of file
+}
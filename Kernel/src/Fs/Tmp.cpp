@@ -2,6 +2,7 @@
 
 #include <Errno.h>
 #include <Debug.h>
+#include <UserMemory.h>
 
 namespace fs::Temp{
     TempVolume::TempVolume(const char* name){
@@ -151,6 +152,51 @@ namespace fs::Temp{
         return writeSize;
     }
 
+    ssize_t TempNode::ReadUser(size_t off, size_t readSize, uint8_t* readBuffer){
+        if((flags & FS_NODE_TYPE) == FS_NODE_DIRECTORY){
+            return -EISDIR;
+        }
+
+        if(off > size){
+            return 0;
+        }
+
+        if(off + readSize > size){
+            readSize = size - off;
+        }
+
+        bufferLock.AcquireRead();
+        long e = copy_to_user(readBuffer, buffer + off, readSize);
+        bufferLock.ReleaseRead();
+
+        return e ? e : readSize;
+    }
+
+    ssize_t TempNode::WriteUser(size_t off, size_t writeSize, const uint8_t* writeBuffer){
+        if((flags & FS_NODE_TYPE) == FS_NODE_DIRECTORY){
+            return -EISDIR;
+        }
+
+        bufferLock.AcquireWrite();
+        size_t old = size;
+        if(!buffer || off + writeSize > size){
+            size = off + writeSize;
+
+            if(size >= bufferSize){
+                vol->ReallocateNode(this, old);
+            }
+        }
+
+        if(long e = copy_from_user(buffer + off, writeBuffer, writeSize); e){
+            size = old; // Do not grow the file with data that was never written
+            bufferLock.ReleaseWrite();
+            return e;
+        }
+        bufferLock.ReleaseWrite();
+
+        return writeSize;
+    }
+
     int TempNode::Truncate(off_t length){
         if(length < 0){
             return -EINVAL; // No negative length
@@ -2,9 +2,48 @@
 
 #include <StringView.h>
 
+static inline uint64_t HashMix(uint64_t a, uint64_t b){
+	unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+	return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+}
+
+static inline uint64_t HashRead(const uint8_t* p, size_t length){
+	uint64_t value = 0;
+	for(size_t i = 0; i < length; i++){
+		value |= static_cast<uint64_t>(p[i]) << (i * 8);
+	}
+
+	return value;
+}
+
+uint64_t HashBytes(const void* data, size_t length, uint64_t seed){
+	const uint64_t k0 = 0xa0761d6478bd642fULL;
+	const uint64_t k1 = 0xe7037ed1a0b428dbULL;
+
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+	uint64_t hash = seed ^ k0;
+
+	size_t remaining = length;
+	while(remaining >= 8){
+		uint64_t value;
+		__builtin_memcpy(&value, p, 8); // Unaligned load
+
+		hash = HashMix(hash ^ value, k1);
+
+		p += 8;
+		remaining -= 8;
+	}
+
+	if(remaining){
+		hash = HashMix(hash ^ HashRead(p, remaining), k1);
+	}
+
+	return HashMix(hash ^ length, k0);
+}
+
 template<>
 unsigned Hash<unsigned long>(const unsigned long& value){
-	return HashU(value);
+	return HashU64(value);
 }
 
 template<>
@@ -24,12 +63,5 @@ unsigned Hash<unsigned char>(const unsigned char& value){
 
 template<>
 unsigned Hash<StringView>(const StringView& sv){
-    const char* str = sv.Data();
-    unsigned value = (*str << 1);
-
-    while(char c = *str++){
-        value ^= HashU(c);
-    }
-
-    return value;
-}
\ No newline at end of file
+	return HashBytes(sv.Data(), sv.Length());
+}
@@ -6,6 +6,7 @@
 #include <Keyboard.h>
 #include <Lemon.h>
 #include <Liballoc.h>
+#include <LockStats.h>
 #include <Logging.h>
 #include <Math.h>
 #include <Modules.h>
@@ -14,6 +15,7 @@
 #include <Objects/Service.h>
 #include <PCI.h>
 #include <Panic.h>
+#include <Profiler.h>
 #include <Scheduler.h>
 #include <SharedMemory.h>
 #include <Storage/AHCI.h>
@@ -121,10 +123,7 @@ void KernelProcess() {
 
     Log::Write("OK");
 
-    void* initElf = (void*)kmalloc(initFsNode->size);
-    fs::Read(initFsNode, 0, initFsNode->size, (uint8_t*)initElf);
-
-    process_t* initProc = Scheduler::CreateELFProcess(initElf, 1, argv, envc, envp);
+    process_t* initProc = Scheduler::CreateELFProcess(initFsNode, 1, argv, envc, envp);
 
     strcpy(initProc->workingDir, "/");
     strcpy(initProc->name, "Init");
@@ -179,6 +178,10 @@ extern "C" [[noreturn]] void kmain() {
     fs::VolumeManager::Initialize();
     DeviceManager::Initialize();
     Log::LateInitialize();
+#ifdef KERNEL_LOCK_STATS
+    LockStats::Initialize();
+#endif
+    Profiler::Initialize();
 
     InitializeConstructors(); // Call global constructors
 
@@ -9,19 +9,29 @@
 #include <Scheduler.h>
 #include <CPU.h>
 	
-volatile int liballocLock = 0;
+TicketLock liballocLock(LockClassHeap);
+int liballocIntEnable = 0; // Interrupt state of the holder before it took the lock
 
 extern "C" {
 	
+// Interrupts stay disabled whilst the heap is locked,
+// otherwise every other CPU allocating spins for as long as the holder is preempted
 int liballoc_lock() {
-	while(acquireTestLock(&liballocLock)) {
-		assert(CheckInterrupts());
-	} // If for some reason liballoc is locked before the scheduler starts something probably went horribly wrong
+	int intEnable = CheckInterrupts();
+	asm("cli");
+
+	liballocLock.Acquire();
+	liballocIntEnable = intEnable;
 	return 0;
 }
 
 int liballoc_unlock() {
-	releaseLock(&liballocLock);
+	int intEnable = liballocIntEnable;
+	liballocLock.Release();
+
+	if(intEnable) {
+		asm("sti");
+	}
 	return 0;
 }
 
@@ -50,4 +50,217 @@ void Semaphore::Signal() {
     }
 
     releaseLock(&lock);
-}
\ No newline at end of file
+}
+
+void LockBlocker::Interrupt() {
+    interrupted = true;
+    shouldBlock = false;
+
+    acquireLock(queueLock);
+    acquireLock(&lock);
+    if (queue) {
+        queue->remove(this);
+        queue = nullptr;
+    }
+
+    if (thread) {
+        thread->Unblock();
+    }
+    releaseLock(&lock);
+    releaseLock(queueLock);
+}
+
+void LockBlocker::Unblock() {
+    shouldBlock = false;
+
+    acquireLock(&lock);
+    if (queue) {
+        queue->remove(this);
+        queue = nullptr;
+    }
+
+    if (thread) {
+        thread->Unblock();
+    }
+    releaseLock(&lock);
+}
+
+LockBlocker::~LockBlocker() {
+    acquireLock(queueLock);
+    if (queue) {
+        queue->remove(this); // Block returned early because of a pending signal
+    }
+    releaseLock(queueLock);
+}
+
+void Mutex::Acquire() {
+    if (TryAcquire()) {
+        return;
+    }
+
+    assert(CheckInterrupts());
+
+#ifdef KERNEL_LOCK_STATS
+    uint64_t start = LockStats::Timestamp();
+#endif
+
+    // The holder will most likely release the mutex soon, spin for a bit before going to sleep
+    bool acquired = false;
+    for (unsigned i = 0; i < spinIterations && !acquired; i++) {
+        asm volatile("pause");
+
+        acquired = !__atomic_load_n(&state, __ATOMIC_RELAXED) && Take();
+    }
+
+    if (!acquired) {
+        Thread* thread = Scheduler::GetCurrentThread();
+
+        acquireLock(&lock);
+        while (__atomic_exchange_n(&state, 2, __ATOMIC_ACQUIRE)) { // Let the holder know it has to wake us
+            {
+                LockBlocker blocker(&lock, &blocked);
+                blocked.add_back(&blocker);
+                releaseLock(&lock);
+
+                // LockBlockers ignore signals, only a thread being killed is interrupted
+                [[maybe_unused]] bool interrupted = thread->Block(&blocker);
+            }
+
+            acquireLock(&lock);
+        }
+        releaseLock(&lock);
+    }
+
+#ifdef KERNEL_LOCK_STATS
+    acquiredAt = LockStats::Timestamp();
+    LockStats::Acquired(lockClass, true, acquiredAt - start);
+#endif
+}
+
+void Mutex::Release() {
+#ifdef KERNEL_LOCK_STATS
+    LockStats::Released(lockClass, LockStats::Timestamp() - acquiredAt);
+#endif
+
+    if (__atomic_exchange_n(&state, 0, __ATOMIC_RELEASE) == 2) {
+        acquireLock(&lock);
+        if (blocked.get_length() > 0) {
+            blocked.get_front()->Unblock();
+        }
+        releaseLock(&lock);
+    }
+}
+
+void ReadWriteMutex::AcquireRead() {
+    assert(CheckInterrupts());
+
+    Thread* thread = Scheduler::GetCurrentThread();
+
+#ifdef KERNEL_LOCK_STATS
+    uint64_t start = LockStats::Timestamp();
+#endif
+
+    acquireLock(&lock);
+    bool contended = writer;
+    while (writer) {
+        {
+            LockBlocker blocker(&lock, &readers);
+            readers.add_back(&blocker);
+            releaseLock(&lock);
+
+            [[maybe_unused]] bool interrupted = thread->Block(&blocker); // See Mutex::Acquire
+        }
+
+        acquireLock(&lock);
+    }
+
+    activeReaders++;
+    releaseLock(&lock);
+
+#ifdef KERNEL_LOCK_STATS
+    LockStats::Acquired(lockClass, contended, LockStats::Timestamp() - start);
+#else
+    (void)contended;
+#endif
+}
+
+void ReadWriteMutex::AcquireWrite() {
+    assert(CheckInterrupts());
+
+    Thread* thread = Scheduler::GetCurrentThread();
+
+#ifdef KERNEL_LOCK_STATS
+    uint64_t start = LockStats::Timestamp();
+#endif
+
+    acquireLock(&lock);
+    bool contended = writer || activeReaders;
+    while (writer || activeReaders) {
+        {
+            LockBlocker blocker(&lock, &writers);
+            writers.add_back(&blocker);
+            releaseLock(&lock);
+
+            [[maybe_unused]] bool interrupted = thread->Block(&blocker); // See Mutex::Acquire
+        }
+
+        acquireLock(&lock);
+    }
+
+    writer = true;
+    releaseLock(&lock);
+
+#ifdef KERNEL_LOCK_STATS
+    writeAcquiredAt = LockStats::Timestamp();
+    LockStats::Acquired(lockClass, contended, writeAcquiredAt - start);
+#else
+    (void)contended;
+#endif
+}
+
+bool ReadWriteMutex::TryAcquireWrite() {
+    if (acquireTestLock(&lock)) {
+        return false;
+    }
+
+    bool acquired = !writer && !activeReaders;
+    if (acquired) {
+        writer = true;
+    }
+
+    releaseLock(&lock);
+
+#ifdef KERNEL_LOCK_STATS
+    if (acquired) {
+        writeAcquiredAt = LockStats::Timestamp();
+        LockStats::Acquired(lockClass, false, 0);
+    }
+#endif
+    return acquired;
+}
+
+void ReadWriteMutex::ReleaseRead() {
+    acquireLock(&lock);
+    if (!--activeReaders && writers.get_length() > 0) {
+        writers.get_front()->Unblock();
+    }
+    releaseLock(&lock);
+}
+
+void ReadWriteMutex::ReleaseWrite() {
+#ifdef KERNEL_LOCK_STATS
+    LockStats::Released(lockClass, LockStats::Timestamp() - writeAcquiredAt);
+#endif
+
+    acquireLock(&lock);
+    writer = false;
+
+    if (readers.get_length() > 0) {
+        while (readers.get_length() > 0) { // Readers go first, the last one out wakes the next writer
+            readers.get_front()->Unblock();
+        }
+    } else if (writers.get_length() > 0) {
+        writers.get_front()->Unblock();
+    }
+    releaseLock(&lock);
+}
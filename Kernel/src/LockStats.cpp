@@ -0,0 +1,76 @@
+#include <LockStats.h>
+
+#ifdef KERNEL_LOCK_STATS
+
+#include <Device.h>
+#include <Memory.h>
+#include <String.h>
+
+namespace LockStats {
+Counters counters[LockClassCount];
+
+static const char* const names[LockClassCount] = {
+    "anonymous", "runqueue", "physalloc", "heap", "sleepqueue", "handles",
+    "ahciport",  "atadrive", "filedata",  "kernelvm", "fdtable",
+};
+
+// One line per lock class:
+// name acquisitions contended waitCycles maxHoldCycles
+class LockStatsDevice : public Device {
+public:
+    LockStatsDevice(const char* name) : Device(name, DeviceTypeUNIXPseudo) { flags = FS_NODE_FILE; }
+
+    ssize_t Read(size_t offset, size_t size, uint8_t* buffer) {
+        const size_t maxLineLength = 128;
+        char* text = reinterpret_cast<char*>(kmalloc(LockClassCount * maxLineLength));
+
+        size_t length = 0;
+        for (unsigned i = 0; i < LockClassCount; i++) {
+            const Counters& c = counters[i];
+            uint64_t values[] = {
+                __atomic_load_n(&c.acquisitions, __ATOMIC_RELAXED),
+                __atomic_load_n(&c.contended, __ATOMIC_RELAXED),
+                __atomic_load_n(&c.waitCycles, __ATOMIC_RELAXED),
+                __atomic_load_n(&c.maxHoldCycles, __ATOMIC_RELAXED),
+            };
+
+            strcpy(text + length, names[i]);
+            length += strlen(names[i]);
+
+            for (uint64_t value : values) {
+                text[length++] = ' ';
+                itoa(value, text + length, 10);
+                length += strlen(text + length);
+            }
+
+            text[length++] = '\n';
+        }
+
+        if (offset >= length) {
+            kfree(text);
+            return 0;
+        }
+
+        if (size > length - offset) {
+            size = length - offset;
+        }
+        memcpy(buffer, text + offset, size);
+
+        kfree(text);
+        return size;
+    }
+
+    // Any write resets the statistics
+    ssize_t Write(size_t, size_t size, uint8_t*) {
+        memset(counters, 0, sizeof(counters));
+
+        return size;
+    }
+};
+
+static LockStatsDevice* lockStatsDevice = nullptr;
+
+void Initialize() { lockStatsDevice = new LockStatsDevice("lockstat"); }
+} // namespace LockStats
+
+#endif
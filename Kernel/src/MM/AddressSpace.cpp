@@ -80,7 +80,12 @@ bool AddressSpace::RangeInRegion(uintptr_t base, size_t size) {
     return false;
 }
 
+// Dropping the last reference to a VMObject can block (e.g. writing back dirty file pages),
+// so unmapping keeps the references here and only drops them once m_lock has been released.
+// Declare the list before the ScopedSpinLock so it is destroyed after the lock is released.
+
 long AddressSpace::UnmapRegion(MappedRegion* region) {
+    List<FancyRefPtr<VMObject>> released;
     ScopedSpinLock acquired(m_lock);
 
     assert(region->lock.IsWriteLocked());
@@ -96,6 +101,7 @@ long AddressSpace::UnmapRegion(MappedRegion* region) {
 
             if (it->vmObject) {
                 it->vmObject->refCount--;
+                released.add_back(it->vmObject);
             }
 
             m_regions.remove(it);
@@ -201,6 +207,7 @@ AddressSpace* AddressSpace::Fork() {
 
 long AddressSpace::UnmapMemory(uintptr_t base, size_t size) {
     uintptr_t end = base + size;
+    List<FancyRefPtr<VMObject>> released;
     ScopedSpinLock acquired(m_lock);
 
 retry:
@@ -220,6 +227,7 @@ retry:
             if (region.End() <= end) { // Whole region within our range
                 if (region.vmObject) {
                     it->vmObject->refCount--;
+                    released.add_back(it->vmObject);
                 }
 
                 Memory::MapVirtualMemory4K(0, base, PAGE_COUNT_4K(size), 0, m_pageMap);
@@ -236,6 +244,7 @@ retry:
 }
 
 void AddressSpace::UnmapAll() {
+    List<FancyRefPtr<VMObject>> released;
     ScopedSpinLock acq(m_lock);
 
     for (MappedRegion& r : m_regions) {
@@ -243,6 +252,7 @@ void AddressSpace::UnmapAll() {
 
         if (r.vmObject.get()) {
             r.vmObject->refCount--;
+            released.add_back(r.vmObject);
         }
     }
 
@@ -4,6 +4,8 @@
 #include <PhysicalAllocator.h>
 #include <Scheduler.h>
 #include <CPU.h>
+#include <Fs/Filesystem.h>
+#include <Fs/PageCache.h>
 
 #include <Assert.h>
 
@@ -11,7 +13,7 @@ VMObject::VMObject(size_t size, bool anonymous, bool shared) : size(size), anony
     assert(!(size & (PAGE_SIZE_4K - 1)));
 }
 
-int VMObject::Hit(uintptr_t, uintptr_t, PageMap*){
+int VMObject::Hit(uintptr_t, uintptr_t, PageMap*, bool){
     return 1; // Fatal page fault, kill process
 }
 
@@ -37,13 +39,13 @@ PhysicalVMObject::PhysicalVMObject(uintptr_t size, bool anonymous, bool shared)
             physicalBlocks[i] = phys >> PAGE_SHIFT_4K; // Allocate all of our blocks
 
             Memory::KernelMapVirtualMemory4K(phys, (uintptr_t)mapping, 1);
-            memset(mapping, 0, PAGE_SIZE_4K);
+            ZeroPage(mapping);
         }
         Memory::KernelFree4KPages(mapping, 1);
     }
 }
 
-int PhysicalVMObject::Hit(uintptr_t base, uintptr_t offset, PageMap* pMap){
+int PhysicalVMObject::Hit(uintptr_t base, uintptr_t offset, PageMap* pMap, bool){
     unsigned blockIndex = offset >> PAGE_SHIFT_4K;
     assert(blockIndex < (size >> PAGE_SHIFT_4K));
 
@@ -64,12 +66,13 @@ int PhysicalVMObject::Hit(uintptr_t base, uintptr_t offset, PageMap* pMap){
         Memory::MapVirtualMemory4K(phys, base + offset, 1, PAGE_USER | PAGE_WRITABLE | PAGE_PRESENT, pMap);
         
         if(GetCR3() == pMap->pml4Phys){
+            // The faulting thread is about to use the page so zero it through the cache
             memset(reinterpret_cast<void*>((base + offset) & ~static_cast<uintptr_t>(PAGE_SIZE_4K - 1)), 0, PAGE_SIZE_4K); // Zero the block
         } else {
             void* mapping = Memory::KernelAllocate4KPages(1);
             Memory::KernelMapVirtualMemory4K(phys, (uintptr_t)mapping, 1);
 
-            memset(mapping, 0, PAGE_SIZE_4K);
+            ZeroPage(mapping);
 
             Memory::KernelFree4KPages(mapping, 1);
         }
@@ -92,7 +95,7 @@ void PhysicalVMObject::ForceAllocate(){
         physicalBlocks[i] = phys >> PAGE_SHIFT_4K;
 
         Memory::KernelMapVirtualMemory4K(phys, (uintptr_t)mapping, 1);
-        memset(mapping, 0, PAGE_SIZE_4K);
+        ZeroPage(mapping);
     }
     Memory::KernelFree4KPages(mapping, 1);
 }
@@ -113,6 +116,21 @@ void PhysicalVMObject::MapAllocatedBlocks(uintptr_t base, PageMap* pMap){
     }
 }
 
+void PhysicalVMObject::Discard(uintptr_t base, uintptr_t offset, size_t size, PageMap* pMap){
+    if(!anonymous || shared || copyOnWrite || refCount > 1){
+        return; // Someone else may still be using the blocks
+    }
+
+    for(uintptr_t i = offset >> PAGE_SHIFT_4K; i < ((offset + size) >> PAGE_SHIFT_4K) && i < (this->size >> PAGE_SHIFT_4K); i++){
+        if(physicalBlocks[i]){
+            Memory::MapVirtualMemory4K(0, base + (i << PAGE_SHIFT_4K), 1, PAGE_USER, pMap); // Zero filled on the next access
+
+            Memory::FreePhysicalMemoryBlock(static_cast<uintptr_t>(physicalBlocks[i]) << PAGE_SHIFT_4K);
+            physicalBlocks[i] = 0;
+        }
+    }
+}
+
 VMObject* PhysicalVMObject::Clone(){
     assert(!shared);
     PhysicalVMObject* newVMO = new PhysicalVMObject(size, anonymous, shared);
@@ -130,7 +148,7 @@ VMObject* PhysicalVMObject::Clone(){
             Memory::KernelMapVirtualMemory4K(block << PAGE_SHIFT_4K, (uintptr_t)virtBuffer, 1); // Map temporary mappings to our blocks
             Memory::KernelMapVirtualMemory4K(newBlock, (uintptr_t)virtDestBuffer, 1);
 
-            memcpy(virtDestBuffer, virtBuffer, PAGE_SIZE_4K); // Copy each block
+            CopyPage(virtDestBuffer, virtBuffer); // Copy each block
         }
     }
 
@@ -211,4 +229,233 @@ VMObject* AnonymousVMObject::Split(uintptr_t offset){
     size = offset;
 
     return newObject;    
-}
\ No newline at end of file
+}
+
+FileVMObject::FileVMObject(FsNode* node, size_t offset, size_t size, bool shared, bool writable)
+    : VMObject(size, false, shared), fileOffset(offset), writable(writable) {
+    assert(!(offset & (PAGE_SIZE_4K - 1)));
+
+    handle = fs::Open(node, 0);
+    cache = PageCache::Get(node);
+
+    size_t blockCount = PAGE_COUNT_4K(size);
+    physicalBlocks = new uint32_t[blockCount];
+    pageState = new uint8_t[blockCount];
+
+    memset(physicalBlocks, 0, sizeof(uint32_t) * blockCount);
+    memset(pageState, 0, blockCount);
+}
+
+FileVMObject::~FileVMObject(){
+    assert(refCount <= 1);
+
+    for(unsigned i = 0; i < (size >> PAGE_SHIFT_4K); i++){
+        if((pageState[i] & PageDirty) && cache->WriteBack(fileOffset + (i << PAGE_SHIFT_4K))){
+            Log::Warning("[FileVMObject] Failed to write back page at offset %x", fileOffset + (i << PAGE_SHIFT_4K));
+        }
+
+        ReleasePage(i);
+    }
+
+    delete[] physicalBlocks;
+    delete[] pageState;
+
+    cache->Release();
+
+    fs::Close(handle);
+    delete handle;
+}
+
+uint64_t FileVMObject::PageFlags(unsigned index) const {
+    if(!pageState[index]){
+        return PAGE_USER; // Mark as user, not present, not writable
+    }
+
+    // Cache pages of private mappings are never writable, we copy them on write.
+    // Cache pages of shared mappings only become writable once dirty so we know what to write back.
+    bool write = (pageState[index] & PagePrivate) ? (!copyOnWrite && !readOnly) : (shared && (pageState[index] & PageDirty));
+    return PAGE_USER | (PAGE_WRITABLE * write) | PAGE_PRESENT;
+}
+
+// Expects the page to no longer be mapped
+void FileVMObject::ReleasePage(unsigned index){
+    if(pageState[index] & PageCached){
+        cache->ReleasePage(fileOffset + (index << PAGE_SHIFT_4K));
+    } else if(pageState[index] & PagePrivate){
+        Memory::FreePhysicalMemoryBlock(static_cast<uintptr_t>(physicalBlocks[index]) << PAGE_SHIFT_4K);
+    }
+
+    physicalBlocks[index] = 0;
+    pageState[index] = 0;
+}
+
+int FileVMObject::Hit(uintptr_t base, uintptr_t offset, PageMap* pMap, bool write){
+    unsigned blockIndex = offset >> PAGE_SHIFT_4K;
+    assert(blockIndex < (size >> PAGE_SHIFT_4K));
+
+    size_t pageOffset = fileOffset + (static_cast<size_t>(blockIndex) << PAGE_SHIFT_4K);
+
+    if(write && shared && !writable){
+        return 1; // Node was not opened for writing
+    } else if(write && readOnly){
+        return 1;
+    }
+
+    if(!pageState[blockIndex]){
+        uintptr_t phys = cache->AcquirePage(pageOffset); // May block on I/O
+        if(!phys){
+            return 1;
+        }
+
+        acquireLock(&lock);
+        if(pageState[blockIndex]){ // Another thread got there first
+            releaseLock(&lock);
+            cache->ReleasePage(pageOffset);
+        } else {
+            physicalBlocks[blockIndex] = phys >> PAGE_SHIFT_4K;
+            pageState[blockIndex] = PageCached;
+            releaseLock(&lock);
+        }
+    }
+
+    ScopedSpinLock acquired(lock);
+    if(write && shared){
+        pageState[blockIndex] |= PageDirty;
+    } else if(write && !(pageState[blockIndex] & PagePrivate)){
+        // Copy on write, take our own copy of the cache page
+        uintptr_t phys = Memory::AllocatePhysicalMemoryBlock();
+        if(!phys){
+            return 1;
+        }
+
+        uint8_t* mapping = reinterpret_cast<uint8_t*>(Memory::KernelAllocate4KPages(2));
+        Memory::KernelMapVirtualMemory4K(static_cast<uintptr_t>(physicalBlocks[blockIndex]) << PAGE_SHIFT_4K, (uintptr_t)mapping, 1);
+        Memory::KernelMapVirtualMemory4K(phys, (uintptr_t)mapping + PAGE_SIZE_4K, 1);
+
+        memcpy(mapping + PAGE_SIZE_4K, mapping, PAGE_SIZE_4K);
+
+        Memory::KernelFree4KPages(mapping, 2);
+
+        cache->ReleasePage(pageOffset);
+        physicalBlocks[blockIndex] = phys >> PAGE_SHIFT_4K;
+        pageState[blockIndex] = PagePrivate;
+    }
+
+    Memory::MapVirtualMemory4K(static_cast<uintptr_t>(physicalBlocks[blockIndex]) << PAGE_SHIFT_4K, base + (static_cast<uintptr_t>(blockIndex) << PAGE_SHIFT_4K), 1, PageFlags(blockIndex), pMap);
+    return 0;
+}
+
+void FileVMObject::MapAllocatedBlocks(uintptr_t base, PageMap* pMap){
+    ScopedSpinLock acquired(lock);
+
+    uintptr_t virt = base;
+    for(unsigned i = 0; i < (size >> PAGE_SHIFT_4K); i++){
+        Memory::MapVirtualMemory4K(static_cast<uintptr_t>(physicalBlocks[i]) << PAGE_SHIFT_4K, virt, 1, PageFlags(i), pMap);
+
+        virt += PAGE_SIZE_4K;
+    }
+}
+
+VMObject* FileVMObject::Clone(){
+    assert(!shared);
+    FileVMObject* newVMO = new FileVMObject(handle->node, fileOffset, size, false, writable);
+
+    uint8_t* virtBuffer = reinterpret_cast<uint8_t*>(Memory::KernelAllocate4KPages(2));
+    uint8_t* virtDestBuffer = virtBuffer + PAGE_SIZE_4K;
+
+    ScopedSpinLock acquired(lock);
+    for(unsigned i = 0; i < (size >> PAGE_SHIFT_4K); i++){
+        if(pageState[i] & PageCached){ // Cache pages are shared
+            newVMO->physicalBlocks[i] = cache->AcquirePage(fileOffset + (i << PAGE_SHIFT_4K)) >> PAGE_SHIFT_4K;
+            newVMO->pageState[i] = PageCached;
+        } else if(pageState[i] & PagePrivate){
+            uintptr_t newBlock = Memory::AllocatePhysicalMemoryBlock();
+
+            Memory::KernelMapVirtualMemory4K(static_cast<uintptr_t>(physicalBlocks[i]) << PAGE_SHIFT_4K, (uintptr_t)virtBuffer, 1);
+            Memory::KernelMapVirtualMemory4K(newBlock, (uintptr_t)virtDestBuffer, 1);
+
+            CopyPage(virtDestBuffer, virtBuffer);
+
+            newVMO->physicalBlocks[i] = newBlock >> PAGE_SHIFT_4K;
+            newVMO->pageState[i] = PagePrivate;
+        }
+    }
+
+    Memory::KernelFree4KPages(virtBuffer, 2);
+
+    newVMO->copyOnWrite = false;
+    newVMO->readOnly = readOnly;
+    newVMO->refCount = 1;
+
+    return newVMO;
+}
+
+int FileVMObject::Sync(uintptr_t base, uintptr_t offset, size_t size, PageMap* pMap){
+    if(!shared){
+        return 0; // Private mappings are never written back
+    }
+
+    for(uintptr_t i = offset >> PAGE_SHIFT_4K; i < PAGE_COUNT_4K(offset + size) && i < (this->size >> PAGE_SHIFT_4K); i++){
+        if(!(pageState[i] & PageDirty)){
+            continue;
+        }
+
+        // Write protect the page again first so we notice any further writes,
+        // another thread of the process may still have the page writable in its TLB
+        acquireLock(&lock);
+        pageState[i] &= ~PageDirty;
+        Memory::MapVirtualMemory4K(static_cast<uintptr_t>(physicalBlocks[i]) << PAGE_SHIFT_4K, base + (i << PAGE_SHIFT_4K), 1, PageFlags(i), pMap);
+        releaseLock(&lock);
+
+        Memory::TLBShootdown(base + (i << PAGE_SHIFT_4K), 1, pMap);
+
+        if(int e = cache->WriteBack(fileOffset + (i << PAGE_SHIFT_4K)); e){
+            ScopedSpinLock acquired(lock);
+            pageState[i] |= PageDirty;
+            return e;
+        }
+    }
+
+    return 0;
+}
+
+void FileVMObject::Prefetch(uintptr_t base, uintptr_t offset, size_t size, PageMap* pMap){
+    for(uintptr_t i = offset >> PAGE_SHIFT_4K; i < PAGE_COUNT_4K(offset + size) && i < (this->size >> PAGE_SHIFT_4K); i++){
+        if(!pageState[i] && Hit(base, i << PAGE_SHIFT_4K, pMap, false)){
+            return; // Only advice, give up
+        }
+    }
+}
+
+void FileVMObject::Discard(uintptr_t base, uintptr_t offset, size_t size, PageMap* pMap){
+    if(refCount > 1){
+        return; // The pages are mapped elsewhere
+    }
+
+    for(uintptr_t i = offset >> PAGE_SHIFT_4K; i < PAGE_COUNT_4K(offset + size) && i < (this->size >> PAGE_SHIFT_4K); i++){
+        if(!pageState[i]){
+            continue;
+        }
+
+        // The page cache frees pages with the last reference so keep modified data
+        if((pageState[i] & PageDirty) && cache->WriteBack(fileOffset + (i << PAGE_SHIFT_4K))){
+            continue;
+        }
+
+        Memory::MapVirtualMemory4K(0, base + (i << PAGE_SHIFT_4K), 1, PAGE_USER, pMap);
+
+        ScopedSpinLock acquired(lock);
+        ReleasePage(i); // Private pages revert to the contents of the node
+    }
+}
+
+size_t FileVMObject::UsedPhysicalMemory() const {
+    unsigned blockCount = 0;
+    for(unsigned i = 0; i < size >> PAGE_SHIFT_4K; i++){
+        if(pageState[i]){
+            blockCount++;
+        }
+    }
+
+    return blockCount << PAGE_SHIFT_4K;
+}
@@ -0,0 +1,281 @@
+#include <MM/VMem.h>
+
+#include <Assert.h>
+#include <Logging.h>
+
+void VMemArena::Initialize(uintptr_t base, size_t size, size_t quantum, void (*populate)(uintptr_t, size_t)) {
+    assert(quantum && !(quantum & (quantum - 1)));
+    assert(!(base & (quantum - 1)) && !(size & (quantum - 1)) && size);
+
+    m_base = base;
+    m_size = size;
+    m_inUse = 0;
+    m_quantum = quantum;
+    m_quantumShift = __builtin_ctzll(quantum);
+    m_populate = populate;
+
+    for (VMemSegment& tag : m_bootstrapTags) {
+        PutTag(&tag);
+    }
+
+    VMemSegment* seg = GetTag();
+    *seg = {
+        .base = base, .size = size, .prev = nullptr, .next = nullptr, .listPrev = nullptr, .listNext = nullptr, .free = true};
+
+    FreelistInsert(seg);
+}
+
+uintptr_t VMemArena::Allocate(size_t size) {
+    size = RoundSize(size);
+
+    size_t quanta = size >> m_quantumShift;
+    if (quanta > VMEM_QCACHE_MAX) {
+        ScopedTicketLock acq(m_lock);
+        return AllocateLocked(size);
+    }
+
+    QuantumCache& cache = m_qcaches[quanta - 1];
+    ScopedTicketLock acqCache(cache.lock);
+
+    if (!cache.count) {
+        // Fill half the cache so frees have space to go to
+        ScopedTicketLock acq(m_lock);
+        while (cache.count < VMEM_QCACHE_DEPTH / 2) {
+            uintptr_t span = AllocateLocked(size);
+            if (!span) {
+                break;
+            }
+
+            cache.spans[cache.count++] = span;
+        }
+
+        if (!cache.count) {
+            return 0;
+        }
+    }
+
+    return cache.spans[--cache.count];
+}
+
+void VMemArena::Free(uintptr_t base, size_t size) {
+    size = RoundSize(size);
+
+    size_t quanta = size >> m_quantumShift;
+    if (quanta > VMEM_QCACHE_MAX) {
+        ScopedTicketLock acq(m_lock);
+        FreeLocked(base, size);
+        return;
+    }
+
+    QuantumCache& cache = m_qcaches[quanta - 1];
+    ScopedTicketLock acqCache(cache.lock);
+
+    if (cache.count >= VMEM_QCACHE_DEPTH) {
+        // Return the older half of the cache to the arena
+        ScopedTicketLock acq(m_lock);
+        for (unsigned i = 0; i < VMEM_QCACHE_DEPTH / 2; i++) {
+            FreeLocked(cache.spans[i], size);
+        }
+
+        cache.count -= VMEM_QCACHE_DEPTH / 2;
+        for (unsigned i = 0; i < cache.count; i++) {
+            cache.spans[i] = cache.spans[i + VMEM_QCACHE_DEPTH / 2];
+        }
+    }
+
+    cache.spans[cache.count++] = base;
+}
+
+uintptr_t VMemArena::AllocateLocked(size_t size) {
+    if (m_freeTagCount < VMEM_TAG_RESERVE) {
+        RefillTags();
+    }
+
+    return AllocateSegment(size);
+}
+
+uintptr_t VMemArena::AllocateSegment(size_t size) {
+    VMemSegment* seg = FindFree(size);
+    if (!seg) {
+        return 0;
+    }
+
+    FreelistRemove(seg);
+
+    if (seg->size > size) {
+        // Split off the remainder as a new free segment
+        VMemSegment* remainder = GetTag();
+        *remainder = {.base = seg->base + size,
+                      .size = seg->size - size,
+                      .prev = seg,
+                      .next = seg->next,
+                      .listPrev = nullptr,
+                      .listNext = nullptr,
+                      .free = true};
+
+        if (seg->next) {
+            seg->next->prev = remainder;
+        }
+        seg->next = remainder;
+        seg->size = size;
+
+        FreelistInsert(remainder);
+    }
+
+    seg->free = false;
+    HashInsert(seg);
+
+    m_inUse += size;
+    return seg->base;
+}
+
+void VMemArena::FreeLocked(uintptr_t base, size_t size) {
+    VMemSegment* seg = HashRemove(base);
+    if (!seg) {
+        Log::Error("[VMem] Freeing %x which was never allocated!", base);
+        return;
+    } else if (seg->size != size) {
+        Log::Error("[VMem] Freeing %x with size %u, expected %u!", base, size, seg->size);
+        HashInsert(seg); // Leak the segment rather than free memory which is still in use
+        return;
+    }
+
+    m_inUse -= size;
+    seg->free = true;
+
+    // Merge with the free neighbours
+    if (VMemSegment* next = seg->next; next && next->free) {
+        FreelistRemove(next);
+
+        seg->size += next->size;
+        seg->next = next->next;
+        if (next->next) {
+            next->next->prev = seg;
+        }
+
+        PutTag(next);
+    }
+
+    if (VMemSegment* prev = seg->prev; prev && prev->free) {
+        FreelistRemove(prev);
+
+        prev->size += seg->size;
+        prev->next = seg->next;
+        if (seg->next) {
+            seg->next->prev = prev;
+        }
+
+        PutTag(seg);
+        seg = prev;
+    }
+
+    FreelistInsert(seg);
+}
+
+VMemSegment* VMemArena::FindFree(size_t size) {
+    size_t quanta = size >> m_quantumShift;
+    unsigned index = FreelistIndex(quanta);
+
+    // Every segment on the next list up is large enough
+    unsigned fitIndex = (quanta & (quanta - 1)) ? index + 1 : index;
+    if (fitIndex < VMEM_FREELIST_COUNT) {
+        if (uint64_t lists = m_freelistMap >> fitIndex; lists) {
+            return m_freelists[fitIndex + __builtin_ctzll(lists)];
+        }
+    }
+
+    // Only the list of our own size class is left, its segments may or may not be large enough
+    for (VMemSegment* seg = m_freelists[index]; seg; seg = seg->listNext) {
+        if (seg->size >= size) {
+            return seg;
+        }
+    }
+
+    return nullptr;
+}
+
+void VMemArena::FreelistInsert(VMemSegment* seg) {
+    unsigned index = FreelistIndex(seg->size >> m_quantumShift);
+
+    seg->listPrev = nullptr;
+    seg->listNext = m_freelists[index];
+    if (seg->listNext) {
+        seg->listNext->listPrev = seg;
+    }
+
+    m_freelists[index] = seg;
+    m_freelistMap |= (1ULL << index);
+}
+
+void VMemArena::FreelistRemove(VMemSegment* seg) {
+    unsigned index = FreelistIndex(seg->size >> m_quantumShift);
+
+    if (seg->listPrev) {
+        seg->listPrev->listNext = seg->listNext;
+    } else {
+        m_freelists[index] = seg->listNext;
+    }
+
+    if (seg->listNext) {
+        seg->listNext->listPrev = seg->listPrev;
+    }
+
+    if (!m_freelists[index]) {
+        m_freelistMap &= ~(1ULL << index);
+    }
+}
+
+void VMemArena::HashInsert(VMemSegment* seg) {
+    VMemSegment*& bucket = m_hash[HashIndex(seg->base)];
+
+    seg->listPrev = nullptr;
+    seg->listNext = bucket;
+    bucket = seg;
+}
+
+VMemSegment* VMemArena::HashRemove(uintptr_t base) {
+    VMemSegment** link = &m_hash[HashIndex(base)];
+    while (*link) {
+        VMemSegment* seg = *link;
+        if (seg->base == base) {
+            *link = seg->listNext;
+            return seg;
+        }
+
+        link = &seg->listNext;
+    }
+
+    return nullptr;
+}
+
+VMemSegment* VMemArena::GetTag() {
+    assert(m_freeTags);
+
+    VMemSegment* tag = m_freeTags;
+    m_freeTags = tag->listNext;
+    m_freeTagCount--;
+
+    return tag;
+}
+
+void VMemArena::PutTag(VMemSegment* tag) {
+    tag->listNext = m_freeTags;
+    m_freeTags = tag;
+    m_freeTagCount++;
+}
+
+void VMemArena::RefillTags() {
+    // The tags come out of the arena itself, the reserve leaves enough tags to allocate them.
+    // They are never freed.
+    uintptr_t base = AllocateSegment(m_quantum);
+    if (!base) {
+        return;
+    }
+
+    m_populate(base, m_quantum);
+
+    VMemSegment* tags = reinterpret_cast<VMemSegment*>(base);
+    for (unsigned i = 0; i < m_quantum / sizeof(VMemSegment); i++) {
+        PutTag(&tags[i]);
+    }
+}
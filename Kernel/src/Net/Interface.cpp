@@ -2,6 +2,8 @@
 #include <Net/Adapter.h>
 
 #include <Scheduler.h>
+#include <SMP.h>
+#include <Hash.h>
 #include <Logging.h>
 #include <Math.h>
 #include <Timer.h>
@@ -10,14 +12,10 @@
 #include <Objects/Service.h>
 #include <Objects/Interface.h>
 
-#define NET_INTERFACE_STACKSIZE 32768
-
 namespace Network{
 	extern HashMap<uint32_t, MACAddress> addressCache;
 	extern Vector<NetworkAdapter*> adapters;
 
-	Semaphore packetQueueSemaphore(0);
-
 	void OnReceiveARP(void* data, size_t length){
 		if(length < sizeof(ARPHeader)){
 			IF_DEBUG(debugLevelNetwork >= DebugLevelVerbose, {
@@ -115,56 +113,166 @@ namespace Network{
 		}
 	}
 
-	[[noreturn]] void InterfaceThread(){
-		Log::Info("[Network] Initializing network interface layer...");
+	// Protocol processing is spread over a worker per CPU.
+	// Each adapter is polled by a single worker, received packets are then steered to a worker by flow
+	// so packets from the same connection are always processed in order.
+	struct NetworkWorker{
+		Semaphore semaphore = Semaphore(0);
+
+		lock_t backlogLock = 0;
+		FastList<NetworkPacket*> backlog;
+	};
+
+	NetworkWorker* workers = nullptr;
+	unsigned workerCount = 0;
+	unsigned nextWorker = 0;
+
+	// Packets from the same IPv4 flow (addresses and ports) hash to the same value
+	static uint32_t FlowHash(NetworkPacket* packet){
+		if(packet->length < sizeof(EthernetFrame) + sizeof(IPv4Header)){
+			return 0;
+		}
+
+		EthernetFrame* etherFrame = reinterpret_cast<EthernetFrame*>(packet->data);
+		if((uint16_t)etherFrame->etherType != EtherTypeIPv4){
+			return 0; // ARP and anything else all go to the same worker
+		}
+
+		IPv4Header* header = reinterpret_cast<IPv4Header*>(etherFrame->data);
+		uint32_t hash = HashU(header->sourceIP.value) * 31 + HashU(header->destIP.value);
+
+		size_t headerLength = header->ihl * 4;
+		if((header->protocol == IPv4ProtocolTCP || header->protocol == IPv4ProtocolUDP)
+			&& packet->length >= sizeof(EthernetFrame) + headerLength + sizeof(uint32_t)){
+			uint32_t ports; // Source and destination port are the first 4 bytes of both TCP and UDP headers
+			memcpy(&ports, reinterpret_cast<uint8_t*>(header) + headerLength, sizeof(uint32_t));
+
+			hash = hash * 31 + HashU(ports);
+		}
+
+		return hash;
+	}
+
+	void ReceivePacket(NetworkPacket* packet){
+		packet->flowHash = FlowHash(packet);
+		NetworkWorker& worker = workers[packet->flowHash % workerCount];
+
+		acquireLock(&worker.backlogLock);
+		if(worker.backlog.get_length() >= NET_MAX_BACKLOG){
+			releaseLock(&worker.backlogLock);
+
+			packet->adapter->CachePacket(packet); // We can't keep up, drop the packet
+			return;
+		}
+
+		// The worker empties its backlog before waiting again,
+		// so it only needs waking if the backlog was empty
+		bool wake = !worker.backlog.get_length();
+		worker.backlog.add_back(packet);
+		releaseLock(&worker.backlogLock);
+
+		if(wake){
+			worker.semaphore.Signal();
+		}
+	}
+
+	void NetworkAdapter::ScheduleReceive(){
+		receiveScheduled = true;
+
+		if(workerCount){ // Otherwise the workers poll all scheduled adapters once they start
+			workers[adapterIndex % workerCount].semaphore.Signal();
+		}
+	}
+
+	static void ProcessPacket(NetworkPacket* p){
+		NetworkAdapter* adapter = p->adapter;
+
+		if(p->length < sizeof(EthernetFrame)){
+			Log::Warning("[Network] Discarding packet (too short)");
+
+			adapter->CachePacket(p);
+			return;
+		}
+
+		// Demux straight from the driver's buffer
+		EthernetFrame* etherFrame = reinterpret_cast<EthernetFrame*>(p->data);
+
+		if(etherFrame->dest != adapter->mac){
+			//Log::Warning("[Network] Discarding packet (invalid MAC address %x:%x:%x:%x:%x:%x)", etherFrame->dest[0], etherFrame->dest[1], etherFrame->dest[2], etherFrame->dest[3], etherFrame->dest[4], etherFrame->dest[5]);
+		}
+		
+		switch ((uint16_t)etherFrame->etherType)
+		{
+		case EtherTypeIPv4:
+			OnReceiveIPv4(etherFrame->data, p->length - sizeof(EthernetFrame));
+			break;
+		case EtherTypeARP:
+			OnReceiveARP(etherFrame->data, p->length - sizeof(EthernetFrame));
+			break;
+		default:
+			Log::Warning("[Network] Discarding packet (invalid EtherType %x)", etherFrame->etherType);
+			break;
+		}
+
+		adapter->CachePacket(p); // Give the buffer back to the NIC driver
+	}
+
+	[[noreturn]] void NetworkWorkerThread(){
+		unsigned index = __atomic_fetch_add(&nextWorker, 1, __ATOMIC_SEQ_CST);
+		NetworkWorker& worker = workers[index];
 
 		for(;;){
-			NetworkPacket* p;
-			if(packetQueueSemaphore.Wait()){
+			if(worker.semaphore.Wait()){
 				continue; // We got interrupted
 			}
-			
+
+			bool polling = false;
 			for(NetworkAdapter* adapter : adapters){
-				if((p = adapter->Dequeue())){
-					if(p->length < sizeof(EthernetFrame)){
-						Log::Warning("[Network] Discarding packet (too short)");
-
-						adapter->CachePacket(p);
-						break;
-					}
-
-					size_t len = p->length;
-					uint8_t buffer[ETHERNET_MAX_PACKET_SIZE];
-					memcpy(buffer, p->data, p->length);
-
-					adapter->CachePacket(p); // Get the packet back to the NIC driver's cache as soon as possible
-
-					EthernetFrame* etherFrame = reinterpret_cast<EthernetFrame*>(buffer);
-
-					if(etherFrame->dest != adapter->mac){
-						//Log::Warning("[Network] Discarding packet (invalid MAC address %x:%x:%x:%x:%x:%x)", etherFrame->dest[0], etherFrame->dest[1], etherFrame->dest[2], etherFrame->dest[3], etherFrame->dest[4], etherFrame->dest[5]);
-					}
-					
-					switch ((uint16_t)etherFrame->etherType)
-					{
-					case EtherTypeIPv4:
-						OnReceiveIPv4(etherFrame->data, len - sizeof(EthernetFrame));
-						break;
-					case EtherTypeARP:
-						OnReceiveARP(etherFrame->data, len - sizeof(EthernetFrame));
-						break;
-					default:
-						Log::Warning("[Network] Discarding packet (invalid EtherType %x)", etherFrame->etherType);
-						break;
-					}
+				if(adapter->adapterIndex % workerCount != index || !adapter->receiveScheduled){
+					continue;
+				}
+
+				if(adapter->Poll(NET_POLL_BUDGET) < NET_POLL_BUDGET){
+					// The adapter has run dry, go back to waiting for interrupts
+					adapter->receiveScheduled = false;
+					adapter->EnableReceiveInterrupts();
+				} else {
+					polling = true; // Under heavy traffic, keep receive interrupts masked and poll again
 				}
 			}
+
+			acquireLock(&worker.backlogLock);
+			while(worker.backlog.get_length()){
+				NetworkPacket* p = worker.backlog.remove_at(0);
+				releaseLock(&worker.backlogLock);
+
+				ProcessPacket(p);
+
+				acquireLock(&worker.backlogLock);
+			}
+			releaseLock(&worker.backlogLock);
+
+			if(polling){
+				Scheduler::Yield(); // Let everything else run before we poll again
+				worker.semaphore.Signal();
+			}
 		}
 	}
 
-	void InitializeNetworkThread(){
-		//Scheduler::CreateChildThread(Scheduler::GetCurrentProcess(), (uintptr_t)InterfaceThread, (uintptr_t)kmalloc(NET_INTERFACE_STACKSIZE) + NET_INTERFACE_STACKSIZE, KERNEL_CS, KERNEL_SS);
-		Scheduler::CreateProcess((void*)InterfaceThread);
+	void InitializeNetworkWorkers(){
+		workerCount = SMP::processorCount;
+		workers = new NetworkWorker[workerCount];
+
+		Log::Info("[Network] Initializing network interface layer (%u workers)...", workerCount);
+
+		// There is no way to pin a thread to a CPU,
+		// however new threads are placed on the least busy CPU which spreads the workers out
+		for(unsigned i = 0; i < workerCount; i++){
+			process_t* proc = Scheduler::CreateProcess((void*)NetworkWorkerThread);
+			strcpy(proc->name, "NetworkWorker");
+
+			workers[i].semaphore.Signal(); // Poll any adapters which were scheduled before we started
+		}
 	}
 
 	void Send(void* data, size_t length, NetworkAdapter* adapter){
@@ -17,7 +17,8 @@ namespace Network {
     HashMap<uint32_t, MACAddress> addressCache;
 
     void InitializeConnections(){
-        InitializeNetworkThread();
+        InitializeNetworkWorkers();
+        TCP::Initialize();
     }
 
     int IPLookup(NetworkAdapter* adapter, const IPv4Address& ip, MACAddress& mac){
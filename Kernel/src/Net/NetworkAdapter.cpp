@@ -5,6 +5,7 @@
 #include <Assert.h>
 #include <Errno.h>
 #include <Net/Socket.h>
+#include <UserMemory.h>
 
 namespace Network {
     extern Vector<NetworkAdapter*> adapters;
@@ -46,6 +47,20 @@ namespace Network {
         }
     }
     
+    int NetworkAdapter::Poll(int budget){
+        int count = 0;
+
+        NetworkPacket* pkt;
+        while(count < budget && (pkt = Dequeue())){
+            pkt->adapter = this;
+            ReceivePacket(pkt);
+
+            count++;
+        }
+
+        return count;
+    }
+
     void NetworkAdapter::CachePacket(NetworkPacket* pkt){
         if(cache.get_length() < maxCache){
             acquireLock(&cacheLock);
@@ -62,21 +77,24 @@ namespace Network {
         process_t* currentProcess = Scheduler::GetCurrentProcess();
 
         if(cmd == SIOCADDRT){
-            rtentry* route = reinterpret_cast<rtentry*>(arg);
-            if(!Memory::CheckUsermodePointer(arg, sizeof(rtentry), currentProcess->addressSpace)){
+            rtentry route;
+            if(get_user(&route, reinterpret_cast<rtentry*>(arg))){
                 return -EFAULT;
             }
 
-            if(!((route->rt_flags & RTF_GATEWAY) && (route->rt_flags & RTF_UP))){
+            if(!((route.rt_flags & RTF_GATEWAY) && (route.rt_flags & RTF_UP))){
                 return -EINVAL;
             }
 
-            size_t nameLen;
-            if(strlenSafe(route->rt_dev, nameLen, currentProcess->addressSpace)){
-                return -EFAULT;
+            char deviceName[IF_NAMESIZE];
+            long nameLen = strncpy_from_user(deviceName, route.rt_dev, IF_NAMESIZE);
+            if(nameLen == -ENAMETOOLONG){
+                return -ENODEV; // Too long to be the name of any adapter
+            } else if(nameLen < 0){
+                return nameLen;
             }
 
-            NetworkAdapter* namedAdapter = NetFS::GetInstance()->FindAdapter(route->rt_dev, nameLen);
+            NetworkAdapter* namedAdapter = NetFS::GetInstance()->FindAdapter(deviceName, nameLen);
             if(!namedAdapter){
                 return -ENODEV;
             }
@@ -88,7 +106,7 @@ namespace Network {
                 return -EPERM; // We are not root
             }
 
-            sockaddr_in* addr = reinterpret_cast<sockaddr_in*>(&route->rt_gateway);
+            sockaddr_in* addr = reinterpret_cast<sockaddr_in*>(&route.rt_gateway);
             if(addr->sin_family != SocketProtocol::InternetProtocol){
                 IF_DEBUG(debugLevelNetwork >= DebugLevelVerbose, {
                     Log::Warning("[Network] NetworkAdapter::Ioctl: Not an IPv4 address!");
@@ -98,9 +116,9 @@ namespace Network {
             namedAdapter->gatewayIP.value = addr->sin_addr.s_addr;
             return 0;
         } else if(cmd >= SIOCGIFNAME && cmd <= SIOCGIFCOUNT){
-            ifreq* req = reinterpret_cast<ifreq*>(arg);
-
-            if(!Memory::CheckUsermodePointer(arg, sizeof(ifreq), currentProcess->addressSpace)){
+            ifreq request;
+            ifreq* req = &request;
+            if(get_user(req, reinterpret_cast<ifreq*>(arg))){
                 return -EFAULT;
             }
 
@@ -172,7 +190,7 @@ namespace Network {
             default:
                 return -EINVAL;
             }
-            return 0;
+            return put_user(reinterpret_cast<ifreq*>(arg), request);
         } else {
             return -EINVAL;
         }
@@ -3,7 +3,9 @@
 #include <Assert.h>
 #include <Errno.h>
 #include <Logging.h>
+#include <Math.h>
 #include <Scheduler.h>
+#include <UserMemory.h>
 
 int Socket::CreateSocket(int domain, int type, int protocol, Socket** sock) {
     if (type & SOCK_NONBLOCK)
@@ -93,6 +95,77 @@ int64_t Socket::SendTo(void* buffer, size_t len, int flags, const sockaddr* src,
     return -1; // We should not return but get the compiler to shut up
 }
 
+int64_t Socket::ReceiveFromUser(void* buffer, size_t len, int flags, sockaddr* src, socklen_t* addrlen,
+                                const void* ancillary, size_t ancillaryLen) {
+    // Receiving again could block so at most USER_BOUNCE_SIZE bytes are received
+    len = MIN(len, (size_t)USER_BOUNCE_SIZE);
+    if (!len) {
+        return ReceiveFrom(nullptr, 0, flags, src, addrlen, ancillary, ancillaryLen);
+    }
+
+    uint8_t* kernelBuffer = reinterpret_cast<uint8_t*>(kmalloc(len));
+    if (!kernelBuffer) {
+        return -ENOMEM;
+    }
+
+    int64_t ret = ReceiveFrom(kernelBuffer, len, flags, src, addrlen, ancillary, ancillaryLen);
+    if (ret > 0 && copy_to_user(buffer, kernelBuffer, ret)) {
+        ret = -EFAULT;
+    }
+
+    kfree(kernelBuffer);
+    return ret;
+}
+
+int64_t Socket::SendToUser(const void* buffer, size_t len, int flags, const sockaddr* src, socklen_t addrlen,
+                           const void* ancillary, size_t ancillaryLen) {
+    if (!len) {
+        return SendTo(nullptr, 0, flags, src, addrlen, ancillary, ancillaryLen);
+    }
+
+    // Datagrams cannot be split, they are sent in one piece or not at all
+    if (type == DatagramSocket && len > USER_BOUNCE_SIZE) {
+        return -EMSGSIZE;
+    }
+
+    size_t chunkSize = MIN(len, (size_t)USER_BOUNCE_SIZE);
+    uint8_t* kernelBuffer = reinterpret_cast<uint8_t*>(kmalloc(chunkSize));
+    if (!kernelBuffer) {
+        return -ENOMEM;
+    }
+
+    int64_t sent = 0;
+    while (static_cast<size_t>(sent) < len) {
+        size_t chunk = MIN(len - sent, chunkSize);
+        if (copy_from_user(kernelBuffer, reinterpret_cast<const uint8_t*>(buffer) + sent, chunk)) {
+            kfree(kernelBuffer);
+            return sent ? sent : -EFAULT;
+        }
+
+        int64_t ret = SendTo(kernelBuffer, chunk, flags, src, addrlen, ancillary, ancillaryLen);
+        if (ret < 0) {
+            kfree(kernelBuffer);
+            return sent ? sent : ret;
+        }
+
+        sent += ret;
+        if (static_cast<size_t>(ret) < chunk) {
+            break;
+        }
+    }
+
+    kfree(kernelBuffer);
+    return sent;
+}
+
+ssize_t Socket::ReadUser(size_t offset, size_t size, uint8_t* buffer) {
+    return ReceiveFromUser(buffer, size, 0, nullptr, nullptr);
+}
+
+ssize_t Socket::WriteUser(size_t offset, size_t size, const uint8_t* buffer) {
+    return SendToUser(buffer, size, 0, nullptr, 0);
+}
+
 int Socket::GetSocketOptions(int level, int opt, void* optValue, socklen_t* optLength) {
     if (level == SOL_SOCKET) {
         switch (opt) {
@@ -149,8 +222,8 @@ LocalSocket::LocalSocket(int type, int protocol) : Socket(type, protocol) {
         inbound = new PacketStream();
         outbound = new PacketStream();
     } else {
-        inbound = new DataStream(1024);
-        outbound = new DataStream(1024);
+        inbound = new DataStream(STREAM_MAX_BUFSIZE);
+        outbound = new DataStream(STREAM_MAX_BUFSIZE);
     }
 }
 
@@ -181,6 +254,11 @@ LocalSocket* LocalSocket::CreatePairedSocket(LocalSocket* client) {
 
     sock->outbound = client->inbound; // Outbound to client
     sock->inbound = client->outbound; // Inbound to server
+
+    FancyRefPtr<PeerLink> link = new PeerLink;
+    sock->m_link = link;
+    client->m_link = link;
+
     sock->peer = client;
     client->peer = sock;
 
@@ -215,23 +293,74 @@ int LocalSocket::ConnectTo(LocalSocket* client) {
 }
 
 void LocalSocket::DisconnectPeer() {
-    assert(peer);
+    LocalSocket* p;
+    {
+        ScopedSpinLock acq(m_link->lock);
+
+        p = peer;
+        if (p) {
+            p->peer = nullptr;
+            __atomic_add_fetch(&p->m_references, 1, __ATOMIC_RELAXED);
+        }
 
-    peer->OnDisconnect();
+        peer = nullptr;
+    }
 
-    peer = nullptr;
+    if (p) {
+        p->OnDisconnect();
+        p->Unref();
+    }
 }
 
+LocalSocket* LocalSocket::AcquirePeer() {
+    if (!m_link.get()) {
+        return nullptr; // Never connected
+    }
+
+    ScopedSpinLock acq(m_link->lock);
+
+    LocalSocket* p = peer;
+    if (p) {
+        __atomic_add_fetch(&p->m_references, 1, __ATOMIC_RELAXED);
+    }
+
+    return p;
+}
+
+void LocalSocket::Unref() {
+    if (__atomic_sub_fetch(&m_references, 1, __ATOMIC_ACQ_REL) == 0) {
+        delete this;
+    }
+}
+
+// Expects peer to have been cleared by DisconnectPeer
 void LocalSocket::OnDisconnect() {
     m_connected = false;
 
+    // Signal everyone blocked or watching on disconnect
+    Wake(FilesystemBlocker::BlockRead);
+    Wake(FilesystemBlocker::BlockWrite);
+}
+
+void LocalSocket::Wake(int blockType) {
+    acquireLock(&blockedLock);
+    FilesystemBlocker* bl = blocked.get_front();
+    while (bl) {
+        FilesystemBlocker* next = blocked.next(bl);
+
+        if (bl->Type() == blockType) {
+            bl->Unblock();
+        }
+
+        bl = next;
+    }
+    releaseLock(&blockedLock);
+
     acquireLock(&m_watcherLock);
     while (m_watching.get_length()) {
-        m_watching.remove_at(0)->Signal(); // Signal all watching on disconnect
+        m_watching.remove_at(0)->Signal();
     }
     releaseLock(&m_watcherLock);
-
-    peer = nullptr;
 }
 
 Socket* LocalSocket::Accept(sockaddr* addr, socklen_t* addrlen, int mode) {
@@ -356,6 +485,15 @@ int LocalSocket::Listen(int backlog) {
 
 int64_t LocalSocket::ReceiveFrom(void* buffer, size_t len, int flags, sockaddr* src, socklen_t* addrlen,
                                  const void* ancillary, size_t ancillaryLen) {
+    return ReceiveStream(buffer, len, flags, src, addrlen, false);
+}
+
+int64_t LocalSocket::ReceiveFromUser(void* buffer, size_t len, int flags, sockaddr* src, socklen_t* addrlen,
+                                     const void* ancillary, size_t ancillaryLen) {
+    return ReceiveStream(buffer, len, flags, src, addrlen, true);
+}
+
+int64_t LocalSocket::ReceiveStream(void* buffer, size_t len, int flags, sockaddr* src, socklen_t* addrlen, bool user) {
     if (type == StreamSocket) {
         if (src || addrlen) {
             return -EISCONN;
@@ -373,20 +511,45 @@ int64_t LocalSocket::ReceiveFrom(void* buffer, size_t len, int flags, sockaddr*
 
     if (inbound->Empty() && (flags & MSG_DONTWAIT)) {
         return -EAGAIN;
-    } else
-        while (inbound->Empty()) {
-            inbound->Wait();
+    }
+
+    while (inbound->Empty() && m_connected) {
+        FilesystemBlocker bl(this, len);
+
+        if (inbound->Empty() && m_connected && Scheduler::GetCurrentThread()->Block(&bl)) {
+            return -EINTR;
         }
+    }
 
     if (flags & MSG_PEEK) {
-        return inbound->Peek(buffer, len);
-    } else {
-        return inbound->Read(buffer, len);
+        return user ? inbound->PeekUser(buffer, len) : inbound->Peek(buffer, len);
     }
+
+    int64_t read = user ? inbound->ReadUser(buffer, len) : inbound->Read(buffer, len);
+
+    // Space has been freed, let the peer continue writing
+    if (read > 0) {
+        if (LocalSocket* p = AcquirePeer(); p) {
+            p->Wake(FilesystemBlocker::BlockWrite);
+            p->Unref();
+        }
+    }
+
+    return read;
 }
 
 int64_t LocalSocket::SendTo(void* buffer, size_t len, int flags, const sockaddr* src, socklen_t addrlen,
                             const void* ancillary, size_t ancillaryLen) {
+    return SendStream(buffer, len, flags, src, addrlen, false);
+}
+
+int64_t LocalSocket::SendToUser(const void* buffer, size_t len, int flags, const sockaddr* src, socklen_t addrlen,
+                                const void* ancillary, size_t ancillaryLen) {
+    return SendStream(buffer, len, flags, src, addrlen, true);
+}
+
+int64_t LocalSocket::SendStream(const void* buffer, size_t len, int flags, const sockaddr* src, socklen_t addrlen,
+                                bool user) {
     if (type == StreamSocket) {
         if (src || addrlen) {
             return -EISCONN;
@@ -402,21 +565,49 @@ int64_t LocalSocket::SendTo(void* buffer, size_t len, int flags, const sockaddr*
         return -ENOTCONN;
     }
 
-    if (type == StreamSocket && (flags & MSG_DONTWAIT) && outbound->Pos() + len >= STREAM_MAX_BUFSIZE) {
+    if (type == DatagramSocket) {
+        int64_t written = user ? outbound->WriteUser(buffer, len) : outbound->Write(const_cast<void*>(buffer), len);
+
+        if (LocalSocket* p = AcquirePeer(); p) {
+            p->Wake(FilesystemBlocker::BlockRead);
+            p->Unref();
+        }
+
+        return written;
+    }
+
+    if ((flags & MSG_DONTWAIT) && !outbound->Space()) {
         return -EAGAIN;
-    } else
-        while (type == StreamSocket && outbound->Pos() + len >= STREAM_MAX_BUFSIZE) {
-            Scheduler::Yield();
+    }
+
+    uint8_t* data = reinterpret_cast<uint8_t*>(const_cast<void*>(buffer));
+    size_t written = 0;
+    while (written < len) {
+        if (!m_connected) {
+            return written ? written : -EPIPE;
         }
 
-    int64_t written = outbound->Write(buffer, len);
+        int64_t ret = user ? outbound->WriteUser(data + written, len - written) : outbound->Write(data + written, len - written);
+        if (ret < 0) {
+            return written ? written : ret;
+        } else if (ret > 0) {
+            written += ret;
 
-    if (peer && peer->CanRead()) {
-        acquireLock(&peer->m_watcherLock);
-        while (peer->m_watching.get_length()) {
-            peer->m_watching.remove_at(0)->Signal();
+            if (LocalSocket* p = AcquirePeer(); p) {
+                p->Wake(FilesystemBlocker::BlockRead);
+                p->Unref();
+            }
+            continue;
+        } else if (flags & MSG_DONTWAIT) {
+            break; // Partial write
+        }
+
+        // The peer is not keeping up, wait for it to make space
+        FilesystemBlocker bl(this, len - written, FilesystemBlocker::BlockWrite);
+
+        if (m_connected && !outbound->Space() && Scheduler::GetCurrentThread()->Block(&bl)) {
+            return written ? written : -EINTR;
         }
-        releaseLock(&peer->m_watcherLock);
     }
 
     return written;
@@ -436,7 +627,7 @@ fs_fd_t* LocalSocket::Open(size_t flags) {
 
 void LocalSocket::Close() {
     if (handleCount == 0) {
-        if (peer) {
+        if (m_link.get()) {
             DisconnectPeer();
         }
 
@@ -452,7 +643,7 @@ void LocalSocket::Close() {
             bound = false;
         }
 
-        delete this;
+        Unref(); // The peer may still be waking us
     }
 }
 
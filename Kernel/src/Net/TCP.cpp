@@ -2,7 +2,9 @@
 #include <Net/Socket.h>
 #include <Net/Adapter.h>
 
+#include <Scheduler.h>
 #include <Timer.h>
+#include <TimerEvent.h>
 #include <Math.h>
 
 #include <Errno.h>
@@ -28,7 +30,11 @@ struct TCPConnectionIdentifier{
 
 template<>
 inline unsigned Hash<TCPConnectionIdentifier>(const TCPConnectionIdentifier& id){
-    return ::Hash(id.remoteIP.value) ^ ::Hash(id.localIP.value) ^ ::Hash(id.remotePort) ^ ::Hash(id.localPort);
+    // XOR alone would give swapped ports/addresses the same hash
+    unsigned hash = ::Hash(id.remoteIP.value);
+    hash = HashCombine(hash, ::Hash(id.localIP.value));
+    hash = HashCombine(hash, ::Hash(id.remotePort));
+    return HashCombine(hash, ::Hash(id.localPort));
 }
 
 namespace Network {
@@ -37,6 +43,54 @@ namespace Network {
         HashMap<TCPConnectionIdentifier, TCPSocket*> sockets;
         uint16_t nextEphemeralPort = EPHEMERAL_PORT_RANGE_START;
 
+        // Retransmission and delayed ACK timers expire in the timer interrupt where we cannot send,
+        // so the timer callback flags the socket and the timer thread does the work
+        lock_t timerSocketsLock = 0;
+        List<TCPSocket*> timerSockets;
+        Semaphore timerSemaphore = Semaphore(0);
+
+        // Sequence numbers wrap around so compare using the difference
+        static inline bool SequenceBefore(uint32_t a, uint32_t b){
+            return static_cast<int32_t>(a - b) < 0;
+        }
+
+        void TimerThread(){
+            List<TCPSocket*> pending;
+            for(;;){
+                if(timerSemaphore.Wait()){
+                    continue; // We got interrupted
+                }
+
+                // Sending takes other locks and may block, so only collect the sockets under timerSocketsLock.
+                // m_timerActive stops a socket from being freed until we are done with it
+                acquireLock(&timerSocketsLock);
+                for(TCPSocket* sock : timerSockets){
+                    if(sock->m_retransmitPending || sock->m_delayedAckPending){
+                        sock->m_timerActive = true;
+                        pending.add_back(sock);
+                    }
+                }
+                releaseLock(&timerSocketsLock);
+
+                while(pending.get_length()){
+                    TCPSocket* sock = pending.remove_at(0);
+                    if(sock->m_retransmitPending){
+                        sock->OnRetransmitTimeout();
+                    }
+
+                    if(sock->m_delayedAckPending){
+                        sock->OnDelayedAckTimeout();
+                    }
+
+                    __atomic_store_n(&sock->m_timerActive, false, __ATOMIC_RELEASE);
+                }
+            }
+        }
+
+        void Initialize(){
+            Scheduler::CreateProcess((void*)TimerThread);
+        }
+
         TCPSocket* FindSocket(TCPConnectionIdentifier id){
             TCPSocket* sock = nullptr;
             
@@ -147,23 +201,69 @@ namespace Network {
             return ret;
         }
 
-        int SendTCP(void* data, size_t length, IPv4Address& source, IPv4Address& destination, TCPHeader& header, NetworkAdapter* adapter = nullptr){
+        struct TCPSynOptions {
+            uint16_t mss = TCP_DEFAULT_MSS;
+            int windowScale = -1; // -1 if the peer does not support window scaling
+            bool sackPermitted = false;
+        };
+
+        // Get the options the peer sent with its SYN
+        static TCPSynOptions ParseSynOptions(TCPHeader* header){
+            TCPSynOptions options;
+
+            uint8_t* option = reinterpret_cast<uint8_t*>(header) + sizeof(TCPHeader);
+            uint8_t* end = reinterpret_cast<uint8_t*>(header) + header->dataOffset * 4;
+
+            while(option < end && *option != TCPOptionEnd){
+                if(*option == TCPOptionNoOp){
+                    option++;
+                    continue;
+                }
+
+                if(option + 1 >= end || option[1] < 2 || option + option[1] > end){
+                    break; // Malformed option
+                }
+
+                if(*option == TCPOptionMaximumSegmentSize && option[1] == 4){
+                    uint16_t mss = (option[2] << 8) | option[3];
+                    if(mss){
+                        options.mss = MIN(mss, TCP_MSS);
+                    }
+                } else if(*option == TCPOptionWindowScale && option[1] == 3){
+                    options.windowScale = MIN(option[2], 14); // RFC 7323 limits the shift to 14
+                } else if(*option == TCPOptionSACKPermitted && option[1] == 2){
+                    options.sackPermitted = true;
+                }
+
+                option += option[1];
+            }
+
+            return options;
+        }
+
+        // Options must be padded to a multiple of 4 bytes
+        int SendTCP(void* data, size_t length, IPv4Address& source, IPv4Address& destination, TCPHeader& header, uint8_t* options = nullptr, size_t optionsLength = 0, NetworkAdapter* adapter = nullptr){
             uint8_t buffer[1600];
 
-            if(length + sizeof(TCPHeader) > 1600){
-                length = 1600 - sizeof(TCPHeader);
+            assert(!(optionsLength & 3) && optionsLength <= 40);
+
+            size_t headerLength = sizeof(TCPHeader) + optionsLength;
+            if(length + headerLength > 1600){
+                length = 1600 - headerLength;
             }
 
             TCPHeader* tcpHeader = reinterpret_cast<TCPHeader*>(buffer);
 
-            memcpy(buffer + sizeof(TCPHeader), data, length);
+            memcpy(buffer + sizeof(TCPHeader), options, optionsLength);
+            memcpy(buffer + headerLength, data, length);
 
             *tcpHeader = header;
+            tcpHeader->dataOffset = headerLength / 4;
 
             tcpHeader->checksum = 0;
-            tcpHeader->checksum = CalculateTCPChecksum(source, destination, buffer, length + sizeof(TCPHeader));
+            tcpHeader->checksum = CalculateTCPChecksum(source, destination, buffer, length + headerLength);
 
-            if(int e = SendIPv4(buffer, length + sizeof(TCPHeader), source, destination, IPv4ProtocolTCP, adapter); e){
+            if(int e = SendIPv4(buffer, length + headerLength, source, destination, IPv4ProtocolTCP, adapter); e){
                 return e;
             }
 
@@ -242,10 +342,30 @@ namespace Network {
                 if(ack && syn){ // It is important that we recieve a SYN and ACK
                     Log::Debug(debugLevelNetwork, DebugLevelVerbose, "[Network] [TCP] (State: SYN-SENT) Recieved SYN-ACK (Sequence number: %u) from %d.%d.%d.%d:%d", tcpHeader->sequence, source.data[0], source.data[1], source.data[2], source.data[3], (uint16_t)tcpHeader->srcPort);
 
-                    m_remoteSequenceNumber = tcpHeader->sequence;
-                    m_lastAcknowledged = tcpHeader->acknowledgementNumber;
+                    // Check the ACK before touching any state so a bogus SYN-ACK cannot corrupt it
+                    uint32_t ackNumber = tcpHeader->acknowledgementNumber;
+                    if(ackNumber == m_sendMax){ // The ACK number must be equal to the sequence number.
+                        m_remoteSequenceNumber = tcpHeader->sequence + 1; // SYN occupies a sequence number
+                        m_lastAcknowledged = ackNumber;
+
+                        TCPSynOptions options = ParseSynOptions(tcpHeader);
+                        m_mss = options.mss;
+                        m_sackPermitted = options.sackPermitted;
+
+                        if(options.windowScale >= 0){ // Only scale if both sides sent the option
+                            m_windowScale = TCP_WINDOW_SCALE;
+                            m_peerWindowScale = options.windowScale;
+                        }
+
+                        m_peerWindow = tcpHeader->windowSize; // Never scaled in a SYN
+
+                        m_advertisedEdge = m_remoteSequenceNumber;
+                        m_receivePeriodStart = Timer::GetSystemUptimeStruct();
+
+                        // Initial congestion window as per RFC 5681
+                        m_congestionWindow = MIN(4 * m_mss, MAX(2 * m_mss, 4380));
+                        m_recover = m_sendMax - 1;
 
-                    if(m_lastAcknowledged == m_sequenceNumber){ // The ACK number must be equal to the sequence number.
                         state = TCPStateEstablished; // Our SYN has been acknowledged with a SYN-ACK
 
                         UnblockAll(); // Unblock waiting threads
@@ -277,58 +397,19 @@ namespace Network {
                     return; // Unsupported flags
                 }
 
-                if(tcpHeader->sequence != m_remoteSequenceNumber){
-                    Log::Debug(debugLevelNetwork, DebugLevelNormal, "[Network] [TCP] (State: ESTABLISHED) Received packet with sequence number of %d, Expected %d", tcpHeader->sequence, m_remoteSequenceNumber);
-                    return; // Either a previous packet has been dropped, or it is retransmitting a previous packet
-                }
-
                 uint16_t dataOffset = tcpHeader->dataOffset * 4;
                 uint16_t dataLength = length - dataOffset;
 
-                if(ack){
-                    if(tcpHeader->acknowledgementNumber > m_sequenceNumber){
-                        Log::Debug(debugLevelNetwork, DebugLevelNormal, "[Network] [TCP] (State: ESTABLIHSED) recieved ACK wth ack number > sequence number");
-                        return;
-                    }
-
-                    acquireLock(&m_unacknowledgedPacketsLock);
-
-                    m_lastAcknowledged = tcpHeader->acknowledgementNumber;
-
-                    for(auto it = m_unacknowledgedPackets.begin(); it != m_unacknowledgedPackets.end(); it++){
-                        if(it->sequenceNumber <= m_lastAcknowledged){
-                            m_unacknowledgedPackets.remove(it);
-                        }
-
-                        if(it == m_unacknowledgedPackets.end()){
-                            break;
-                        }
-                    }
-
-                    releaseLock(&m_unacknowledgedPacketsLock);
+                // The peer's ACK number is still meaningful if the segment is out of order
+                if(ack && !OnAcknowledgement(tcpHeader->acknowledgementNumber, static_cast<uint32_t>(tcpHeader->windowSize) << m_peerWindowScale, !dataLength && !fin)){
+                    Log::Debug(debugLevelNetwork, DebugLevelNormal, "[Network] [TCP] (State: ESTABLIHSED) recieved ACK wth ack number > sequence number");
+                    return;
                 }
 
                 Log::Debug(debugLevelNetwork, DebugLevelVerbose, "[Network] [TCP] Recieving %d bytes of data (Flags: %hx, total len: %d)", dataLength, tcpHeader->flags & TCPHeader::FlagsMask);
 
                 if(dataLength){
-                    m_inboundData.Write(data + dataOffset, dataLength);
-
-                    acquireLock(&blockedLock);
-                    FilesystemBlocker* bl = blocked.get_front();
-                    while(bl){
-                        FilesystemBlocker* next = blocked.next(bl);
-
-                        if(bl->RequestedLength() <= m_inboundData.Pos()){
-                            bl->Unblock();
-                        }
-
-                        bl = next;
-                    }
-                    releaseLock(&blockedLock);
-
-                    m_remoteSequenceNumber = tcpHeader->sequence + dataLength;
-
-                    Acknowledge(m_remoteSequenceNumber);
+                    ReceiveData(tcpHeader->sequence, data + dataOffset, dataLength);
                 }
 
                 if(psh){
@@ -337,11 +418,14 @@ namespace Network {
                     doUnblock = true;
                 }
 
-                if(fin){
+                // Only accept the FIN once everything before it has been received, otherwise wait for the peer to retransmit
+                if(fin && tcpHeader->sequence + dataLength == m_remoteSequenceNumber){
                     Log::Debug(debugLevelNetwork, DebugLevelVerbose, "[Network] [TCP] (State: ESTABLISHED) Peer closed connection with FIN, entering CLOSE-WAIT");
                     state = TCPStateCloseWait; // Connection ended, wait for process(es) to close file descriptors
 
-                    Acknowledge(m_remoteSequenceNumber);
+                    m_remoteSequenceNumber++; // FIN occupies a sequence number
+
+                    Acknowledge();
                     doUnblock = true;
                 }
 
@@ -358,20 +442,27 @@ namespace Network {
                     return; // Unexpected flags
                 }
 
-                if(fin && ack){
+                if(ack){
+                    OnAcknowledgement(tcpHeader->acknowledgementNumber, static_cast<uint32_t>(tcpHeader->windowSize) << m_peerWindowScale, false);
+                }
+
+                bool finAcknowledged = m_finSent && m_lastAcknowledged == m_sendMax;
+                if(fin && finAcknowledged){
+                    m_remoteSequenceNumber = tcpHeader->sequence + 1;
+
                     state = TCPStateTimeWait;
 
-                    Acknowledge(m_remoteSequenceNumber);
-                } else if(ack){
+                    Acknowledge();
+                } else if(finAcknowledged){
                     m_remoteSequenceNumber = tcpHeader->sequence;
 
                     state = TCPStateFinWait2;
                 } else if(fin){
                     m_remoteSequenceNumber = tcpHeader->sequence + 1;
 
-                    FinishAcknowledge(m_remoteSequenceNumber);
+                    Acknowledge();
 
-                    state = TCPStateLastAck;
+                    state = TCPStateClosing; // Simultaneous close, wait for our FIN to be acknowledged then TIME-WAIT
                 }
 
                 return;
@@ -391,17 +482,35 @@ namespace Network {
 
                     state = TCPStateTimeWait;
 
-                    Acknowledge(m_remoteSequenceNumber);
+                    Acknowledge();
                 }
+            } else if(state == TCPStateCloseWait && tcpHeader->ack && !tcpHeader->fin && length == tcpHeader->dataOffset * 4u){
+                OnAcknowledgement(tcpHeader->acknowledgementNumber, static_cast<uint32_t>(tcpHeader->windowSize) << m_peerWindowScale, true); // The peer is acknowledging data we sent
             } else if(state == TCPStateCloseWait || state == TCPStateTimeWait){
                 state = TCPStateUnknown;
 
                 Reset(); // (CLOSE-WAIT) We should not be receiving packets on a close-wait / (TIME-WAIT) It did not receive our ACK, just reset
+            } else if(state == TCPStateClosing){
+                if(tcpHeader->ack){
+                    OnAcknowledgement(tcpHeader->acknowledgementNumber, static_cast<uint32_t>(tcpHeader->windowSize) << m_peerWindowScale, false);
+
+                    if(m_lastAcknowledged == m_sendMax){
+                        state = TCPStateTimeWait;
+                    }
+                }
+
+                if(tcpHeader->fin){
+                    Acknowledge(); // Our ACK of the peer's FIN was lost
+                }
             } else if(state == TCPStateLastAck){
                 bool ack = tcpHeader->ack;
 
                 if(ack){
-                    state = TCPStateUnknown; // We have closed successfully
+                    OnAcknowledgement(tcpHeader->acknowledgementNumber, static_cast<uint32_t>(tcpHeader->windowSize) << m_peerWindowScale, false);
+
+                    if(m_finSent && m_lastAcknowledged == m_sendMax){
+                        state = TCPStateUnknown; // We have closed successfully
+                    }
                 } else {
                     Log::Debug(debugLevelNetwork, DebugLevelNormal, "[Network] [TCP] (State: LAST_ACK) Unexpected flags: %hx. Expected ACK", tcpHeader->flags & TCPHeader::FlagsMask);
 
@@ -421,8 +530,13 @@ namespace Network {
         }
 
         int TCPSocket::Synchronize(uint32_t seqNumber){ // TCP SYN (Establish a connection to the server)
-            TCPHeader tcpHeader;
-            memset(&tcpHeader, 0, sizeof(TCPHeader));
+            struct {
+                TCPHeader header;
+                uint8_t options[12];
+            } segment;
+            memset(&segment, 0, sizeof(segment));
+
+            TCPHeader& tcpHeader = segment.header;
             
             Log::Debug(debugLevelNetwork, DebugLevelVerbose, "[Network] [TCP] [SYN] Sequence Number: %u", seqNumber);
 
@@ -431,45 +545,42 @@ namespace Network {
             tcpHeader.sequence = seqNumber;
             tcpHeader.acknowledgementNumber = 0;
 
-            tcpHeader.dataOffset = sizeof(TCPHeader) / 4; // Size of the TCP Header in DWORDs
+            tcpHeader.dataOffset = sizeof(segment) / 4; // Size of the TCP Header in DWORDs
             tcpHeader.syn = 1; // SYN/Synchronize
 
             tcpHeader.windowSize = 65535;
 
-            tcpHeader.checksum = CalculateTCPChecksum(adapter->adapterIP, peerAddress, &tcpHeader, sizeof(TCPHeader));
-
-            if(int e = SendIPv4(&tcpHeader, sizeof(TCPHeader), address, peerAddress, IPv4ProtocolTCP, adapter); e){
-                return e;
-            }
-
-            return 0;
-        }
-        
-        int TCPSocket::Acknowledge(uint32_t ackNumber){ // TCP ACK (Acknowledge connection)
-            TCPHeader tcpHeader;
-            memset(&tcpHeader, 0, sizeof(TCPHeader));
-
-            Log::Debug(debugLevelNetwork, DebugLevelVerbose, "[Network] [TCP] [ACK] Acknowledgement Number: %u", ackNumber);
-            
-            tcpHeader.srcPort = port;
-            tcpHeader.destPort = destinationPort;
-            tcpHeader.sequence = m_sequenceNumber;
-            tcpHeader.acknowledgementNumber = ackNumber;
+            // Let the peer know the largest segment we can receive
+            segment.options[0] = TCPOptionMaximumSegmentSize;
+            segment.options[1] = 4;
+            segment.options[2] = TCP_MSS >> 8;
+            segment.options[3] = TCP_MSS & 0xFF;
 
-            tcpHeader.dataOffset = sizeof(TCPHeader) / 4; // Size of the TCP Header in DWORDs
-            tcpHeader.ack = 1; // ACK/Acknowledge
+            segment.options[4] = TCPOptionNoOp;
+            segment.options[5] = TCPOptionWindowScale;
+            segment.options[6] = 3;
+            segment.options[7] = TCP_WINDOW_SCALE;
 
-            tcpHeader.windowSize = 65535;
+            segment.options[8] = TCPOptionNoOp;
+            segment.options[9] = TCPOptionNoOp;
+            segment.options[10] = TCPOptionSACKPermitted;
+            segment.options[11] = 2;
 
-            tcpHeader.checksum = CalculateTCPChecksum(adapter->adapterIP, peerAddress, &tcpHeader, sizeof(TCPHeader));
+            tcpHeader.checksum = CalculateTCPChecksum(adapter->adapterIP, peerAddress, &segment, sizeof(segment));
 
-            if(int e = SendIPv4(&tcpHeader, sizeof(TCPHeader), address, peerAddress, IPv4ProtocolTCP, adapter); e){
+            if(int e = SendIPv4(&segment, sizeof(segment), address, peerAddress, IPv4ProtocolTCP, adapter); e){
                 return e;
             }
 
             return 0;
         }
         
+        int TCPSocket::Acknowledge(){ // TCP ACK (Acknowledge everything received so far)
+            Log::Debug(debugLevelNetwork, DebugLevelVerbose, "[Network] [TCP] [ACK] Acknowledgement Number: %u", m_remoteSequenceNumber);
+
+            return SendSegment(m_sequenceNumber, TCPHeader::ACK);
+        }
+        
         int TCPSocket::SynchronizeAcknowledge(uint32_t seqNumber, uint32_t ackNumber){ // TCP SYN-ACK (Establish connection to client and acknowledge the connection
             TCPHeader tcpHeader;
             memset(&tcpHeader, 0, sizeof(TCPHeader));
@@ -568,6 +679,673 @@ namespace Network {
             return 0;
         }
 
+        int TCPSocket::SendSegment(uint32_t sequence, uint16_t flags, void* data, size_t length){
+            TCPHeader header;
+            memset(&header, 0, sizeof(TCPHeader));
+
+            uint8_t options[40];
+            size_t optionsLength = 0;
+
+            header.srcPort = port;
+            header.destPort = destinationPort;
+            header.sequence = sequence;
+
+            header.flags = flags;
+            header.dataOffset = sizeof(TCPHeader) / 4; // Shares a word with the flags so set after
+
+            acquireLock(&m_receiveLock);
+            header.acknowledgementNumber = m_remoteSequenceNumber;
+
+            uint32_t window = ReceiveWindow();
+            if(window > (static_cast<uint32_t>(UINT16_MAX) << m_windowScale)){
+                window = static_cast<uint32_t>(UINT16_MAX) << m_windowScale;
+            }
+
+            header.windowSize = window >> m_windowScale;
+            m_advertisedEdge = m_remoteSequenceNumber + (static_cast<uint32_t>(header.windowSize) << m_windowScale);
+
+            if((flags & TCPHeader::ACK) && m_sackPermitted && m_outOfOrderSegments.get_length()){
+                // Merge the out of order segments into contiguous blocks.
+                // The block containing the most recently received segment is reported first (RFC 2018)
+                uint32_t blocks[TCP_MAX_SACK_BLOCKS][2];
+                int blockCount = 1; // blocks[0] is reserved for the most recent block
+                bool hasRecent = false;
+
+                auto it = m_outOfOrderSegments.begin();
+                uint32_t left = it->sequenceNumber;
+                uint32_t right = it->sequenceNumber + it->length;
+                for(;;){
+                    it++;
+
+                    bool atEnd = it == m_outOfOrderSegments.end();
+                    if(!atEnd && !SequenceBefore(right, it->sequenceNumber)){ // Contiguous or overlapping
+                        if(SequenceBefore(right, it->sequenceNumber + it->length)){
+                            right = it->sequenceNumber + it->length;
+                        }
+                        continue;
+                    }
+
+                    if(!SequenceBefore(m_lastOutOfOrderSequence, left) && SequenceBefore(m_lastOutOfOrderSequence, right)){
+                        blocks[0][0] = left;
+                        blocks[0][1] = right;
+                        hasRecent = true;
+                    } else if(blockCount < TCP_MAX_SACK_BLOCKS){
+                        blocks[blockCount][0] = left;
+                        blocks[blockCount][1] = right;
+                        blockCount++;
+                    }
+
+                    if(atEnd){
+                        break;
+                    }
+
+                    left = it->sequenceNumber;
+                    right = it->sequenceNumber + it->length;
+                }
+
+                int firstBlock = hasRecent ? 0 : 1;
+
+                options[0] = TCPOptionNoOp;
+                options[1] = TCPOptionNoOp;
+                options[2] = TCPOptionSACK;
+                options[3] = 2 + (blockCount - firstBlock) * 8;
+                optionsLength = 4;
+
+                for(int i = firstBlock; i < blockCount; i++){
+                    BigEndian<uint32_t> edges[2];
+                    edges[0] = blocks[i][0];
+                    edges[1] = blocks[i][1];
+
+                    memcpy(options + optionsLength, edges, sizeof(edges));
+                    optionsLength += sizeof(edges);
+                }
+            }
+
+            if(flags & TCPHeader::ACK){
+                // Any segment we send acknowledges everything received so far
+                m_unacknowledgedSegments = 0;
+                m_delayedAckPending = false;
+
+                if(m_delayedAckTimer){
+                    delete m_delayedAckTimer;
+                    m_delayedAckTimer = nullptr;
+                }
+            }
+            releaseLock(&m_receiveLock);
+
+            int64_t ret = SendTCP(data, length, address, peerAddress, header, options, optionsLength, adapter);
+            if(ret < 0){
+                return ret;
+            }
+
+            return 0;
+        }
+
+        void TCPSocket::ReceiveData(uint32_t sequence, uint8_t* data, size_t length){
+            bool acknowledgeNow = false;
+
+            acquireLock(&m_receiveLock);
+
+            if(SequenceBefore(sequence, m_remoteSequenceNumber)){
+                uint32_t duplicate = m_remoteSequenceNumber - sequence;
+                if(duplicate >= length){
+                    releaseLock(&m_receiveLock);
+
+                    Acknowledge(); // Retransmission of data we already have, our ACK may have been lost
+                    return;
+                }
+
+                // Trim what we have already received
+                sequence += duplicate;
+                data += duplicate;
+                length -= duplicate;
+            }
+
+            uint32_t window = ReceiveWindow();
+            uint32_t offset = sequence - m_remoteSequenceNumber;
+            if(offset >= window){
+                releaseLock(&m_receiveLock);
+
+                Log::Debug(debugLevelNetwork, DebugLevelNormal, "[Network] [TCP] Received segment outside of window (Sequence number: %u, Expected: %u, Window: %u)", sequence, m_remoteSequenceNumber, window);
+                Acknowledge();
+                return;
+            }
+
+            length = MIN(length, window - offset);
+
+            if(offset){
+                Log::Debug(debugLevelNetwork, DebugLevelVerbose, "[Network] [TCP] Received out of order segment (Sequence number: %u, Expected: %u)", sequence, m_remoteSequenceNumber);
+
+                InsertOutOfOrder(sequence, data, length);
+                acknowledgeNow = true; // Send a duplicate ACK straight away so the peer can fast retransmit
+            } else {
+                m_inboundData.Write(data, length);
+                m_remoteSequenceNumber += length;
+
+                size_t received = length;
+
+                // Deliver anything that is now in order
+                bool filledGap = m_outOfOrderSegments.get_length();
+                while(m_outOfOrderSegments.get_length()){
+                    TCPReceivedSegment& segment = m_outOfOrderSegments.get_front();
+                    if(SequenceBefore(m_remoteSequenceNumber, segment.sequenceNumber)){
+                        break;
+                    }
+
+                    uint32_t overlap = m_remoteSequenceNumber - segment.sequenceNumber;
+                    if(overlap < segment.length){
+                        m_inboundData.Write(segment.data + overlap, segment.length - overlap);
+                        m_remoteSequenceNumber += segment.length - overlap;
+                        received += segment.length - overlap;
+                    }
+
+                    delete[] segment.data;
+                    m_outOfOrderSegments.remove_at(0);
+                }
+
+                // Grow the receive buffer if the peer sent more than half of it over the last RTT.
+                // The peer can never send more than our window per RTT so this tracks the bandwidth-delay product
+                m_receivedThisPeriod += received;
+
+                timeval now = Timer::GetSystemUptimeStruct();
+                long rtt = m_smoothedRTT;
+                if(rtt && now - m_receivePeriodStart >= rtt){
+                    if(m_receivedThisPeriod * 2 > m_receiveBufferSize && m_receiveBufferSize < TCP_RECEIVE_BUFFER_MAX){
+                        m_receiveBufferSize = MIN(m_receivedThisPeriod * 2, TCP_RECEIVE_BUFFER_MAX);
+
+                        Log::Debug(debugLevelNetwork, DebugLevelVerbose, "[Network] [TCP] Receive buffer grown to %u bytes", m_receiveBufferSize);
+                    }
+
+                    m_receivedThisPeriod = 0;
+                    m_receivePeriodStart = now;
+                }
+
+                // ACK at least every second segment (RFC 5681), or straight away if we filled a gap
+                if(filledGap || ++m_unacknowledgedSegments >= 2){
+                    acknowledgeNow = true;
+                } else if(!m_delayedAckTimer){
+                    m_delayedAckTimer = new Timer::TimerEvent(TCP_DELAYED_ACK, [](void* sock){
+                        reinterpret_cast<TCPSocket*>(sock)->m_delayedAckPending = true;
+
+                        timerSemaphore.Signal();
+                    }, this);
+                }
+            }
+
+            releaseLock(&m_receiveLock);
+
+            if(acknowledgeNow){
+                Acknowledge();
+            }
+
+            acquireLock(&blockedLock);
+            FilesystemBlocker* bl = blocked.get_front();
+            while(bl){
+                FilesystemBlocker* next = blocked.next(bl);
+
+                if(bl->Type() == FilesystemBlocker::BlockRead && bl->RequestedLength() <= m_inboundData.Pos()){
+                    bl->Unblock();
+                }
+
+                bl = next;
+            }
+            releaseLock(&blockedLock);
+        }
+
+        void TCPSocket::InsertOutOfOrder(uint32_t sequence, uint8_t* data, size_t length){
+            m_lastOutOfOrderSequence = sequence;
+
+            auto it = m_outOfOrderSegments.begin();
+            for(; it != m_outOfOrderSegments.end(); it++){
+                if(SequenceBefore(sequence, it->sequenceNumber)){
+                    break; // Keep the queue in sequence order
+                }
+
+                if(!SequenceBefore(it->sequenceNumber + it->length, sequence + length)){
+                    return; // Already have all of this segment
+                }
+            }
+
+            TCPReceivedSegment segment = { .sequenceNumber = sequence, .length = static_cast<uint32_t>(length), .data = new uint8_t[length] };
+            memcpy(segment.data, data, length);
+
+            m_outOfOrderSegments.insert(segment, it);
+        }
+
+        uint32_t TCPSocket::ReceiveWindow(){
+            size_t used = m_inboundData.Pos();
+            if(used >= m_receiveBufferSize){
+                return 0;
+            }
+
+            uint32_t window = m_receiveBufferSize - used;
+
+            // Never move the right edge of the window backwards
+            if(SequenceBefore(m_remoteSequenceNumber + window, m_advertisedEdge)){
+                window = m_advertisedEdge - m_remoteSequenceNumber;
+            }
+
+            return window;
+        }
+
+        void TCPSocket::OnDelayedAckTimeout(){
+            acquireLock(&m_receiveLock);
+
+            bool pending = m_delayedAckPending;
+            m_delayedAckPending = false;
+
+            if(m_delayedAckTimer){
+                delete m_delayedAckTimer;
+                m_delayedAckTimer = nullptr;
+            }
+
+            releaseLock(&m_receiveLock);
+
+            if(pending){
+                Acknowledge();
+            }
+        }
+
+        bool TCPSocket::OnAcknowledgement(uint32_t ackNumber, uint32_t window, bool canBeDuplicate){
+            uint8_t buffer[TCP_MSS];
+            uint32_t retransmitSequence = 0;
+            uint32_t retransmitLength = 0;
+            bool retransmit = false;
+            bool sendFin = false;
+            bool spaceFreed = false;
+
+            acquireLock(&m_sendLock);
+
+            // SND.NXT may have been moved back by a retransmission timeout, data up to SND.MAX can still be acknowledged
+            if(SequenceBefore(m_sendMax, ackNumber)){
+                releaseLock(&m_sendLock);
+                return false; // Acknowledges something we have not sent
+            }
+
+            if(SequenceBefore(ackNumber, m_lastAcknowledged)){
+                releaseLock(&m_sendLock);
+                return true; // Old ACK, ignore
+            }
+
+            bool windowChanged = window != m_peerWindow;
+            m_peerWindow = window;
+
+            if(ackNumber == m_lastAcknowledged){
+                // RFC 5681 only considers pure ACKs that leave the window unchanged while data is outstanding to be duplicates
+                if(canBeDuplicate && !windowChanged && m_sendMax != m_lastAcknowledged){
+                    m_duplicateAcks++;
+
+                    if(m_fastRecovery){
+                        m_congestionWindow += m_mss; // Each duplicate ACK means a segment has left the network
+                    } else if(m_duplicateAcks == TCP_DUPLICATE_ACK_THRESHOLD && SequenceBefore(m_recover, ackNumber)){
+                        // Fast retransmit
+                        uint32_t flightSize = m_sendMax - m_lastAcknowledged;
+
+                        m_slowStartThreshold = MAX(flightSize / 2, 2u * m_mss);
+                        m_congestionWindow = m_slowStartThreshold + TCP_DUPLICATE_ACK_THRESHOLD * m_mss;
+
+                        m_recover = m_sendMax;
+                        m_fastRecovery = true;
+
+                        retransmit = true;
+                    }
+                }
+            } else {
+                uint32_t acknowledged = ackNumber - m_lastAcknowledged;
+                uint32_t freed = MIN(acknowledged, m_sendQueueSize); // A FIN occupies a sequence number but not the queue
+
+                long rtt = -1;
+                timeval now = Timer::GetSystemUptimeStruct();
+
+                while(m_sendQueue.get_length()){
+                    TCPSegment& segment = m_sendQueue.get_front();
+                    if(SequenceBefore(ackNumber, segment.sequenceNumber + segment.length)){
+                        if(SequenceBefore(segment.sequenceNumber, ackNumber)){ // Partially acknowledged
+                            uint32_t trim = ackNumber - segment.sequenceNumber;
+
+                            for(uint32_t i = trim; i < segment.length; i++){
+                                segment.data[i - trim] = segment.data[i]; // Overlapping so copy forwards
+                            }
+                            segment.sequenceNumber += trim;
+                            segment.length -= trim;
+                        }
+                        break;
+                    }
+
+                    if(segment.transmitted && !segment.retransmitted){
+                        rtt = now - segment.sent;
+                    }
+
+                    delete[] segment.data;
+                    m_sendQueue.remove_at(0);
+                }
+
+                m_sendQueueSize -= freed;
+                m_lastAcknowledged = ackNumber;
+                spaceFreed = freed > 0;
+
+                if(SequenceBefore(m_sequenceNumber, ackNumber)){
+                    m_sequenceNumber = ackNumber; // Data sent before a retransmission timeout arrived after all
+                }
+
+                if(rtt >= 0){
+                    UpdateRTO(rtt);
+                }
+
+                if(m_fastRecovery){
+                    if(SequenceBefore(ackNumber, m_recover)){
+                        // Partial acknowledgement, the next segment was also lost (RFC 6582)
+                        m_congestionWindow -= MIN(acknowledged, m_congestionWindow);
+                        if(acknowledged >= m_mss){
+                            m_congestionWindow += m_mss;
+                        }
+
+                        retransmit = true;
+                    } else {
+                        uint32_t flightSize = m_sendMax - m_lastAcknowledged;
+
+                        m_congestionWindow = MIN(m_slowStartThreshold, MAX(flightSize, (uint32_t)m_mss) + m_mss);
+                        m_fastRecovery = false;
+                    }
+                } else if(m_congestionWindow < m_slowStartThreshold){
+                    m_congestionWindow += MIN(acknowledged, (uint32_t)m_mss); // Slow start
+                } else {
+                    m_congestionWindow += MAX(1u, (uint32_t)m_mss * m_mss / m_congestionWindow); // Congestion avoidance
+                }
+
+                if(!m_fastRecovery){
+                    m_duplicateAcks = 0;
+                }
+
+                if(m_finPending && !m_sendQueue.get_length()){
+                    m_finPending = false;
+                    sendFin = true;
+                } else if(m_sendQueue.get_length() || m_sendMax != m_lastAcknowledged){
+                    ArmRetransmitTimer(); // Restart the timer as new data has been acknowledged
+                } else {
+                    CancelRetransmitTimer();
+                }
+            }
+
+            if(retransmit && m_sendQueue.get_length()){
+                TCPSegment& segment = m_sendQueue.get_front();
+
+                retransmitSequence = segment.sequenceNumber;
+                retransmitLength = segment.length;
+                memcpy(buffer, segment.data, segment.length);
+
+                segment.sent = Timer::GetSystemUptimeStruct();
+                segment.retransmitted = true;
+            } else {
+                retransmit = false;
+            }
+
+            releaseLock(&m_sendLock);
+
+            if(retransmit){
+                Log::Debug(debugLevelNetwork, DebugLevelVerbose, "[Network] [TCP] Fast retransmit (Sequence number: %u)", retransmitSequence);
+
+                SendSegment(retransmitSequence, TCPHeader::ACK | TCPHeader::PSH, buffer, retransmitLength);
+            }
+
+            if(spaceFreed){
+                UnblockWriters();
+            }
+
+            if(sendFin){
+                SendFinish();
+            } else {
+                Transmit(); // The window may have opened
+            }
+
+            return true;
+        }
+
+        void TCPSocket::OnRetransmitTimeout(){
+            acquireLock(&m_sendLock);
+
+            if(!m_retransmitPending){
+                releaseLock(&m_sendLock);
+                return; // The timer was rearmed
+            }
+
+            m_retransmitPending = false;
+            CancelRetransmitTimer();
+
+            if(m_sendMax == m_lastAcknowledged){
+                if(!m_sendQueue.get_length()){
+                    releaseLock(&m_sendLock);
+                    return; // Nothing outstanding
+                }
+
+                // Data is queued but none is in flight so the peer's window must be closed,
+                // send a segment with an old sequence number to prompt an ACK with the current window
+                m_rto = MIN(m_rto * 2, TCP_RETRY_MAX);
+                ArmRetransmitTimer();
+
+                uint32_t sequence = m_lastAcknowledged - 1;
+                releaseLock(&m_sendLock);
+
+                SendSegment(sequence, TCPHeader::ACK);
+                return;
+            }
+
+            m_rto = MIN(m_rto * 2, TCP_RETRY_MAX); // Back off
+
+            if(m_finSent && !m_sendQueue.get_length()){
+                ArmRetransmitTimer();
+
+                uint32_t sequence = m_sendMax - 1;
+                releaseLock(&m_sendLock);
+
+                SendSegment(sequence, TCPHeader::ACK | TCPHeader::FIN); // Our FIN was lost
+                return;
+            }
+
+            Log::Debug(debugLevelNetwork, DebugLevelVerbose, "[Network] [TCP] Retransmission timeout (Sequence number: %u, RTO: %d us)", m_lastAcknowledged, m_rto);
+
+            // As per RFC 5681 drop to the loss window
+            uint32_t flightSize = m_sendMax - m_lastAcknowledged;
+            m_slowStartThreshold = MAX(flightSize / 2, 2u * m_mss);
+            m_congestionWindow = m_mss;
+
+            m_recover = m_sendMax;
+            m_fastRecovery = false;
+            m_duplicateAcks = 0;
+
+            // Go back N, resend everything from the oldest unacknowledged segment
+            for(TCPSegment& segment : m_sendQueue){
+                if(segment.transmitted){
+                    segment.transmitted = false;
+                    segment.retransmitted = true;
+                }
+            }
+            // SND.NXT only ever moves back here, SND.MAX keeps track of what the peer may still acknowledge
+            if(SequenceBefore(m_lastAcknowledged, m_sequenceNumber)){
+                m_sequenceNumber = m_lastAcknowledged;
+            }
+
+            releaseLock(&m_sendLock);
+
+            Transmit();
+        }
+
+        void TCPSocket::Transmit(){
+            uint8_t buffer[TCP_MSS];
+
+            for(;;){
+                acquireLock(&m_sendLock);
+
+                TCPSegment* segment = nullptr;
+                for(TCPSegment& s : m_sendQueue){
+                    if(!s.transmitted){
+                        segment = &s;
+                        break;
+                    }
+                }
+
+                if(!segment){
+                    releaseLock(&m_sendLock);
+                    break;
+                }
+
+                uint32_t window = MIN(m_peerWindow, m_congestionWindow);
+                uint32_t inFlight = m_sequenceNumber - m_lastAcknowledged;
+                if(inFlight + segment->length > window){
+                    if(!m_retransmitTimer){
+                        ArmRetransmitTimer(); // Probe the window if it does not open
+                    }
+
+                    releaseLock(&m_sendLock);
+                    break;
+                }
+
+                if(!m_noDelay && segment->length < m_mss && inFlight){
+                    releaseLock(&m_sendLock);
+                    break; // Nagle's algorithm, hold small segments until outstanding data is acknowledged
+                }
+
+                uint32_t sequence = segment->sequenceNumber;
+                uint32_t length = segment->length;
+                memcpy(buffer, segment->data, length);
+
+                segment->transmitted = true;
+                segment->sent = Timer::GetSystemUptimeStruct();
+
+                if(SequenceBefore(m_sequenceNumber, sequence + length)){
+                    m_sequenceNumber = sequence + length;
+                }
+
+                if(SequenceBefore(m_sendMax, m_sequenceNumber)){
+                    m_sendMax = m_sequenceNumber;
+                }
+
+                if(!m_retransmitTimer){
+                    ArmRetransmitTimer();
+                }
+
+                releaseLock(&m_sendLock);
+
+                if(int e = SendSegment(sequence, TCPHeader::ACK | TCPHeader::PSH, buffer, length); e){
+                    Log::Debug(debugLevelNetwork, DebugLevelNormal, "[Network] [TCP] Failed to send segment: %d", e);
+                    break; // The retransmission timer will try again
+                }
+            }
+        }
+
+        size_t TCPSocket::QueueData(uint8_t* data, size_t length){
+            size_t queued = MIN(length, TCP_SEND_BUFFER_SIZE - m_sendQueueSize);
+
+            size_t offset = 0;
+            if(queued && m_sendQueue.get_length()){
+                // Coalesce with the last segment if it has not been sent yet
+                TCPSegment& last = m_sendQueue.get_back();
+                if(!last.transmitted && last.length < m_mss){
+                    size_t count = MIN(queued, m_mss - last.length);
+
+                    memcpy(last.data + last.length, data, count);
+                    last.length += count;
+                    offset += count;
+                }
+            }
+
+            while(offset < queued){
+                size_t count = MIN(queued - offset, m_mss);
+
+                TCPSegment segment = { .sequenceNumber = m_lastAcknowledged + static_cast<uint32_t>(m_sendQueueSize + offset), .length = static_cast<uint32_t>(count), .data = new uint8_t[m_mss], .sent = {}, .transmitted = false, .retransmitted = false };
+                memcpy(segment.data, data + offset, count);
+
+                m_sendQueue.add_back(segment);
+                offset += count;
+            }
+
+            m_sendQueueSize += queued;
+            return queued;
+        }
+
+        void TCPSocket::SendFinish(){
+            acquireLock(&m_sendLock);
+
+            if(m_sendQueue.get_length()){
+                m_finPending = true; // Sent once the queue has been acknowledged
+
+                releaseLock(&m_sendLock);
+                return;
+            }
+
+            // Everything queued has been acknowledged so SND.NXT is SND.MAX
+            uint32_t sequence = m_sequenceNumber++; // FIN occupies a sequence number
+            m_sendMax = m_sequenceNumber;
+            m_finSent = true;
+
+            ArmRetransmitTimer();
+            releaseLock(&m_sendLock);
+
+            Log::Debug(debugLevelNetwork, DebugLevelVerbose, "[Network] [TCP] [FIN]");
+
+            SendSegment(sequence, TCPHeader::ACK | TCPHeader::FIN);
+        }
+
+        void TCPSocket::ArmRetransmitTimer(){
+            CancelRetransmitTimer();
+
+            // Runs in the timer interrupt, leave the work to the retransmission thread
+            m_retransmitTimer = new Timer::TimerEvent(m_rto, [](void* sock){
+                reinterpret_cast<TCPSocket*>(sock)->m_retransmitPending = true;
+
+                timerSemaphore.Signal();
+            }, this);
+        }
+
+        void TCPSocket::CancelRetransmitTimer(){
+            if(m_retransmitTimer){
+                delete m_retransmitTimer; // Once deleted the callback is guaranteed not to run
+                m_retransmitTimer = nullptr;
+            }
+
+            m_retransmitPending = false;
+        }
+
+        void TCPSocket::UpdateRTO(long rtt){
+            // As per RFC 6298
+            if(!m_smoothedRTT){
+                m_smoothedRTT = rtt;
+                m_rttVariance = rtt / 2;
+            } else {
+                long difference = m_smoothedRTT - rtt;
+                if(difference < 0){
+                    difference = -difference;
+                }
+
+                m_rttVariance = (3 * m_rttVariance + difference) / 4;
+                m_smoothedRTT = (7 * m_smoothedRTT + rtt) / 8;
+            }
+
+            long granularity = 1000000 / Timer::GetFrequency();
+            m_rto = m_smoothedRTT + MAX(granularity, 4 * m_rttVariance);
+
+            if(m_rto < TCP_RETRY_MIN){
+                m_rto = TCP_RETRY_MIN;
+            } else if(m_rto > TCP_RETRY_MAX){
+                m_rto = TCP_RETRY_MAX;
+            }
+        }
+
+        void TCPSocket::UnblockWriters(){
+            acquireLock(&blockedLock);
+            FilesystemBlocker* bl = blocked.get_front();
+            while(bl){
+                FilesystemBlocker* next = blocked.next(bl);
+
+                if(bl->Type() == FilesystemBlocker::BlockWrite){
+                    bl->Unblock();
+                }
+
+                bl = next;
+            }
+            releaseLock(&blockedLock);
+        }
+
         unsigned short TCPSocket::AllocatePort(){
             return Network::TCP::AllocatePort(this);
         }
@@ -582,10 +1360,38 @@ namespace Network {
 
         TCPSocket::TCPSocket(int type, int protocol) : IPSocket(type, protocol) {
             assert(type == StreamSocket);
+
+            ScopedSpinLock acquired(timerSocketsLock);
+            timerSockets.add_back(this);
         }
 
         TCPSocket::~TCPSocket(){
+            acquireLock(&timerSocketsLock);
+            timerSockets.remove(this);
+            releaseLock(&timerSocketsLock);
+
+            while(__atomic_load_n(&m_timerActive, __ATOMIC_ACQUIRE)){
+                Scheduler::Yield(); // The timer thread is still using us
+            }
+
+            acquireLock(&m_sendLock);
+            CancelRetransmitTimer();
+
+            while(m_sendQueue.get_length()){
+                delete[] m_sendQueue.remove_at(0).data;
+            }
+            releaseLock(&m_sendLock);
 
+            acquireLock(&m_receiveLock);
+            if(m_delayedAckTimer){
+                delete m_delayedAckTimer;
+                m_delayedAckTimer = nullptr;
+            }
+
+            while(m_outOfOrderSegments.get_length()){
+                delete[] m_outOfOrderSegments.remove_at(0).data;
+            }
+            releaseLock(&m_receiveLock);
         }
 
         Socket* TCPSocket::Accept(sockaddr* addr, socklen_t* addrlen, int mode){
@@ -657,8 +1463,12 @@ namespace Network {
             Log::Debug(debugLevelNetwork, DebugLevelVerbose, "[Network] [TCP] Connecting to %hd.%hd.%hd.%hd:%hd", peerAddress.data[0], peerAddress.data[1], peerAddress.data[2], peerAddress.data[3], (uint16_t)destinationPort);
 
             m_sequenceNumber = (Timer::GetSystemUptime() % 512) * (rand() % 255) + Timer::GetTicks() + 1;
+            m_sendMax = m_sequenceNumber;
             Synchronize(m_sequenceNumber - 1); // The peer should acknowledge the sent sequence number + 1, so just send (sequenceNumber - 1)
 
+            timeval synSent = Timer::GetSystemUptimeStruct();
+            bool synRetransmitted = false;
+
             long retryPeriod = TCP_RETRY_MIN;
             while(state == TCPStateSyn){
                 FilesystemBlocker bl(this);
@@ -668,8 +1478,11 @@ namespace Network {
                     return -EINTR;
                 }
 
-                if(timeout <= 0){
+                if(timeout <= 0 && state == TCPStateSyn){
                     retryPeriod *= 4;
+
+                    Synchronize(m_sequenceNumber - 1);
+                    synRetransmitted = true;
                 }
             }
 
@@ -677,8 +1490,13 @@ namespace Network {
                 return -ECONNREFUSED;
             }
 
-            m_remoteSequenceNumber += 1;
-            Acknowledge(m_remoteSequenceNumber);
+            if(!synRetransmitted){
+                // Use the handshake for the first RTT sample
+                ScopedSpinLock acquired(m_sendLock);
+                UpdateRTO(Timer::GetSystemUptimeStruct() - synSent);
+            }
+
+            Acknowledge();
             return 0;
         }
 
@@ -701,6 +1519,14 @@ namespace Network {
         }
 
         int64_t TCPSocket::ReceiveFrom(void* buffer, size_t len, int flags, sockaddr* src, socklen_t* addrlen, const void* ancillary, size_t ancillaryLen){
+            return ReceiveInbound(buffer, len, flags, src, addrlen, false);
+        }
+
+        int64_t TCPSocket::ReceiveFromUser(void* buffer, size_t len, int flags, sockaddr* src, socklen_t* addrlen, const void* ancillary, size_t ancillaryLen){
+            return ReceiveInbound(buffer, len, flags, src, addrlen, true);
+        }
+
+        int64_t TCPSocket::ReceiveInbound(void* buffer, size_t len, int flags, sockaddr* src, socklen_t* addrlen, bool user){
             if(state != TCPStateEstablished && !m_inboundData.Pos()){
                 Log::Debug(debugLevelNetwork, DebugLevelNormal, "TCPSocket::ReceiveFrom: Not connected!");
                 return -ENOTCONN;
@@ -713,7 +1539,7 @@ namespace Network {
             }
 
             if(state == TCPStateEstablished && m_inboundData.Pos() < len){ // We do not want to block when in CLOSE-WAIT
-                FilesystemBlocker bl(this, len);
+                FilesystemBlocker bl(this, MIN(len, m_receiveBufferSize)); // We will never hold more than the receive buffer
 
                 if(Scheduler::GetCurrentThread()->Block(&bl)){
                     return -EINTR; // We were interrupted
@@ -732,11 +1558,26 @@ namespace Network {
                 }
             }
 
-            return m_inboundData.Read(buffer, len);
+            int64_t read = user ? m_inboundData.ReadUser(buffer, len) : m_inboundData.Read(buffer, len);
+            if(read < 0){
+                return read;
+            }
+
+            // Let the peer know once the window has opened by a worthwhile amount, avoiding silly window syndrome (RFC 1122)
+            acquireLock(&m_receiveLock);
+            uint32_t opened = (m_remoteSequenceNumber + ReceiveWindow()) - m_advertisedEdge;
+            bool updateWindow = state == TCPStateEstablished && static_cast<int32_t>(opened) >= static_cast<int32_t>(MIN(m_receiveBufferSize / 2, (size_t)TCP_MSS));
+            releaseLock(&m_receiveLock);
+
+            if(updateWindow){
+                Acknowledge();
+            }
+
+            return read;
         }
 
         int64_t TCPSocket::SendTo(void* buffer, size_t len, int flags, const sockaddr* dest, socklen_t addrlen, const void* ancillary, size_t ancillaryLen){
-            if(state != TCPStateEstablished){
+            if(state != TCPStateEstablished && state != TCPStateCloseWait){ // The peer has finished sending but can still receive in CLOSE-WAIT
                 Log::Debug(debugLevelNetwork, DebugLevelNormal, "TCPSocket::SendTo: Not connected!");
                 return -ENOTCONN;
             }
@@ -746,35 +1587,38 @@ namespace Network {
                 return -EISCONN; // dest is invalid
             }
 
-            uint16_t shortLength = static_cast<uint16_t>(len);
-
-            TCPHeader header;
-            memset(&header, 0, sizeof(TCPHeader));
+            uint8_t* data = reinterpret_cast<uint8_t*>(buffer);
+            size_t written = 0;
 
-            header.srcPort = port;
-            header.destPort = destinationPort;
-            header.sequence = m_sequenceNumber;
-            header.acknowledgementNumber = m_remoteSequenceNumber;
+            while(written < len){
+                // Register the blocker before checking for space so an ACK freeing space cannot be missed
+                FilesystemBlocker bl(this, 1, FilesystemBlocker::BlockWrite);
 
-            header.dataOffset = sizeof(TCPHeader) / 4;
+                acquireLock(&m_sendLock);
+                size_t queued = QueueData(data + written, len - written);
+                releaseLock(&m_sendLock);
 
-            header.windowSize = 65535;
+                if(queued){
+                    written += queued;
 
-            header.ack = 1;
-            header.psh = 1;
+                    Transmit();
+                    continue;
+                }
 
-            TCPPacket pack = { .header = header, .sequenceNumber = m_sequenceNumber, .length = shortLength, .data = new uint8_t[len]};
-            memcpy(pack.data, buffer, shortLength);
+                if(flags & MSG_DONTWAIT){
+                    return written ? written : -EAGAIN; // Send queue is full
+                }
 
-            m_sequenceNumber += shortLength;
+                if(Scheduler::GetCurrentThread()->Block(&bl)){
+                    return written ? written : -EINTR;
+                }
 
-            int64_t ret = SendTCP(buffer, shortLength, address, peerAddress, header, adapter);
-            if(ret >= 0){
-                ScopedSpinLock acquired(m_unacknowledgedPacketsLock);
-                m_unacknowledgedPackets.add_back(pack);
+                if(state != TCPStateEstablished && state != TCPStateCloseWait){
+                    return written ? written : -ECONNRESET;
+                }
             }
 
-            return ret;
+            return written;
         }
 
         int TCPSocket::SetSocketOptions(int level, int opt, const void* optValue, socklen_t optLength){
@@ -785,8 +1629,11 @@ namespace Network {
                             return -EFAULT; // need to be at least int size
                         }
 
-                        m_noDelay = *reinterpret_cast<const int*>(optValue); // Disable 'Nagle's algorithm', we don't actualy implement this yet 
+                        m_noDelay = *reinterpret_cast<const int*>(optValue); // Disable 'Nagle's algorithm'
                         // Nagle's algorithm involves buffering output until we fill a packet
+                        if(m_noDelay){
+                            Transmit(); // Flush anything being held back
+                        }
                         return 0;
                     default:
                         Log::Warning("TCPSocket::SetSocketOptions: Unknown option: %d", opt);
@@ -855,11 +1702,11 @@ namespace Network {
                 if(state == TCPStateEstablished){
                     state = TCPStateFinWait1;
 
-                    FinishAcknowledge(m_remoteSequenceNumber);
+                    SendFinish();
                 } else if(state == TCPStateCloseWait){
                     state = TCPStateLastAck;
 
-                    Finish();
+                    SendFinish();
                 }
 
                 closedSockets.add_back(this);
@@ -138,7 +138,9 @@ namespace Network::UDP{
         pkt.data = new uint8_t[len];
         memcpy(pkt.data, buffer, len);
 
+        acquireLock(&packetsLock); // Packets from different flows may be received by different network workers
         packets.add_back(pkt);
+        releaseLock(&packetsLock);
 
         acquireLock(&blockedLock);
         while(blocked.get_length()){
@@ -0,0 +1,78 @@
+#include <Objects/Handle.h>
+
+#include <Errno.h>
+#include <Move.h>
+
+// Keep IDs positive so they can be told apart from error codes
+#define HANDLE_GENERATION_MASK 0x7FFFFFFF
+
+handle_id_t HandleTable::Register(FancyRefPtr<KernelObject> ko) {
+    ScopedTicketLock acq(m_lock);
+
+    long index = m_slots.Allocate();
+    if (index < 0) {
+        return -EMFILE;
+    }
+
+    Entry* entry = m_slots.Get(index);
+    entry->handle.ko = ko;
+
+    handle_id_t id = MakeID(index, entry->generation);
+    __atomic_store_n(&entry->handle.id, id, __ATOMIC_RELEASE); // The handle is visible to Find from here on
+
+    return id;
+}
+
+Handle* HandleTable::Find(handle_id_t id) {
+    if (id < 1) {
+        return nullptr;
+    }
+
+    Entry* entry = m_slots.Get((id & 0xFFFFFFFF) - 1);
+    if (!entry || __atomic_load_n(&entry->handle.id, __ATOMIC_ACQUIRE) != id) {
+        return nullptr;
+    }
+
+    return &entry->handle;
+}
+
+long HandleTable::Destroy(handle_id_t id) {
+    if (id < 1) {
+        return 1;
+    }
+
+    FancyRefPtr<KernelObject> ko; // Drop the reference once the lock is released
+
+    ScopedTicketLock acq(m_lock);
+
+    unsigned index = (id & 0xFFFFFFFF) - 1;
+    Entry* entry = m_slots.Get(index);
+    if (!entry || entry->handle.id != id) {
+        return 1;
+    }
+
+    ko = DestroyLocked(index, entry);
+    return 0;
+}
+
+void HandleTable::Clear() {
+    for (unsigned i = 0; i < m_slots.Capacity(); i++) {
+        FancyRefPtr<KernelObject> ko;
+
+        ScopedTicketLock acq(m_lock);
+
+        Entry* entry = m_slots.Get(i);
+        if (entry->handle.id) {
+            ko = DestroyLocked(i, entry);
+        }
+    }
+}
+
+FancyRefPtr<KernelObject> HandleTable::DestroyLocked(unsigned index, Entry* entry) {
+    __atomic_store_n(&entry->handle.id, 0, __ATOMIC_RELEASE);
+    entry->generation = (entry->generation + 1) & HANDLE_GENERATION_MASK;
+
+    m_slots.Release(index);
+
+    return std::move(entry->handle.ko);
+}
@@ -3,6 +3,8 @@
 #include <String.h>
 #include <Scheduler.h>
 
+#include <ABI/IPC.h>
+
 MessageInterface::MessageInterface(const char* _name, uint16_t msgSize){
     name = strdup(_name);
 
@@ -67,4 +69,109 @@ FancyRefPtr<MessageEndpoint> MessageInterface::Connect(){
     }
 
     return connection.item2;
-}
\ No newline at end of file
+}
+
+void MessageInterface::Register(const FancyRefPtr<MessageInterface>& self, const FancyRefPtr<MessageEndpoint>& endpoint, handle_id_t handle){
+    assert(self.get() == this);
+
+    acquireLock(&endpoint->ownerLock);
+    endpoint->owner = self;
+    endpoint->ownerHandle = handle;
+
+    // The peer may have already sent messages or disconnected
+    if(!endpoint->queue.Empty() || !endpoint->peer.get()){
+        MarkReady(endpoint.get());
+    }
+    releaseLock(&endpoint->ownerLock);
+}
+
+void MessageInterface::Unregister(MessageEndpoint* endpoint){
+    acquireLock(&readyLock);
+    if(endpoint->ready){
+        ready.remove(endpoint);
+        endpoint->ready = false;
+    }
+    releaseLock(&readyLock);
+}
+
+void MessageInterface::MarkReady(MessageEndpoint* endpoint){
+    acquireLock(&readyLock);
+    if(endpoint->ready){
+        releaseLock(&readyLock);
+        return; // Already on the ready list, anyone waiting has been woken
+    }
+
+    ready.add_back(endpoint);
+    endpoint->ready = true;
+    releaseLock(&readyLock);
+
+    acquireLock(&waitingLock);
+    while(waiting.get_length() > 0){
+        waiting.remove_at(0)->Signal();
+    }
+    releaseLock(&waitingLock);
+}
+
+long MessageInterface::Dequeue(Process* process, uint8_t* buffer, size_t size, unsigned maxCount){
+    unsigned count = 0;
+    size_t offset = 0;
+
+    if(maxCount && incoming.get_length() && size >= LEMON_MESSAGE_RECORD_LENGTH(0)){
+        lemon_message_record_t* record = reinterpret_cast<lemon_message_record_t*>(buffer);
+        *record = {.endpoint = 0, .id = 0, .size = 0, .flags = LEMON_MESSAGE_RECORD_INCOMING, .reserved = 0};
+
+        offset += LEMON_MESSAGE_RECORD_LENGTH(0);
+        count++;
+    }
+
+    // Only take a message off an endpoint if there is space for the largest possible message
+    while(count < maxCount && size - offset >= LEMON_MESSAGE_RECORD_LENGTH(msgSize)){
+        acquireLock(&readyLock);
+        MessageEndpoint* endpoint = ready.get_front();
+        if(!endpoint){
+            releaseLock(&readyLock);
+            break;
+        }
+
+        ready.remove(endpoint);
+        endpoint->ready = false;
+
+        handle_id_t id = endpoint->ownerHandle;
+        releaseLock(&readyLock);
+
+        // Once off the ready list the endpoint may be destroyed at any time,
+        // make sure the process still holds it and keep a reference
+        Handle* handle;
+        if(Scheduler::FindHandle(process, id, &handle) || handle->ko.get() != endpoint){
+            continue;
+        }
+        FancyRefPtr<KernelObject> ref = handle->ko;
+
+        lemon_message_record_t* record = reinterpret_cast<lemon_message_record_t*>(buffer + offset);
+
+        uint64_t messageID = 0;
+        uint16_t messageSize = 0;
+        long ret = endpoint->Read(&messageID, &messageSize, reinterpret_cast<uint8_t*>(record + 1));
+        if(ret == 0){
+            continue; // Read through the endpoint handle in the meantime
+        } else if(ret < 0){
+            *record = {.endpoint = id, .id = 0, .size = 0, .flags = LEMON_MESSAGE_RECORD_DISCONNECTED, .reserved = 0};
+        } else {
+            *record = {.endpoint = id, .id = messageID, .size = messageSize, .flags = 0, .reserved = 0};
+
+            // Send the endpoint to the back of the list so other endpoints get a turn.
+            // A peer that disconnected after its last message still needs to be reported, same as in Register
+            acquireLock(&readyLock);
+            if(!endpoint->ready && (!endpoint->queue.Empty() || !endpoint->peer.get())){
+                ready.add_back(endpoint);
+                endpoint->ready = true;
+            }
+            releaseLock(&readyLock);
+        }
+
+        offset += LEMON_MESSAGE_RECORD_LENGTH(messageSize);
+        count++;
+    }
+
+    return count;
+}
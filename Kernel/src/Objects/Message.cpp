@@ -1,5 +1,7 @@
 #include <Objects/Message.h>
 
+#include <Objects/Interface.h>
+
 #include <Errno.h>
 #include <Logging.h>
 
@@ -26,7 +28,23 @@ MessageEndpoint::~MessageEndpoint(){
 void MessageEndpoint::Destroy(){
     if(peer.get()){
         peer->peer = nullptr;
+        peer->NotifyOwner(); // The owner of our peer needs to see the disconnect
+    }
+
+    acquireLock(&ownerLock);
+    if(owner.get()){
+        owner->Unregister(this);
+        owner = nullptr;
     }
+    releaseLock(&ownerLock);
+}
+
+void MessageEndpoint::NotifyOwner(){
+    acquireLock(&ownerLock);
+    if(owner.get()){
+        owner->MarkReady(this);
+    }
+    releaseLock(&ownerLock);
 }
 
 int64_t MessageEndpoint::Read(uint64_t* id, uint16_t* size, uint8_t* data){
@@ -46,6 +64,7 @@ int64_t MessageEndpoint::Read(uint64_t* id, uint16_t* size, uint8_t* data){
 
     Message* m;
     if(queue.Dequeue(m) <= 0){
+        releaseLock(&queueLock);
         return 0;
     }
 
@@ -89,13 +108,29 @@ int64_t MessageEndpoint::Call(uint64_t id, uint16_t size, uint64_t data, uint64_
 
     Write(id, size, data); // Send message
 
-    // TODO: timeout
-    if(s.Wait()){ // Await response
-        if(buffer){
-            delete buffer;
+    bool interrupted;
+    if(timeout >= 0){
+        long remaining = timeout;
+        interrupted = s.WaitTimeout(remaining); // Await response
+    } else {
+        interrupted = s.Wait(); // Await response
+    }
+
+    // The peer removes us from the list when it responds,
+    // if we are still there we were interrupted or timed out and s must not be signalled after we return
+    bool responded = true;
+    acquireLock(&waitingResponseLock);
+    for(auto it = waitingResponse.begin(); it != waitingResponse.end(); it++){
+        if(it->item1 == &s){
+            waitingResponse.remove(it);
+            responded = false;
+            break;
         }
+    }
+    releaseLock(&waitingResponseLock);
 
-        return -EINTR; // Interrupted
+    if(!responded){
+        return interrupted ? -EINTR : 1;
     }
     
     if(buffer){
@@ -174,5 +209,7 @@ int64_t MessageEndpoint::Write(uint64_t id, uint16_t size, uint64_t data){
     }
 
     releaseLock(&peer->queueLock);
+
+    peer->NotifyOwner();
     return 0;
 }
\ No newline at end of file
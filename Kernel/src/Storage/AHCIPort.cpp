@@ -168,7 +168,6 @@ Port::Port(int num, hba_port_t* portStructure, hba_mem_t* hbaMem) {
 
     InitializePartitions();
 
-    portLock.SetValue(1);
     bufferSemaphore.SetValue(8);
 }
 
@@ -310,9 +309,7 @@ int Port::WriteDiskBlock(uint64_t lba, uint32_t count, void* _buffer) {
 }
 
 int Port::Access(uint64_t lba, uint32_t count, uintptr_t physBuffer, int write) {
-    if (portLock.Wait()) {
-        return EINTR;
-    }
+    portLock.Acquire();
 
     registers->ie = 0xffffffff;
     registers->is = 0;
@@ -322,7 +319,7 @@ int Port::Access(uint64_t lba, uint32_t count, uintptr_t physBuffer, int write)
     if (slot == 1) {
         Log::Warning("[SATA] Could not find command slot!");
 
-        portLock.Signal();
+        portLock.Release();
         return 2;
     }
 
@@ -383,7 +380,7 @@ int Port::Access(uint64_t lba, uint32_t count, uintptr_t physBuffer, int write)
     if (spin <= 0) {
         Log::Warning("[SATA] Port Hung");
 
-        portLock.Signal();
+        portLock.Release();
         return 3;
     }
 
@@ -401,7 +398,7 @@ int Port::Access(uint64_t lba, uint32_t count, uintptr_t physBuffer, int write)
             Log::Warning("[SATA] Disk Error (SERR: %x)", registers->serr);
 
             stopCMD(registers);
-            portLock.Signal();
+            portLock.Release();
             return 1;
         }
     }
@@ -416,7 +413,7 @@ int Port::Access(uint64_t lba, uint32_t count, uintptr_t physBuffer, int write)
     if (spin <= 0) {
         Log::Warning("[SATA] Port Hung");
 
-        portLock.Signal();
+        portLock.Release();
         return 3;
     }
 
@@ -426,11 +423,11 @@ int Port::Access(uint64_t lba, uint32_t count, uintptr_t physBuffer, int write)
     if (registers->is & HBA_PxIS_TFES) {
         Log::Warning("[SATA] Disk Error (SERR: %x)", registers->serr);
 
-        portLock.Signal();
+        portLock.Release();
         return 1;
     }
 
-    portLock.Signal();
+    portLock.Release();
     return 0;
 }
 
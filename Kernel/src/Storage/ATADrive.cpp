@@ -70,17 +70,15 @@ int ATADiskDevice::ReadDiskBlock(uint64_t lba, uint32_t count, void* _buffer) {
         if (!size)
             continue;
 
-        if (driveLock.Wait()) {
-            return -EINTR;
-        }
+        driveLock.Acquire();
 
         if (ATA::Access(this, lba, 1, false)) {
-            driveLock.Signal();
+            driveLock.Release();
             return 1; // Error Reading Sectors
         }
 
         memcpy(buffer, prdBuffer, size);
-        driveLock.Signal();
+        driveLock.Release();
 
         buffer += size;
         lba++;
@@ -103,17 +101,15 @@ int ATADiskDevice::WriteDiskBlock(uint64_t lba, uint32_t count, void* _buffer) {
         if (!size)
             continue;
 
-        if (driveLock.Wait()) {
-            return -EINTR;
-        }
+        driveLock.Acquire();
 
         memcpy(prdBuffer, buffer, size);
 
         if (ATA::Access(this, lba, 1, true)) {
-            driveLock.Signal();
+            driveLock.Release();
             return 1; // Error Reading Sectors
         }
-        driveLock.Signal();
+        driveLock.Release();
 
         buffer += size;
         lba++;
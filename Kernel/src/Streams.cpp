@@ -1,8 +1,9 @@
 #include <Stream.h>
 
 #include <Assert.h>
-#include <Logging.h>
-#include <Timer.h>
+#include <Errno.h>
+#include <Paging.h>
+#include <UserMemory.h>
 
 int64_t Stream::Read(void* buffer, size_t len) {
     assert(!"Stream::Read called from base class");
@@ -22,6 +23,24 @@ int64_t Stream::Peek(void* buffer, size_t len) {
     return -1; // We should not return but get the compiler to shut up
 }
 
+int64_t Stream::ReadUser(void* buffer, size_t len) {
+    assert(!"Stream::ReadUser called from base class");
+
+    return -1; // We should not return but get the compiler to shut up
+}
+
+int64_t Stream::PeekUser(void* buffer, size_t len) {
+    assert(!"Stream::PeekUser called from base class");
+
+    return -1; // We should not return but get the compiler to shut up
+}
+
+int64_t Stream::WriteUser(const void* buffer, size_t len) {
+    assert(!"Stream::WriteUser called from base class");
+
+    return -1; // We should not return but get the compiler to shut up
+}
+
 int64_t Stream::Empty() { return 1; }
 
 void Stream::Wait() { assert(!"Stream::Wait called from base class"); }
@@ -29,84 +48,170 @@ void Stream::Wait() { assert(!"Stream::Wait called from base class"); }
 Stream::~Stream() {}
 
 DataStream::DataStream(size_t bufSize) {
-    bufferSize = bufSize;
-    bufferPos = 0;
+    capacity = bufSize;
+    pageCount = PAGE_COUNT_4K(bufSize);
 
-    buffer = reinterpret_cast<uint8_t*>(kmalloc(bufferSize));
+    pages = reinterpret_cast<uint8_t**>(kmalloc(pageCount * sizeof(uint8_t*)));
+    for (size_t i = 0; i < pageCount; i++) {
+        pages[i] = nullptr;
+    }
 }
 
-DataStream::~DataStream() { kfree(buffer); }
+DataStream::~DataStream() {
+    for (size_t i = 0; i < pageCount; i++) {
+        if (pages[i]) {
+            kfree(pages[i]);
+        }
+    }
 
-int64_t DataStream::Read(void* data, size_t len) {
-    acquireLock(&streamLock);
+    if (sparePage) {
+        kfree(sparePage);
+    }
 
-    if (len >= bufferPos)
-        len = bufferPos;
+    kfree(pages);
+}
 
-    if (!len) {
-        releaseLock(&streamLock);
-        return 0;
-    }
+// Expects streamLock to be held
+int64_t DataStream::CopyOut(uint8_t* data, size_t len, bool consume, bool user) {
+    if (len > count)
+        len = count;
+
+    size_t pos = readPos;
+    size_t copied = 0;
+    while (copied < len) {
+        size_t index = pos / PAGE_SIZE_4K;
+        size_t offset = pos % PAGE_SIZE_4K;
+
+        size_t copy = PAGE_SIZE_4K - offset;
+        if (copy > len - copied)
+            copy = len - copied;
+
+        if (user) {
+            if (copy_to_user(data + copied, pages[index] + offset, copy)) {
+                break; // Whatever was not copied stays in the stream
+            }
+        } else {
+            memcpy(data + copied, pages[index] + offset, copy);
+        }
 
-    memcpy(data, buffer, len);
+        copied += copy;
 
-    memcpy(buffer, buffer + len, bufferPos - len);
-    bufferPos -= len;
+        pos += copy;
+        if (pos >= pageCount * PAGE_SIZE_4K) {
+            pos = 0;
+        }
 
-    releaseLock(&streamLock);
+        // Once we reach the end of a page it can be freed unless the unread data wraps around into it,
+        // which happens when the ring is (nearly) full as the newest bytes are at the start of the page
+        size_t unread = count - copied;
+        if (consume && offset + copy == PAGE_SIZE_4K && unread <= (pageCount - 1) * PAGE_SIZE_4K) {
+            if (sparePage) {
+                kfree(pages[index]);
+            } else {
+                sparePage = pages[index];
+            }
+
+            pages[index] = nullptr;
+        }
+    }
 
-    return len;
+    if (consume) {
+        readPos = pos;
+        count -= copied;
+    }
+
+    if (!copied && len) {
+        return -EFAULT;
+    }
+
+    return copied;
 }
 
-int64_t DataStream::Peek(void* data, size_t len) {
-    acquireLock(&streamLock);
+// Expects streamLock to be held
+int64_t DataStream::CopyIn(const uint8_t* data, size_t len, bool user) {
+    if (len > capacity - count)
+        len = capacity - count;
+
+    size_t pos = (readPos + count) % (pageCount * PAGE_SIZE_4K);
+    size_t written = 0;
+    while (written < len) {
+        size_t index = pos / PAGE_SIZE_4K;
+        size_t offset = pos % PAGE_SIZE_4K;
+
+        if (!pages[index]) {
+            if (sparePage) {
+                pages[index] = sparePage;
+                sparePage = nullptr;
+            } else if (!(pages[index] = reinterpret_cast<uint8_t*>(kmalloc(PAGE_SIZE_4K)))) {
+                break;
+            }
+        }
 
-    if (len >= bufferPos)
-        len = bufferPos;
+        size_t copy = PAGE_SIZE_4K - offset;
+        if (copy > len - written)
+            copy = len - written;
+
+        if (user) {
+            if (copy_from_user(pages[index] + offset, data + written, copy)) {
+                if (!written) {
+                    return -EFAULT;
+                }
+                break;
+            }
+        } else {
+            memcpy(pages[index] + offset, data + written, copy);
+        }
 
-    if (!len) {
-        releaseLock(&streamLock);
-        return 0;
+        written += copy;
+
+        pos += copy;
+        if (pos >= pageCount * PAGE_SIZE_4K) {
+            pos = 0;
+        }
     }
 
-    memcpy(data, buffer, len);
+    count += written;
 
-    releaseLock(&streamLock);
+    return written;
+}
 
-    return len;
+int64_t DataStream::Read(void* data, size_t len) {
+    ScopedSpinLock acq(streamLock);
+
+    return CopyOut(reinterpret_cast<uint8_t*>(data), len, true, false);
 }
 
-int64_t DataStream::Write(void* data, size_t len) {
-    acquireLock(&streamLock);
-    if (bufferPos + len >= bufferSize) {
-        void* oldBuffer = buffer;
+int64_t DataStream::Peek(void* data, size_t len) {
+    ScopedSpinLock acq(streamLock);
 
-        while (bufferPos + len >= bufferSize)
-            bufferSize *= 2;
+    return CopyOut(reinterpret_cast<uint8_t*>(data), len, false, false);
+}
 
-        buffer = reinterpret_cast<uint8_t*>(kmalloc(bufferSize));
+int64_t DataStream::Write(void* data, size_t len) {
+    ScopedSpinLock acq(streamLock);
 
-        memcpy(buffer, oldBuffer, bufferPos);
+    return CopyIn(reinterpret_cast<uint8_t*>(data), len, false);
+}
 
-        kfree(oldBuffer);
-    }
+int64_t DataStream::ReadUser(void* data, size_t len) {
+    ScopedSpinLock acq(streamLock);
 
-    memcpy(buffer + bufferPos, data, len);
-    bufferPos += len;
+    return CopyOut(reinterpret_cast<uint8_t*>(data), len, true, true);
+}
 
-    if (bufferPos > 0 && waiting.get_length() > 0) {
-        while (waiting.get_length()) {
-            // Scheduler::UnblockThread(waiting.remove_at(0));
-            // TODO: Reinstate blocker
-        }
-    }
+int64_t DataStream::PeekUser(void* data, size_t len) {
+    ScopedSpinLock acq(streamLock);
 
-    releaseLock(&streamLock);
+    return CopyOut(reinterpret_cast<uint8_t*>(data), len, false, true);
+}
 
-    return len;
+int64_t DataStream::WriteUser(const void* data, size_t len) {
+    ScopedSpinLock acq(streamLock);
+
+    return CopyIn(reinterpret_cast<const uint8_t*>(data), len, true);
 }
 
-int64_t DataStream::Empty() { return !bufferPos; }
+int64_t DataStream::Empty() { return !count; }
 
 void DataStream::Wait() {
     if (!Empty())
@@ -168,6 +273,57 @@ int64_t PacketStream::Write(void* buffer, size_t len) {
     return pkt.len;
 }
 
+int64_t PacketStream::ReadUser(void* buffer, size_t len) {
+    if (packets.get_length() <= 0)
+        return 0;
+
+    stream_packet_t pkt = packets.get_at(0);
+
+    if (len > pkt.len)
+        len = pkt.len;
+
+    if (copy_to_user(buffer, pkt.data, len)) {
+        return -EFAULT; // Leave the packet for the next read
+    }
+
+    packets.remove_at(0);
+    kfree(pkt.data);
+
+    return len;
+}
+
+int64_t PacketStream::PeekUser(void* buffer, size_t len) {
+    if (packets.get_length() <= 0)
+        return 0;
+
+    stream_packet_t pkt = packets.get_at(0);
+
+    if (len > pkt.len)
+        len = pkt.len;
+
+    if (copy_to_user(buffer, pkt.data, len)) {
+        return -EFAULT;
+    }
+
+    return len;
+}
+
+int64_t PacketStream::WriteUser(const void* buffer, size_t len) {
+    uint8_t* data = reinterpret_cast<uint8_t*>(kmalloc(len));
+    if (!data) {
+        return -ENOMEM;
+    }
+
+    if (copy_from_user(data, buffer, len)) {
+        kfree(data);
+        return -EFAULT;
+    }
+
+    packets.add_back({data, len});
+
+    return len;
+}
+
 int64_t PacketStream::Empty() { return !packets.get_length(); }
 
 void PacketStream::Wait() {
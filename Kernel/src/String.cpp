@@ -1,5 +1,6 @@
 #include <String.h>
 
+#include <CPU.h>
 #include <Liballoc.h>
 #include <Paging.h>
 #include <stdint.h>
@@ -61,9 +62,43 @@ char* itoa(unsigned long long num, char* str, int base) {
     return str;
 }
 
+// Below this the startup cost of the rep string instructions outweighs a simple loop,
+// unless the CPU has fast short REP MOVSB
+#define REP_STRING_THRESHOLD 64
+
+// Set by InitializeStringFunctions
+static bool useERMS = false;
+static bool useFSRM = false;
+
+void InitializeStringFunctions() {
+    uint32_t maxLeaf, ebx, ecx, edx;
+    CPUIDLeaf(0, 0, maxLeaf, ebx, ecx, edx);
+    if (maxLeaf < 7) {
+        return;
+    }
+
+    uint32_t eax;
+    CPUIDLeaf(7, 0, eax, ebx, ecx, edx);
+    useERMS = ebx & CPUID_7_EBX_ERMS;
+    useFSRM = useERMS && (edx & CPUID_7_EDX_FSRM);
+}
+
 extern "C" void* memset(void* src, int c, size_t count) {
     uint8_t* xs = (uint8_t*)src;
 
+    if (count >= REP_STRING_THRESHOLD) {
+        if (useERMS) {
+            asm volatile("rep stosb" : "+D"(xs), "+c"(count) : "a"(c) : "memory");
+            return src;
+        }
+
+        uint64_t pattern = 0x0101010101010101ULL * static_cast<uint8_t>(c);
+        size_t qwords = count / sizeof(uint64_t);
+        asm volatile("rep stosq" : "+D"(xs), "+c"(qwords) : "a"(pattern) : "memory");
+
+        count &= sizeof(uint64_t) - 1;
+    }
+
     while (count--)
         *xs++ = c;
 
@@ -73,6 +108,17 @@ extern "C" void* memset(void* src, int c, size_t count) {
 extern "C" void* memcpy(void* dest, const void* src, size_t count) {
     const char* sp = (char*)src;
     char* dp = (char*)dest;
+
+    if (useFSRM || (useERMS && count >= REP_STRING_THRESHOLD)) {
+        asm volatile("rep movsb" : "+D"(dp), "+S"(sp), "+c"(count)::"memory");
+        return dest;
+    } else if (count >= REP_STRING_THRESHOLD) {
+        size_t qwords = count / sizeof(uint64_t);
+        asm volatile("rep movsq" : "+D"(dp), "+S"(sp), "+c"(qwords)::"memory");
+
+        count &= sizeof(uint64_t) - 1;
+    }
+
     for (size_t i = count; i >= sizeof(uint64_t); i = count) {
         *((uint64_t*)dp) = *((uint64_t*)sp);
         sp = sp + sizeof(uint64_t);
@@ -80,13 +126,6 @@ extern "C" void* memcpy(void* dest, const void* src, size_t count) {
         count -= sizeof(uint64_t);
     }
 
-    for (size_t i = count; i >= 4; i = count) {
-        *((uint32_t*)dp) = *((uint32_t*)sp);
-        sp = sp + 4;
-        dp = dp + 4;
-        count -= 4;
-    }
-
     for (size_t i = count; i > 0; i = count) {
         *(dp++) = *(sp++);
         count--;
@@ -99,6 +138,20 @@ extern "C" int memcmp(const void* s1, const void* s2, size_t n) {
     const uint8_t* a = (uint8_t*)s1;
     const uint8_t* b = (uint8_t*)s2;
 
+    // Compare a word at a time, the first differing byte is the most significant once byte swapped
+    for (; n >= sizeof(uint64_t); n -= sizeof(uint64_t)) {
+        uint64_t wa, wb;
+        __builtin_memcpy(&wa, a, sizeof(uint64_t)); // Unaligned load
+        __builtin_memcpy(&wb, b, sizeof(uint64_t));
+
+        if (wa != wb) {
+            return __builtin_bswap64(wa) < __builtin_bswap64(wb) ? -1 : 1;
+        }
+
+        a += sizeof(uint64_t);
+        b += sizeof(uint64_t);
+    }
+
     for (size_t i = 0; i < n; i++) {
         if (a[i] < b[i]) {
             return -1;
@@ -110,6 +163,31 @@ extern "C" int memcmp(const void* s1, const void* s2, size_t n) {
     return 0;
 }
 
+// movnti stores a general purpose register so these work without SSE being enabled in the kernel
+void ZeroPage(void* page) {
+    uint64_t* dp = reinterpret_cast<uint64_t*>(page);
+    for (size_t i = 0; i < PAGE_SIZE_4K / sizeof(uint64_t); i += 4) {
+        asm volatile("movnti %1, (%0); movnti %1, 8(%0); movnti %1, 16(%0); movnti %1, 24(%0)" ::"r"(dp + i),
+                     "r"(0ULL)
+                     : "memory");
+    }
+
+    // Non-temporal stores are weakly ordered
+    asm volatile("sfence" ::: "memory");
+}
+
+void CopyPage(void* dest, const void* src) {
+    uint64_t* dp = reinterpret_cast<uint64_t*>(dest);
+    const uint64_t* sp = reinterpret_cast<const uint64_t*>(src);
+    for (size_t i = 0; i < PAGE_SIZE_4K / sizeof(uint64_t); i += 4) {
+        asm volatile("movnti %1, (%0); movnti %2, 8(%0); movnti %3, 16(%0); movnti %4, 24(%0)" ::"r"(dp + i),
+                     "r"(sp[i]), "r"(sp[i + 1]), "r"(sp[i + 2]), "r"(sp[i + 3])
+                     : "memory");
+    }
+
+    asm volatile("sfence" ::: "memory");
+}
+
 void strcpy(char* dest, const char* src) {
     while (*src) {
         *(dest++) = *(src++);
@@ -4,6 +4,7 @@
 #include <Lemon/GUI/Window.h>
 
 #include <Lemon/Core/Keyboard.h>
+#include <Lemon/System/Util.h>
 
 #include <algorithm>
 #include <assert.h>
@@ -636,7 +637,7 @@ void TextBox::Paint(surface_t* surface) {
 
     if (parent->active == this) { // Only draw cursor if active
         timespec t;
-        clock_gettime(CLOCK_BOOTTIME, &t);
+        Lemon::ClockGetTime(CLOCK_BOOTTIME, &t);
 
         long msec = (t.tv_nsec / 1000000.0);
         if (msec < 250 || (msec > 500 && msec < 750)) // Only draw the cursor for a quarter of a second so it blinks
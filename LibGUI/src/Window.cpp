@@ -3,6 +3,7 @@
 #include <Lemon/GUI/Window.h>
 
 #include <Lemon/GUI/WindowServer.h>
+#include <Lemon/System/Util.h>
 
 #include <stdlib.h>
 #include <unistd.h>
@@ -147,7 +148,7 @@ void Window::GUIHandleEvent(LemonEvent& ev) {
         }
 
         timespec newClick;
-        clock_gettime(CLOCK_BOOTTIME, &newClick);
+        Lemon::ClockGetTime(CLOCK_BOOTTIME, &newClick);
 
         if ((newClick.tv_nsec / 1000000 + newClick.tv_sec * 1000) -
                 (m_lastClick.tv_nsec / 1000000 + m_lastClick.tv_sec * 1000) <
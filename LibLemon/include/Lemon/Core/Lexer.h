@@ -25,18 +25,14 @@ class BasicLexer {
 
     template <typename C> std::string_view EatWhile(C cond) {
         if (End())
-            return nullptr;
+            return {};
 
         auto start = it;
         size_t count = 0;
         char c;
         while (!End() && cond(c = Peek())) {
             count++;
-
-            if (c == '\n') {
-                line++;
-            }
-            Eat();
+            Eat(); // Counts lines
         }
 
         return sv.substr(static_cast<size_t>(start - sv.begin()), count);
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <Lemon/Graphics/Surface.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Lemon::Graphics {
+// Thread safe, process wide cache of decoded images
+//
+// Decoded surfaces are keyed by path, modification time and target size
+// and evicted least recently used first once the byte budget is exceeded.
+// Images too large to be worth keeping (e.g. backgrounds) are not held in memory.
+// Scaled down images (thumbnails) are also persisted to disk so that
+// they survive between processes.
+//
+// Paths should be canonical (see realpath) so an image only has one key.
+class ImageCache final {
+  public:
+    static ImageCache* Instance();
+
+    /////////////////////////////
+    /// \brief Look up a decoded image
+    ///
+    /// Copies the cached pixels into a new surface allocated with malloc.
+    /// A width and height of 0 refer to the image at its original size.
+    ///
+    /// \param path Path of the image file
+    /// \param mtime Modification time of the image file
+    /// \param width Target width
+    /// \param height Target height
+    /// \param surface Surface to fill
+    /// \param preserveAspectRatio Whether the image was scaled preserving aspect ratio
+    ///
+    /// \return true if the image was found
+    /////////////////////////////
+    bool Lookup(const std::string& path, time_t mtime, int width, int height, surface_t* surface,
+                bool preserveAspectRatio = false);
+
+    /////////////////////////////
+    /// \brief Insert a decoded image
+    ///
+    /// The surface is copied, the caller retains ownership.
+    /// Ignored if the image is larger than 1/maximumEntryFraction of the capacity.
+    /////////////////////////////
+    void Insert(const std::string& path, time_t mtime, int width, int height, const surface_t* surface,
+                bool preserveAspectRatio = false);
+
+    /////////////////////////////
+    /// \brief Look up a thumbnail in the on-disk store
+    ///
+    /// \return true if a thumbnail matching the modification time was found
+    /////////////////////////////
+    bool LoadThumbnail(const std::string& path, time_t mtime, int width, int height, surface_t* surface,
+                       bool preserveAspectRatio = false);
+
+    /////////////////////////////
+    /// \brief Save a thumbnail to the on-disk store
+    ///
+    /// The store is $HOME/.cache/thumbnails, nothing is saved if HOME is not set.
+    /////////////////////////////
+    void SaveThumbnail(const std::string& path, time_t mtime, int width, int height, const surface_t* surface,
+                       bool preserveAspectRatio = false);
+
+    /////////////////////////////
+    /// \brief Set the maximum amount of pixel data to keep in memory
+    ///
+    /// Evicts images if necessary
+    /////////////////////////////
+    void SetCapacity(size_t bytes);
+    size_t Capacity();
+    size_t Size();
+
+    // Discard all images held in memory
+    void Clear();
+
+    // Images with an original area of at least this many times the target area are persisted
+    static const int thumbnailMinimumRatio = 4;
+    // Only images scaled to a size below this are persisted
+    static const int thumbnailMaximumSize = 256;
+    // Images larger than this fraction of the capacity are not held in memory
+    static const int maximumEntryFraction = 8;
+
+  private:
+    struct CacheEntry {
+        std::string key;
+        surface_t surface;
+        size_t size;
+    };
+
+    ImageCache();
+
+    std::string GetKey(const std::string& path, time_t mtime, int width, int height, bool preserveAspectRatio) const;
+    std::string GetThumbnailPath(const std::string& path, int width, int height, bool preserveAspectRatio) const;
+    void Evict();
+
+    static ImageCache* m_instance;
+    static std::mutex m_instanceMutex;
+
+    std::mutex m_lock;
+
+    size_t m_capacity = 4 * 1024 * 1024; // 4 MB
+    size_t m_size = 0;
+
+    std::list<CacheEntry> m_entries; // Most recently used at the front
+    std::unordered_map<std::string, std::list<CacheEntry>::iterator> m_lookup;
+
+    std::string m_thumbnailDirectory; // Empty if thumbnails are not kept on disk
+    std::once_flag m_createThumbnailDirectory;
+};
+} // namespace Lemon::Graphics
@@ -7,10 +7,14 @@
 #include <Lemon/Types.h>
 
 #include <Lemon/IPC/Message.h>
+#include <Lemon/IPC/Ring.h>
 
 #include <assert.h>
 #include <stdint.h>
 
+#include <deque>
+#include <memory>
+
 namespace Lemon {
 class EndpointException : public std::exception {
 public:
@@ -37,7 +41,9 @@ public:
 
     Endpoint(const Lemon::Endpoint& other) = delete;
 
-    Endpoint(Lemon::Endpoint&& other) : m_handle(std::move(other.m_handle)), m_msgSize(other.m_msgSize) {
+    Endpoint(Lemon::Endpoint&& other)
+        : m_handle(std::move(other.m_handle)), m_msgSize(other.m_msgSize), m_channel(std::move(other.m_channel)),
+          m_pending(std::move(other.m_pending)) {
         assert(m_handle.get() > 0);
 
         other.m_handle = Handle();
@@ -48,6 +54,7 @@ public:
 
         m_handle = h;
         this->m_msgSize = msgSize;
+        m_channel = RingChannel::Find(m_handle.get()); // Use the rings if the peer set them up
     }
 
     Endpoint(Handle h) {
@@ -66,11 +73,19 @@ public:
             }
         }
         this->m_msgSize = endpInfo.msgSize;
+        m_channel = RingChannel::Find(m_handle.get()); // Use the rings if the peer set them up
     }
 
-    Endpoint(const std::string& path) : Endpoint(path.c_str()) {}
+    Endpoint(const std::string& path, Transport transport = TransportKernel) : Endpoint(path.c_str(), transport) {}
 
-    Endpoint(const char* path) {
+    /////////////////////////////
+    /// \brief Connect to an interface
+    ///
+    /// \param path Path of the interface
+    /// \param transport TransportSharedRing to send messages through shared memory rings instead of the kernel.
+    /// Falls back to the kernel if the rings cannot be set up.
+    /////////////////////////////
+    Endpoint(const char* path, Transport transport = TransportKernel) {
         handle_t handle = InterfaceConnect(path);
 
         if (handle <= 0) {
@@ -88,11 +103,17 @@ public:
         }
         m_handle = Handle(handle);
         m_msgSize = endpInfo.msgSize;
+
+        if (transport == TransportSharedRing) {
+            m_channel = RingChannel::Create(handle, m_msgSize);
+        }
     }
 
     Lemon::Endpoint& operator=(Lemon::Endpoint&& other) {
         m_handle = std::move(other.m_handle);
         m_msgSize = other.m_msgSize;
+        m_channel = std::move(other.m_channel);
+        m_pending = std::move(other.m_pending);
 
         assert(m_handle.get());
 
@@ -101,7 +122,15 @@ public:
         return *this;
     }
 
-    ~Endpoint() = default;
+    ~Endpoint() {
+        if (m_channel && m_channel->IsCreator()) {
+            RingChannel::Remove(m_handle.get()); // We own the connection
+        }
+
+        for (auto& pending : m_pending) {
+            delete[] pending.data;
+        }
+    }
 
     /////////////////////////////
     /// \brief Close Endpoint
@@ -110,6 +139,11 @@ public:
     /// the actual endpoint will be destroyed when any peers destroy their handles
     /////////////////////////////
     inline void Close() {
+        if (m_channel) {
+            RingChannel::Remove(m_handle.get());
+            m_channel.reset();
+        }
+
         DestroyKObject(m_handle.get());
 
         m_handle = Handle();
@@ -133,19 +167,32 @@ public:
     /////////////////////////////
     inline uint16_t GetMessageSize() const { return m_msgSize; }
 
+    // Is the endpoint using shared memory rings?
+    inline bool IsRingTransport() const { return m_channel.get(); }
+
     inline long Queue(uint64_t id, const uint8_t* data, uint16_t size) {
+        if (m_channel) {
+            return m_channel->Queue(id, data, size);
+        }
+
         return EndpointQueue(m_handle.get(), id, size, reinterpret_cast<uintptr_t>(data));
     }
 
     inline long Queue(uint64_t id, uint64_t data, uint16_t size) {
+        if (m_channel) {
+            return m_channel->Queue(id, reinterpret_cast<const uint8_t*>(data), size);
+        }
+
         return EndpointQueue(m_handle.get(), id, size, data);
     }
 
-    inline long Queue(const Message& m) {
-        return EndpointQueue(m_handle.get(), m.id(), m.length(), reinterpret_cast<uintptr_t>(m.data()));
-    }
+    inline long Queue(const Message& m) { return Queue(m.id(), m.data(), m.length()); }
 
     inline long Poll(Message& m) {
+        if (m_channel) {
+            return PollRing(m);
+        }
+
         uint64_t id;
         uint16_t size;
         uint8_t* data = new uint8_t[m_msgSize];
@@ -163,8 +210,13 @@ public:
         uint16_t size = call.length();
         uint8_t* data = new uint8_t[m_msgSize];
 
-        long ret = EndpointCall(m_handle.get(), call.id(), reinterpret_cast<uintptr_t>(call.data()), id,
-                                reinterpret_cast<uintptr_t>(data), &size);
+        long ret;
+        if (m_channel) {
+            ret = CallRing(call.id(), call.data(), size, id, data, &size);
+        } else {
+            ret = EndpointCall(m_handle.get(), call.id(), reinterpret_cast<uintptr_t>(call.data()), id,
+                               reinterpret_cast<uintptr_t>(data), &size);
+        }
 
         if (!ret) {
             rmsg.Set(data, size, id);
@@ -178,8 +230,13 @@ public:
         uint16_t size = call.length();
         uint8_t* data = const_cast<uint8_t*>(call.data());
 
-        long ret = EndpointCall(m_handle.get(), call.id(), reinterpret_cast<uintptr_t>(call.data()), id,
-                                reinterpret_cast<uintptr_t>(call.data()), &size);
+        long ret;
+        if (m_channel) {
+            ret = CallRing(call.id(), call.data(), size, id, data, &size);
+        } else {
+            ret = EndpointCall(m_handle.get(), call.id(), reinterpret_cast<uintptr_t>(call.data()), id,
+                               reinterpret_cast<uintptr_t>(call.data()), &size);
+        }
 
         if (!ret) {
             call.Set(data, size, id);
@@ -188,7 +245,19 @@ public:
     }
 
 protected:
+    struct PendingMessage {
+        uint64_t id;
+        uint8_t* data;
+        uint16_t length;
+    };
+
     Handle m_handle;
     uint16_t m_msgSize = 512;
+
+    std::shared_ptr<RingChannel> m_channel;
+    std::deque<PendingMessage> m_pending; // Messages that arrived while waiting for a response
+
+    long PollRing(Message& m);
+    long CallRing(uint64_t id, const uint8_t* data, uint16_t size, uint64_t rID, uint8_t* rData, uint16_t* rSize);
 };
 }; // namespace Lemon
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <Lemon/IPC/Message.h>
+#include <Lemon/IPC/Ring.h>
 #include <string.h>
 
+#include <deque>
 #include <list>
 #include <map>
 #include <vector>
@@ -49,21 +51,27 @@ public:
 
     void RegisterObject(const std::string& name, int id);
 
+    /////////////////////////////
+    /// \brief Interface::Poll(client, m) - Get the next message from any client
+    ///
+    /// Messages from every client are dequeued in batches with a single call to the kernel.
+    /// Waiting on the interface handle wakes up once any client has sent a message.
+    ///
+    /// \return 1 if a message was received, otherwise 0
+    /////////////////////////////
     long Poll(Handle& client, Message& m);
-    void Wait();
 
     inline const Handle& GetHandle() { return m_interfaceHandle; }
-    void GetAllHandles(std::vector<handle_t>& v) {
-        v.insert(v.end(), m_rawEndpoints.begin(), m_rawEndpoints.end());
-        v.push_back(m_interfaceHandle.get());
-    }
 
 private:
     Handle m_serviceHandle;
     Handle m_interfaceHandle;
 
-    // Repopulate the std::vector of raw handles
-    void RepopulateRawHandles();
+    // Dequeue a batch of messages from the kernel
+    void Dequeue();
+    // Move every message on a ring channel to the queue, arming the channel.
+    // Returns a negative error code if the client corrupted the ring
+    long DrainChannel(const Handle& client, RingChannel& channel);
 
 protected:
     struct InterfaceMessageInfo {
@@ -73,12 +81,18 @@ protected:
         uint16_t length = 0;
     };
 
+    static const unsigned recordBufferMaxCount = 64;
+    static const size_t recordBufferMinSize = 0x4000;
+
     std::map<std::string, int> m_objects;
-    std::vector<handle_t> m_rawEndpoints;
-    std::list<Handle> m_endpoints;
+    std::map<handle_t, Handle> m_endpoints;
+    std::map<handle_t, std::shared_ptr<RingChannel>> m_channels; // Clients using shared memory rings
     uint16_t m_msgSize;
     uint8_t* m_dataBuffer = nullptr;
 
+    uint8_t* m_recordBuffer = nullptr; // Records returned by InterfaceDequeue
+    size_t m_recordBufferSize = 0;
+
     std::deque<InterfaceMessageInfo> m_queue;
 };
 } // namespace Lemon
@@ -14,6 +14,8 @@ enum CoreMessageIDs {
     MessagePeerDisconnect = 0,
     MessageObjectRequest = 1,
     MessageObjectResponse = 2,
+    MessageRingSetup = 3,    // Peer has created shared memory rings (Ring.h), data is the shared memory key
+    MessageRingDoorbell = 4, // Peer has queued on a ring while we were asleep
 };
 
 using MessageRawDataObject = std::pair<uint8_t*, uint16_t>; // length, data
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <Lemon/Types.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Lemon {
+enum Transport {
+    TransportKernel,     // Every message is copied through the kernel endpoint
+    TransportSharedRing, // Messages go through rings in shared memory, the endpoint only carries doorbells
+};
+
+/////////////////////////////
+/// \brief Single producer, single consumer ring of messages
+///
+/// The header and data live in memory shared by both processes.
+/// Records are a 16 byte header followed by the message data, padded to 16 bytes.
+///
+/// The peer can rewrite the shared memory at any time, so the ring size and our own index
+/// are kept outside of it and anything read from it is checked before use.
+/////////////////////////////
+class MessageRing final {
+public:
+    struct Header {
+        alignas(64) std::atomic<uint32_t> head; // Written by the producer
+        alignas(64) std::atomic<uint32_t> tail; // Written by the consumer
+        std::atomic<uint32_t> consumerWaiting;  // Set by the consumer before it sleeps
+        uint32_t size;                          // Size of the data area, a power of two
+    };
+
+    MessageRing() = default;
+    MessageRing(Header* header, uint8_t* data, uint32_t size)
+        : m_header(header), m_data(data), m_size(size),
+          m_head(header->head.load(std::memory_order_relaxed) & ~15U),
+          m_tail(header->tail.load(std::memory_order_relaxed) & ~15U) {}
+
+    /////////////////////////////
+    /// \brief Push a message onto the ring
+    ///
+    /// \return 1 on success, 0 if there is no space for the message, -EPROTO if the peer corrupted the ring
+    /////////////////////////////
+    int Push(uint64_t id, const uint8_t* data, uint16_t size);
+
+    /////////////////////////////
+    /// \brief Pop a message off the ring
+    ///
+    /// \param data Buffer of at least maxSize bytes
+    /// \param maxSize Maximum message size, larger messages are truncated
+    ///
+    /// \return 1 on success, 0 if the ring is empty, -EPROTO if the peer corrupted the ring
+    /////////////////////////////
+    int Pop(uint64_t& id, uint16_t& size, uint8_t* data, uint16_t maxSize);
+
+    inline bool Empty() const { return m_header->head.load(std::memory_order_acquire) == m_tail; }
+
+    /////////////////////////////
+    /// \brief Tell the producer that the consumer is about to sleep
+    ///
+    /// \return false if a message arrived in the meantime and the consumer should not sleep
+    /////////////////////////////
+    bool Arm();
+
+    /////////////////////////////
+    /// \brief Check whether the consumer needs waking, clearing the flag
+    /////////////////////////////
+    inline bool TakeConsumerWaiting() { return m_header->consumerWaiting.exchange(0, std::memory_order_seq_cst); }
+
+private:
+    struct Record {
+        uint64_t id;
+        uint32_t size;
+        uint32_t flags;
+    };
+
+    enum {
+        RecordWrap = 1, // Skip to the start of the ring
+    };
+
+    static inline uint32_t RecordLength(uint32_t size) { return (sizeof(Record) + size + 15) & ~15U; }
+
+    Header* m_header = nullptr;
+    uint8_t* m_data = nullptr;
+    uint32_t m_size = 0; // Size of the data area, header->size is only trusted when the channel is set up
+
+    // Only the producer writes head and only the consumer writes tail, keep our own copy
+    uint32_t m_head = 0;
+    uint32_t m_tail = 0;
+};
+
+/////////////////////////////
+/// \brief Pair of message rings shared between the two ends of an endpoint
+///
+/// The side that connects creates the shared memory and sends its key to the peer
+/// over the endpoint (MessageRingSetup). From then on messages go through the rings
+/// and the endpoint is only used to wake a peer that has gone to sleep (MessageRingDoorbell).
+///
+/// Channels are looked up by endpoint handle so every Endpoint wrapping the same handle uses the same rings.
+/////////////////////////////
+class RingChannel final {
+public:
+    /////////////////////////////
+    /// \brief Create a channel on an endpoint and send it to the peer
+    ///
+    /// \return Channel on success, nullptr on failure in which case the kernel transport should be used
+    /////////////////////////////
+    static std::shared_ptr<RingChannel> Create(handle_t endpoint, uint16_t msgSize);
+
+    /////////////////////////////
+    /// \brief Map a channel created by the peer
+    ///
+    /// \param key Shared memory key from the MessageRingSetup message
+    /////////////////////////////
+    static std::shared_ptr<RingChannel> Accept(handle_t endpoint, int64_t key, uint16_t msgSize);
+
+    static std::shared_ptr<RingChannel> Find(handle_t endpoint);
+    static void Remove(handle_t endpoint);
+
+    ~RingChannel();
+
+    /////////////////////////////
+    /// \brief Send a message to the peer
+    ///
+    /// Waits for space if the ring is full.
+    ///
+    /// \return 0 on success, negative error code on failure (-EPROTO if the peer corrupted the ring)
+    /////////////////////////////
+    long Queue(uint64_t id, const uint8_t* data, uint16_t size);
+
+    /////////////////////////////
+    /// \brief Receive a message from the peer
+    ///
+    /// If the ring is empty the peer is asked to ring the doorbell on its next message,
+    /// so the caller can then safely wait on the endpoint handle.
+    ///
+    /// \return 1 on success, 0 on empty, -EPROTO if the peer corrupted the ring in which case the channel must be dropped
+    /////////////////////////////
+    long Poll(uint64_t& id, uint16_t& size, uint8_t* data);
+
+    // Was the channel created by this side of the endpoint?
+    inline bool IsCreator() const { return m_creator; }
+
+private:
+    RingChannel(handle_t endpoint, int64_t key, uint8_t* base, uint32_t ringSize, uint16_t msgSize, bool creator);
+
+    static uint32_t RingSize(uint16_t msgSize);
+
+    handle_t m_endpoint;
+    int64_t m_key;
+    uint8_t* m_base;
+    uint16_t m_msgSize;
+    bool m_creator;
+
+    MessageRing m_tx;
+    MessageRing m_rx;
+
+    std::mutex m_txLock; // Threads of the same process share the producer side
+    std::mutex m_rxLock;
+};
+} // namespace Lemon
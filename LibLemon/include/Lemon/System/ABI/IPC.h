@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+// Returned by SYS_INTERFACE_DEQUEUE, followed by size bytes of message data
+typedef struct {
+    int64_t endpoint; // Handle ID of the endpoint the message arrived on
+
+    uint64_t id; // Message ID
+    uint16_t size; // Message Size
+    uint16_t flags;
+
+    uint32_t reserved;
+} lemon_message_record_t;
+
+#define LEMON_MESSAGE_RECORD_DISCONNECTED 0x1 // The peer of the endpoint has disconnected, no message data
+#define LEMON_MESSAGE_RECORD_INCOMING 0x2 // There are connections waiting to be accepted on the interface, endpoint is invalid
+
+// Records are padded to 8 bytes
+#define LEMON_MESSAGE_RECORD_LENGTH(size) ((sizeof(lemon_message_record_t) + (size) + 7) & ~((uint64_t)7))
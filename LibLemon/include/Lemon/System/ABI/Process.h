@@ -18,4 +18,8 @@ typedef struct {
     uint64_t activeUs;
 
     uint64_t usedMem; // Used memory in KB
+
+    uint64_t fpuSaves; // Times the extended register state of the threads was saved
+    uint64_t fpuRestores; // Times the extended register state of the threads was loaded
+    uint64_t fpuTraps; // Times a thread used the FPU with its state not loaded (lazy FPU restore)
 } lemon_process_info_t;
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+// Device the samples are read from, writing a sampling frequency in Hz (as text) starts the profiler and 0 stops it
+#define LEMON_PROFILER_DEVICE "/dev/profile"
+
+#define LEMON_PROFILER_MAX_FREQUENCY 10000
+#define LEMON_PROFILER_MAX_DEPTH 32
+
+// Interrupted in usermode, the frames are from the user stack
+#define LEMON_PROFILER_SAMPLE_USER 0x1
+
+// Reads from the device return whole samples
+typedef struct {
+    uint64_t timestamp; // Nanoseconds since boot
+    int64_t pid;
+    int64_t tid;
+    uint32_t cpu;
+    uint16_t flags;
+    uint16_t depth; // Number of frames, the first is the interrupted instruction
+    uint64_t frames[LEMON_PROFILER_MAX_DEPTH]; // Innermost first
+} lemon_profiler_sample_t;
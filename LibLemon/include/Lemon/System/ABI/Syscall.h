@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #define SYS_EXIT 1
 #define SYS_EXEC 2
 #define SYS_READ 3
@@ -103,4 +105,46 @@
 #define SYS_SIGNAL_ACTION 102
 #define SYS_SIGPROCMASK 103
 #define SYS_KILL 104
-#define SYS_SIGNAL_RETURN 105
\ No newline at end of file
+#define SYS_SIGNAL_RETURN 105
+#define SYS_MSYNC 106
+#define SYS_MADVISE 107
+#define SYS_SPLICE 108
+#define SYS_INTERFACE_DEQUEUE 109
+#define SYS_CLOCK_GETTIME 110
+
+// System calls are made with the SYSCALL instruction, define LEMON_SYSCALL_INT to use the int 0x69 gate instead.
+// The call number is passed in rax and arguments in rdi, rsi, rdx, r10, r9 and r8.
+// The return value is in rax, SYSCALL also clobbers rcx and r11.
+static inline long lemon_syscall(uint64_t call, uint64_t arg0, uint64_t arg1, uint64_t arg2, uint64_t arg3,
+                                 uint64_t arg4, uint64_t arg5) {
+    register uint64_t r10 asm("r10") = arg3;
+    register uint64_t r9 asm("r9") = arg4;
+    register uint64_t r8 asm("r8") = arg5;
+
+    long ret;
+#ifdef LEMON_SYSCALL_INT
+    asm volatile("int $0x69"
+                 : "=a"(ret)
+                 : "a"(call), "D"(arg0), "S"(arg1), "d"(arg2), "r"(r10), "r"(r9), "r"(r8)
+                 : "memory");
+#else
+    asm volatile("syscall"
+                 : "=a"(ret)
+                 : "a"(call), "D"(arg0), "S"(arg1), "d"(arg2), "r"(r10), "r"(r9), "r"(r8)
+                 : "rcx", "r11", "memory");
+#endif
+    return ret;
+}
+
+#ifdef __cplusplus
+namespace Lemon {
+// Takes up to 6 integer or pointer arguments
+template <typename... T> __attribute__((always_inline)) inline long Syscall(uint64_t call, T... args) {
+    static_assert(sizeof...(T) <= 6, "System calls take at most 6 arguments");
+
+    uint64_t a[6] = {((uint64_t)args)...}; // Unused arguments are zeroed
+
+    return lemon_syscall(call, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+} // namespace Lemon
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+// Auxiliary vector entry with the address of the vDSO header (lemon_vdso_header_t)
+#define AT_LEMON_VDSO 0x1000
+
+#define LEMON_VDSO_MAGIC 0x4F53444C // 'LDSO'
+#define LEMON_VDSO_VERSION 1
+
+// Layout of the vDSO region, the header is at the start of the code
+#define LEMON_VDSO_TIME_PAGE_OFFSET 0
+#define LEMON_VDSO_PROCESS_PAGE_OFFSET 0x1000
+#define LEMON_VDSO_CODE_OFFSET 0x2000
+
+// Clock IDs with an offset from the time since boot, same values as mlibc
+#define LEMON_CLOCK_REALTIME 0
+#define LEMON_CLOCK_REALTIME_COARSE 5
+
+// Function offsets are relative to the header
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+
+    uint64_t clockGetTime; // int clock_gettime(clockid_t clock, struct timespec* t), makes SYS_CLOCK_GETTIME for clocks it does not handle
+    uint64_t uptime; // int uptime(uint64_t* seconds, uint64_t* milliseconds), same as SYS_UPTIME
+    uint64_t getPID; // pid_t getpid()
+} lemon_vdso_header_t;
+
+// Shared by every process, read under the sequence lock
+typedef struct {
+    uint32_t sequence; // Odd whilst the page is being written
+    uint32_t reserved;
+
+    uint64_t tscBase; // TSC value at boot
+    uint64_t tscMultiplier; // Nanoseconds per TSC tick as 32.32 fixed point
+    uint64_t coarseNs; // Time since boot in nanoseconds at the last timer interrupt
+    int64_t realtimeOffset; // Added to the time since boot for CLOCK_REALTIME
+} lemon_vdso_time_page_t;
+
+typedef struct {
+    int64_t pid;
+} lemon_vdso_process_page_t;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <Lemon/System/ABI/IPC.h>
+#include <Lemon/System/ABI/Syscall.h>
 #include <Lemon/Types.h>
 #include <lemon/syscall.h>
 
@@ -18,7 +20,7 @@ struct LemonEndpointInfo {
 ///
 /// \return Handle ID on success, error code on failure
 /////////////////////////////
-inline handle_t CreateService(const char* name) { return syscall(SYS_CREATE_SERVICE, name); }
+inline handle_t CreateService(const char* name) { return Syscall(SYS_CREATE_SERVICE, name); }
 
 /////////////////////////////
 /// \brief CreateInterface (service, name, msgSize) - Create a new interface
@@ -32,7 +34,7 @@ inline handle_t CreateService(const char* name) { return syscall(SYS_CREATE_SERV
 /// \return Handle ID of service on success, negative error code on failure
 /////////////////////////////
 inline handle_t CreateInterface(handle_t svc, const char* name, uint16_t msgSize) {
-    return syscall(SYS_CREATE_INTERFACE, svc, name, msgSize);
+    return Syscall(SYS_CREATE_INTERFACE, svc, name, msgSize);
 }
 
 /////////////////////////////
@@ -44,7 +46,24 @@ inline handle_t CreateInterface(handle_t svc, const char* name, uint16_t msgSize
 ///
 /// \return Handle ID of endpoint on success, 0 when no pending connections, negative error code on failure
 /////////////////////////////
-inline handle_t InterfaceAccept(handle_t interface) { return syscall(SYS_INTERFACE_ACCEPT, interface); }
+inline handle_t InterfaceAccept(handle_t interface) { return Syscall(SYS_INTERFACE_ACCEPT, interface); }
+
+/////////////////////////////
+/// \brief InterfaceDequeue (interface, buffer, size, count) - Dequeue messages from all endpoints of an interface
+///
+/// Fills buffer with lemon_message_record_t records, each followed by the message data and padded to 8 bytes
+/// (LEMON_MESSAGE_RECORD_LENGTH). Endpoints accepted on the interface are serviced round robin.
+///
+/// \param interface (handle_t) Handle ID of the interface
+/// \param buffer (void*) Record buffer, should have space for at least one record of the maximum message size
+/// \param size (size_t) Size of buffer
+/// \param count (unsigned) Maximum amount of records
+///
+/// \return Amount of records on success, negative error code on failure
+/////////////////////////////
+inline long InterfaceDequeue(handle_t interface, void* buffer, size_t size, unsigned count) {
+    return Syscall(SYS_INTERFACE_DEQUEUE, interface, buffer, size, count);
+}
 
 /////////////////////////////
 /// \brief InterfaceConnect (path) - Open a connection to an interface
@@ -55,7 +74,7 @@ inline handle_t InterfaceAccept(handle_t interface) { return syscall(SYS_INTERFA
 ///
 /// \return Handle ID of endpoint on success, negative error code on failure
 /////////////////////////////
-inline handle_t InterfaceConnect(const char* path) { return syscall(SYS_INTERFACE_CONNECT, path); }
+inline handle_t InterfaceConnect(const char* path) { return Syscall(SYS_INTERFACE_CONNECT, path); }
 
 /////////////////////////////
 /// \brief EndpointQueue (endpoint, id, size, data) - Queue a message on an endpoint
@@ -71,7 +90,7 @@ inline handle_t InterfaceConnect(const char* path) { return syscall(SYS_INTERFAC
 /////////////////////////////
 __attribute__((always_inline)) inline long EndpointQueue(handle_t endpoint, uint64_t id, uint16_t size,
                                                          uintptr_t data) {
-    return syscall(SYS_ENDPOINT_QUEUE, endpoint, id, size, data);
+    return Syscall(SYS_ENDPOINT_QUEUE, endpoint, id, size, data);
 }
 
 /////////////////////////////
@@ -87,7 +106,7 @@ __attribute__((always_inline)) inline long EndpointQueue(handle_t endpoint, uint
 /////////////////////////////
 template <typename T>
 __attribute__((always_inline)) inline long EndpointQueue(handle_t endpoint, uint64_t id, const T& data) {
-    return syscall(SYS_ENDPOINT_QUEUE, endpoint, id, sizeof(T), &data);
+    return Syscall(SYS_ENDPOINT_QUEUE, endpoint, id, sizeof(T), &data);
 }
 
 /////////////////////////////
@@ -104,7 +123,7 @@ __attribute__((always_inline)) inline long EndpointQueue(handle_t endpoint, uint
 /////////////////////////////
 __attribute__((always_inline)) inline long EndpointDequeue(handle_t endpoint, uint64_t* id, uint16_t* size,
                                                            uint8_t* data) {
-    return syscall(SYS_ENDPOINT_DEQUEUE, endpoint, id, size, data);
+    return Syscall(SYS_ENDPOINT_DEQUEUE, endpoint, id, size, data);
 }
 
 /////////////////////////////
@@ -124,7 +143,7 @@ __attribute__((always_inline)) inline long EndpointDequeue(handle_t endpoint, ui
 /////////////////////////////
 __attribute__((always_inline)) inline long EndpointCall(handle_t endpoint, uint64_t id, uintptr_t data, uint64_t rID,
                                                         uintptr_t rData, uint16_t* size) {
-    return syscall(SYS_ENDPOINT_CALL, endpoint, id, data, rID, rData, size);
+    return Syscall(SYS_ENDPOINT_CALL, endpoint, id, data, rID, rData, size);
 }
 
 /////////////////////////////
@@ -138,6 +157,6 @@ __attribute__((always_inline)) inline long EndpointCall(handle_t endpoint, uint6
 /// \return 0 on success, negative error code on failure
 /////////////////////////////
 __attribute__((always_inline)) inline long EndpointInfo(handle_t endp, LemonEndpointInfo& info) {
-    return syscall(SYS_ENDPOINT_INFO, endp, &info);
+    return Syscall(SYS_ENDPOINT_INFO, endp, &info);
 }
 } // namespace Lemon
@@ -10,6 +10,7 @@
 #include <sys/types.h>
 #include <stdint.h>
 #include <limits.h>
+#include <time.h>
 
 #include <vector>
 
@@ -56,4 +57,17 @@ namespace Lemon{
     /// \param list Reference to a std::vector<lemon_process_info_t>
     /////////////////////////////
     void GetProcessList(std::vector<lemon_process_info_t>& list);
+
+    /////////////////////////////
+    /// \brief Get the time of a clock
+    ///
+    /// Same as clock_gettime, but reads the clock through the vDSO when the kernel provides one
+    /// so that frequently polled clocks (e.g. CLOCK_BOOTTIME for frame timing) do not need a system call.
+    ///
+    /// \param clock Clock ID
+    /// \param t Pointer to the time
+    ///
+    /// \return 0 on success, -1 on failure (errno is set)
+    /////////////////////////////
+    int ClockGetTime(clockid_t clock, timespec* t);
 }
@@ -279,7 +279,6 @@ void surfacecpy(surface_t* dest, const surface_t* src, vector2i_t offset, rect_t
 
     if (offset.y < 0) {
         i -= offset.y;
-        offset.y = 0;
     }
 
     unsigned destPitch = dest->width << 2;
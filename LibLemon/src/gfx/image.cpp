@@ -1,12 +1,18 @@
 #include <Lemon/Graphics/Graphics.h>
+#include <Lemon/Graphics/ImageCache.h>
 
 #include <assert.h>
 #include <math.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <zlib.h>
 
+#include <algorithm>
+#include <string>
+
 namespace Lemon::Graphics {
 bool IsPNG(const void* data) { return !png_sig_cmp((png_const_bytep)data, 0, 8); }
 
@@ -28,7 +34,8 @@ int LoadImage(FILE* f, surface_t* surface) {
         return -1;
 }
 
-int LoadImage(const char* path, surface_t* surface) {
+// Decode the image at path, bypassing the image cache
+static int DecodeImage(const char* path, surface_t* surface) {
     FILE* imageFile = fopen(path, "rb");
 
     if (!imageFile) {
@@ -51,45 +58,51 @@ int LoadImage(const char* path, surface_t* surface) {
         return type;
     }
 
-    surface_t surf;
-    int r = LoadImage(imageFile, &surf);
+    int r = LoadImage(imageFile, surface);
     fclose(imageFile);
 
-    *surface = surf;
     return r;
 }
 
-int LoadImage(const char* path, int x, int y, int w, int h, surface_t* surface, bool preserveAspectRatio) {
-    FILE* imageFile = fopen(path, "rb");
-
-    if (!imageFile) {
-        return -1; // Error opening image file
+// Key for the image cache, so that different paths to the same file share entries
+static std::string CanonicalPath(const char* path) {
+    char* rPath = realpath(path, nullptr);
+    if (!rPath) {
+        return path;
     }
 
-    char sig[8];
-
-    fseek(imageFile, 0, SEEK_SET);
+    std::string canonical = rPath;
+    free(rPath);
+    return canonical;
+}
 
-    if (!fread(sig, 8, 1, imageFile)) {
-        fclose(imageFile);
-        return -2; // Could not read first 8 bytes of image
+int LoadImage(const char* path, surface_t* surface) {
+    struct stat st;
+    if (stat(path, &st)) {
+        return -1; // Error opening image file
     }
 
-    int type = IdentifyImage(sig); // Identify Image Type
+    std::string key = CanonicalPath(path);
 
-    if (type == Image_Unknown) { // Unknown Image Type
-        fclose(imageFile);
-        return type;
+    ImageCache* cache = ImageCache::Instance();
+    if (cache->Lookup(key, st.st_mtime, 0, 0, surface)) {
+        return 0;
     }
 
     surface_t surf;
-    int r = LoadImage(imageFile, &surf);
+    int r = DecodeImage(path, &surf);
+    if (!r) {
+        cache->Insert(key, st.st_mtime, 0, 0, &surf);
+    }
 
-    if (r)
-        return r;
+    *surface = surf;
+    return r;
+}
 
-    double xScale = ((double)w) / surf.width;
-    double yScale = (((double)h) / surf.height);
+// Scale src to (w, h) into a new surface
+static void ScaleImage(const surface_t* src, int w, int h, bool preserveAspectRatio, surface_t* dest) {
+    double xScale = ((double)w) / src->width;
+    double yScale = (((double)h) / src->height);
     double xOffset = 0;
 
     if (preserveAspectRatio) {
@@ -99,47 +112,87 @@ int LoadImage(const char* path, int x, int y, int w, int h, surface_t* surface,
             yScale = xScale;
     }
 
-    uint8_t* srcBuffer = surf.buffer;
+    const uint8_t* srcBuffer = src->buffer;
 
-    if (!surface->buffer) { // Allocate new surface if needed
-        *surface = {.width = w + x, .height = h + y, .depth = 32, .buffer = new uint8_t[(w + x) * (h + y) * 4]};
-    }
-
-    uint32_t* destBuffer = (uint32_t*)surface->buffer;
+    *dest = {.width = w, .height = h, .depth = 32, .buffer = (uint8_t*)calloc(static_cast<size_t>(w) * h, 4)};
+    uint32_t* destBuffer = (uint32_t*)dest->buffer;
 
-    for (int i = 0; i < h && i + y < surface->height; i++) {
+    for (int i = 0; i < h; i++) {
         double _yval = ((double)i) / yScale;
-        if (ceil(_yval) >= surf.height)
+        if (ceil(_yval) >= src->height)
             break;
-        for (int j = 0; j < w && j + x < surface->width; j++) {
+        for (int j = 0; j < w; j++) {
             double _xval = xOffset + ((double)+j) / xScale;
-            if (ceil(_xval) >= surf.width)
+            if (ceil(_xval) >= src->width)
                 break;
-            uint32_t offset = (y + i) * surface->width + x + j;
-
-            long b = Interpolate(srcBuffer[((int)floor(_yval) * surf.width + (int)floor(_xval)) * 4],
-                                 srcBuffer[((int)floor(_yval) * surf.width + (int)ceil(_xval)) * 4],
-                                 srcBuffer[((int)ceil(_yval) * surf.width + (int)floor(_xval)) * 4],
-                                 srcBuffer[((int)ceil(_yval) * surf.width + (int)ceil(_xval)) * 4], _xval, _yval);
-            long g = Interpolate(srcBuffer[((int)floor(_yval) * surf.width + (int)floor(_xval)) * 4 + 1],
-                                 srcBuffer[((int)floor(_yval) * surf.width + (int)ceil(_xval)) * 4 + 1],
-                                 srcBuffer[((int)floor(_yval) * surf.width + (int)ceil(_xval)) * 4 + 1],
-                                 srcBuffer[((int)ceil(_yval) * surf.width + (int)ceil(_xval)) * 4 + 1], _xval, _yval);
-            long r = Interpolate(srcBuffer[((int)floor(_yval) * surf.width + (int)floor(_xval)) * 4 + 2],
-                                 srcBuffer[((int)floor(_yval) * surf.width + (int)ceil(_xval)) * 4 + 2],
-                                 srcBuffer[((int)floor(_yval) * surf.width + (int)ceil(_xval)) * 4 + 2],
-                                 srcBuffer[((int)ceil(_yval) * surf.width + (int)ceil(_xval)) * 4 + 2], _xval, _yval);
-            long a = Interpolate(srcBuffer[((int)floor(_yval) * surf.width + (int)floor(_xval)) * 4 + 3],
-                                 srcBuffer[((int)floor(_yval) * surf.width + (int)ceil(_xval)) * 4 + 3],
-                                 srcBuffer[((int)floor(_yval) * surf.width + (int)ceil(_xval)) * 4 + 3],
-                                 srcBuffer[((int)ceil(_yval) * surf.width + (int)ceil(_xval)) * 4 + 3], _xval, _yval);
+            uint32_t offset = i * w + j;
+
+            long b = Interpolate(srcBuffer[((int)floor(_yval) * src->width + (int)floor(_xval)) * 4],
+                                 srcBuffer[((int)floor(_yval) * src->width + (int)ceil(_xval)) * 4],
+                                 srcBuffer[((int)ceil(_yval) * src->width + (int)floor(_xval)) * 4],
+                                 srcBuffer[((int)ceil(_yval) * src->width + (int)ceil(_xval)) * 4], _xval, _yval);
+            long g = Interpolate(srcBuffer[((int)floor(_yval) * src->width + (int)floor(_xval)) * 4 + 1],
+                                 srcBuffer[((int)floor(_yval) * src->width + (int)ceil(_xval)) * 4 + 1],
+                                 srcBuffer[((int)floor(_yval) * src->width + (int)ceil(_xval)) * 4 + 1],
+                                 srcBuffer[((int)ceil(_yval) * src->width + (int)ceil(_xval)) * 4 + 1], _xval, _yval);
+            long r = Interpolate(srcBuffer[((int)floor(_yval) * src->width + (int)floor(_xval)) * 4 + 2],
+                                 srcBuffer[((int)floor(_yval) * src->width + (int)ceil(_xval)) * 4 + 2],
+                                 srcBuffer[((int)floor(_yval) * src->width + (int)ceil(_xval)) * 4 + 2],
+                                 srcBuffer[((int)ceil(_yval) * src->width + (int)ceil(_xval)) * 4 + 2], _xval, _yval);
+            long a = Interpolate(srcBuffer[((int)floor(_yval) * src->width + (int)floor(_xval)) * 4 + 3],
+                                 srcBuffer[((int)floor(_yval) * src->width + (int)ceil(_xval)) * 4 + 3],
+                                 srcBuffer[((int)floor(_yval) * src->width + (int)ceil(_xval)) * 4 + 3],
+                                 srcBuffer[((int)ceil(_yval) * src->width + (int)ceil(_xval)) * 4 + 3], _xval, _yval);
 
             destBuffer[offset] = (a << 24) | (r << 16) | (g << 8) | b;
         }
     }
+}
 
-    free(srcBuffer);
-    fclose(imageFile);
+int LoadImage(const char* path, int x, int y, int w, int h, surface_t* surface, bool preserveAspectRatio) {
+    struct stat st;
+    if (stat(path, &st)) {
+        return -1; // Error opening image file
+    }
+
+    std::string key = CanonicalPath(path);
+
+    ImageCache* cache = ImageCache::Instance();
+    bool isThumbnail = w <= ImageCache::thumbnailMaximumSize && h <= ImageCache::thumbnailMaximumSize;
+
+    surface_t scaled;
+    if (!cache->Lookup(key, st.st_mtime, w, h, &scaled, preserveAspectRatio)) {
+        if (isThumbnail && cache->LoadThumbnail(key, st.st_mtime, w, h, &scaled, preserveAspectRatio)) {
+            cache->Insert(key, st.st_mtime, w, h, &scaled, preserveAspectRatio);
+        } else {
+            surface_t surf;
+            if (int r = DecodeImage(path, &surf); r) {
+                return r;
+            }
+
+            ScaleImage(&surf, w, h, preserveAspectRatio, &scaled);
+            cache->Insert(key, st.st_mtime, w, h, &scaled, preserveAspectRatio);
+
+            // Only bother persisting images that are expensive to decode relative to their size
+            if (isThumbnail && static_cast<long>(surf.width) * surf.height >=
+                                   static_cast<long>(ImageCache::thumbnailMinimumRatio) * w * h) {
+                cache->SaveThumbnail(key, st.st_mtime, w, h, &scaled, preserveAspectRatio);
+            }
+
+            free(surf.buffer);
+        }
+    }
+
+    if (!surface->buffer) { // Allocate new surface if needed
+        *surface = {.width = w + x, .height = h + y, .depth = 32, .buffer = new uint8_t[(w + x) * (h + y) * 4]};
+    }
+
+    int rowLength = std::min(w, surface->width - x);
+    for (int i = 0; i < h && i + y < surface->height && rowLength > 0; i++) {
+        memcpy(surface->buffer + ((y + i) * surface->width + x) * 4, scaled.buffer + i * w * 4, rowLength * 4);
+    }
+
+    free(scaled.buffer);
 
     return 0;
 }
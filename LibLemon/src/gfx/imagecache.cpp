@@ -0,0 +1,225 @@
+#include <Lemon/Graphics/ImageCache.h>
+
+#include <Lemon/Core/SHA.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+namespace Lemon::Graphics {
+ImageCache* ImageCache::m_instance = nullptr;
+std::mutex ImageCache::m_instanceMutex;
+
+namespace {
+struct ThumbnailHeader {
+    char magic[4]; // Should be "LTHM"
+    uint32_t version;
+    int64_t mtime; // Modification time of the original image
+    int32_t width;
+    int32_t height;
+} __attribute__((packed));
+
+const uint32_t thumbnailVersion = 1;
+} // namespace
+
+ImageCache::ImageCache() {
+    // Thumbnails are only kept on disk for users with a home directory
+    const char* home = getenv("HOME");
+    if (home && home[0] == '/') {
+        m_thumbnailDirectory = std::string(home) + "/.cache/thumbnails";
+    }
+}
+
+ImageCache* ImageCache::Instance() {
+    std::scoped_lock lock(m_instanceMutex);
+
+    if (!m_instance) {
+        m_instance = new ImageCache();
+    }
+
+    return m_instance;
+}
+
+bool ImageCache::Lookup(const std::string& path, time_t mtime, int width, int height, surface_t* surface,
+                        bool preserveAspectRatio) {
+    std::scoped_lock lock(m_lock);
+
+    auto it = m_lookup.find(GetKey(path, mtime, width, height, preserveAspectRatio));
+    if (it == m_lookup.end()) {
+        return false;
+    }
+
+    // Move to the front of the LRU list
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+    const CacheEntry& entry = *it->second;
+    *surface = {.width = entry.surface.width,
+                .height = entry.surface.height,
+                .depth = 32,
+                .buffer = (uint8_t*)malloc(entry.size)};
+    memcpy(surface->buffer, entry.surface.buffer, entry.size);
+
+    return true;
+}
+
+void ImageCache::Insert(const std::string& path, time_t mtime, int width, int height, const surface_t* surface,
+                        bool preserveAspectRatio) {
+    size_t size = static_cast<size_t>(surface->width) * surface->height * 4;
+    std::string key = GetKey(path, mtime, width, height, preserveAspectRatio);
+
+    std::scoped_lock lock(m_lock);
+
+    if (!size || size > m_capacity / maximumEntryFraction) {
+        return; // Most likely only loaded once and would evict everything else
+    }
+
+    if (m_lookup.find(key) != m_lookup.end()) {
+        return; // Another thread got there first
+    }
+
+    CacheEntry entry = {.key = key,
+                        .surface = {.width = surface->width,
+                                    .height = surface->height,
+                                    .depth = 32,
+                                    .buffer = (uint8_t*)malloc(size)},
+                        .size = size};
+    memcpy(entry.surface.buffer, surface->buffer, size);
+
+    m_entries.push_front(entry);
+    m_lookup[key] = m_entries.begin();
+    m_size += size;
+
+    Evict();
+}
+
+bool ImageCache::LoadThumbnail(const std::string& path, time_t mtime, int width, int height, surface_t* surface,
+                               bool preserveAspectRatio) {
+    if (m_thumbnailDirectory.empty()) {
+        return false;
+    }
+
+    FILE* f = fopen(GetThumbnailPath(path, width, height, preserveAspectRatio).c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+
+    ThumbnailHeader header;
+    if (fread(&header, sizeof(ThumbnailHeader), 1, f) != 1 || strncmp(header.magic, "LTHM", 4) ||
+        header.version != thumbnailVersion || header.mtime != mtime || header.width != width ||
+        header.height != height) {
+        fclose(f);
+        return false; // Stale or invalid thumbnail
+    }
+
+    size_t size = static_cast<size_t>(width) * height * 4;
+    uint8_t* buffer = (uint8_t*)malloc(size);
+    if (fread(buffer, size, 1, f) != 1) {
+        free(buffer);
+        fclose(f);
+        return false;
+    }
+
+    fclose(f);
+
+    *surface = {.width = width, .height = height, .depth = 32, .buffer = buffer};
+    return true;
+}
+
+void ImageCache::SaveThumbnail(const std::string& path, time_t mtime, int width, int height,
+                               const surface_t* surface, bool preserveAspectRatio) {
+    if (m_thumbnailDirectory.empty()) {
+        return;
+    }
+
+    // Only create the directory once there is something to put in it
+    std::call_once(m_createThumbnailDirectory, [this]() {
+        mkdir(m_thumbnailDirectory.substr(0, m_thumbnailDirectory.rfind('/')).c_str(), 0755);
+        mkdir(m_thumbnailDirectory.c_str(), 0755);
+    });
+
+    std::string thumbnailPath = GetThumbnailPath(path, width, height, preserveAspectRatio);
+    std::string temporaryPath = thumbnailPath + ".tmp";
+
+    FILE* f = fopen(temporaryPath.c_str(), "wb");
+    if (!f) {
+        return; // Cache directory may not be writable
+    }
+
+    ThumbnailHeader header = {
+        .magic = {'L', 'T', 'H', 'M'},
+        .version = thumbnailVersion,
+        .mtime = mtime,
+        .width = width,
+        .height = height,
+    };
+
+    size_t size = static_cast<size_t>(width) * height * 4;
+    bool written = fwrite(&header, sizeof(ThumbnailHeader), 1, f) == 1 && fwrite(surface->buffer, size, 1, f) == 1;
+    fclose(f);
+
+    // Write to a temporary file first so another process never sees a partial thumbnail
+    if (!written || rename(temporaryPath.c_str(), thumbnailPath.c_str())) {
+        remove(temporaryPath.c_str());
+    }
+}
+
+void ImageCache::SetCapacity(size_t bytes) {
+    std::scoped_lock lock(m_lock);
+
+    m_capacity = bytes;
+    Evict();
+}
+
+size_t ImageCache::Capacity() {
+    std::scoped_lock lock(m_lock);
+    return m_capacity;
+}
+
+size_t ImageCache::Size() {
+    std::scoped_lock lock(m_lock);
+    return m_size;
+}
+
+void ImageCache::Clear() {
+    std::scoped_lock lock(m_lock);
+
+    for (CacheEntry& entry : m_entries) {
+        free(entry.surface.buffer);
+    }
+
+    m_entries.clear();
+    m_lookup.clear();
+    m_size = 0;
+}
+
+std::string ImageCache::GetKey(const std::string& path, time_t mtime, int width, int height,
+                               bool preserveAspectRatio) const {
+    return path + ":" + std::to_string(mtime) + ":" + std::to_string(width) + "x" + std::to_string(height) +
+           (preserveAspectRatio ? "a" : "");
+}
+
+std::string ImageCache::GetThumbnailPath(const std::string& path, int width, int height,
+                                         bool preserveAspectRatio) const {
+    std::string name =
+        path + ":" + std::to_string(width) + "x" + std::to_string(height) + (preserveAspectRatio ? "a" : "");
+
+    SHA256 sha;
+    sha.Update(name.data(), name.length());
+
+    return m_thumbnailDirectory + "/" + sha.GetHash();
+}
+
+// Expects m_lock to be held
+void ImageCache::Evict() {
+    while (m_size > m_capacity && m_entries.size()) {
+        CacheEntry& entry = m_entries.back();
+
+        m_size -= entry.size;
+        free(entry.surface.buffer);
+
+        m_lookup.erase(entry.key);
+        m_entries.pop_back();
+    }
+}
+} // namespace Lemon::Graphics
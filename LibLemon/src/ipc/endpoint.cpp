@@ -0,0 +1,95 @@
+#include <Lemon/IPC/Endpoint.h>
+
+#include <Lemon/System/KernelObject.h>
+
+#include <string.h>
+
+namespace Lemon {
+long Endpoint::PollRing(Message& m) {
+    if (m_pending.size()) {
+        PendingMessage& front = m_pending.front();
+        m.Set(front.data, front.length, front.id);
+
+        m_pending.pop_front();
+        return 1;
+    }
+
+    uint64_t id;
+    uint16_t size;
+    uint8_t* data = new uint8_t[m_msgSize];
+    long ret = m_channel->Poll(id, size, data);
+    if (ret > 0) {
+        m.Set(data, size, id);
+        return 1;
+    } else if (ret < 0) {
+        delete[] data;
+
+        Close(); // The peer corrupted the ring, we can no longer trust anything it sends
+        return ret;
+    }
+
+    // The ring is empty, check the endpoint itself for doorbells,
+    // messages sent with EndpointQueue and disconnection
+    while ((ret = EndpointDequeue(m_handle.get(), &id, &size, data)) > 0) {
+        if (id == MessageRingDoorbell) {
+            if ((ret = m_channel->Poll(id, size, data)) > 0) {
+                m.Set(data, size, id);
+                return 1;
+            } else if (ret < 0) {
+                delete[] data;
+
+                Close();
+                return ret;
+            }
+
+            continue;
+        }
+
+        m.Set(data, size, id);
+        return 1;
+    }
+
+    delete[] data;
+    return ret;
+}
+
+long Endpoint::CallRing(uint64_t id, const uint8_t* data, uint16_t size, uint64_t rID, uint8_t* rData,
+                        uint16_t* rSize) {
+    if (long ret = m_channel->Queue(id, data, size); ret) {
+        return ret;
+    }
+
+    uint64_t msgID;
+    uint16_t msgSize;
+    while (true) {
+        // The response may come through the ring or have been queued directly on the endpoint
+        long ret = m_channel->Poll(msgID, msgSize, rData);
+        if (ret < 0) {
+            Close(); // The peer corrupted the ring
+            return ret;
+        } else if (!ret) {
+            ret = EndpointDequeue(m_handle.get(), &msgID, &msgSize, rData);
+        }
+
+        if (ret < 0) {
+            return ret;
+        } else if (!ret) {
+            WaitForKernelObject(m_handle.get(), -1);
+            continue;
+        }
+
+        if (msgID == rID) {
+            *rSize = msgSize;
+            return 0;
+        } else if (msgID == MessageRingDoorbell) {
+            continue;
+        }
+
+        // Keep anything else for Poll
+        uint8_t* pending = new uint8_t[msgSize];
+        memcpy(pending, rData, msgSize);
+
+        m_pending.push_back({.id = msgID, .data = pending, .length = msgSize});
+    }
+}
+} // namespace Lemon
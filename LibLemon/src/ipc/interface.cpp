@@ -4,6 +4,8 @@
 #include <Lemon/System/IPC.h>
 #include <errno.h>
 
+#include <algorithm>
+
 namespace Lemon {
 const char* const EndpointException::errorStrings[] = {
     "Error: Unknown Endpoint Error",
@@ -35,74 +37,108 @@ Interface::Interface(const Handle& service, const char* name, uint16_t msgSize)
 
     m_interfaceHandle = Handle(handle);
     m_dataBuffer = new uint8_t[msgSize];
+
+    m_recordBufferSize = std::max<size_t>(LEMON_MESSAGE_RECORD_LENGTH(msgSize), recordBufferMinSize);
+    m_recordBuffer = new uint8_t[m_recordBufferSize];
 }
 
 void Interface::RegisterObject(const std::string& name, int id) { m_objects[name] = id; }
 
 long Interface::Poll(Lemon::Handle& client, Message& m) {
-    handle_t newIf;
-    while ((newIf = InterfaceAccept(m_interfaceHandle.get()))) { // Accept any incoming connections
-        if (newIf > 0) {
-            m_rawEndpoints.push_back(newIf);
-            m_endpoints.push_back(Handle(newIf));
-
-            for (Waiter* waiter : waiters) {
-                waiter->RepopulateHandles(); // Repopulate handles
-            }
-        }
+    if (!m_queue.size()) {
+        Dequeue();
     }
 
-    if (m_queue.size() > 0) { // Check for messages on the queue
+    if (m_queue.size() > 0) {
         auto& front = m_queue.front();
 
-        client = front.client;
+        client = std::move(front.client);
         m.Set(front.data, front.length, front.id);
 
         m_queue.pop_front();
         return 1;
+    } else {
+        return 0;
     }
+}
 
-    for (auto it = m_endpoints.begin(); !m_endpoints.empty() && it != m_endpoints.end(); it++) {
-        InterfaceMessageInfo msg{*it, 0, nullptr, 0};
-
-        while (long ret = EndpointDequeue(it->get(), &msg.id, &msg.length, m_dataBuffer)) {
-            if (ret < 0) { // We have probably disconnected
-                m_endpoints.erase(it);
-                RepopulateRawHandles();
+void Interface::Dequeue() {
+    long count = InterfaceDequeue(m_interfaceHandle.get(), m_recordBuffer, m_recordBufferSize, recordBufferMaxCount);
 
-                msg.id = MessagePeerDisconnect;
-                m_queue.push_back(std::move(msg));
+    uint8_t* next = m_recordBuffer;
+    for (long i = 0; i < count; i++) {
+        lemon_message_record_t* record = reinterpret_cast<lemon_message_record_t*>(next);
+        next += LEMON_MESSAGE_RECORD_LENGTH(record->size);
 
-                for (Waiter* waiter : waiters) {
-                    waiter->RepopulateHandles();
+        if (record->flags & LEMON_MESSAGE_RECORD_INCOMING) {
+            handle_t newIf;
+            while ((newIf = InterfaceAccept(m_interfaceHandle.get()))) { // Accept any incoming connections
+                if (newIf > 0) {
+                    m_endpoints.emplace(newIf, Handle(newIf));
                 }
-                break;
             }
+            continue;
+        }
+
+        auto it = m_endpoints.find(record->endpoint);
+        if (it == m_endpoints.end()) {
+            continue;
+        }
 
-            msg.data = m_dataBuffer;
-            m_queue.push_back(msg);
+        const Handle& endpoint = it->second;
+        auto channel = m_channels.find(record->endpoint);
 
-            m_dataBuffer = new uint8_t[m_msgSize];
+        // A client that corrupts its ring is treated as having disconnected
+        bool disconnected = record->flags & LEMON_MESSAGE_RECORD_DISCONNECTED;
+        uint8_t* data = reinterpret_cast<uint8_t*>(record + 1);
+        if (disconnected) {
+            if (channel != m_channels.end()) {
+                DrainChannel(endpoint, *channel->second); // Anything left on the ring was sent before the disconnect
+            }
+        } else if (record->id == MessageRingSetup) { // Client wants to use shared memory rings from now on
+            if (record->size == sizeof(int64_t)) {
+                if (auto newChannel = RingChannel::Accept(record->endpoint, *reinterpret_cast<int64_t*>(data), m_msgSize)) {
+                    channel = m_channels.insert_or_assign(record->endpoint, newChannel).first;
+                    disconnected = DrainChannel(endpoint, *newChannel) < 0;
+                }
+            }
+        } else if (record->id == MessageRingDoorbell) {
+            if (channel != m_channels.end()) {
+                disconnected = DrainChannel(endpoint, *channel->second) < 0;
+            }
         }
-    }
 
-    if (m_queue.size() > 0) {
-        auto& front = m_queue.front();
+        if (disconnected) {
+            if (channel != m_channels.end()) {
+                RingChannel::Remove(record->endpoint);
+                m_channels.erase(channel);
+            }
 
-        client = std::move(front.client);
-        m.Set(front.data, front.length, front.id);
+            m_queue.push_back({endpoint, MessagePeerDisconnect, nullptr, 0});
+            m_endpoints.erase(it); // Closes our handle so the client sees the disconnect
+            continue;
+        } else if (record->id == MessageRingSetup || record->id == MessageRingDoorbell) {
+            continue;
+        }
 
-        m_queue.pop_front();
-        return 1;
-    } else {
-        return 0;
+        uint8_t* buffer = new uint8_t[m_msgSize];
+        memcpy(buffer, data, record->size);
+
+        m_queue.push_back({endpoint, record->id, buffer, record->size});
     }
 }
 
-void Interface::RepopulateRawHandles() {
-    m_rawEndpoints.clear();
-    for (auto& handle : m_endpoints) {
-        m_rawEndpoints.push_back(handle.get());
+long Interface::DrainChannel(const Handle& client, RingChannel& channel) {
+    InterfaceMessageInfo msg{client, 0, nullptr, 0};
+
+    long ret;
+    while ((ret = channel.Poll(msg.id, msg.length, m_dataBuffer)) > 0) { // Once empty the client rings the doorbell again
+        msg.data = m_dataBuffer;
+        m_queue.push_back(msg);
+
+        m_dataBuffer = new uint8_t[m_msgSize];
     }
+
+    return ret;
 }
 } // namespace Lemon
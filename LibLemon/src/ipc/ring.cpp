@@ -0,0 +1,277 @@
+#include <Lemon/IPC/Ring.h>
+
+#include <Lemon/Core/SharedMemory.h>
+#include <Lemon/IPC/Message.h>
+#include <Lemon/System/IPC.h>
+
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+
+#include <map>
+
+namespace Lemon {
+namespace {
+// The headers of both rings share the first page, the data areas follow it
+const size_t ringHeaderAreaSize = 4096;
+const size_t ringHeaderStride = 256;
+
+// Ring at least this many maximum size messages
+const uint32_t ringMinimumMessages = 4;
+const uint32_t ringMinimumSize = 0x10000; // 64 KB
+
+// How many times to yield on a full ring before ringing the doorbell again
+const int ringFullDoorbellInterval = 64;
+
+std::mutex channelsLock;
+std::map<handle_t, std::shared_ptr<RingChannel>> channels;
+} // namespace
+
+int MessageRing::Push(uint64_t id, const uint8_t* data, uint16_t size) {
+    uint32_t head = m_head;
+    uint32_t tail = m_header->tail.load(std::memory_order_acquire);
+    if (head - tail > m_size) {
+        return -EPROTO; // The consumer is ahead of us or more than a ring behind
+    }
+
+    uint32_t length = RecordLength(size);
+    uint32_t offset = head & (m_size - 1);
+    uint32_t toEnd = m_size - offset;
+
+    // Records are never split, if it does not fit before the end of the ring skip to the start
+    uint32_t needed = (toEnd < length) ? (toEnd + length) : length;
+    if (m_size - (head - tail) < needed) {
+        return 0;
+    }
+
+    if (toEnd < length) {
+        Record* wrap = reinterpret_cast<Record*>(m_data + offset);
+        wrap->id = 0;
+        wrap->size = 0;
+        wrap->flags = RecordWrap;
+
+        head += toEnd;
+        offset = 0;
+    }
+
+    Record* record = reinterpret_cast<Record*>(m_data + offset);
+    record->id = id;
+    record->size = size;
+    record->flags = 0;
+
+    if (size) {
+        memcpy(record + 1, data, size);
+    }
+
+    m_head = head + length;
+    m_header->head.store(m_head, std::memory_order_release);
+    return 1;
+}
+
+int MessageRing::Pop(uint64_t& id, uint16_t& size, uint8_t* data, uint16_t maxSize) {
+    uint32_t tail = m_tail;
+    uint32_t head = m_header->head.load(std::memory_order_acquire);
+
+    if (head == tail) {
+        return 0;
+    } else if (head - tail > m_size) {
+        return -EPROTO;
+    }
+
+    // The peer is another process, take a copy of the record header so it cannot change after being checked.
+    // Our tail is always 16 byte aligned so the header fits before the end of the ring
+    uint32_t offset = tail & (m_size - 1);
+    Record record;
+    memcpy(&record, m_data + offset, sizeof(Record));
+    if (record.flags & RecordWrap) {
+        tail += m_size - offset;
+        offset = 0;
+
+        if (head == tail || head - tail > m_size) {
+            return -EPROTO;
+        }
+
+        memcpy(&record, m_data, sizeof(Record));
+    }
+
+    uint32_t length = RecordLength(record.size);
+    if (record.size > m_size || length > m_size - offset || length > head - tail) {
+        return -EPROTO;
+    }
+
+    id = record.id;
+    size = (record.size > maxSize) ? maxSize : record.size;
+
+    if (size) {
+        memcpy(data, m_data + offset + sizeof(Record), size);
+    }
+
+    m_tail = tail + length;
+    m_header->tail.store(m_tail, std::memory_order_release);
+    return 1;
+}
+
+bool MessageRing::Arm() {
+    m_header->consumerWaiting.store(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (!Empty()) {
+        m_header->consumerWaiting.store(0, std::memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
+
+RingChannel::RingChannel(handle_t endpoint, int64_t key, uint8_t* base, uint32_t ringSize, uint16_t msgSize,
+                         bool creator)
+    : m_endpoint(endpoint), m_key(key), m_base(base), m_msgSize(msgSize), m_creator(creator) {
+    // The creator sends on the first ring and receives on the second
+    MessageRing first(reinterpret_cast<MessageRing::Header*>(base), base + ringHeaderAreaSize, ringSize);
+    MessageRing second(reinterpret_cast<MessageRing::Header*>(base + ringHeaderStride),
+                       base + ringHeaderAreaSize + ringSize, ringSize);
+
+    m_tx = creator ? first : second;
+    m_rx = creator ? second : first;
+}
+
+RingChannel::~RingChannel() {
+    UnmapSharedMemory(m_base, m_key);
+
+    // The key lives until the peer has unmapped it too
+    if (m_creator) {
+        DestroySharedMemory(m_key);
+    }
+}
+
+uint32_t RingChannel::RingSize(uint16_t msgSize) {
+    uint32_t needed = ((sizeof(uint64_t) * 2 + msgSize + 15) & ~15U) * ringMinimumMessages;
+
+    uint32_t size = ringMinimumSize;
+    while (size < needed) {
+        size <<= 1;
+    }
+
+    return size;
+}
+
+std::shared_ptr<RingChannel> RingChannel::Create(handle_t endpoint, uint16_t msgSize) {
+    uint32_t ringSize = RingSize(msgSize);
+
+    int64_t key = CreateSharedMemory(ringHeaderAreaSize + ringSize * 2, SMEM_FLAGS_SHARED);
+    if (key <= 0) {
+        return nullptr;
+    }
+
+    uint8_t* base = (uint8_t*)MapSharedMemory(key);
+    if (!base) {
+        DestroySharedMemory(key);
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < 2; i++) {
+        MessageRing::Header* header = reinterpret_cast<MessageRing::Header*>(base + ringHeaderStride * i);
+        header->head.store(0, std::memory_order_relaxed);
+        header->tail.store(0, std::memory_order_relaxed);
+        header->consumerWaiting.store(0, std::memory_order_relaxed);
+        header->size = ringSize;
+    }
+
+    std::shared_ptr<RingChannel> channel(new RingChannel(endpoint, key, base, ringSize, msgSize, true));
+
+    // Everything we send after this goes through the rings
+    if (EndpointQueue(endpoint, MessageRingSetup, sizeof(int64_t), reinterpret_cast<uintptr_t>(&key)) < 0) {
+        return nullptr; // The channel unmaps and destroys the shared memory
+    }
+
+    std::scoped_lock lock(channelsLock);
+    channels[endpoint] = channel;
+    return channel;
+}
+
+std::shared_ptr<RingChannel> RingChannel::Accept(handle_t endpoint, int64_t key, uint16_t msgSize) {
+    uint8_t* base = (uint8_t*)MapSharedMemory(key);
+    if (!base) {
+        return nullptr;
+    }
+
+    // Make sure the peer gave us something sensible before using it,
+    // the size is read once and kept by the rings as the peer could change it afterwards
+    uint32_t ringSize = reinterpret_cast<volatile MessageRing::Header*>(base)->size;
+    uint32_t otherRingSize = reinterpret_cast<volatile MessageRing::Header*>(base + ringHeaderStride)->size;
+    if (ringSize != otherRingSize || ringSize < RingSize(msgSize) || (ringSize & (ringSize - 1))) {
+        UnmapSharedMemory(base, key);
+        return nullptr;
+    }
+
+    std::shared_ptr<RingChannel> channel(new RingChannel(endpoint, key, base, ringSize, msgSize, false));
+
+    std::scoped_lock lock(channelsLock);
+    channels[endpoint] = channel;
+    return channel;
+}
+
+std::shared_ptr<RingChannel> RingChannel::Find(handle_t endpoint) {
+    std::scoped_lock lock(channelsLock);
+
+    auto it = channels.find(endpoint);
+    if (it == channels.end()) {
+        return nullptr;
+    }
+
+    return it->second;
+}
+
+void RingChannel::Remove(handle_t endpoint) {
+    std::scoped_lock lock(channelsLock);
+    channels.erase(endpoint);
+}
+
+long RingChannel::Queue(uint64_t id, const uint8_t* data, uint16_t size) {
+    if (size > m_msgSize) {
+        return -EINVAL;
+    }
+
+    std::scoped_lock lock(m_txLock);
+
+    int spins = 0;
+    int ret;
+    while (!(ret = m_tx.Push(id, data, size))) {
+        // The ring is full, make sure the peer is awake and let it catch up.
+        // Queueing on the endpoint also tells us if the peer has gone away
+        if (!(spins++ % ringFullDoorbellInterval)) {
+            if (long ret = EndpointQueue(m_endpoint, MessageRingDoorbell, 0, 0); ret < 0) {
+                return ret;
+            }
+        }
+
+        sched_yield();
+    }
+
+    if (ret < 0) {
+        return ret;
+    }
+
+    // Only pay for a syscall when the peer is asleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_tx.TakeConsumerWaiting()) {
+        return EndpointQueue(m_endpoint, MessageRingDoorbell, 0, 0);
+    }
+
+    return 0;
+}
+
+long RingChannel::Poll(uint64_t& id, uint16_t& size, uint8_t* data) {
+    std::scoped_lock lock(m_rxLock);
+
+    if (int ret = m_rx.Pop(id, size, data, m_msgSize); ret) {
+        return ret;
+    }
+
+    if (m_rx.Arm()) {
+        return 0; // Still empty, the peer will ring the doorbell
+    }
+
+    return m_rx.Pop(id, size, data, m_msgSize);
+}
+} // namespace Lemon
@@ -1,8 +1,10 @@
 #include <Lemon/System/Util.h>
+#include <Lemon/System/ABI/VDSO.h>
 #include <lemon/syscall.h>
 
 #include <errno.h>
 #include <stdint.h>
+#include <sys/auxv.h>
 #include <sys/types.h>
 
 extern char** environ;
@@ -27,9 +29,38 @@ pid_t lemon_spawn(const char* path, int argc, const char* const argv[], int flag
     return ret;
 }
 
+namespace {
+using VDSOClockGetTime = int (*)(clockid_t, timespec*);
+
+// The kernel passes the address of the vDSO header in the auxiliary vector
+VDSOClockGetTime FindVDSOClockGetTime() {
+    auto* header = reinterpret_cast<const lemon_vdso_header_t*>(getauxval(AT_LEMON_VDSO));
+    if (!header || header->magic != LEMON_VDSO_MAGIC || header->version < LEMON_VDSO_VERSION) {
+        return nullptr;
+    }
+
+    return reinterpret_cast<VDSOClockGetTime>(reinterpret_cast<uintptr_t>(header) + header->clockGetTime);
+}
+} // namespace
+
 namespace Lemon {
 void Yield() { syscall(SYS_YIELD); }
 
+int ClockGetTime(clockid_t clock, timespec* t) {
+    static VDSOClockGetTime vdsoClockGetTime = FindVDSOClockGetTime();
+    if (!vdsoClockGetTime) {
+        return clock_gettime(clock, t);
+    }
+
+    // Returns a negative error code like the system call
+    if (int e = vdsoClockGetTime(clock, t); e < 0) {
+        errno = -e;
+        return -1;
+    }
+
+    return 0;
+}
+
 long InterruptThread(pid_t tid) {
     if (long e = syscall(SYS_INTERRUPT_THREAD, tid); e < 0) {
         errno = e;
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <iomanip>
 #include <sstream>
 
 SHA256::SHA256() { memcpy(hash, initialHash, SHA256_HASH_SIZE); }
@@ -85,7 +86,7 @@ void SHA256::Update(const void* _data, size_t count) {
 std::string SHA256::GetHash() {
     std::stringstream stream;
     for (int i = 0; i < 8; i++) {
-        stream << std::hex << hash[i];
+        stream << std::hex << std::setw(8) << std::setfill('0') << hash[i];
     }
     return stream.str();
 }
@@ -29,5 +29,5 @@ cd "$LEMOND/Services"
 
 "$LIC" lemon.lemond.li "$INCLUDEDIR/lemon.lemond.h"
 "$LIC" lemon.networkgovernor.li "$INCLUDEDIR/lemon.networkgovernor.h"
-"$LIC" lemon.lemonwm.li "$INCLUDEDIR/lemon.lemonwm.h"
+"$LIC" -t ring lemon.lemonwm.li "$INCLUDEDIR/lemon.lemonwm.h"
 "$LIC" lemon.shell.li "$INCLUDEDIR/lemon.shell.h"
@@ -1,6 +1,7 @@
 #include "WM.h"
 
 #include <Lemon/GUI/Colours.h>
+#include <Lemon/System/Util.h>
 
 static unsigned int fCount = 0;
 static unsigned int avgFrametime = 0;
@@ -12,7 +13,7 @@ rgba_colour_t backgroundColor = {64, 128, 128, 255};
 
 CompositorInstance::CompositorInstance(WMInstance* wm){
     this->wm = wm;
-    clock_gettime(CLOCK_BOOTTIME, &lastRender);
+    Lemon::ClockGetTime(CLOCK_BOOTTIME, &lastRender);
 }
 
 void CompositorInstance::RecalculateClipping(){
@@ -53,7 +54,7 @@ void CompositorInstance::RecalculateClipping(){
 void CompositorInstance::Paint(){
     if(displayFramerate){
         timespec cTime;
-        clock_gettime(CLOCK_BOOTTIME, &cTime);
+        Lemon::ClockGetTime(CLOCK_BOOTTIME, &cTime);
 
         unsigned int renderTime = (cTime - lastRender);
 
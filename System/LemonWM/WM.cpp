@@ -3,6 +3,7 @@
 #include <Lemon/Core/Keyboard.h>
 #include <Lemon/Core/SharedMemory.h>
 #include <Lemon/Core/Shell.h>
+#include <Lemon/System/Util.h>
 
 #include <algorithm>
 #include <pthread.h>
@@ -660,7 +661,7 @@ void WMInstance::KeyUpdate(int key, bool pressed) {
 }
 
 void WMInstance::Update() {
-    clock_gettime(CLOCK_BOOTTIME, &startTime);
+    Lemon::ClockGetTime(CLOCK_BOOTTIME, &startTime);
 
     input.Poll(); // Poll input devices
 
@@ -669,7 +670,7 @@ void WMInstance::Update() {
     compositor.Paint(); // Render the frame
 
     if (targetFrameDelay) {
-        clock_gettime(CLOCK_BOOTTIME, &endTime);
+        Lemon::ClockGetTime(CLOCK_BOOTTIME, &endTime);
         long diff = (endTime - startTime) / 1000;
         if (diff < frameDelayThreshold) {
             usleep(targetFrameDelay - diff);
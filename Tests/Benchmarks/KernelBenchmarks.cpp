@@ -0,0 +1,173 @@
+#include <benchmark/benchmark.h>
+
+#include <Hash.h>
+#include <List.h>
+#include <RefPtr.h>
+#include <RingBuffer.h>
+#include <String.h>
+#include <StringView.h>
+#include <Vector.h>
+
+static void VectorAddBack(benchmark::State& state) {
+    for (auto _ : state) {
+        Vector<uint64_t> v;
+        for (int64_t i = 0; i < state.range(0); i++) {
+            v.add_back(i);
+        }
+        benchmark::DoNotOptimize(v.Data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(VectorAddBack)->Range(8, 8 << 10);
+
+static void VectorErase(benchmark::State& state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        Vector<uint64_t> v;
+        for (int64_t i = 0; i < state.range(0); i++) {
+            v.add_back(i);
+        }
+        state.ResumeTiming();
+
+        while (v.size()) {
+            v.erase(0);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(VectorErase)->Range(8, 1 << 10);
+
+// add_back and remove_at(0) recycle nodes through the list's node cache
+static void ListQueue(benchmark::State& state) {
+    List<uint64_t> l;
+    for (auto _ : state) {
+        for (int i = 0; i < 4; i++) {
+            l.add_back(i);
+        }
+        for (int i = 0; i < 4; i++) {
+            benchmark::DoNotOptimize(l.remove_at(0));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 4);
+}
+BENCHMARK(ListQueue);
+
+static void ListGetAt(benchmark::State& state) {
+    List<uint64_t> l;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        l.add_back(i);
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(l.get_at(state.range(0) - 1));
+    }
+}
+BENCHMARK(ListGetAt)->Range(8, 1 << 10);
+
+static void HashMapInsert(benchmark::State& state) {
+    for (auto _ : state) {
+        HashMap<unsigned long, unsigned long> map;
+        for (int64_t i = 0; i < state.range(0); i++) {
+            map.insert(i * 4096, i); // Page aligned keys, as used for address lookups
+        }
+        benchmark::DoNotOptimize(map.get_length());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(HashMapInsert)->Range(8, 64 << 10);
+
+static void HashMapLookup(benchmark::State& state) {
+    HashMap<unsigned long, unsigned long> map;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        map.insert(i * 4096, i);
+    }
+
+    unsigned long key = 0;
+    unsigned long value;
+    for (auto _ : state) {
+        // Every other lookup misses
+        benchmark::DoNotOptimize(map.get(key * 2048, value));
+        key = (key + 1) % (state.range(0) * 2);
+    }
+}
+BENCHMARK(HashMapLookup)->Range(8, 64 << 10);
+
+static void HashMapStringView(benchmark::State& state) {
+    const char* names[] = {"bin", "lib", "etc", "system", "dev", "tmp", "usr", "home"};
+
+    HashMap<StringView, int> map;
+    for (int i = 0; i < 8; i++) {
+        map.insert(names[i], i);
+    }
+
+    int i = 0;
+    int value;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(map.get(names[i++ & 7], value));
+    }
+}
+BENCHMARK(HashMapStringView);
+
+static void HashBytesThroughput(benchmark::State& state) {
+    std::vector<uint8_t> data(state.range(0), 0xAB);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(HashBytes(data.data(), data.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(HashBytesThroughput)->Range(8, 4096);
+
+static void RingBufferBytes(benchmark::State& state) {
+    RingBuffer<uint8_t> buffer(4096);
+    std::vector<uint8_t> in(state.range(0), 0xAB);
+    std::vector<uint8_t> out(state.range(0));
+
+    for (auto _ : state) {
+        buffer.Enqueue(in.data(), in.size());
+        benchmark::DoNotOptimize(buffer.Dequeue(out.data(), out.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(RingBufferBytes)->Range(16, 2048);
+
+static void RingBufferPointers(benchmark::State& state) {
+    RingBuffer<void*> buffer;
+    void* p;
+
+    for (auto _ : state) {
+        buffer.Enqueue(&p);
+        benchmark::DoNotOptimize(buffer.Dequeue(p));
+    }
+}
+BENCHMARK(RingBufferPointers);
+
+static void StringAppend(benchmark::State& state) {
+    for (auto _ : state) {
+        String s("/system");
+        for (int64_t i = 0; i < state.range(0); i++) {
+            s += "/lib";
+        }
+        benchmark::DoNotOptimize(s.Data());
+    }
+}
+BENCHMARK(StringAppend)->Range(1, 256);
+
+static void StringCopy(benchmark::State& state) {
+    String s("/system/lib/libc.so");
+    for (auto _ : state) {
+        String copy(s);
+        benchmark::DoNotOptimize(copy.Data());
+    }
+}
+BENCHMARK(StringCopy);
+
+static void RefPtrCopy(benchmark::State& state) {
+    FancyRefPtr<uint64_t> p(new uint64_t(1));
+    for (auto _ : state) {
+        FancyRefPtr<uint64_t> copy = p;
+        benchmark::DoNotOptimize(copy.get());
+    }
+}
+BENCHMARK(RefPtrCopy);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,134 @@
+#include <benchmark/benchmark.h>
+
+#include <Lemon/Core/JSON.h>
+#include <Lemon/Core/SHA.h>
+#include <Lemon/IPC/Message.h>
+
+#ifdef LEMON_HOST_GRAPHICS
+#include <Lemon/Graphics/Graphics.h>
+#endif
+
+#include <vector>
+
+// Roughly the shape of the system config files
+static std::string JSONDocument(int entries) {
+    std::string doc = "{\n";
+    for (int i = 0; i < entries; i++) {
+        doc += "    \"item" + std::to_string(i) + "\" : {\"name\" : \"Item " + std::to_string(i) +
+               "\", \"size\" : " + std::to_string(i * 37) + ", \"scale\" : 1.25, \"enabled\" : true, " +
+               "\"tags\" : [\"a\", \"b\", \"c\"]},\n";
+    }
+    doc += "    \"end\" : null\n}\n";
+
+    return doc;
+}
+
+// JSONValue does not own what it points to, free the tree so that memory use stays flat
+static void FreeJSON(Lemon::JSONValue& v) {
+    if (v.IsString()) {
+        delete v.str;
+    } else if (v.IsArray()) {
+        for (auto& item : *v.array) {
+            FreeJSON(item);
+        }
+        delete v.array;
+    } else if (v.IsObject()) {
+        for (auto& item : *v.object) {
+            FreeJSON(item.second);
+        }
+        delete v.object;
+    }
+}
+
+static void JSONParse(benchmark::State& state) {
+    std::string doc = JSONDocument(state.range(0));
+    for (auto _ : state) {
+        std::string_view sv(doc);
+        Lemon::JSONParser parser(sv);
+
+        Lemon::JSONValue root = parser.Parse();
+        benchmark::DoNotOptimize(root);
+
+        state.PauseTiming();
+        FreeJSON(root);
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * doc.length());
+}
+BENCHMARK(JSONParse)->Range(1, 256);
+
+static void SHA256Throughput(benchmark::State& state) {
+    std::vector<uint8_t> data(state.range(0), 0xAB);
+    for (auto _ : state) {
+        SHA256 sha;
+        sha.Update(data.data(), data.size());
+        benchmark::DoNotOptimize(sha.GetHash());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(SHA256Throughput)->Range(64, 1 << 20);
+
+static void MessageEncodeDecode(benchmark::State& state) {
+    std::string path = "/system/lib/libc.so";
+    for (auto _ : state) {
+        Lemon::Message m(1, static_cast<uint64_t>(1), path, static_cast<int32_t>(2));
+
+        uint64_t a;
+        std::string s;
+        int32_t b;
+        benchmark::DoNotOptimize(m.Decode(a, s, b));
+    }
+}
+BENCHMARK(MessageEncodeDecode);
+
+#ifdef LEMON_HOST_GRAPHICS
+namespace {
+struct BenchSurface {
+    surface_t surface;
+    std::vector<uint32_t> pixels;
+
+    BenchSurface(int width, int height) : pixels(width * height) {
+        surface.width = width;
+        surface.height = height;
+        surface.buffer = reinterpret_cast<uint8_t*>(pixels.data());
+    }
+};
+} // namespace
+
+// A square of range(0) pixels
+static void GraphicsDrawRect(benchmark::State& state) {
+    BenchSurface s(1024, 768);
+    for (auto _ : state) {
+        Lemon::Graphics::DrawRect(10, 10, state.range(0), state.range(0), 0x20, 0x40, 0x80, &s.surface);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * state.range(0) * 4);
+}
+BENCHMARK(GraphicsDrawRect)->RangeMultiplier(4)->Range(16, 512);
+
+// Whole window onto the screen, as the window server does
+static void GraphicsSurfaceCopy(benchmark::State& state) {
+    BenchSurface screen(1024, 768);
+    BenchSurface window(state.range(0), state.range(0) * 3 / 4);
+    for (auto _ : state) {
+        Lemon::Graphics::surfacecpy(&screen.surface, &window.surface, {1, 1});
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * window.pixels.size() * 4);
+}
+BENCHMARK(GraphicsSurfaceCopy)->RangeMultiplier(4)->Range(16, 1000);
+
+// Damaged region of a window
+static void GraphicsSurfaceCopyRegion(benchmark::State& state) {
+    BenchSurface screen(1024, 768);
+    BenchSurface window(800, 600);
+    for (auto _ : state) {
+        Lemon::Graphics::surfacecpy(&screen.surface, &window.surface, {100, 100}, {50, 50, 200, 100});
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * 200 * 100 * 4);
+}
+BENCHMARK(GraphicsSurfaceCopyRegion);
+#endif
+
+BENCHMARK_MAIN();
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+
+#include <Stream.h>
+#include <UserMemory.h>
+
+#include <vector>
+
+static std::vector<uint8_t> Pattern(size_t size, uint8_t seed) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = static_cast<uint8_t>(seed + i * 7);
+    }
+
+    return data;
+}
+
+TEST(DataStream, ReadWrite) {
+    DataStream stream(4 * PAGE_SIZE_4K);
+    std::vector<uint8_t> data = Pattern(10000, 1);
+
+    ASSERT_EQ(stream.Write(data.data(), data.size()), 10000);
+    EXPECT_EQ(stream.Pos(), 10000);
+
+    std::vector<uint8_t> out(data.size());
+    ASSERT_EQ(stream.Peek(out.data(), out.size()), 10000);
+    EXPECT_EQ(out, data);
+
+    std::fill(out.begin(), out.end(), 0);
+    ASSERT_EQ(stream.Read(out.data(), out.size()), 10000);
+    EXPECT_EQ(out, data);
+    EXPECT_TRUE(stream.Empty());
+}
+
+TEST(DataStream, WriteLimitedToSpace) {
+    DataStream stream(2 * PAGE_SIZE_4K);
+    std::vector<uint8_t> data = Pattern(3 * PAGE_SIZE_4K, 2);
+
+    EXPECT_EQ(stream.Write(data.data(), data.size()), 2 * PAGE_SIZE_4K);
+    EXPECT_EQ(stream.Space(), 0);
+    EXPECT_EQ(stream.Write(data.data(), 1), 0);
+}
+
+// Fill the ring starting part way into a page so the newest bytes share the first page with the oldest
+TEST(DataStream, FullRingWrapsIntoReadPage) {
+    const size_t capacity = 4 * PAGE_SIZE_4K;
+    DataStream stream(capacity);
+
+    std::vector<uint8_t> skip(100);
+    ASSERT_EQ(stream.Write(skip.data(), skip.size()), 100);
+    ASSERT_EQ(stream.Read(skip.data(), skip.size()), 100);
+
+    std::vector<uint8_t> data = Pattern(capacity, 3);
+    ASSERT_EQ(stream.Write(data.data(), data.size()), static_cast<int64_t>(capacity));
+    EXPECT_EQ(stream.Space(), 0);
+
+    std::vector<uint8_t> out(capacity);
+    ASSERT_EQ(stream.Read(out.data(), out.size()), static_cast<int64_t>(capacity));
+    EXPECT_EQ(out, data);
+    EXPECT_TRUE(stream.Empty());
+}
+
+// Read the wrapped ring in pieces that end on page boundaries
+TEST(DataStream, WrappedRingPartialReads) {
+    const size_t capacity = 4 * PAGE_SIZE_4K;
+    DataStream stream(capacity);
+
+    std::vector<uint8_t> skip(100);
+    ASSERT_EQ(stream.Write(skip.data(), skip.size()), 100);
+    ASSERT_EQ(stream.Read(skip.data(), skip.size()), 100);
+
+    std::vector<uint8_t> data = Pattern(capacity, 4);
+    ASSERT_EQ(stream.Write(data.data(), data.size()), static_cast<int64_t>(capacity));
+
+    std::vector<uint8_t> out;
+    size_t first = PAGE_SIZE_4K - 100; // Up to the end of the first page
+    out.resize(first);
+    ASSERT_EQ(stream.Read(out.data(), first), static_cast<int64_t>(first));
+
+    // Space has been freed, writing now reuses the first page again
+    std::vector<uint8_t> more = Pattern(first, 5);
+    ASSERT_EQ(stream.Write(more.data(), more.size()), static_cast<int64_t>(first));
+
+    std::vector<uint8_t> rest(capacity);
+    ASSERT_EQ(stream.Read(rest.data(), rest.size()), static_cast<int64_t>(capacity));
+
+    std::vector<uint8_t> expected(data.begin() + first, data.end());
+    expected.insert(expected.end(), more.begin(), more.end());
+    EXPECT_EQ(rest, expected);
+}
+
+// Keep the ring nearly full whilst streaming through it many times
+TEST(DataStream, Streaming) {
+    const size_t capacity = 3 * PAGE_SIZE_4K;
+    DataStream stream(capacity);
+
+    std::vector<uint8_t> data = Pattern(capacity * 20, 6);
+    size_t written = 0;
+    size_t read = 0;
+    std::vector<uint8_t> out(data.size());
+
+    while (read < data.size()) {
+        size_t space = std::min<size_t>(stream.Space(), data.size() - written);
+        written += stream.Write(data.data() + written, std::min<size_t>(space, 5000));
+
+        int64_t ret = stream.Read(out.data() + read, 3001);
+        ASSERT_GE(ret, 0);
+        read += ret;
+    }
+
+    EXPECT_EQ(out, data);
+}
+
+// Data that could not be copied to user memory stays in the stream
+TEST(DataStream, ReadUserStopsAtFault) {
+    DataStream stream(4 * PAGE_SIZE_4K);
+    std::vector<uint8_t> data = Pattern(3 * PAGE_SIZE_4K, 7);
+    ASSERT_EQ(stream.Write(data.data(), data.size()), static_cast<int64_t>(data.size()));
+
+    std::vector<uint8_t> out(data.size());
+    userFaultBase = reinterpret_cast<uintptr_t>(out.data()) + PAGE_SIZE_4K + 10;
+    userFaultSize = 1;
+
+    // Only the first page can be copied, the second crosses the faulting byte
+    EXPECT_EQ(stream.ReadUser(out.data(), out.size()), static_cast<int64_t>(PAGE_SIZE_4K));
+    EXPECT_EQ(stream.Pos(), static_cast<int64_t>(2 * PAGE_SIZE_4K));
+    EXPECT_EQ(stream.ReadUser(out.data() + PAGE_SIZE_4K, out.size()), -EFAULT);
+    EXPECT_EQ(stream.PeekUser(out.data() + PAGE_SIZE_4K, out.size()), -EFAULT);
+
+    userFaultSize = 0;
+
+    ASSERT_EQ(stream.ReadUser(out.data() + PAGE_SIZE_4K, out.size()), static_cast<int64_t>(2 * PAGE_SIZE_4K));
+    EXPECT_EQ(out, data);
+    EXPECT_TRUE(stream.Empty());
+}
+
+TEST(DataStream, WriteUserStopsAtFault) {
+    DataStream stream(4 * PAGE_SIZE_4K);
+    std::vector<uint8_t> data = Pattern(3 * PAGE_SIZE_4K, 8);
+
+    userFaultBase = reinterpret_cast<uintptr_t>(data.data()) + 2 * PAGE_SIZE_4K;
+    userFaultSize = 1;
+
+    EXPECT_EQ(stream.WriteUser(data.data() + 2 * PAGE_SIZE_4K, PAGE_SIZE_4K), -EFAULT);
+    EXPECT_TRUE(stream.Empty());
+
+    EXPECT_EQ(stream.WriteUser(data.data(), data.size()), static_cast<int64_t>(2 * PAGE_SIZE_4K));
+
+    userFaultSize = 0;
+
+    std::vector<uint8_t> out(2 * PAGE_SIZE_4K);
+    ASSERT_EQ(stream.ReadUser(out.data(), out.size() + 1), static_cast<int64_t>(out.size()));
+    EXPECT_EQ(out, std::vector<uint8_t>(data.begin(), data.begin() + 2 * PAGE_SIZE_4K));
+}
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <Hash.h>
+#include <StringView.h>
+
+TEST(HashMap, InsertAndGet) {
+    HashMap<unsigned long, int> map;
+    for (unsigned long i = 0; i < 10000; i++) {
+        map.insert(i * 7919, static_cast<int>(i));
+    }
+
+    ASSERT_EQ(map.get_length(), 10000U);
+    for (unsigned long i = 0; i < 10000; i++) {
+        int value = -1;
+        ASSERT_TRUE(map.get(i * 7919, value));
+        EXPECT_EQ(value, static_cast<int>(i));
+    }
+
+    int value;
+    EXPECT_FALSE(map.get(1, value));
+    EXPECT_FALSE(map.find(7919 * 10000));
+}
+
+TEST(HashMap, Replace) {
+    HashMap<unsigned, int> map;
+    map.insert(5, 1);
+    map.insert(5, 2);
+
+    int value = 0;
+    EXPECT_EQ(map.get_length(), 1U);
+    EXPECT_TRUE(map.get(5, value));
+    EXPECT_EQ(value, 2);
+}
+
+TEST(HashMap, Remove) {
+    HashMap<unsigned, int> map;
+    for (unsigned i = 0; i < 1000; i++) {
+        map.insert(i, i);
+    }
+
+    // Removing shifts entries back, check every key is still found afterwards
+    for (unsigned i = 0; i < 1000; i += 2) {
+        EXPECT_EQ(map.remove(i), static_cast<int>(i));
+    }
+    EXPECT_EQ(map.remove(2000), 0);
+
+    ASSERT_EQ(map.get_length(), 500U);
+    for (unsigned i = 0; i < 1000; i++) {
+        EXPECT_EQ(map.find(i), static_cast<int>(i & 1));
+    }
+
+    map.removeValue(999);
+    EXPECT_FALSE(map.find(999));
+    EXPECT_EQ(map.get_length(), 499U);
+}
+
+TEST(HashMap, Iterate) {
+    HashMap<unsigned, unsigned> map(100);
+    unsigned expectedSum = 0;
+    for (unsigned i = 0; i < 100; i++) {
+        map.insert(i, i);
+        expectedSum += i;
+    }
+
+    unsigned count = 0;
+    unsigned sum = 0;
+    for (unsigned value : map) {
+        count++;
+        sum += value;
+    }
+
+    EXPECT_EQ(count, 100U);
+    EXPECT_EQ(sum, expectedSum);
+}
+
+TEST(HashMap, Move) {
+    HashMap<unsigned, int> map;
+    map.insert(1, 1);
+    map.insert(2, 2);
+
+    HashMap<unsigned, int> other(std::move(map));
+    EXPECT_EQ(map.get_length(), 0U);
+    EXPECT_FALSE(map.find(1));
+    EXPECT_EQ(other.get_length(), 2U);
+    EXPECT_TRUE(other.find(2));
+}
+
+TEST(HashMap, StringViewKeys) {
+    HashMap<StringView, int> map;
+    map.insert("bin", 1);
+    map.insert("lib", 2);
+    map.insert("system", 3);
+
+    int value = 0;
+    EXPECT_TRUE(map.get("lib", value));
+    EXPECT_EQ(value, 2);
+    EXPECT_FALSE(map.find("usr"));
+}
+
+TEST(StripedHashMap, InsertAndRemove) {
+    StripedHashMap<unsigned long, int> map;
+    for (unsigned long i = 0; i < 1000; i++) {
+        map.insert(i, static_cast<int>(i));
+    }
+    EXPECT_EQ(map.get_length(), 1000U);
+
+    for (unsigned long i = 0; i < 1000; i += 3) {
+        EXPECT_EQ(map.remove(i), static_cast<int>(i));
+    }
+
+    for (unsigned long i = 0; i < 1000; i++) {
+        EXPECT_EQ(map.find(i), static_cast<int>(i % 3 != 0));
+    }
+}
+
+TEST(Hash, HashBytes) {
+    const char data[] = "the quick brown fox jumps over the lazy dog";
+
+    EXPECT_EQ(HashBytes(data, sizeof(data)), HashBytes(data, sizeof(data)));
+    EXPECT_NE(HashBytes(data, sizeof(data)), HashBytes(data, sizeof(data) - 1));
+    EXPECT_NE(HashBytes(data, sizeof(data), 0), HashBytes(data, sizeof(data), 1));
+}
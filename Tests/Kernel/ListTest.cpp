@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+
+#include <List.h>
+
+#include "LiveObject.h"
+
+TEST(List, AddAndGet) {
+    List<int> l;
+    for (int i = 0; i < 100; i++) {
+        l.add_back(i);
+    }
+    l.add_front(-1);
+
+    ASSERT_EQ(l.get_length(), 101U);
+    EXPECT_EQ(l.get_front(), -1);
+    EXPECT_EQ(l.get_back(), 99);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(l[i + 1], i);
+    }
+}
+
+TEST(List, Iterate) {
+    List<int> l;
+    for (int i = 0; i < 100; i++) {
+        l.add_back(i);
+    }
+
+    int expected = 0;
+    for (int value : l) {
+        EXPECT_EQ(value, expected++);
+    }
+    EXPECT_EQ(expected, 100);
+}
+
+TEST(List, RemoveAt) {
+    List<int> l;
+    for (int i = 0; i < 5; i++) {
+        l.add_back(i);
+    }
+
+    EXPECT_EQ(l.remove_at(0), 0);
+    EXPECT_EQ(l.remove_at(3), 4);
+    EXPECT_EQ(l.remove_at(1), 2);
+
+    ASSERT_EQ(l.get_length(), 2U);
+    EXPECT_EQ(l.get_front(), 1);
+    EXPECT_EQ(l.get_back(), 3);
+
+    l.remove_at(0);
+    l.remove_at(0);
+    EXPECT_EQ(l.get_length(), 0U);
+    EXPECT_EQ(l.begin(), l.end());
+}
+
+TEST(List, RemoveValue) {
+    List<int> l;
+    for (int i = 0; i < 5; i++) {
+        l.add_back(i);
+    }
+
+    l.remove(2);
+    l.remove(42); // Not present, nothing should be removed
+
+    ASSERT_EQ(l.get_length(), 4U);
+    const int expected[] = {0, 1, 3, 4};
+    for (unsigned i = 0; i < 4; i++) {
+        EXPECT_EQ(l[i], expected[i]);
+    }
+}
+
+TEST(List, InsertBeforeIterator) {
+    List<int> l;
+    l.add_back(1);
+    l.add_back(3);
+
+    auto it = l.begin();
+    it++;
+    l.insert(2, it);
+
+    it = l.begin();
+    l.insert(0, it);
+
+    ASSERT_EQ(l.get_length(), 4U);
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(l[i], i);
+    }
+}
+
+TEST(List, Move) {
+    List<int> l;
+    for (int i = 0; i < 10; i++) {
+        l.add_back(i);
+    }
+
+    List<int> other;
+    other = std::move(l);
+
+    EXPECT_EQ(l.get_length(), 0U);
+    ASSERT_EQ(other.get_length(), 10U);
+    EXPECT_EQ(other.get_back(), 9);
+}
+
+TEST(List, ObjectLifetimes) {
+    LiveObject::live = 0;
+    {
+        List<LiveObject> l;
+        for (int i = 0; i < 20; i++) {
+            l.add_back(LiveObject(i));
+        }
+        EXPECT_EQ(LiveObject::live, 20);
+
+        l.remove_at(5);
+        EXPECT_EQ(LiveObject::live, 19);
+
+        l.clear();
+        EXPECT_EQ(LiveObject::live, 0);
+
+        l.add_back(LiveObject(1));
+    }
+    EXPECT_EQ(LiveObject::live, 0);
+}
+
+namespace {
+struct Node {
+    Node* next = nullptr;
+    Node* prev = nullptr;
+    int value;
+};
+} // namespace
+
+TEST(FastList, AddAndRemove) {
+    Node nodes[8];
+    FastList<Node*> l;
+
+    for (int i = 0; i < 8; i++) {
+        nodes[i].value = i;
+        l.add_back(&nodes[i]);
+    }
+
+    ASSERT_EQ(l.get_length(), 8U);
+    EXPECT_EQ(l.get_front(), &nodes[0]);
+    EXPECT_EQ(l.get_back(), &nodes[7]);
+    EXPECT_EQ(l.get_at(3), &nodes[3]);
+
+    l.remove(&nodes[0]);
+    l.remove(&nodes[7]);
+    l.remove(&nodes[4]);
+    EXPECT_EQ(l.remove_at(0), &nodes[1]);
+
+    ASSERT_EQ(l.get_length(), 4U);
+
+    const int expected[] = {2, 3, 5, 6};
+    int i = 0;
+    for (Node* n = l.get_front(); n; n = l.next(n)) {
+        ASSERT_LT(i, 4);
+        EXPECT_EQ(n->value, expected[i++]);
+    }
+    EXPECT_EQ(i, 4);
+
+    l.add_front(&nodes[0]);
+    EXPECT_EQ(l.get_front(), &nodes[0]);
+    EXPECT_EQ(l.get_back(), &nodes[6]);
+
+    while (l.get_length()) {
+        l.remove(l.get_front());
+    }
+    EXPECT_EQ(l.get_front(), nullptr);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// Counts constructions and destructions so tests can check that containers manage object lifetimes
+struct LiveObject {
+    static inline int live = 0;
+
+    int value;
+
+    LiveObject() : value(0) { live++; }
+    LiveObject(int v) : value(v) { live++; }
+    LiveObject(const LiveObject& other) : value(other.value) { live++; }
+    LiveObject(LiveObject&& other) : value(other.value) { live++; }
+    ~LiveObject() { live--; }
+
+    LiveObject& operator=(const LiveObject& other) = default;
+    LiveObject& operator=(LiveObject&& other) = default;
+
+    bool operator==(const LiveObject& other) const { return value == other.value; }
+};
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include <RefPtr.h>
+
+namespace {
+struct Base {
+    static inline int live = 0;
+
+    Base() { live++; }
+    virtual ~Base() { live--; }
+};
+
+struct Derived : public Base {
+    int value = 42;
+};
+} // namespace
+
+TEST(FancyRefPtr, References) {
+    Base::live = 0;
+    {
+        FancyRefPtr<Base> a(new Base());
+        EXPECT_EQ(*a.GetRefCount(), 1U);
+
+        FancyRefPtr<Base> b = a;
+        EXPECT_EQ(*a.GetRefCount(), 2U);
+        EXPECT_EQ(a.get(), b.get());
+
+        FancyRefPtr<Base> c(std::move(b));
+        EXPECT_EQ(b.get(), nullptr);
+        EXPECT_EQ(*a.GetRefCount(), 2U);
+
+        c = nullptr;
+        EXPECT_EQ(*a.GetRefCount(), 1U);
+        EXPECT_EQ(Base::live, 1);
+    }
+    EXPECT_EQ(Base::live, 0);
+}
+
+TEST(FancyRefPtr, Assign) {
+    Base::live = 0;
+
+    FancyRefPtr<Base> a(new Base());
+    FancyRefPtr<Base> b(new Base());
+    EXPECT_EQ(Base::live, 2);
+
+    b = a; // The object held by b goes away
+    EXPECT_EQ(Base::live, 1);
+    EXPECT_EQ(*a.GetRefCount(), 2U);
+
+    a = nullptr;
+    b = nullptr;
+    EXPECT_EQ(Base::live, 0);
+}
+
+TEST(FancyRefPtr, Cast) {
+    Base::live = 0;
+    {
+        FancyRefPtr<Derived> derived(new Derived());
+        FancyRefPtr<Base> base = static_pointer_cast<Base>(derived);
+
+        EXPECT_EQ(derived.GetRefCount(), base.GetRefCount());
+        EXPECT_EQ(*base.GetRefCount(), 2U);
+
+        derived = nullptr;
+        EXPECT_EQ(Base::live, 1);
+        EXPECT_EQ(*base.GetRefCount(), 1U);
+    }
+    EXPECT_EQ(Base::live, 0);
+}
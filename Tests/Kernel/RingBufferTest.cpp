@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <RingBuffer.h>
+
+TEST(RingBuffer, SingleElements) {
+    RingBuffer<int> buffer;
+    EXPECT_TRUE(buffer.Empty());
+
+    // Enough to grow the buffer a few times
+    for (int i = 0; i < 1000; i++) {
+        buffer.Enqueue(i);
+    }
+    EXPECT_EQ(buffer.Count(), 1000U);
+
+    int value;
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_TRUE(buffer.Dequeue(value));
+        EXPECT_EQ(value, i);
+    }
+
+    EXPECT_TRUE(buffer.Empty());
+    EXPECT_FALSE(buffer.Dequeue(value));
+}
+
+// Grow the buffer whilst the data wraps around the end
+TEST(RingBuffer, GrowWhilstWrapped) {
+    RingBuffer<int> buffer(16);
+
+    int next = 0;
+    int expected = 0;
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 13; i++) {
+            buffer.Enqueue(next++);
+        }
+
+        int value;
+        for (int i = 0; i < 10; i++) {
+            ASSERT_TRUE(buffer.Dequeue(value));
+            ASSERT_EQ(value, expected++);
+        }
+    }
+
+    int value;
+    while (buffer.Dequeue(value)) {
+        ASSERT_EQ(value, expected++);
+    }
+    EXPECT_EQ(expected, next);
+}
+
+TEST(RingBuffer, Bulk) {
+    RingBuffer<uint8_t> buffer(64);
+
+    uint8_t in[256];
+    uint8_t out[256];
+    for (int i = 0; i < 256; i++) {
+        in[i] = static_cast<uint8_t>(i);
+    }
+
+    // Exactly fill the buffer
+    buffer.Enqueue(in, 64);
+    EXPECT_FALSE(buffer.Empty());
+    EXPECT_EQ(buffer.Count(), 64U);
+
+    ASSERT_EQ(buffer.Dequeue(out, 256), 64);
+    EXPECT_EQ(memcmp(in, out, 64), 0);
+    EXPECT_TRUE(buffer.Empty());
+
+    // Then make the contents wrap around, and grow it whilst wrapped
+    uint8_t next = 0;
+    uint8_t expected = 0;
+    for (int round = 0; round < 64; round++) {
+        uint8_t chunk[37];
+        for (auto& c : chunk) {
+            c = next++;
+        }
+        buffer.Enqueue(chunk, sizeof(chunk));
+
+        int ret = buffer.Dequeue(out, 29);
+        ASSERT_EQ(ret, 29);
+        for (int i = 0; i < ret; i++) {
+            ASSERT_EQ(out[i], expected++);
+        }
+    }
+
+    EXPECT_EQ(buffer.Count(), 64U * 8);
+    while (int ret = buffer.Dequeue(out, sizeof(out))) {
+        for (int i = 0; i < ret; i++) {
+            ASSERT_EQ(out[i], expected++);
+        }
+    }
+    EXPECT_EQ(expected, next);
+}
+
+TEST(RingBuffer, Drain) {
+    RingBuffer<uint8_t> buffer(32);
+
+    uint8_t data[24];
+    for (int i = 0; i < 24; i++) {
+        data[i] = static_cast<uint8_t>(i);
+    }
+
+    buffer.Enqueue(data, 24);
+    buffer.Drain(20);
+
+    // Wrap around the end
+    buffer.Enqueue(data, 24);
+    EXPECT_EQ(buffer.Count(), 28U);
+
+    buffer.Drain(14); // Past the end of the buffer
+    EXPECT_EQ(buffer.Count(), 14U);
+
+    uint8_t out[32];
+    ASSERT_EQ(buffer.Dequeue(out, sizeof(out)), 14);
+    EXPECT_EQ(out[0], 10);
+    EXPECT_EQ(out[13], 23);
+
+    buffer.Enqueue(data, 24);
+    buffer.Drain();
+    EXPECT_TRUE(buffer.Empty());
+    EXPECT_EQ(buffer.Count(), 0U);
+}
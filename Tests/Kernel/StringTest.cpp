@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include <String.h>
+
+TEST(String, Construct) {
+    String empty;
+    EXPECT_TRUE(empty.Empty());
+    EXPECT_EQ(empty.Length(), 0U);
+
+    String s("hello");
+    EXPECT_FALSE(s.Empty());
+    EXPECT_EQ(s.Length(), 5U);
+    EXPECT_STREQ(s.c_str(), "hello");
+}
+
+TEST(String, Copy) {
+    String s("a fairly long string that does not fit in one buffer round");
+    String copy(s);
+    EXPECT_STREQ(copy.c_str(), s.c_str());
+    EXPECT_NE(copy.Data(), s.Data());
+
+    String assigned("x");
+    assigned = s;
+    EXPECT_EQ(assigned.Compare(s), 0);
+}
+
+TEST(String, Move) {
+    String s("hello");
+    String moved(std::move(s));
+    EXPECT_STREQ(moved.c_str(), "hello");
+    EXPECT_TRUE(s.Empty());
+
+    String assigned("previous");
+    assigned = std::move(moved);
+    EXPECT_STREQ(assigned.c_str(), "hello");
+    EXPECT_TRUE(moved.Empty());
+}
+
+TEST(String, Append) {
+    String s("/system");
+    s += "/lib";
+    s += String("/libc.so");
+    EXPECT_STREQ(s.c_str(), "/system/lib/libc.so");
+    EXPECT_EQ(s.Length(), 19U);
+
+    // Enough to reallocate several times
+    String long_;
+    for (int i = 0; i < 100; i++) {
+        long_ += "0123456789";
+    }
+    EXPECT_EQ(long_.Length(), 1000U);
+    EXPECT_EQ(long_.c_str()[999], '9');
+    EXPECT_EQ(long_.c_str()[1000], '\0');
+
+    String joined = String("a") + String("b");
+    EXPECT_STREQ(joined.c_str(), "ab");
+}
+
+TEST(String, Compare) {
+    String s("abc");
+    EXPECT_EQ(s.Compare("abc"), 0);
+    EXPECT_LT(s.Compare("abd"), 0);
+    EXPECT_GT(s.Compare("ab"), 0);
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <Vector.h>
+
+#include "LiveObject.h"
+
+TEST(Vector, AddBack) {
+    Vector<int> v;
+    for (int i = 0; i < 1000; i++) {
+        v.add_back(i);
+    }
+
+    ASSERT_EQ(v.size(), 1000U);
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_EQ(v[i], i);
+    }
+}
+
+TEST(Vector, Iterate) {
+    Vector<int> v;
+    for (int i = 0; i < 100; i++) {
+        v.add_back(i);
+    }
+
+    int expected = 0;
+    for (int value : v) {
+        EXPECT_EQ(value, expected++);
+    }
+    EXPECT_EQ(expected, 100);
+}
+
+TEST(Vector, Erase) {
+    Vector<int> v;
+    for (int i = 0; i < 10; i++) {
+        v.add_back(i);
+    }
+
+    v.erase(0);
+    v.erase(4); // Was 5
+    v.erase(7); // Was 9, the last element
+
+    const int expected[] = {1, 2, 3, 4, 6, 7, 8};
+    ASSERT_EQ(v.size(), 7U);
+    for (unsigned i = 0; i < 7; i++) {
+        EXPECT_EQ(v[i], expected[i]);
+    }
+}
+
+TEST(Vector, Remove) {
+    Vector<int> v;
+    for (int i = 0; i < 10; i++) {
+        v.add_back(i);
+    }
+
+    v.remove(3);
+    v.remove(42); // Not present
+
+    ASSERT_EQ(v.size(), 9U);
+    EXPECT_EQ(v[3], 4);
+
+    v.add_back(10); // The lock must have been released
+    EXPECT_EQ(v[9], 10);
+}
+
+TEST(Vector, Copy) {
+    Vector<int> v;
+    for (int i = 0; i < 50; i++) {
+        v.add_back(i);
+    }
+
+    Vector<int> copy(v);
+    ASSERT_EQ(copy.size(), 50U);
+    for (int i = 0; i < 50; i++) {
+        EXPECT_EQ(copy[i], i);
+    }
+}
+
+TEST(Vector, PopBack) {
+    Vector<int> v;
+    v.add_back(1);
+    v.add_back(2);
+
+    EXPECT_EQ(v.pop_back(), 2);
+    EXPECT_EQ(v.pop_back(), 1);
+    EXPECT_EQ(v.size(), 0U);
+}
+
+TEST(Vector, Resize) {
+    Vector<int> v;
+    v.resize(100);
+    ASSERT_EQ(v.size(), 100U);
+
+    v[99] = 5;
+    v.resize(10);
+    EXPECT_EQ(v.size(), 10U);
+
+    v.clear();
+    EXPECT_EQ(v.size(), 0U);
+}
+
+TEST(Vector, ObjectLifetimes) {
+    LiveObject::live = 0;
+    {
+        Vector<LiveObject> v;
+        for (int i = 0; i < 100; i++) {
+            v.add_back(LiveObject(i));
+        }
+        EXPECT_EQ(LiveObject::live, 100);
+
+        for (int i = 0; i < 100; i++) {
+            EXPECT_EQ(v[i].value, i);
+        }
+
+        v.resize(200);
+        EXPECT_EQ(LiveObject::live, 200);
+
+        v.resize(50);
+        EXPECT_EQ(LiveObject::live, 50);
+    }
+}
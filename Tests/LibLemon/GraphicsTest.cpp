@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <Lemon/Graphics/Graphics.h>
+
+#include <vector>
+
+using namespace Lemon::Graphics;
+
+namespace {
+// Surface with its own buffer, every pixel starts as fill
+struct TestSurface {
+    surface_t surface;
+    std::vector<uint32_t> pixels;
+
+    TestSurface(int width, int height, uint32_t fill = 0) : pixels(width * height, fill) {
+        surface.width = width;
+        surface.height = height;
+        surface.buffer = reinterpret_cast<uint8_t*>(pixels.data());
+    }
+
+    uint32_t At(int x, int y) const { return pixels[y * surface.width + x]; }
+
+    // Number of pixels set to value
+    int Count(uint32_t value) const {
+        int count = 0;
+        for (uint32_t pixel : pixels) {
+            count += (pixel == value);
+        }
+        return count;
+    }
+};
+} // namespace
+
+TEST(Graphics, DrawRect) {
+    TestSurface s(64, 32);
+    DrawRect(4, 2, 10, 5, 0x12, 0x34, 0x56, &s.surface);
+
+    const uint32_t colour = 0xFF123456;
+    EXPECT_EQ(s.Count(colour), 50);
+    EXPECT_EQ(s.At(4, 2), colour);
+    EXPECT_EQ(s.At(13, 6), colour);
+    EXPECT_EQ(s.At(14, 6), 0U);
+    EXPECT_EQ(s.At(13, 7), 0U);
+}
+
+TEST(Graphics, DrawRectClipped) {
+    TestSurface s(16, 16);
+
+    // Hangs off every edge of the surface
+    DrawRect(-4, -4, 32, 32, 0xFF, 0xFF, 0xFF, &s.surface);
+    EXPECT_EQ(s.Count(0xFFFFFFFF), 16 * 16);
+
+    // Clipped to the mask
+    TestSurface masked(16, 16);
+    DrawRect(0, 0, 16, 16, 0, 0, 0xFF, &masked.surface, {4, 4, 2, 3});
+    EXPECT_EQ(masked.Count(0xFF0000FF), 6);
+    EXPECT_EQ(masked.At(4, 4), 0xFF0000FFU);
+    EXPECT_EQ(masked.At(5, 6), 0xFF0000FFU);
+
+    // Entirely outside
+    TestSurface outside(16, 16);
+    DrawRect(-20, 0, 10, 10, 0xFF, 0, 0, &outside.surface);
+    EXPECT_EQ(outside.Count(0), 16 * 16);
+}
+
+TEST(Graphics, SurfaceCopy) {
+    TestSurface src(8, 8);
+    for (int i = 0; i < 64; i++) {
+        src.pixels[i] = i + 1;
+    }
+
+    // Same size, copied in one go
+    TestSurface same(8, 8);
+    surfacecpy(&same.surface, &src.surface);
+    EXPECT_EQ(same.pixels, src.pixels);
+
+    TestSurface dest(16, 16);
+    surfacecpy(&dest.surface, &src.surface, {4, 6});
+    EXPECT_EQ(dest.At(4, 6), src.At(0, 0));
+    EXPECT_EQ(dest.At(11, 13), src.At(7, 7));
+    EXPECT_EQ(dest.At(3, 6), 0U);
+    EXPECT_EQ(dest.Count(0), 256 - 64);
+
+    // Partly off the top left and bottom right
+    TestSurface clipped(8, 8);
+    surfacecpy(&clipped.surface, &src.surface, {-2, -3});
+    EXPECT_EQ(clipped.At(0, 0), src.At(2, 3));
+    EXPECT_EQ(clipped.At(5, 4), src.At(7, 7));
+    EXPECT_EQ(clipped.Count(0), 64 - 6 * 5);
+
+    surfacecpy(&clipped.surface, &src.surface, {5, 6});
+    EXPECT_EQ(clipped.At(5, 6), src.At(0, 0));
+    EXPECT_EQ(clipped.At(7, 7), src.At(2, 1));
+}
+
+TEST(Graphics, SurfaceCopyRegion) {
+    TestSurface src(8, 8);
+    for (int i = 0; i < 64; i++) {
+        src.pixels[i] = i + 1;
+    }
+
+    TestSurface dest(16, 16);
+    surfacecpy(&dest.surface, &src.surface, {1, 2}, {2, 3, 4, 2});
+    EXPECT_EQ(dest.Count(0), 256 - 8);
+    EXPECT_EQ(dest.At(1, 2), src.At(2, 3));
+    EXPECT_EQ(dest.At(4, 3), src.At(5, 4));
+
+    // Partly off the top left
+    TestSurface clipped(16, 16);
+    surfacecpy(&clipped.surface, &src.surface, {-1, -1}, {0, 0, 4, 4});
+    EXPECT_EQ(clipped.Count(0), 256 - 9);
+    EXPECT_EQ(clipped.At(0, 0), src.At(1, 1));
+    EXPECT_EQ(clipped.At(2, 2), src.At(3, 3));
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <Lemon/Core/JSON.h>
+
+using namespace Lemon;
+
+static JSONValue Parse(const char* text) {
+    std::string_view sv(text);
+    JSONParser parser(sv);
+
+    return parser.Parse();
+}
+
+TEST(JSON, Values) {
+    JSONValue root = Parse(R"({
+        "string" : "hello \"world\"\n",
+        "unsigned" : 4096,
+        "signed" : -12,
+        "zero" : 0,
+        "float" : 1.5,
+        "true" : true,
+        "false" : false,
+        "null" : null
+    })");
+
+    ASSERT_TRUE(root.IsObject());
+    auto& object = *root.object;
+    EXPECT_EQ(object.size(), 8U);
+
+    EXPECT_EQ(object["string"].AsString(), "hello \"world\"\n");
+
+    EXPECT_TRUE(object["unsigned"].IsNumber());
+    EXPECT_FALSE(object["unsigned"].isSigned);
+    EXPECT_EQ(object["unsigned"].AsUnsignedNumber(), 4096U);
+
+    EXPECT_TRUE(object["signed"].isSigned);
+    EXPECT_EQ(object["signed"].AsSignedNumber(), -12);
+    EXPECT_EQ(object["zero"].AsSignedNumber(), 0);
+
+    EXPECT_TRUE(object["float"].isFloatingPoint);
+    EXPECT_FLOAT_EQ(object["float"].AsFloat(), 1.5f);
+
+    EXPECT_TRUE(object["true"].AsBool());
+    EXPECT_FALSE(object["false"].AsBool());
+    EXPECT_TRUE(object["null"].IsNull());
+}
+
+TEST(JSON, Nested) {
+    JSONValue root = Parse(R"({"users" : [{"name" : "root", "uid" : 0}, {"name" : "user", "uid" : 1000}]})");
+
+    ASSERT_TRUE(root.IsObject());
+    JSONValue users = root.object->at("users");
+    ASSERT_TRUE(users.IsArray());
+    ASSERT_EQ(users.array->size(), 2U);
+
+    JSONValue user = users.array->at(1);
+    ASSERT_TRUE(user.IsObject());
+    EXPECT_EQ(user.object->at("name").AsString(), "user");
+    EXPECT_EQ(user.object->at("uid").AsUnsignedNumber(), 1000U);
+}
+
+TEST(JSON, Invalid) {
+    EXPECT_TRUE(Parse(R"({"key" : tru})").IsNull());
+    EXPECT_TRUE(Parse(R"({"key" 1})").IsNull());
+    EXPECT_TRUE(Parse(R"({"key" : [1, 2})").IsNull());
+    EXPECT_TRUE(Parse(R"({"key" : "\q"})").IsNull()); // Unknown escape sequence
+    EXPECT_TRUE(Parse(R"([1, 2])").IsNull()); // The root must be an object
+}
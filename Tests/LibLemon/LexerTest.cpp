@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+
+#include <Lemon/Core/Lexer.h>
+
+using namespace Lemon;
+
+namespace {
+// Exposes the line counter
+class TestLexer : public BasicLexer {
+public:
+    TestLexer(const std::string_view& v) : BasicLexer(v) {}
+
+    int Line() const { return line; }
+};
+} // namespace
+
+TEST(BasicLexer, Eat) {
+    TestLexer lexer("key = value\n# comment\n");
+
+    EXPECT_EQ(lexer.EatWhile([](char c) { return isalpha(c); }), "key");
+    lexer.EatWhitespace();
+    EXPECT_TRUE(lexer.EatOne('='));
+    lexer.EatWhitespace(false);
+
+    EXPECT_EQ(lexer.Peek(), 'v');
+    EXPECT_EQ(lexer.Peek(4), 'e');
+    EXPECT_TRUE(lexer.EatWord("value"));
+    EXPECT_EQ(lexer.Line(), 1);
+
+    lexer.EatWhitespace();
+    EXPECT_EQ(lexer.Line(), 2);
+    EXPECT_FALSE(lexer.EatOne('!'));
+    EXPECT_EQ(lexer.Eat(), ' ');
+    EXPECT_FALSE(lexer.EatWord("commit"));
+
+    lexer.EatWhile([](char c) { return c != '\n'; });
+    EXPECT_EQ(lexer.Eat(), '\n');
+    EXPECT_TRUE(lexer.End());
+    EXPECT_EQ(lexer.Line(), 3);
+
+    lexer.Restart();
+    EXPECT_FALSE(lexer.End());
+    EXPECT_EQ(lexer.Peek(), 'k');
+}
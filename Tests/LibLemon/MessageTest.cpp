@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+
+#include <Lemon/IPC/Message.h>
+
+using namespace Lemon;
+
+TEST(Message, EncodeDecode) {
+    const uint8_t raw[] = {1, 2, 3, 4, 5};
+    Message m(42, static_cast<uint32_t>(7), std::string("hello"), static_cast<int16_t>(-3),
+              Message::EncodeGenericData(raw, sizeof(raw)), 1.5);
+
+    EXPECT_EQ(m.id(), 42U);
+    EXPECT_EQ(m.length(), sizeof(uint32_t) + 2 + 5 + sizeof(int16_t) + 2 + sizeof(raw) + sizeof(double));
+
+    uint32_t a;
+    std::string s;
+    int16_t b;
+    MessageRawDataObject data;
+    double d;
+    ASSERT_EQ(m.Decode(a, s, b, data, d), 0);
+
+    EXPECT_EQ(a, 7U);
+    EXPECT_EQ(s, "hello");
+    EXPECT_EQ(b, -3);
+    ASSERT_EQ(data.second, sizeof(raw));
+    EXPECT_EQ(memcmp(data.first, raw, sizeof(raw)), 0);
+    EXPECT_EQ(d, 1.5);
+
+    delete[] data.first;
+}
+
+TEST(Message, OutOfBounds) {
+    Message m(1, static_cast<uint32_t>(7), std::string("hi"));
+
+    uint32_t a;
+    std::string s;
+    uint64_t extra;
+    EXPECT_EQ(m.Decode(a, s, extra), Message::ErrorDecodeOutOfBounds);
+
+    // The string length claims more data than is in the message
+    uint8_t* buffer = new uint8_t[4];
+    *reinterpret_cast<uint16_t*>(buffer) = 100;
+    Message truncated(buffer, 4, 1);
+    EXPECT_EQ(truncated.Decode(s), Message::ErrorDecodeOutOfBounds);
+
+    Message empty;
+    EXPECT_EQ(empty.Decode(a), Message::ErrorBufferNotInitialized);
+}
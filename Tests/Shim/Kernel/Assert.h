@@ -0,0 +1,5 @@
+#pragma once
+
+// Kernel assertions become C library assertions, the tests are always built with assertions enabled
+#undef NDEBUG
+#include <assert.h>
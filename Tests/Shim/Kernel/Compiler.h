@@ -0,0 +1,7 @@
+#pragma once
+
+#define ALWAYS_INLINE __attribute__((always_inline)) inline
+
+// The kernel defines its own placement new, on the host it comes from the C++ library
+#include <new>
+#include <stddef.h>
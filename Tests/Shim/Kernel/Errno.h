@@ -0,0 +1,5 @@
+#pragma once
+
+// The kernel error numbers clash with the host ones, use the host ones instead
+
+#include <errno.h>
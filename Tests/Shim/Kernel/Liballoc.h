@@ -0,0 +1,11 @@
+#pragma once
+
+// The kernel heap is replaced by the C library allocator so that ASan and heap profilers see every allocation
+
+#include <stddef.h>
+#include <stdlib.h>
+
+inline void* kmalloc(size_t size) { return malloc(size); }
+inline void* krealloc(void* p, size_t size) { return realloc(p, size); }
+inline void* kcalloc(size_t count, size_t size) { return calloc(count, size); }
+inline void kfree(void* p) { free(p); }
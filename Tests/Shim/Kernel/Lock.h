@@ -0,0 +1,5 @@
+#pragma once
+
+// Only the spinlocks are needed, the sleeping locks depend on the scheduler
+
+#include <Spinlock.h>
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <Compiler.h>
+#include <Liballoc.h>
+#include <String.h>
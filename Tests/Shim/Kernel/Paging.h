@@ -0,0 +1,8 @@
+#pragma once
+
+// Only the page size is needed by the containers and DataStream
+
+#include <stdint.h>
+
+#define PAGE_SIZE_4K 4096U
+#define PAGE_COUNT_4K(size) (((size) + (PAGE_SIZE_4K - 1)) >> 12)
@@ -0,0 +1,9 @@
+#pragma once
+
+// Nothing is ever blocked on the host, threads only appear in pointers
+
+struct Thread;
+
+namespace Scheduler {
+inline void Yield() {}
+} // namespace Scheduler
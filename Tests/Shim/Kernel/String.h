@@ -0,0 +1,18 @@
+#pragma once
+
+// The kernel declares its own C string functions, some of which differ from the C library prototypes
+// (e.g. strcpy returns void). Rename those whilst the kernel header is parsed so the C library versions are used.
+
+#include <string.h>
+
+#define strcpy KernelStrcpy
+#define strncpy KernelStrncpy
+#define strchr KernelStrchr
+#define strrchr KernelStrrchr
+
+#include_next <String.h>
+
+#undef strcpy
+#undef strncpy
+#undef strchr
+#undef strrchr
@@ -0,0 +1,38 @@
+#pragma once
+
+// There is no user memory on the host, any address is accessible
+// except for the range tests mark as faulting with userFaultBase and userFaultSize
+
+#include <Errno.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define USER_BOUNCE_SIZE 0x10000
+
+inline uintptr_t userFaultBase = 0;
+inline size_t userFaultSize = 0;
+
+inline bool UserRangeFaults(const void* ptr, size_t size) {
+    uintptr_t base = reinterpret_cast<uintptr_t>(ptr);
+    return size && userFaultSize && base < userFaultBase + userFaultSize && userFaultBase < base + size;
+}
+
+[[nodiscard]] inline long copy_from_user(void* dest, const void* src, size_t size) {
+    if (UserRangeFaults(src, size)) {
+        return -EFAULT;
+    }
+
+    memcpy(dest, src, size);
+    return 0;
+}
+
+[[nodiscard]] inline long copy_to_user(void* dest, const void* src, size_t size) {
+    if (UserRangeFaults(dest, size)) {
+        return -EFAULT;
+    }
+
+    memcpy(dest, src, size);
+    return 0;
+}
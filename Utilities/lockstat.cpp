@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Kernel lock contention statistics, only present when the kernel is built with kernel_lock_stats
+const char* lockStatsPath = "/dev/lockstat";
+
+struct LockClassStats {
+    std::string name;
+    uint64_t acquisitions;
+    uint64_t contended;
+    uint64_t waitCycles;
+    uint64_t maxHoldCycles;
+};
+
+enum SortKey {
+    SortContended,
+    SortWait,
+    SortHold,
+    SortAcquisitions,
+};
+
+uint64_t SortValue(const LockClassStats& s, int key){
+    switch(key){
+        case SortWait:
+            return s.waitCycles;
+        case SortHold:
+            return s.maxHoldCycles;
+        case SortAcquisitions:
+            return s.acquisitions;
+        case SortContended:
+        default:
+            return s.contended;
+    }
+}
+
+void Usage(const char* name){
+    printf("Usage: %s [-s contended|wait|hold|acquisitions] [-a] [-r]\n"
+           "    -s  Sort key (default contended)\n"
+           "    -a  Show locks that were never acquired\n"
+           "    -r  Reset the statistics\n", name);
+}
+
+int main(int argc, char** argv){
+    int sortKey = SortContended;
+    bool showAll = false;
+    bool reset = false;
+
+    int opt;
+    while((opt = getopt(argc, argv, "s:arh")) >= 0){
+        switch(opt){
+            case 's':
+                if(!strcmp(optarg, "contended")){
+                    sortKey = SortContended;
+                } else if(!strcmp(optarg, "wait")){
+                    sortKey = SortWait;
+                } else if(!strcmp(optarg, "hold")){
+                    sortKey = SortHold;
+                } else if(!strcmp(optarg, "acquisitions")){
+                    sortKey = SortAcquisitions;
+                } else {
+                    Usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'a':
+                showAll = true;
+                break;
+            case 'r':
+                reset = true;
+                break;
+            case 'h':
+                Usage(argv[0]);
+                return 0;
+            case '?':
+                Usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if(reset){
+        FILE* f = fopen(lockStatsPath, "wb");
+        if(!f || fwrite("0", 1, 1, f) != 1){
+            fprintf(stderr, "Failed to reset %s: %s\n", lockStatsPath, strerror(errno));
+            return 1;
+        }
+
+        fclose(f);
+        return 0;
+    }
+
+    FILE* f = fopen(lockStatsPath, "rb");
+    if(!f){
+        fprintf(stderr, "Failed to open %s: %s (is the kernel built with kernel_lock_stats?)\n", lockStatsPath, strerror(errno));
+        return 1;
+    }
+
+    std::vector<LockClassStats> locks;
+
+    char name[64];
+    LockClassStats s;
+    while(fscanf(f, "%63s %lu %lu %lu %lu", name, &s.acquisitions, &s.contended, &s.waitCycles, &s.maxHoldCycles) == 5){
+        s.name = name;
+
+        if(showAll || s.acquisitions){
+            locks.push_back(s);
+        }
+    }
+
+    fclose(f);
+
+    std::sort(locks.begin(), locks.end(), [sortKey](const LockClassStats& l, const LockClassStats& r) -> bool {
+        return SortValue(l, sortKey) > SortValue(r, sortKey);
+    });
+
+    printf("%-12s %14s %12s %8s %16s %14s %14s\n", "Lock:", "Acquisitions:", "Contended:", "%:", "Wait (cycles):", "Avg wait:", "Max hold:");
+    for(const LockClassStats& lock : locks){
+        double contendedPercent = lock.acquisitions ? (100.0 * lock.contended / lock.acquisitions) : 0;
+        uint64_t averageWait = lock.contended ? (lock.waitCycles / lock.contended) : 0;
+
+        printf("%-12s %14lu %12lu %7.2f%% %16lu %14lu %14lu\n", lock.name.c_str(), lock.acquisitions, lock.contended,
+            contendedPercent, lock.waitCycles, averageWait, lock.maxHoldCycles);
+    }
+
+    return 0;
+}
@@ -0,0 +1,359 @@
+#include <Lemon/System/ABI/Profiler.h>
+#include <Lemon/System/Util.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <elf.h>
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Sampling profiler frontend, see Documentation/Kernel/Profiler.md
+const char* kernelSymbolsPath = "/initrd/kernel.map";
+
+#define KERNEL_ADDRESS_BASE 0xFFFF800000000000
+#define READ_INTERVAL_MS 100 // Drain the kernel buffers often enough that they do not fill
+
+struct Symbol {
+    uint64_t address;
+    std::string name;
+};
+
+std::vector<Symbol> kernelSymbols;
+std::vector<Symbol> userSymbols;
+
+std::vector<lemon_profiler_sample_t> samples;
+std::unordered_map<int64_t, std::string> processNames;
+
+// nm output, <address> <type> <name>
+void LoadKernelSymbols(){
+    FILE* f = fopen(kernelSymbolsPath, "r");
+    if(!f){
+        fprintf(stderr, "Warning: Failed to open %s: %s, kernel addresses will not be resolved\n", kernelSymbolsPath, strerror(errno));
+        return;
+    }
+
+    char line[512];
+    while(fgets(line, sizeof(line), f)){
+        char* end;
+        uint64_t address = strtoull(line, &end, 16);
+        if(end == line || strlen(end) < 4){
+            continue; // Undefined symbol or invalid line
+        }
+
+        char type = end[1];
+        if(type != 'T' && type != 't' && type != 'W' && type != 'w'){
+            continue; // Only interested in code
+        }
+
+        std::string name = end + 3;
+        if(!name.empty() && name.back() == '\n'){
+            name.pop_back();
+        }
+
+        kernelSymbols.push_back({address, name});
+    }
+
+    fclose(f);
+}
+
+// Functions from the symbol table of an executable, only makes sense for executables loaded at their link address
+int LoadUserSymbols(const char* path){
+    FILE* f = fopen(path, "rb");
+    if(!f){
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    std::vector<uint8_t> buffer(size);
+    if(size < (long)sizeof(Elf64_Ehdr) || fread(buffer.data(), 1, size, f) != (size_t)size){
+        fprintf(stderr, "Failed to read %s\n", path);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    Elf64_Ehdr* header = reinterpret_cast<Elf64_Ehdr*>(buffer.data());
+    if(memcmp(header->e_ident, ELFMAG, SELFMAG) || header->e_shoff + header->e_shnum * sizeof(Elf64_Shdr) > (uint64_t)size){
+        fprintf(stderr, "%s: Not a valid ELF file\n", path);
+        return -1;
+    }
+
+    Elf64_Shdr* sections = reinterpret_cast<Elf64_Shdr*>(buffer.data() + header->e_shoff);
+    for(unsigned i = 0; i < header->e_shnum; i++){
+        Elf64_Shdr& section = sections[i];
+        if(section.sh_type != SHT_SYMTAB || section.sh_link >= header->e_shnum){
+            continue;
+        }
+
+        Elf64_Shdr& strtab = sections[section.sh_link];
+        if(section.sh_offset + section.sh_size > (uint64_t)size || strtab.sh_offset + strtab.sh_size > (uint64_t)size){
+            continue;
+        }
+
+        Elf64_Sym* symbols = reinterpret_cast<Elf64_Sym*>(buffer.data() + section.sh_offset);
+        const char* names = reinterpret_cast<const char*>(buffer.data() + strtab.sh_offset);
+        for(size_t j = 0; j < section.sh_size / sizeof(Elf64_Sym); j++){
+            if(ELF64_ST_TYPE(symbols[j].st_info) != STT_FUNC || !symbols[j].st_value || symbols[j].st_name >= strtab.sh_size){
+                continue;
+            }
+
+            userSymbols.push_back({symbols[j].st_value, names + symbols[j].st_name});
+        }
+    }
+
+    return 0;
+}
+
+void SortSymbols(std::vector<Symbol>& symbols){
+    std::sort(symbols.begin(), symbols.end(), [](const Symbol& l, const Symbol& r) -> bool {
+        return l.address < r.address;
+    });
+}
+
+// Closest symbol at or below the address
+std::string ResolveAddress(uint64_t address){
+    const std::vector<Symbol>& symbols = (address >= KERNEL_ADDRESS_BASE) ? kernelSymbols : userSymbols;
+
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), address, [](uint64_t a, const Symbol& s) -> bool {
+        return a < s.address;
+    });
+
+    if(it != symbols.begin()){
+        return std::prev(it)->name;
+    }
+
+    char hex[20];
+    snprintf(hex, sizeof(hex), "0x%lx", address);
+    return hex;
+}
+
+const std::string& ProcessName(int64_t pid){
+    auto it = processNames.find(pid);
+    if(it != processNames.end()){
+        return it->second;
+    }
+
+    lemon_process_info_t info;
+    std::string name;
+    if(Lemon::GetProcessInfo(pid, info)){
+        name = "pid " + std::to_string(pid); // Has exited
+    } else {
+        name = info.name;
+    }
+
+    return processNames[pid] = name;
+}
+
+int SetFrequency(unsigned frequency){
+    int fd = open(LEMON_PROFILER_DEVICE, O_WRONLY);
+    if(fd < 0){
+        return -1;
+    }
+
+    std::string text = std::to_string(frequency);
+    if(write(fd, text.c_str(), text.length()) != (ssize_t)text.length()){
+        close(fd);
+        return -1;
+    }
+
+    close(fd);
+    return 0;
+}
+
+void ReadSamples(int fd, int64_t pid){
+    lemon_profiler_sample_t buffer[64];
+
+    ssize_t ret;
+    while((ret = read(fd, buffer, sizeof(buffer))) > 0){
+        for(size_t i = 0; i < ret / sizeof(lemon_profiler_sample_t); i++){
+            if(pid < 0 || buffer[i].pid == pid){
+                samples.push_back(buffer[i]);
+            }
+        }
+    }
+}
+
+// One line per unique stack, process;outermost;...;innermost count
+int WriteFoldedStacks(const char* path){
+    FILE* f = fopen(path, "w");
+    if(!f){
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    std::map<std::string, uint64_t> stacks;
+    for(const lemon_profiler_sample_t& s : samples){
+        std::string stack = ProcessName(s.pid);
+        for(int i = s.depth - 1; i >= 0; i--){
+            stack += ';';
+            stack += ResolveAddress(s.frames[i]);
+        }
+
+        stacks[stack]++;
+    }
+
+    for(auto& stack : stacks){
+        fprintf(f, "%s %lu\n", stack.first.c_str(), stack.second);
+    }
+
+    fclose(f);
+    return 0;
+}
+
+void PrintFlatProfile(unsigned count){
+    struct FunctionStats {
+        std::string name;
+        uint64_t self = 0; // Samples in the function itself
+        uint64_t total = 0; // Samples in the function or anything it called
+    };
+
+    std::unordered_map<std::string, FunctionStats> functions;
+    uint64_t userSamples = 0;
+    for(const lemon_profiler_sample_t& s : samples){
+        if(s.flags & LEMON_PROFILER_SAMPLE_USER){
+            userSamples++;
+        }
+
+        std::vector<std::string> seen; // Only count recursive functions once
+        for(unsigned i = 0; i < s.depth; i++){
+            std::string name = ResolveAddress(s.frames[i]);
+
+            FunctionStats& stats = functions[name];
+            stats.name = name;
+            if(i == 0){
+                stats.self++;
+            }
+
+            if(std::find(seen.begin(), seen.end(), name) == seen.end()){
+                stats.total++;
+                seen.push_back(name);
+            }
+        }
+    }
+
+    std::vector<FunctionStats> sorted;
+    for(auto& f : functions){
+        sorted.push_back(f.second);
+    }
+
+    std::sort(sorted.begin(), sorted.end(), [](const FunctionStats& l, const FunctionStats& r) -> bool {
+        return l.self > r.self || (l.self == r.self && l.total > r.total);
+    });
+
+    printf("%lu samples, %.2f%% in usermode\n\n", samples.size(), 100.0 * userSamples / samples.size());
+    printf("%8s %8s %8s  %s\n", "Self:", "Self %:", "Total %:", "Function:");
+    for(unsigned i = 0; i < sorted.size() && i < count; i++){
+        const FunctionStats& f = sorted[i];
+        printf("%8lu %7.2f%% %7.2f%%  %s\n", f.self, 100.0 * f.self / samples.size(), 100.0 * f.total / samples.size(), f.name.c_str());
+    }
+}
+
+void Usage(const char* name){
+    printf("Usage: %s [-f frequency] [-t seconds] [-p pid] [-e executable] [-n count] [-o file]\n"
+           "    -f  Sampling frequency in Hz (default 1000, max %d)\n"
+           "    -t  Time to sample for in seconds (default 5)\n"
+           "    -p  Only keep samples from the process\n"
+           "    -e  Resolve user addresses with the symbols of an executable\n"
+           "    -n  Number of functions to show (default 25)\n"
+           "    -o  Write folded stacks for flame graphs to a file\n", name, LEMON_PROFILER_MAX_FREQUENCY);
+}
+
+int main(int argc, char** argv){
+    unsigned frequency = 1000;
+    unsigned seconds = 5;
+    int64_t pid = -1;
+    unsigned count = 25;
+    const char* foldedPath = nullptr;
+
+    int opt;
+    while((opt = getopt(argc, argv, "f:t:p:e:n:o:h")) >= 0){
+        switch(opt){
+            case 'f':
+                frequency = strtoul(optarg, nullptr, 10);
+                if(!frequency || frequency > LEMON_PROFILER_MAX_FREQUENCY){
+                    Usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 't':
+                seconds = strtoul(optarg, nullptr, 10);
+                break;
+            case 'p':
+                pid = strtol(optarg, nullptr, 10);
+                break;
+            case 'e':
+                if(LoadUserSymbols(optarg)){
+                    return 1;
+                }
+                break;
+            case 'n':
+                count = strtoul(optarg, nullptr, 10);
+                break;
+            case 'o':
+                foldedPath = optarg;
+                break;
+            case 'h':
+                Usage(argv[0]);
+                return 0;
+            case '?':
+                Usage(argv[0]);
+                return 2;
+        }
+    }
+
+    LoadKernelSymbols();
+    SortSymbols(kernelSymbols);
+    SortSymbols(userSymbols);
+
+    int fd = open(LEMON_PROFILER_DEVICE, O_RDONLY);
+    if(fd < 0){
+        fprintf(stderr, "Failed to open %s: %s\n", LEMON_PROFILER_DEVICE, strerror(errno));
+        return 1;
+    }
+
+    ReadSamples(fd, pid); // Discard anything left over from a previous run
+    samples.clear();
+
+    if(SetFrequency(frequency)){
+        fprintf(stderr, "Failed to start the profiler: %s\n", strerror(errno));
+        close(fd);
+        return 1;
+    }
+
+    for(unsigned elapsed = 0; elapsed < seconds * 1000; elapsed += READ_INTERVAL_MS){
+        usleep(READ_INTERVAL_MS * 1000);
+        ReadSamples(fd, pid);
+    }
+
+    SetFrequency(0);
+    ReadSamples(fd, pid);
+    close(fd);
+
+    if(samples.empty()){
+        printf("No samples\n");
+        return 0;
+    }
+
+    PrintFlatProfile(count);
+
+    if(foldedPath && WriteFoldedStacks(foldedPath)){
+        return 1;
+    }
+
+    return 0;
+}
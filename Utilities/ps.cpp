@@ -1,17 +1,37 @@
 #include <Lemon/System/Util.h>
 
 #include <stdio.h>
+#include <string.h>
 
 #include <vector>
 
 int main(int argc, char** argv){
+    bool showFPU = false; // Show FPU state switching counters
+    for(int i = 1; i < argc; i++){
+        if(!strcmp(argv[i], "-f")){
+            showFPU = true;
+        } else {
+            fprintf(stderr, "Usage: %s [-f]\n", argv[0]);
+            return 1;
+        }
+    }
+
     std::vector<lemon_process_info_t> procs;
     Lemon::GetProcessList(procs);
 
+    if(showFPU){
+        printf("Process:        PID:   FPU Saves:  FPU Restores:  FPU Traps:\n\n");
+        for(lemon_process_info_t proc : procs){
+            printf("%14s  %4d  %10lu  %13lu  %10lu\n", proc.name, proc.pid, proc.fpuSaves, proc.fpuRestores, proc.fpuTraps);
+        }
+
+        return 0;
+    }
+
     printf("Process:        PID:   Uptime:\n\n");
     for(lemon_process_info_t proc : procs){
         printf("%14s  %4d  %lus\n", proc.name, proc.pid, proc.runningTime);
     }
 
     return 0;
-}
\ No newline at end of file
+}